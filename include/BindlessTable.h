@@ -0,0 +1,107 @@
+// Bindless resources: one descriptor set holding large arrays of every texture and storage
+// buffer in use, bound once per command buffer instead of a set per draw. Resources are
+// registered into a free slot of the arrays and draws refer to them by that slot index, as
+// push constant or instance data, indexed with nonuniformEXT in the shaders. The set is
+// created update-after-bind and partially bound (VK_EXT_descriptor_indexing), so slots can be
+// written while frames using other slots are in flight. A released slot is reused only after
+// the frames that may still read it have retired.
+//
+// Shader side, set 'setIndex':
+//   layout(set = N, binding = 0) uniform sampler2D textures[];
+//   layout(set = N, binding = 1) buffer Buffers { uint data[]; } buffers[];
+
+#pragma once
+
+#include "Headers.h"
+
+class VulkanDevice;
+struct DeviceFeatures;
+
+typedef uint32_t BindlessHandle;
+const BindlessHandle INVALID_BINDLESS_HANDLE = UINT32_MAX;
+
+struct BindlessStats {
+    uint64_t texturesRegistered;
+    uint64_t buffersRegistered;
+    uint32_t texturesInUse;
+    uint32_t buffersInUse;
+    uint32_t peakTextures;
+    uint32_t peakBuffers;
+    uint64_t descriptorWrites; // vkUpdateDescriptorSets calls.
+};
+
+class BindlessTable {
+public:
+    static const uint32_t TEXTURE_BINDING = 0;
+    static const uint32_t BUFFER_BINDING = 1;
+    static const uint32_t DEFAULT_MAX_TEXTURES = 16384;
+    static const uint32_t DEFAULT_MAX_BUFFERS = 4096;
+
+    BindlessTable();
+    ~BindlessTable();
+
+    // Asks for the descriptor indexing features the table needs, before the device is created.
+    static void requestFeatures(DeviceFeatures& features);
+
+    // Whether the device was created with those features.
+    static bool isSupported(const VulkanDevice* deviceObj);
+
+    // Array sizes are clamped to the limits of the device.
+    void createBindlessTable(VulkanDevice* deviceObj, uint32_t maxTextures = DEFAULT_MAX_TEXTURES,
+        uint32_t maxBuffers = DEFAULT_MAX_BUFFERS);
+    void destroyBindlessTable(); // The caller makes sure no frame using the set is in flight.
+
+    // Writes the resource into a free slot and returns its index, INVALID_BINDLESS_HANDLE when
+    // the array is full. The slot may be used by command buffers submitted from now on.
+    BindlessHandle registerTexture(VkImageView view, VkSampler sampler, VkImageLayout layout);
+    BindlessHandle registerBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+    // Rewrites a slot in place, for a resource that was recreated. Frames in flight that use
+    // the slot must have retired.
+    void updateTexture(BindlessHandle handle, VkImageView view, VkSampler sampler, VkImageLayout layout);
+    void updateBuffer(BindlessHandle handle, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+    // Gives the slot back once the frame being recorded has retired. The resource itself must
+    // stay alive until then too (see DeletionQueue).
+    void releaseTexture(BindlessHandle handle);
+    void releaseBuffer(BindlessHandle handle);
+
+    // Starts frame 'frameNumber' and recycles the slots released by frames below 'retiredFrameCount'.
+    void beginFrame(uint64_t frameNumber, uint64_t retiredFrameCount);
+
+    // Binds the table as set 'setIndex' of 'pipelineLayout', which was created with getLayout() there.
+    void bind(VkCommandBuffer cmdBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t setIndex) const;
+
+    VkDescriptorSetLayout getLayout() const { return setLayout; }
+    uint32_t getMaxTextures() const { return maxTextures; }
+    uint32_t getMaxBuffers() const { return maxBuffers; }
+    const BindlessStats& getStats() const { return stats; }
+    void printStats() const;
+
+private:
+    struct ReleasedSlot {
+        uint32_t binding;
+        BindlessHandle handle;
+        uint64_t frameNumber; // Frame that released it.
+    };
+
+    void writeTexture(BindlessHandle handle, VkImageView view, VkSampler sampler, VkImageLayout layout);
+    void writeBuffer(BindlessHandle handle, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+
+    VulkanDevice* deviceObj;
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool pool;
+    VkDescriptorSet set;
+    uint32_t maxTextures;
+    uint32_t maxBuffers;
+
+    // Slots never used are handed out in order, released ones from the free lists first.
+    uint32_t textureHighWater;
+    uint32_t bufferHighWater;
+    std::vector<BindlessHandle> freeTextures;
+    std::vector<BindlessHandle> freeBuffers;
+    std::vector<ReleasedSlot> releasedSlots; // Waiting for their frame to retire, in release order.
+    uint64_t currentFrame;
+
+    BindlessStats stats;
+};
@@ -0,0 +1,73 @@
+// Compact record of the layers and extensions exposed by the loader and by every
+// physical device. Extension enumeration loads every layer library, which is slow on
+// machines with many layers, so it runs on worker threads and the results are kept in
+// a file. The next start up only lists the layers and device properties (cheap) and
+// reuses the file as long as the loader version, the layer list and the driver
+// versions are unchanged. The instance extensions of the drivers themselves are
+// enumerated on every start up, installing a driver changes none of the above.
+
+#pragma once
+
+#include "Headers.h"
+#include "VulkanLayerAndExtension.h"
+#include <string>
+
+struct DeviceCapabilities {
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    LayerProperties implementation; // Extensions of the driver itself, the layer name is empty.
+    std::vector<LayerProperties> layers; // Device extensions per instance layer.
+};
+
+class CapabilityDatabase {
+public:
+    CapabilityDatabase();
+    ~CapabilityDatabase();
+
+    // Reads the database written by an earlier run, entries are only used once they are
+    // validated against the running system. An empty path disables the file.
+    void loadDatabase(const std::string& filePath);
+    bool saveDatabase(); // Writes the file if anything had to be enumerated.
+
+    // Instance layers and their extensions, from the file or enumerated in parallel.
+    VkResult enumerateInstance();
+
+    // Device extensions for every layer of every device, from the file or enumerated in parallel.
+    VkResult enumerateDevices(const std::vector<VkPhysicalDevice>& gpus);
+
+    const std::vector<LayerProperties>& getInstanceLayers() const { return instanceLayers; }
+    const LayerProperties& getInstanceImplementation() const { return instanceImplementation; }
+    const DeviceCapabilities* findDevice(VkPhysicalDevice gpu) const; // NULL if not enumerated.
+
+    uint32_t getLoaderVersion() const { return loaderVersion; }
+    bool isInstanceFromCache() const { return instanceFromCache; }
+    uint32_t getDevicesFromCache() const { return devicesFromCache; } // Identical GPUs share one entry.
+    void printSummary() const;
+
+private:
+    static uint32_t queryLoaderVersion();
+    static bool sameLayers(const std::vector<LayerProperties>& a, const std::vector<VkLayerProperties>& b);
+    static bool sameExtensions(const LayerProperties& a, const LayerProperties& b);
+    static void enumerateExtensions(std::vector<LayerProperties>& layers, const std::vector<VkPhysicalDevice>& gpus);
+
+    std::string filePath;
+    bool dirty; // Something was enumerated, the file is stale.
+
+    uint32_t loaderVersion;
+    LayerProperties instanceImplementation; // Extensions of the loader and drivers, not of a layer.
+    std::vector<LayerProperties> instanceLayers;
+    std::vector<DeviceCapabilities> devices; // Devices of this run and stored ones not matched (yet).
+    std::vector<std::pair<VkPhysicalDevice, size_t> > deviceIndices; // Running devices into 'devices'.
+
+    // Entries read from the file, moved to the live lists once they validate.
+    uint32_t cachedLoaderVersion;
+    LayerProperties cachedInstanceImplementation;
+    std::vector<LayerProperties> cachedInstanceLayers;
+
+    double instanceMs;
+    double deviceMs;
+    bool instanceFromCache;
+    uint32_t devicesFromCache;
+};
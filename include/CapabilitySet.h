@@ -0,0 +1,96 @@
+// Hashed view of the layers and extensions available at one level (instance or device).
+// Names are interned once when the set is built, afterwards every support query is a
+// single hash lookup. The set also turns a list of required and optional extensions
+// into the list to enable: dependencies first, unsupported optional ones dropped.
+// It only looks at the enumerated properties, so it can be built from made-up data.
+
+#pragma once
+
+#include "Headers.h"
+#include <string>
+#include <deque>
+#include <unordered_map>
+
+struct LayerProperties {
+    VkLayerProperties properties;
+    std::vector<VkExtensionProperties> extensions;
+};
+
+enum CapabilityLevel {
+    CAPABILITY_LEVEL_INSTANCE,
+    CAPABILITY_LEVEL_DEVICE
+};
+
+class CapabilitySet {
+public:
+    CapabilitySet();
+    ~CapabilitySet();
+
+    // The hash maps point into 'names', a copy would point into the original.
+    CapabilitySet(const CapabilitySet&) = delete;
+    CapabilitySet& operator=(const CapabilitySet&) = delete;
+
+    // Rebuilds the set from the implementation's extensions and the extensions of every layer.
+    void build(CapabilityLevel level, const LayerProperties& implementation, const std::vector<LayerProperties>& layers);
+    void clear();
+
+    bool hasLayer(const char* layerName) const;
+    bool hasExtension(const char* extensionName) const; // Provided by the implementation or any layer.
+
+    // NULL for extensions of the implementation, otherwise the layer that has to be enabled.
+    const char* getProvidingLayer(const char* extensionName) const;
+    uint32_t getExtensionSpecVersion(const char* extensionName) const; // 0 if unsupported.
+
+    // The requested layers that are supported, in their original order.
+    std::vector<const char*> filterLayers(const std::vector<const char*>& requestedLayers) const;
+
+    /*
+     * Builds the ordered list of extensions to enable: every extension comes after the
+     * extensions it depends on. Missing 'required' extensions (or missing dependencies
+     * of them) are collected in 'missing' and make the call return false. 'optional'
+     * extensions are enabled when they and their dependencies are supported. Device
+     * extensions depending on instance extensions are checked against 'enabledInstanceExtensions'.
+     * The names in 'enableList' are interned and live as long as the set.
+     */
+    bool resolveExtensions(const std::vector<const char*>& required,
+        const std::vector<const char*>& optional,
+        std::vector<const char*>& enableList,
+        std::vector<const char*>* missing = NULL,
+        const CapabilitySet* enabledInstanceExtensions = NULL) const;
+
+    // Interns the names of an enable list, e.g. to answer "is X enabled" in O(1).
+    void buildEnabled(CapabilityLevel level, const std::vector<const char*>& layerNames, const std::vector<const char*>& extensionNames);
+
+    size_t getExtensionCount() const { return extensions.size(); }
+
+private:
+    struct CStringHash {
+        size_t operator()(const char* str) const
+        {
+            // FNV-1a
+            size_t hash = (size_t)2166136261u;
+            for (; *str; str++) {
+                hash = (hash ^ (unsigned char)*str) * (size_t)16777619u;
+            }
+            return hash;
+        }
+    };
+    struct CStringEqual {
+        bool operator()(const char* a, const char* b) const { return strcmp(a, b) == 0; }
+    };
+
+    struct ExtensionInfo {
+        uint32_t specVersion;
+        const char* layerName; // NULL for the implementation.
+    };
+
+    const char* intern(const char* name);
+    bool enableExtension(const char* name, std::vector<const char*>& enableList,
+        std::unordered_map<const char*, bool, CStringHash, CStringEqual>& visited,
+        std::vector<const char*>* missing, const CapabilitySet* enabledInstanceExtensions) const;
+
+    CapabilityLevel level;
+    std::deque<std::string> names; // Interned strings, a deque never moves its elements.
+    std::unordered_map<const char*, const char*, CStringHash, CStringEqual> layers; // Name -> interned name.
+    std::unordered_map<const char*, ExtensionInfo, CStringHash, CStringEqual> extensions; // Keys are interned.
+};
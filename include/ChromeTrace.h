@@ -0,0 +1,32 @@
+// Writer for the Chrome trace event format (chrome://tracing, Perfetto). Every timed
+// scope becomes one complete ("X") event; 'pid' separates the timelines of different
+// sources, 'tid' the tracks inside one of them.
+
+#pragma once
+
+#include "Headers.h"
+#include <string>
+
+struct TraceEvent {
+    std::string name;
+    const char* category; // Static string, e.g. "gpu" or "cpu".
+    double startUs; // Microseconds since the start of the trace.
+    double durationUs;
+    uint32_t pid;
+    uint32_t tid;
+};
+
+class ChromeTrace {
+public:
+    // Appends 'event' as one JSON object, without a separating comma.
+    static void appendEvent(std::string& json, const TraceEvent& event);
+
+    // Names a pid/tid in the viewer, 'tid' UINT32_MAX names the process.
+    static void appendTrackName(std::string& json, uint32_t pid, uint32_t tid, const char* name);
+
+    // Writes {"traceEvents": [...]} with the already formatted 'eventList' (comma separated).
+    // The file is replaced only once it is fully written.
+    static bool writeTrace(const std::string& filePath, const std::string& eventList);
+
+    static void appendEscaped(std::string& json, const char* text);
+};
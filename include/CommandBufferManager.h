@@ -1,13 +1,199 @@
 #pragma once
 
 #include "Headers.h"
+#include "FencePool.h"
+#include <unordered_map>
+
+class DebugUtils;
+class VulkanDevice;
+struct DeviceFeatures;
 
 /***************COMMAND BUFFER WRAPPERS***************/
 class CommandBufferMgr
 {
 public:
-    static void allocCommandBuffer(const VkDevice* device, const VkCommandPool cmdPool,VkCommandBuffer* cmdBuffer, const VkCommandBufferAllocateInfo* cmdBufferAllocateInfo = NULL);
+    // 'name' labels every allocated command buffer when 'debugUtils' is given.
+    static void allocCommandBuffer(const VkDevice* device, const VkCommandPool cmdPool,VkCommandBuffer* cmdBuffer, const VkCommandBufferAllocateInfo* cmdBufferAllocateInfo = NULL,
+        const DebugUtils* debugUtils = NULL, const char* name = NULL);
     static void beginCommandBuffer(VkCommandBuffer cmdBuffer, VkCommandBufferBeginInfo* inCmdBufferBeginInfo = NULL);
     static void endCommandBuffer(VkCommandBuffer cmdBuffer);
     static void submitCommandBuffer(const VkQueue& queue, const VkCommandBuffer* cmdBufferList, const VkSubmitInfo* submitInfo = NULL, const VkFence& fence = VK_NULL_HANDLE);
-};
\ No newline at end of file
+
+    // Non-blocking submission: returns immediately with a token backed by a pooled fence.
+    // Access to 'queue' must be externally synchronized as for any vkQueueSubmit.
+    static SubmitToken submitCommandBufferAsync(const VkQueue& queue, FencePool& fencePool, const VkCommandBuffer* cmdBufferList, uint32_t cmdBufferCount = 1, const VkSubmitInfo* submitInfo = NULL);
+    // Submit many VkSubmitInfo in a single vkQueueSubmit, signaled by one token.
+    static SubmitToken submitCommandBufferBatch(const VkQueue& queue, FencePool& fencePool, const VkSubmitInfo* submitInfoList, uint32_t submitInfoCount);
+
+    // Queue family ownership transfer of an exclusive resource: the release barrier is recorded
+    // into 'releaseCmdBuffer' (executed on the source family), the matching acquire barrier into
+    // 'acquireCmdBuffer' (executed on the destination family). The caller orders the two
+    // submissions with a semaphore. Nothing is recorded when both families are the same.
+    static void transferBufferOwnership(VkCommandBuffer releaseCmdBuffer, VkCommandBuffer acquireCmdBuffer,
+        VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t srcQueueFamily, uint32_t dstQueueFamily,
+        VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
+    static void transferImageOwnership(VkCommandBuffer releaseCmdBuffer, VkCommandBuffer acquireCmdBuffer,
+        VkImage image, const VkImageSubresourceRange& range, VkImageLayout oldLayout, VkImageLayout newLayout,
+        uint32_t srcQueueFamily, uint32_t dstQueueFamily,
+        VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
+};
+
+struct BarrierBuilderStats {
+    uint64_t flushes; // With at least one barrier.
+    uint64_t imageUses;
+    uint64_t imageBarriers;
+    uint64_t bufferBarriers;
+    uint64_t memoryBarriers;
+    uint64_t skippedBarriers; // Subresource ranges used with no layout change and no hazard.
+    uint64_t mergedBarriers; // Folded into a range, a stage pair, or a later use of the same subresource.
+};
+
+// Collects the image, buffer and memory barriers of a pass and records them in one
+// vkCmdPipelineBarrier, or vkCmdPipelineBarrier2KHR with VK_KHR_synchronization2. Without it the
+// stage masks of the barriers are combined, with it each barrier keeps its own.
+//
+// Tracked images keep the layout and the last accesses of every mip level and array layer, so a
+// use only produces a barrier when it changes the layout or has a hazard with the accesses before
+// it. Neighbouring subresources with the same barrier become one range. Barriers without a layout
+// change or ownership transfer become one global memory barrier per stage pair, which drivers
+// handle as well as per resource barriers.
+//
+// The uses added between two flushes are those of the commands recorded after the second flush:
+// several uses of a subresource in between merge, its last layout wins. Tracking across command
+// buffers assumes they execute in recording order.
+class BarrierBuilder
+{
+public:
+    BarrierBuilder();
+    ~BarrierBuilder();
+
+    // Asks for synchronization2, before the device is created.
+    static void requestFeatures(DeviceFeatures& features);
+
+    void createBarrierBuilder(const VulkanDevice* deviceObj);
+
+    // Starts tracking 'image', whose subresources are all in 'layout', UNDEFINED for a new image.
+    // Every use covers all the aspects in 'aspectMask'.
+    void trackImage(VkImage image, VkImageAspectFlags aspectMask, uint32_t mipLevels, uint32_t arrayLayers, VkImageLayout layout);
+    void untrackImage(VkImage image);
+    VkImageLayout getLayout(VkImage image, uint32_t mipLevel = 0, uint32_t arrayLayer = 0) const;
+
+    // The commands after the next flush use 'range' of a tracked image in 'layout'.
+    void useImage(VkImage image, const VkImageSubresourceRange& range, VkImageLayout layout,
+        VkPipelineStageFlags stageMask, VkAccessFlags accessMask);
+    void useImage(VkImage image, VkImageLayout layout, VkPipelineStageFlags stageMask, VkAccessFlags accessMask);
+
+    // Explicit barriers, for resources that are not tracked.
+    void addMemoryBarrier(VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask,
+        VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
+    void addBufferBarrier(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size,
+        VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask,
+        uint32_t srcQueueFamily = VK_QUEUE_FAMILY_IGNORED, uint32_t dstQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+    void addImageBarrier(VkImage image, const VkImageSubresourceRange& range, VkImageLayout oldLayout, VkImageLayout newLayout,
+        VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask,
+        uint32_t srcQueueFamily = VK_QUEUE_FAMILY_IGNORED, uint32_t dstQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+
+    // Records what was collected, nothing when no barrier is needed, and starts a new batch.
+    void flush(VkCommandBuffer cmdBuffer);
+
+    bool usesSynchronization2() const { return pipelineBarrier2Fn != NULL; }
+    const BarrierBuilderStats& getStats() const { return stats; }
+    void printStats() const;
+
+private:
+    struct Dependency {
+        VkPipelineStageFlags srcStageMask;
+        VkAccessFlags srcAccessMask;
+        VkPipelineStageFlags dstStageMask;
+        VkAccessFlags dstAccessMask;
+    };
+
+    struct ImageBarrier {
+        Dependency dependency;
+        VkImage image;
+        VkImageSubresourceRange range;
+        VkImageLayout oldLayout;
+        VkImageLayout newLayout;
+        uint32_t srcQueueFamily;
+        uint32_t dstQueueFamily;
+    };
+
+    struct BufferBarrier {
+        Dependency dependency;
+        VkBuffer buffer;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        uint32_t srcQueueFamily;
+        uint32_t dstQueueFamily;
+    };
+
+    struct SubresourceState {
+        VkImageLayout layout;
+        VkPipelineStageFlags writeStages; // Of the last write or layout transition, 0 before the first.
+        VkAccessFlags writeAccess;
+        VkPipelineStageFlags readStages; // Reading since then.
+        VkPipelineStageFlags visibleStages; // The last write is visible to these stages and accesses.
+        VkAccessFlags visibleAccess;
+
+        // Use in the current batch, none while 'pendingStages' is 0.
+        VkImageLayout pendingLayout;
+        VkPipelineStageFlags pendingStages;
+        VkAccessFlags pendingAccess;
+    };
+
+    struct TrackedImage {
+        VkImageAspectFlags aspectMask;
+        uint32_t mipLevels;
+        uint32_t arrayLayers;
+        std::vector<SubresourceState> subresources; // Mip level major.
+        bool pending; // In 'pendingImages'.
+    };
+
+    // Barrier for the pending use of 'state' against its tracked accesses, and the state after it.
+    // False when none is needed.
+    static bool resolveUse(SubresourceState& state, Dependency& dependency, VkImageLayout& oldLayout);
+    void resolveImage(VkImage image, TrackedImage& tracked);
+    void addDependency(const Dependency& dependency); // Merged by stage pair.
+    void recordBarrier(VkCommandBuffer cmdBuffer);
+    void recordBarrier2(VkCommandBuffer cmdBuffer);
+
+    PFN_vkCmdPipelineBarrier2KHR pipelineBarrier2Fn; // NULL without synchronization2.
+    std::unordered_map<VkImage, TrackedImage> images;
+    std::vector<VkImage> pendingImages; // With uses in the current batch.
+    std::vector<Dependency> memoryBarriers; // One per stage pair.
+    std::vector<BufferBarrier> bufferBarriers;
+    std::vector<ImageBarrier> imageBarriers;
+    BarrierBuilderStats stats;
+};
+
+// Scoped debug utils label: everything recorded into 'cmdBuffer' while it lives is grouped
+// under 'name' in validation messages and frame captures. Does nothing when 'debugUtils'
+// is NULL or the extension is not enabled.
+class CommandBufferLabel
+{
+public:
+    CommandBufferLabel(const DebugUtils* debugUtils, VkCommandBuffer cmdBuffer, const char* name, const float color[4] = NULL);
+    ~CommandBufferLabel();
+
+private:
+    CommandBufferLabel(const CommandBufferLabel&) = delete;
+    CommandBufferLabel& operator=(const CommandBufferLabel&) = delete;
+
+    const DebugUtils* debugUtils;
+    VkCommandBuffer cmdBuffer;
+};
+
+// Same for the submissions made to 'queue' while it lives.
+class QueueLabel
+{
+public:
+    QueueLabel(const DebugUtils* debugUtils, VkQueue queue, const char* name, const float color[4] = NULL);
+    ~QueueLabel();
+
+private:
+    QueueLabel(const QueueLabel&) = delete;
+    QueueLabel& operator=(const QueueLabel&) = delete;
+
+    const DebugUtils* debugUtils;
+    VkQueue queue;
+};
@@ -0,0 +1,52 @@
+// This owns the command pools used for recording. Every (frame slot, worker thread)
+// pair gets its own transient VkCommandPool, so recording never needs to lock a
+// pool, and all buffers of a frame are recycled with one vkResetCommandPool per
+// pool instead of being freed one by one. Secondary command buffers can be recorded
+// in parallel on a ThreadPool and then executed from a single primary.
+
+#pragma once
+
+#include "Headers.h"
+#include "ThreadPool.h"
+
+class VulkanDevice;
+
+class CommandPoolManager {
+public:
+    CommandPoolManager();
+    ~CommandPoolManager();
+
+    // Creates the pools for 'frameSlotCount' frames and 'workerCount' recording threads
+    // (0 uses one thread per hardware thread) on the given queue family.
+    void createCommandPools(VulkanDevice* deviceObj, uint32_t queueFamilyIndex, uint32_t frameSlotCount, uint32_t workerCount = 0);
+    void destroyCommandPools();
+
+    // Resets all pools of a frame slot, the slot's previous work must have completed.
+    void resetFramePools(uint32_t frameSlot);
+
+    // Hands out a command buffer from the pool of 'workerIndex'. Buffers are reused after resetFramePools().
+    VkCommandBuffer acquireCommandBuffer(uint32_t frameSlot, uint32_t workerIndex, VkCommandBufferLevel level);
+
+    // Splits [0, batchCount) into ranges and records each range into its own secondary command
+    // buffer on the worker threads, then executes the secondaries in order inside 'primary'.
+    // 'inheritanceInfo' describes the render pass the secondaries continue, or NULL outside one.
+    void recordParallel(uint32_t frameSlot, VkCommandBuffer primary, uint32_t batchCount,
+        const VkCommandBufferInheritanceInfo* inheritanceInfo,
+        const std::function<void(VkCommandBuffer, uint32_t, uint32_t)>& recordBatches);
+
+    uint32_t getWorkerCount() const { return workerCount; }
+
+private:
+    struct ThreadCommandPool {
+        VkCommandPool cmdPool;
+        std::vector<VkCommandBuffer> cmdBuffers[2]; // Indexed by VkCommandBufferLevel.
+        uint32_t usedCount[2];
+    };
+
+    ThreadCommandPool& getPool(uint32_t frameSlot, uint32_t workerIndex);
+
+    VulkanDevice* deviceObj;
+    ThreadPool threadPool;
+    uint32_t workerCount;
+    std::vector<ThreadCommandPool> threadPools; // frameSlot * workerCount + workerIndex
+};
@@ -0,0 +1,153 @@
+// Compute work outside the frame loop: image filters, reductions and other GPGPU jobs.
+// SPIR-V modules are memory mapped from disk and handed to the driver without a copy,
+// each file is loaded once. Kernels are compute pipelines whose workgroup size, and any
+// other tuning parameter, is a specialization constant fixed per device when the
+// pipeline is compiled, so the driver can unroll and size registers for it. Dispatches
+// are recorded into batches, one command buffer and one submission each, that run
+// asynchronously on the compute queue and complete through a SubmitToken.
+
+#pragma once
+
+#include "Headers.h"
+#include "FencePool.h"
+#include "DescriptorAllocator.h"
+#include <string>
+#include <map>
+
+class VulkanDevice;
+
+// Values for the specialization constants of a shader, by constant id.
+class SpecializationConstants {
+public:
+    template <typename T>
+    void set(uint32_t constantId, const T& value)
+    {
+        for (auto& entry : entries) {
+            if (entry.constantID == constantId) {
+                assert(entry.size == sizeof(T));
+                memcpy(&data[entry.offset], &value, sizeof(T));
+                return;
+            }
+        }
+
+        VkSpecializationMapEntry entry;
+        entry.constantID = constantId;
+        entry.offset = (uint32_t)data.size();
+        entry.size = sizeof(T);
+        entries.push_back(entry);
+        data.resize(data.size() + sizeof(T));
+        memcpy(&data[entry.offset], &value, sizeof(T));
+    }
+
+    bool has(uint32_t constantId) const;
+
+    // Points into this object, valid while it is not modified.
+    VkSpecializationInfo getInfo() const;
+
+private:
+    std::vector<VkSpecializationMapEntry> entries;
+    std::vector<uint8_t> data;
+};
+
+struct ComputeKernelDesc {
+    std::string spirvPath;
+    std::string entryPoint;
+    uint32_t storageBufferCount; // Bound to bindings 0 to count - 1 of set 0.
+    uint32_t pushConstantSize;
+    uint32_t dimensions; // 1, 2 or 3, for the workgroup size chosen for the device.
+    SpecializationConstants constants; // Ids from FIRST_USER_CONSTANT_ID on.
+};
+
+struct ComputeKernel {
+    std::string name; // Of the debug label around its dispatches.
+    VkPipeline pipeline; // Owned by the device's pipeline manager.
+    VkPipelineLayout pipelineLayout; // Shared by the kernels with the same bindings and push constants.
+    VkDescriptorSetLayout setLayout; // Owned by the engine's descriptor allocator.
+    const DescriptorTemplate* bufferTemplate; // Writes the storage buffers from VkDescriptorBufferInfos.
+    uint32_t storageBufferCount;
+    uint32_t pushConstantSize;
+    uint32_t workgroupSize[3];
+};
+
+struct ComputeStats {
+    uint32_t shaderModules;
+    uint64_t spirvBytes; // Mapped from disk.
+    uint32_t kernels;
+    uint64_t dispatches;
+    uint64_t workgroups;
+    uint64_t batches; // Submissions.
+};
+
+class ComputeEngine {
+public:
+    // Shaders take their workgroup size from these, with
+    // layout(local_size_x_id = 0, local_size_y_id = 1, local_size_z_id = 2) in;
+    static const uint32_t WORKGROUP_SIZE_X_ID = 0;
+    static const uint32_t WORKGROUP_SIZE_Y_ID = 1;
+    static const uint32_t WORKGROUP_SIZE_Z_ID = 2;
+    static const uint32_t FIRST_USER_CONSTANT_ID = 3;
+    static const uint32_t BATCH_SLOT_COUNT = 4; // Batches in flight before the oldest is waited for.
+
+    ComputeEngine();
+    ~ComputeEngine();
+
+    void createComputeEngine(VulkanDevice* deviceObj, VkQueue queue, uint32_t queueFamilyIndex);
+    void destroyComputeEngine(); // Waits for the batches in flight.
+
+    // Maps the SPIR-V file and creates its module, once per path. VK_NULL_HANDLE if the file
+    // cannot be read or is not SPIR-V.
+    VkShaderModule loadShaderModule(const std::string& spirvPath);
+
+    // Creates the pipeline of 'desc' with the workgroup size chosen for the device, the
+    // constants of 'desc' are applied on top. NULL on failure. Owned by the engine.
+    const ComputeKernel* createKernel(const ComputeKernelDesc& desc);
+
+    // Workgroup size for 'dimensions' dimensions within the limits of the device.
+    void chooseWorkgroupSize(uint32_t dimensions, uint32_t workgroupSize[3]) const;
+
+    // Records into the current batch, starting one if needed. 'buffers' holds one range per
+    // storage buffer of the kernel. Dispatches of a batch may overlap unless separated by barrier().
+    void dispatch(const ComputeKernel* kernel, const VkDescriptorBufferInfo* buffers, const void* pushConstants,
+        uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1);
+
+    // Same, with enough workgroups to cover 'itemCountX' x 'itemCountY' x 'itemCountZ' invocations.
+    void dispatchItems(const ComputeKernel* kernel, const VkDescriptorBufferInfo* buffers, const void* pushConstants,
+        uint32_t itemCountX, uint32_t itemCountY = 1, uint32_t itemCountZ = 1);
+
+    // Later dispatches of the batch see the writes of the earlier ones.
+    void barrier();
+
+    // Submits the current batch without waiting. A token with serial 0 when nothing was recorded.
+    SubmitToken submit();
+    bool isComplete(const SubmitToken& token) { return fencePool.isComplete(token); }
+    VkResult wait(const SubmitToken& token, uint64_t timeout = UINT64_MAX) { return fencePool.wait(token, timeout); }
+
+    const ComputeStats& getStats() const { return stats; }
+    void printStats() const;
+
+private:
+    struct BatchSlot {
+        VkCommandBuffer cmdBuffer;
+        SubmitToken token; // Last submission of the slot.
+    };
+
+    VkCommandBuffer beginBatch();
+    VkPipelineLayout getPipelineLayout(VkDescriptorSetLayout setLayout, uint32_t pushConstantSize);
+
+    VulkanDevice* deviceObj;
+    VkQueue queue;
+    VkCommandPool cmdPool;
+    FencePool fencePool;
+    DescriptorAllocator descriptors; // One pool chain per batch slot.
+
+    BatchSlot batchSlots[BATCH_SLOT_COUNT];
+    uint32_t nextSlot;
+    uint32_t recordingSlot; // BATCH_SLOT_COUNT when no batch is being recorded.
+    VkPipeline boundPipeline; // In the batch being recorded.
+
+    // Kept until the engine is destroyed, which evicts the kernels from the pipeline manager.
+    std::map<std::string, VkShaderModule> shaderModules;
+    std::map<std::pair<VkDescriptorSetLayout, uint32_t>, VkPipelineLayout> pipelineLayouts;
+    std::vector<ComputeKernel*> kernels;
+    ComputeStats stats;
+};
@@ -0,0 +1,77 @@
+// CPU-side scoped timers. PROFILE_SCOPE("name") records the time spent until the end of
+// the enclosing block into a buffer owned by the calling thread: no lock, no allocation
+// except a new chunk every CHUNK_RECORDS scopes. The buffers are exported as a Chrome
+// trace with one track per thread. With ENABLE_CPU_PROFILING set to 0, the default when
+// NDEBUG is defined, the macros expand to nothing and the profiler functions are empty.
+
+#pragma once
+
+#include "Headers.h"
+#include <string>
+
+#ifndef ENABLE_CPU_PROFILING
+#ifdef NDEBUG
+#define ENABLE_CPU_PROFILING 0
+#else
+#define ENABLE_CPU_PROFILING 1
+#endif
+#endif
+
+#if ENABLE_CPU_PROFILING
+
+#include <atomic>
+
+class CpuProfiler {
+public:
+    static const uint32_t CHUNK_RECORDS = 4096;
+    static const uint32_t MAX_CHUNKS = 64; // Per thread, later scopes are counted as dropped.
+
+    // 'name' must outlive the profiler, string literals and __FUNCTION__ do.
+    static void record(const char* name, uint64_t startNs, uint64_t endNs);
+
+    // Track name of the calling thread in the trace, set it before the first export.
+    static void setThreadName(const char* name);
+
+    static uint64_t nowNanoseconds(); // Since the start of the process.
+
+    // Appends every recorded scope under 'pid', comma separated. Call once the recording
+    // threads are quiet, scopes still open are not included.
+    static void appendTraceEvents(std::string& eventList, uint32_t pid);
+    static bool writeChromeTrace(const std::string& filePath);
+    static void printStats();
+};
+
+class CpuProfileScope
+{
+public:
+    explicit CpuProfileScope(const char* inName) : name(inName), startNs(CpuProfiler::nowNanoseconds()) { }
+    ~CpuProfileScope() { CpuProfiler::record(name, startNs, CpuProfiler::nowNanoseconds()); }
+
+private:
+    CpuProfileScope(const CpuProfileScope&) = delete;
+    CpuProfileScope& operator=(const CpuProfileScope&) = delete;
+
+    const char* name;
+    uint64_t startNs;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) CpuProfileScope PROFILE_CONCAT(cpuProfileScope, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#define PROFILE_THREAD_NAME(name) CpuProfiler::setThreadName(name)
+
+#else // ENABLE_CPU_PROFILING
+
+class CpuProfiler {
+public:
+    static void appendTraceEvents(std::string&, uint32_t) { }
+    static bool writeChromeTrace(const std::string&) { return false; }
+    static void printStats() { }
+};
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+
+#endif // ENABLE_CPU_PROFILING
@@ -0,0 +1,119 @@
+// Asynchronous sink for debug report messages. The callback runs on whatever thread
+// made the Vulkan call, so it only copies the message into a fixed size record of a
+// lock-free multi-producer ring and returns; it never blocks and never allocates. A
+// background thread drains the ring, folds repeated messages (same code, object and
+// severity) into one line per time window and writes each batch with a single flush.
+// When the ring is full the message is dropped and counted instead of stalling the driver.
+
+#pragma once
+
+#include "Headers.h"
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
+#include <string>
+
+enum DebugSeverity {
+    DEBUG_SEVERITY_ERROR,
+    DEBUG_SEVERITY_WARNING,
+    DEBUG_SEVERITY_PERFORMANCE,
+    DEBUG_SEVERITY_INFORMATION,
+    DEBUG_SEVERITY_DEBUG,
+    DEBUG_SEVERITY_COUNT
+};
+
+struct DebugRecord {
+    VkFlags msgFlags;
+    VkDebugReportObjectTypeEXT objType;
+    uint64_t srcObject;
+    size_t location;
+    int32_t msgCode;
+    char layerPrefix[64];
+    char msg[1024]; // Truncated if longer.
+};
+
+struct DebugSinkStats {
+    uint64_t received[DEBUG_SEVERITY_COUNT]; // Every message the callback saw.
+    uint64_t printed;
+    uint64_t suppressed; // Folded by the rate limit.
+    uint64_t dropped; // Lost because the ring was full.
+};
+
+class DebugReportSink {
+public:
+    static const uint32_t RING_CAPACITY = 1024; // Power of two.
+
+    DebugReportSink();
+    ~DebugReportSink();
+
+    // 'maxPerWindow' messages with the same code/object/severity are printed per 'windowMs',
+    // the rest is counted and reported when the window closes.
+    void startSink(uint32_t maxPerWindow = 4, uint32_t windowMs = 1000);
+    void stopSink(); // Drains what is left and prints the counters.
+
+    // Called from the debug callback on any thread, lock-free and wait-free unless the ring is contended.
+    void push(VkFlags msgFlags, VkDebugReportObjectTypeEXT objType, uint64_t srcObject,
+        size_t location, int32_t msgCode, const char* layerPrefix, const char* msg);
+
+    DebugSinkStats getStats() const;
+    void printStats() const;
+
+    static DebugSeverity severityOf(VkFlags msgFlags);
+
+private:
+    // Bounded MPSC queue: a slot is free for the producer claiming position 'pos' when its
+    // sequence equals pos, and ready for the consumer when it equals pos + 1.
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        DebugRecord record;
+    };
+
+    struct RepeatKey {
+        int32_t msgCode;
+        uint64_t srcObject;
+        uint32_t severity;
+        bool operator==(const RepeatKey& other) const
+        {
+            return msgCode == other.msgCode && srcObject == other.srcObject && severity == other.severity;
+        }
+    };
+    struct RepeatKeyHash {
+        size_t operator()(const RepeatKey& key) const
+        {
+            return std::hash<uint64_t>()(key.srcObject * 31 + (uint64_t)(uint32_t)key.msgCode) ^ key.severity;
+        }
+    };
+    struct RepeatState {
+        uint64_t windowStart; // ms
+        uint32_t printedInWindow;
+        uint32_t suppressedInWindow;
+    };
+
+    bool pop(DebugRecord& record);
+    void drainLoop();
+    uint32_t drain(std::string& batch); // Returns the number of records taken.
+    void formatRecord(const DebugRecord& record, std::string& batch);
+    void closeWindows(uint64_t nowMs, bool all, std::string& batch);
+    static uint64_t nowMilliseconds();
+
+    Slot* ring;
+    std::atomic<uint64_t> enqueuePos;
+    uint64_t dequeuePos; // Consumer only.
+
+    std::atomic<uint64_t> received[DEBUG_SEVERITY_COUNT];
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> printed;
+    std::atomic<uint64_t> suppressed;
+
+    // Drain thread state, only touched by the drain thread once started.
+    std::unordered_map<RepeatKey, RepeatState, RepeatKeyHash> repeats;
+    uint32_t maxPerWindow;
+    uint64_t windowMs;
+
+    std::thread drainThread;
+    std::mutex wakeMutex; // Only for the drain thread's timed sleep and shutdown.
+    std::condition_variable wakeCondition;
+    bool stopping;
+    bool running;
+};
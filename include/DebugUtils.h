@@ -0,0 +1,61 @@
+// VK_EXT_debug_utils backend: the messenger that replaces the debug report callback,
+// object names and command buffer/queue labels that show up in validation messages and
+// in frame captures. The entry points are loaded once per instance. When the extension
+// is not enabled every call is a single branch on a NULL function pointer, and the
+// application keeps using VK_EXT_debug_report for its messages.
+
+#pragma once
+
+#include "Headers.h"
+
+class DebugReportSink;
+
+class DebugUtils {
+public:
+    DebugUtils();
+    ~DebugUtils();
+
+    // Loads the entry points, returns false if the instance does not have the extension enabled.
+    bool loadFunctions(VkInstance instance);
+
+    // Routes validation messages into 'sink', the same sink the debug report path uses.
+    VkResult createMessenger(VkInstance instance, DebugReportSink* sink);
+    void destroyMessenger(VkInstance instance);
+
+    // Create info for messages of vkCreateInstance/vkDestroyInstance themselves (instance pNext chain).
+    static VkDebugUtilsMessengerCreateInfoEXT messengerCreateInfo(DebugReportSink* sink);
+
+    bool isEnabled() const { return setObjectNameFn != NULL; }
+
+    void setObjectName(VkDevice device, VkObjectType objectType, uint64_t objectHandle, const char* name) const;
+
+    template <typename T>
+    void setObjectName(VkDevice device, VkObjectType objectType, T* objectHandle, const char* name) const
+    {
+        setObjectName(device, objectType, (uint64_t)(uintptr_t)objectHandle, name);
+    }
+
+    void beginLabel(VkCommandBuffer cmdBuffer, const char* name, const float color[4] = NULL) const;
+    void endLabel(VkCommandBuffer cmdBuffer) const;
+    void insertLabel(VkCommandBuffer cmdBuffer, const char* name, const float color[4] = NULL) const;
+    void beginLabel(VkQueue queue, const char* name, const float color[4] = NULL) const;
+    void endLabel(VkQueue queue) const;
+
+    static VKAPI_ATTR VkBool32 VKAPI_CALL messengerFunction(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
+        VkDebugUtilsMessageTypeFlagsEXT messageTypes,
+        const VkDebugUtilsMessengerCallbackDataEXT* callbackData,
+        void* userData);
+
+private:
+    static VkDebugUtilsLabelEXT makeLabel(const char* name, const float color[4]);
+
+    PFN_vkCreateDebugUtilsMessengerEXT createMessengerFn;
+    PFN_vkDestroyDebugUtilsMessengerEXT destroyMessengerFn;
+    PFN_vkSetDebugUtilsObjectNameEXT setObjectNameFn;
+    PFN_vkCmdBeginDebugUtilsLabelEXT cmdBeginLabelFn;
+    PFN_vkCmdEndDebugUtilsLabelEXT cmdEndLabelFn;
+    PFN_vkCmdInsertDebugUtilsLabelEXT cmdInsertLabelFn;
+    PFN_vkQueueBeginDebugUtilsLabelEXT queueBeginLabelFn;
+    PFN_vkQueueEndDebugUtilsLabelEXT queueEndLabelFn;
+    VkDebugUtilsMessengerEXT messenger;
+};
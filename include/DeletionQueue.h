@@ -0,0 +1,107 @@
+// Deferred destruction of device objects. Destroying an object the GPU may still use
+// would otherwise need a queue or device wait first; instead the object is queued with
+// the completion point of the last submission that used it, either a frame number of
+// the frame scheduler or the serial of a FencePool submission, and destroyed in bulk
+// once that point has passed. The queue is drained at the start of every frame.
+
+#pragma once
+
+#include "Headers.h"
+#include "FencePool.h"
+#include "MemoryAllocator.h"
+#include <deque>
+
+class VulkanDevice;
+
+// When a queued object may be destroyed.
+struct DeletionKey {
+    FencePool* fencePool; // NULL for a frame number.
+    uint64_t value; // Frame number or fence pool serial, CURRENT_FRAME for the frame being recorded.
+
+    static const uint64_t CURRENT_FRAME = UINT64_MAX;
+
+    DeletionKey() : fencePool(NULL), value(CURRENT_FRAME) { }
+
+    // After frame 'frameNumber' has completed.
+    static DeletionKey afterFrame(uint64_t frameNumber) { DeletionKey key; key.value = frameNumber; return key; }
+
+    // After the submission behind 'token' has completed.
+    static DeletionKey afterSubmit(FencePool& pool, const SubmitToken& token)
+    {
+        DeletionKey key;
+        key.fencePool = &pool;
+        key.value = token.serial;
+        return key;
+    }
+};
+
+struct DeletionQueueStats {
+    uint64_t queued;
+    uint64_t destroyed;
+    uint32_t maxPending; // Most objects waiting at once.
+};
+
+class DeletionQueue {
+public:
+    DeletionQueue();
+    ~DeletionQueue();
+
+    void createDeletionQueue(VulkanDevice* deviceObj);
+    void destroyDeletionQueue(); // Destroys everything still queued, the device must be idle.
+
+    // Queues 'handle' for vkDestroy* (vkFreeMemory for VK_OBJECT_TYPE_DEVICE_MEMORY). Objects
+    // with the same key are destroyed in the order they were queued, so queue views before
+    // their images and the resources before their memory. Safe to call from any thread.
+    template <typename T>
+    void destroyObject(VkObjectType objectType, T handle, const DeletionKey& key = DeletionKey())
+    {
+        if (handle != VK_NULL_HANDLE) {
+            push(objectType, (uint64_t)handle, MemoryAllocation(), key);
+        }
+    }
+
+    // Queues 'allocation' to be given back to the device's memory allocator.
+    void freeAllocation(const MemoryAllocation& allocation, const DeletionKey& key = DeletionKey());
+
+    // Starts frame 'frameNumber' and destroys every object whose key has passed: frames below
+    // 'retiredFrameCount' have completed, fence pool serials are polled.
+    void beginFrame(uint64_t frameNumber, uint64_t retiredFrameCount);
+
+    // Destroys what has become free since the last frame began, without starting a frame.
+    void collect();
+
+    uint32_t getPendingCount();
+    const DeletionQueueStats& getStats() const { return stats; }
+    void printStats() const;
+
+private:
+    struct DeferredObject {
+        VkObjectType objectType; // VK_OBJECT_TYPE_UNKNOWN for an allocator allocation.
+        uint64_t handle;
+        MemoryAllocation allocation;
+        uint64_t value; // Frame number or serial it waits for.
+    };
+
+    // Objects waiting on one completion counter, in the order they were queued.
+    struct PendingList {
+        FencePool* fencePool;
+        std::deque<DeferredObject> objects;
+    };
+
+    void push(VkObjectType objectType, uint64_t handle, const MemoryAllocation& allocation, const DeletionKey& key);
+
+    // Moves the leading objects of 'list' that are complete into 'ready'. Only the front is
+    // checked, an object queued behind a later key waits for it, which is late but never early.
+    static void takeCompleted(PendingList& list, uint64_t completedValue, std::vector<DeferredObject>& ready);
+    void collectLocked(uint64_t retiredFrameCount, std::vector<DeferredObject>& ready);
+    void destroy(const DeferredObject& object);
+
+    VulkanDevice* deviceObj;
+    PendingList frameList; // Keyed on frame numbers.
+    std::vector<PendingList> fenceLists; // One per fence pool in use.
+    uint64_t currentFrame;
+    uint64_t retiredFrames; // From the last beginFrame().
+    uint32_t pendingCount;
+    DeletionQueueStats stats;
+    std::mutex queueMutex;
+};
@@ -0,0 +1,130 @@
+// Descriptor sets for the frames. Layouts are cached by a hash of their bindings, so each
+// distinct layout is created once however often it is asked for. Sets live for one frame:
+// every (frame slot, worker thread) pair owns a chain of pools that takes on another pool
+// when the current one is exhausted, and the whole chain is recycled with one
+// vkResetDescriptorPool per pool when the slot comes around again. Sets are never freed
+// one by one, so the pools do not fragment and allocating needs no lock. Writes go through
+// update templates, one call per set, with a vkUpdateDescriptorSets fallback on devices
+// without VK_KHR_descriptor_update_template.
+
+#pragma once
+
+#include "Headers.h"
+#include <map>
+#include <unordered_map>
+
+class VulkanDevice;
+
+// Descriptors of a type reserved per set in every pool.
+struct DescriptorPoolRatio {
+    VkDescriptorType type;
+    float descriptorsPerSet;
+};
+
+// Writes a set from one block of data: each entry reads its descriptor infos at 'offset'
+// bytes into the block, 'stride' bytes apart.
+struct DescriptorTemplate {
+    VkDescriptorUpdateTemplateKHR handle; // VK_NULL_HANDLE when written with vkUpdateDescriptorSets.
+    VkDescriptorSetLayout layout;
+    std::vector<VkDescriptorUpdateTemplateEntryKHR> entries;
+};
+
+struct DescriptorAllocatorStats {
+    uint64_t setsAllocated;
+    uint32_t poolsCreated;
+    uint32_t poolResets;
+    uint32_t layoutsCreated;
+    uint64_t layoutCacheHits;
+    uint32_t templatesCreated;
+};
+
+class DescriptorAllocator {
+public:
+    static const uint32_t INITIAL_SETS_PER_POOL = 256;
+    static const uint32_t MAX_SETS_PER_POOL = 4096; // Pools grow by doubling up to this.
+
+    DescriptorAllocator();
+    ~DescriptorAllocator();
+
+    // Pool chains for 'frameSlotCount' frames and 'workerCount' recording threads. 'poolRatios'
+    // sizes the pools for the descriptor mix of the application, empty takes a general mix.
+    void createDescriptorAllocator(VulkanDevice* deviceObj, uint32_t frameSlotCount, uint32_t workerCount = 1,
+        const std::vector<DescriptorPoolRatio>& poolRatios = std::vector<DescriptorPoolRatio>());
+    void destroyDescriptorAllocator(); // The caller makes sure no frame using the sets is in flight.
+
+    // Returns the layout with 'bindings', creating it on first use. Owned by the allocator. Thread safe.
+    // 'name' labels the layout when it is created, the first caller names a shared layout.
+    VkDescriptorSetLayout getLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+        VkDescriptorSetLayoutCreateFlags flags = 0, const char* name = "Descriptor set layout");
+
+    // Template writing 'entries' into sets of 'layout'. Owned by the allocator. Thread safe.
+    const DescriptorTemplate* createTemplate(VkDescriptorSetLayout layout,
+        const std::vector<VkDescriptorUpdateTemplateEntryKHR>& entries);
+
+    // Sets valid until resetFrame(frameSlot). Each worker allocates from its own chain,
+    // only the thread of 'workerIndex' may use it.
+    VkDescriptorSet allocate(uint32_t frameSlot, VkDescriptorSetLayout layout, uint32_t workerIndex = 0);
+    void allocate(uint32_t frameSlot, VkDescriptorSetLayout layout, uint32_t count, VkDescriptorSet* sets,
+        uint32_t workerIndex = 0);
+
+    // Writes 'data', laid out as 'descriptorTemplate' describes, into 'set'.
+    void update(VkDescriptorSet set, const DescriptorTemplate* descriptorTemplate, const void* data);
+
+    // Recycles the pools of a frame slot, the slot's previous work must have completed.
+    void resetFrame(uint32_t frameSlot);
+
+    bool hasUpdateTemplates() const { return createTemplateFn != NULL; }
+    DescriptorAllocatorStats getStats();
+    void printStats();
+
+private:
+    struct PoolChain {
+        VkDescriptorPool currentPool;
+        std::vector<VkDescriptorPool> fullPools; // Exhausted in this frame.
+        uint32_t setsPerPool; // Size of the next pool created.
+        uint64_t setsAllocated;
+    };
+
+    // Bindings sorted by binding number, compared and hashed by value. The immutable sampler
+    // pointers are cleared, the samplers are copied out instead.
+    struct LayoutKey {
+        VkDescriptorSetLayoutCreateFlags flags;
+        std::vector<VkDescriptorSetLayoutBinding> bindings;
+        std::vector<uint32_t> samplerBindings; // Bindings with immutable samplers.
+        std::vector<VkSampler> immutableSamplers; // Of those bindings, in order.
+
+        bool operator==(const LayoutKey& other) const;
+    };
+
+    struct LayoutKeyHash {
+        size_t operator()(const LayoutKey& key) const;
+    };
+
+    PoolChain& getChain(uint32_t frameSlot, uint32_t workerIndex);
+    VkDescriptorPool acquirePool(uint32_t setsPerPool);
+    void switchPool(PoolChain& chain);
+    VkResult allocateFromChain(PoolChain& chain, const VkDescriptorSetLayout* layouts, uint32_t count, VkDescriptorSet* sets);
+
+    // Writes 'data' with vkUpdateDescriptorSets, for devices without update templates.
+    void updateWithWrites(VkDescriptorSet set, const DescriptorTemplate* descriptorTemplate, const void* data);
+
+    VulkanDevice* deviceObj;
+    uint32_t workerCount;
+    std::vector<DescriptorPoolRatio> ratios;
+    std::vector<PoolChain> chains; // frameSlot * workerCount + workerIndex
+
+    std::multimap<uint32_t, VkDescriptorPool> freePools; // Reset pools ready for any chain, by maxSets.
+    std::unordered_map<VkDescriptorPool, uint32_t> poolMaxSets; // Of every pool created.
+    uint32_t poolsCreated;
+    uint32_t poolResets;
+    std::mutex poolMutex;
+
+    std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutKeyHash> layouts;
+    std::vector<DescriptorTemplate*> templates;
+    uint64_t layoutCacheHits;
+    std::mutex layoutMutex;
+
+    PFN_vkCreateDescriptorUpdateTemplateKHR createTemplateFn;
+    PFN_vkDestroyDescriptorUpdateTemplateKHR destroyTemplateFn;
+    PFN_vkUpdateDescriptorSetWithTemplateKHR updateWithTemplateFn;
+};
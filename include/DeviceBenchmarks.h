@@ -0,0 +1,18 @@
+// Benchmarks that need a Vulkan device. The application runs one of them instead of its frame
+// loop with --benchmark <name>, on the context initialize() and prepare() have set up. They print
+// their numbers and fail when a result is wrong. The CPU side benchmarks are in engineTests.
+
+#pragma once
+
+#include "Headers.h"
+
+class VulkanApplication;
+
+class DeviceBenchmarks {
+public:
+    typedef bool (*BenchmarkFunction)(VulkanApplication* appObj);
+
+    // False when the benchmark is unknown or one of its checks failed.
+    static bool run(VulkanApplication* appObj, const std::string& name);
+    static void printNames();
+};
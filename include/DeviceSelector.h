@@ -0,0 +1,53 @@
+// Ranks the physical devices of the system so the application runs on the best GPU
+// instead of whichever the loader lists first. A device is usable if it has a graphics
+// queue and every required extension. Usable devices are ordered by device type
+// (discrete first), device local memory, dedicated compute/transfer queue families and
+// API version, with the enumeration index as the final tie break, so the order is
+// deterministic. Scoring only reads the property tables, fake ones rank the same way.
+
+#pragma once
+
+#include "Headers.h"
+
+struct DeviceCandidate {
+    uint32_t gpuIndex; // Index in the enumerated device list.
+    VkPhysicalDeviceProperties properties;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    std::vector<VkQueueFamilyProperties> queueFamilies;
+    bool hasRequiredExtensions; // Filled in by the caller, see CapabilitySet::resolveExtensions.
+};
+
+struct DeviceScore {
+    bool suitable;
+    uint32_t typeRank; // Discrete 4, integrated 3, virtual 2, CPU 1, other 0.
+    VkDeviceSize deviceLocalBytes; // Largest device local heap.
+    uint32_t dedicatedQueueFamilies; // Compute-only and transfer-only families.
+    uint32_t apiVersion;
+    uint32_t gpuIndex;
+
+    bool betterThan(const DeviceScore& other) const;
+};
+
+struct DeviceSelectionPolicy {
+    int32_t forcedGpuIndex; // Use this device if it is suitable, -1 to rank.
+    uint32_t preferredVendorID; // Rank devices of this vendor first, 0 for no preference.
+    bool allowCpuDevices; // Software rasterizers are only picked when nothing else works.
+
+    DeviceSelectionPolicy() : forcedGpuIndex(-1), preferredVendorID(0), allowCpuDevices(true) { }
+};
+
+class DeviceSelector {
+public:
+    // Reads the properties, memory heaps and queue families of 'gpu'.
+    static void queryCandidate(VkPhysicalDevice gpu, uint32_t gpuIndex, DeviceCandidate& candidate);
+
+    static DeviceScore scoreDevice(const DeviceCandidate& candidate, const DeviceSelectionPolicy& policy);
+
+    // Why the candidate can not be used, NULL if it is suitable.
+    static const char* getRejectionReason(const DeviceCandidate& candidate, const DeviceSelectionPolicy& policy);
+
+    // Returns the gpuIndex of every suitable candidate, best first.
+    static std::vector<uint32_t> rankDevices(const std::vector<DeviceCandidate>& candidates, const DeviceSelectionPolicy& policy);
+
+    static void printRanking(const std::vector<DeviceCandidate>& candidates, const DeviceSelectionPolicy& policy);
+};
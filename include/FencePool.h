@@ -0,0 +1,73 @@
+// This keeps a pool of reusable fences for the asynchronous submission path.
+// Every submission made through the pool is stamped with a monotonically
+// increasing serial, callers hold on to that serial (SubmitToken) and can
+// poll or wait on it instead of draining the whole queue.
+
+#pragma once
+
+#include "Headers.h"
+#include <deque>
+#include <string>
+
+class DebugUtils;
+
+// Completion token handed back by the non-blocking submit functions.
+// A token with serial 0 was never submitted and is always complete, the submit
+// functions also return it when vkQueueSubmit failed.
+struct SubmitToken {
+    uint64_t serial;
+
+    SubmitToken() : serial(0) { }
+};
+
+class FencePool {
+public:
+    FencePool();
+    ~FencePool();
+
+    // 'name' labels the fences when 'debugUtils' is given.
+    void createFencePool(const VkDevice& device, uint32_t initialFenceCount = 4, const DebugUtils* debugUtils = NULL,
+        const char* name = "Pooled fence");
+    void destroyFencePool(); // Waits for everything in flight before destroying the fences.
+
+    // Returns an unsignaled fence for the next submission, the serial it
+    // will complete is written into 'token'.
+    VkFence acquireFence(SubmitToken* token);
+
+    // Hands back the fence of a submission that failed, unsignaled. Its serial
+    // counts as complete, it does not hold back the retirement of later ones.
+    void releaseFence(const SubmitToken& token);
+
+    // Non-blocking query whether the submission behind 'token' has finished.
+    bool isComplete(const SubmitToken& token);
+
+    // Blocks until the submission behind 'token' has finished or 'timeout' (ns) expires.
+    VkResult wait(const SubmitToken& token, uint64_t timeout = UINT64_MAX);
+
+    // Recycles the fences of all finished submissions (in submission order)
+    // and returns the serial up to which everything has completed.
+    uint64_t retireCompleted();
+
+    uint64_t lastCompletedSerial();
+    uint64_t lastSubmittedSerial();
+
+private:
+    struct InFlightFence {
+        VkFence fence;
+        uint64_t serial;
+        uint32_t waiters; // Threads in wait() on the fence, it is not recycled before they leave.
+        bool released; // The submit failed, the fence never signals.
+    };
+
+    VkFence createFence();
+    uint64_t retireCompletedLocked();
+
+    VkDevice device;
+    const DebugUtils* debugUtils;
+    std::string fenceName;
+    std::vector<VkFence> freeFences; // Unsignaled fences ready for reuse.
+    std::deque<InFlightFence> inFlightFences; // Ordered by serial.
+    uint64_t nextSerial;
+    uint64_t completedSerial;
+    std::mutex poolMutex;
+};
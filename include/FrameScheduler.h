@@ -0,0 +1,94 @@
+// This drives the per-frame loop with several frames in flight. Each frame slot
+// owns its own command pool, command buffer, fence and semaphores, so the CPU
+// can record frame N+1 while the GPU is still executing frame N. The scheduler
+// only blocks when it comes back around to a slot whose work is not finished.
+
+#pragma once
+
+#include "Headers.h"
+#include <chrono>
+
+class VulkanDevice;
+class GpuProfiler;
+
+struct FrameSlot {
+    uint32_t slotIndex; // Position in the ring of frame slots.
+    VkCommandPool cmdPool; // Reset wholesale when the slot is reused.
+    VkCommandBuffer cmdBuffer;
+    VkFence inFlightFence; // Signaled when the GPU has finished this slot's work.
+    VkSemaphore imageAcquiredSemaphore; // For the presentation engine, unused when rendering offscreen.
+    VkSemaphore renderCompleteSemaphore;
+    uint64_t frameNumber;
+    bool submitted; // Has work been submitted that was not yet observed as completed.
+    uint32_t gpuFrameScope; // GPU profiler scope around the whole command buffer.
+    std::chrono::steady_clock::time_point recordStartTime;
+    std::chrono::steady_clock::time_point submitTime;
+};
+
+// Frame pacing statistics, the timings are exponential moving averages.
+struct FramePacingStats {
+    double cpuRecordMs; // From beginFrame() to endFrame() of a slot.
+    double submitToCompleteMs; // From vkQueueSubmit to the fence being observed as signaled.
+    double framesPerSecond; // Completed frames per second over the last measuring window.
+    uint64_t framesSubmitted;
+    uint64_t framesCompleted;
+    uint64_t failedCalls; // Vulkan calls of the frame loop that did not return VK_SUCCESS.
+    VkResult lastFailure; // Returned by the latest of them.
+};
+
+class FrameScheduler {
+public:
+    static const uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+    FrameScheduler();
+    ~FrameScheduler();
+
+    void createFrameSlots(VulkanDevice* deviceObj, uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
+    void destroyFrameSlots(); // Waits for all in-flight frames before destroying.
+
+    // Waits until the next slot is free, resets its command pool and begins its command buffer.
+    FrameSlot* beginFrame();
+
+    // Ends the slot's command buffer and submits it without waiting. When 'waitSemaphore'
+    // is given the submission waits on it, when 'signalRenderComplete' is set the slot's
+    // renderCompleteSemaphore is signaled for a subsequent present.
+    void endFrame(FrameSlot* slot, VkSemaphore waitSemaphore = VK_NULL_HANDLE,
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        bool signalRenderComplete = false);
+
+    // Blocks until every submitted frame has completed.
+    void waitIdle();
+
+    // Times every frame's command buffer as a "Frame" scope of 'profiler', NULL turns it off.
+    // The profiler must have a query pool per frame slot.
+    void setProfiler(GpuProfiler* inProfiler) { profiler = inProfiler; }
+
+    const FramePacingStats& getStats() const { return stats; }
+    uint32_t getFramesInFlight() const { return (uint32_t)frameSlots.size(); }
+    uint64_t getFrameNumber() const { return frameNumber; }
+
+    // Every frame numbered below the returned value has completed on the GPU, as far as the
+    // fences polled so far tell. Resources retired at frame N are free once this exceeds N - 1.
+    uint64_t getRetiredFrameCount() const;
+    void printStats() const;
+
+private:
+    // Polls the fences of submitted slots and records the completion of finished frames.
+    void collectCompletedFrames();
+    void onFrameCompleted(FrameSlot& slot, std::chrono::steady_clock::time_point now);
+
+    // Counts and reports a failed call, the frame loop carries on.
+    void checkResult(VkResult result, const char* call);
+
+    VulkanDevice* deviceObj;
+    GpuProfiler* profiler;
+    std::vector<FrameSlot> frameSlots;
+    uint32_t currentSlot;
+    uint64_t frameNumber;
+    bool recording; // Between beginFrame() and endFrame() of the current slot.
+    FramePacingStats stats;
+
+    // Frames per second measuring window.
+    std::chrono::steady_clock::time_point fpsWindowStart;
+    uint64_t fpsWindowFrames;
+};
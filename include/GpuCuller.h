@@ -0,0 +1,165 @@
+// GPU driven draw submission. The objects of a scene, a bounding sphere and the draw they use,
+// live in storage buffers on the device. Each frame a compute pass (shaders/cull.comp) tests
+// them against the view frustum and writes a VkDrawIndexedIndirectCommand per visible object,
+// packed at the front of the slot's command buffer with their count next to it, and the draws
+// are issued with one vkCmdDrawIndexedIndirectCount. The CPU cost of a frame no longer grows
+// with the object count. Without VK_KHR_draw_indirect_count the commands stay in object order,
+// culled ones with no instance, and are drawn with vkCmdDrawIndexedIndirect.
+//
+// Every command draws one instance with firstInstance set to the object index, so the vertex
+// shader reads its object from getObjectBuffer() at gl_InstanceIndex. Scenes without meshes of
+// their own can draw the bounding box of each visible object with recordBoundsDraws().
+
+#pragma once
+
+#include "Headers.h"
+#include "MemoryAllocator.h"
+#include "ComputeEngine.h"
+#include <string>
+
+class VulkanDevice;
+class DescriptorAllocator;
+class StagingRing;
+struct DescriptorTemplate;
+struct DeviceFeatures;
+
+// The records below are read by the shader with the std430 layout.
+struct CullObject {
+    float center[3]; // Bounding sphere in world space.
+    float radius;
+    uint32_t drawIndex; // Into the draw table of the scene.
+    uint32_t reserved[3];
+};
+
+// A range of the index buffer bound for the draws, a mesh or one of its LODs.
+struct CullDraw {
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(CullObject) == 32, "CullObject must match shaders/cull.comp");
+static_assert(sizeof(CullDraw) == 16, "CullDraw must match shaders/cull.comp");
+
+struct GpuCullerStats {
+    uint32_t objects;
+    uint64_t framesCulled;
+    uint64_t visibleDraws; // Summed over the frames read back.
+    uint32_t lastVisibleDraws;
+    uint64_t framesRead;
+    uint64_t drawCalls; // Indirect draw commands recorded on the CPU.
+    double recordMs; // CPU time recording the culling passes and the draws.
+};
+
+class GpuCuller {
+public:
+    static const uint32_t COMPACT_CONSTANT_ID = ComputeEngine::FIRST_USER_CONSTANT_ID;
+    static const char* const DEFAULT_SHADER_PATH;
+    static const char* const DEFAULT_BOUNDS_VERTEX_PATH;
+    static const char* const DEFAULT_BOUNDS_FRAGMENT_PATH;
+
+    GpuCuller();
+    ~GpuCuller();
+
+    // Asks for the indirect draw features, before the device is created.
+    static void requestFeatures(DeviceFeatures& features);
+
+    // Whether the device was created with firstInstance support in indirect draws.
+    static bool isSupported(const VulkanDevice* deviceObj);
+
+    // The culling kernel comes from 'computeEngine', its descriptor sets from 'descriptors' by
+    // frame slot, and the scene is uploaded through 'stagingRing'. False if the shader cannot
+    // be loaded, the culler is not usable then.
+    bool createGpuCuller(VulkanDevice* deviceObj, ComputeEngine* computeEngine, DescriptorAllocator* descriptors,
+        StagingRing* stagingRing, uint32_t frameSlotCount, const std::string& shaderPath = DEFAULT_SHADER_PATH);
+    void destroyGpuCuller(); // The caller makes sure no frame using the buffers is in flight.
+
+    // Pipeline of recordBoundsDraws() for the first subpass of 'renderPass', before setScene().
+    // False if the shaders cannot be loaded, the bounds are not drawn then.
+    bool createBoundsPipeline(VkRenderPass renderPass, uint32_t width, uint32_t height,
+        const std::string& vertexPath = DEFAULT_BOUNDS_VERTEX_PATH, const std::string& fragmentPath = DEFAULT_BOUNDS_FRAGMENT_PATH);
+
+    // Replaces the scene, the upload is flushed with the staging ring. Buffers of the previous
+    // scene go to the deletion queue.
+    void setScene(const std::vector<CullDraw>& draws, const std::vector<CullObject>& objects);
+
+    // Reads the visible count the slot wrote when it last ran, the slot must have retired.
+    void beginFrame(uint32_t frameSlot);
+
+    // Culls against 'planes', each (normal, distance) with the normal pointing inside. Recorded
+    // outside a render pass, the draws of the slot wait for it.
+    void recordCulling(VkCommandBuffer cmdBuffer, uint32_t frameSlot, const float planes[6][4]);
+
+    // Draws the visible objects, inside a render pass with the graphics pipeline and the index
+    // and vertex buffers of the draw table bound.
+    void recordDraws(VkCommandBuffer cmdBuffer, uint32_t frameSlot);
+
+    // Draws the bounding box of each visible object with recordDraws(), inside the render pass of
+    // createBoundsPipeline(). The rows of 'viewProjection' take world positions to clip space.
+    void recordBoundsDraws(VkCommandBuffer cmdBuffer, uint32_t frameSlot, const float viewProjection[4][4]);
+
+    // The culling pass on the CPU: appends the command of each visible object to 'commands',
+    // compacted, and returns their count. Reference and baseline for the shader.
+    static uint32_t cullOnCpu(const std::vector<CullDraw>& draws, const std::vector<CullObject>& objects,
+        const float planes[6][4], std::vector<VkDrawIndexedIndirectCommand>& commands);
+
+    // Generated scene of random spheres filling a cube of half side testSceneExtent(), drawing
+    // 8 index ranges that stand in for the meshes of a real scene.
+    static float testSceneExtent(uint32_t objectCount);
+    static void buildTestScene(uint32_t objectCount, std::vector<CullDraw>& draws, std::vector<CullObject>& objects);
+
+    // Camera at the origin looking along 'yaw' around the Y axis with a 60 degree vertical field
+    // of view: its frustum planes and the rows of its view-projection matrix.
+    static void cameraFrustum(float yaw, float aspect, float farDistance, float planes[6][4]);
+    static void cameraViewProjection(float yaw, float aspect, float farDistance, float rows[4][4]);
+
+    bool isCompacting() const { return drawIndirectCountFn != NULL; }
+    VkBuffer getObjectBuffer() const { return objectBuffer; }
+    uint32_t getObjectCount() const { return objectCount; }
+    const GpuCullerStats& getStats() const { return stats; }
+    void printStats() const;
+
+private:
+    struct FrameOutput {
+        VkBuffer commandBuffer; // One command per object at most.
+        MemoryAllocation commandAllocation;
+        VkBuffer countBuffer; // Host visible, read back by beginFrame().
+        MemoryAllocation countAllocation;
+        bool pending; // Culled since the count was last read.
+    };
+
+    struct CullPushConstants {
+        float planes[6][4];
+        uint32_t objectCount;
+    };
+
+    VkBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryFlags,
+        const char* name, MemoryAllocation* allocation);
+    void destroyBuffer(VkBuffer& buffer, MemoryAllocation& allocation);
+    void upload(VkBuffer buffer, const void* data, VkDeviceSize size);
+
+    VulkanDevice* deviceObj;
+    ComputeEngine* computeEngine; // Loads the shader modules.
+    DescriptorAllocator* descriptors;
+    StagingRing* stagingRing;
+    const ComputeKernel* kernel;
+    PFN_vkCmdDrawIndexedIndirectCountKHR drawIndirectCountFn; // NULL without VK_KHR_draw_indirect_count.
+
+    VkBuffer objectBuffer;
+    MemoryAllocation objectAllocation;
+    VkBuffer drawBuffer;
+    MemoryAllocation drawAllocation;
+    uint32_t objectCount;
+    std::vector<FrameOutput> outputs; // By frame slot.
+
+    // Bounding box draws, VK_NULL_HANDLE without createBoundsPipeline().
+    VkDescriptorSetLayout boundsSetLayout; // The object buffer, owned by 'descriptors'.
+    const DescriptorTemplate* boundsTemplate;
+    VkPipelineLayout boundsPipelineLayout;
+    VkPipeline boundsPipeline; // Owned by the pipeline manager.
+    VkBuffer boundsIndexBuffer; // The indices of a cube over every range of the draw table.
+    MemoryAllocation boundsIndexAllocation;
+
+    GpuCullerStats stats;
+};
@@ -0,0 +1,130 @@
+// GPU timing with timestamp queries. Named scopes write a timestamp pair into the query
+// pool of the frame slot being recorded; the results are read back without waiting when
+// that slot comes around again, by then its fence has been observed as signaled. Each
+// scope name accumulates a log-scale histogram of its durations for min/avg/p99, and the
+// individual scopes of recent frames can be exported as a Chrome trace.
+
+#pragma once
+
+#include "Headers.h"
+#include "ChromeTrace.h"
+#include <string>
+#include <unordered_map>
+
+class VulkanDevice;
+
+struct GpuScopeStats {
+    std::string name;
+    uint64_t count;
+    double minMs;
+    double avgMs;
+    double p99Ms; // Upper edge of the histogram bucket holding the 99th percentile.
+    double maxMs;
+};
+
+class GpuProfiler {
+public:
+    static const uint32_t INVALID_SCOPE = UINT32_MAX;
+    static const uint32_t DEFAULT_MAX_SCOPES = 128; // Per frame.
+    static const uint32_t HISTOGRAM_BUCKETS = 80; // Four per octave from 1 us, the last one is open ended.
+    static const size_t MAX_TRACE_EVENTS = 1 << 16;
+
+    GpuProfiler();
+    ~GpuProfiler();
+
+    // One query pool per frame slot. Profiling stays disabled if the queue family of
+    // 'queueFamilyIndex' does not support timestamps.
+    void createProfiler(VulkanDevice* deviceObj, uint32_t frameSlotCount, uint32_t queueFamilyIndex,
+        uint32_t maxScopesPerFrame = DEFAULT_MAX_SCOPES);
+    void destroyProfiler();
+
+    bool isEnabled() const { return !frames.empty(); }
+
+    // Takes the results of the frame previously recorded in 'slotIndex', its work must have
+    // completed, and resets the slot's queries in 'cmdBuffer'. Must be recorded before any scope.
+    void beginFrame(uint32_t slotIndex, VkCommandBuffer cmdBuffer);
+
+    // Scopes may nest; they go into the slot of the last beginFrame(). beginScope() returns
+    // INVALID_SCOPE when disabled or out of queries, endScope() ignores it.
+    uint32_t beginScope(VkCommandBuffer cmdBuffer, const char* name,
+        VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+    void endScope(VkCommandBuffer cmdBuffer, uint32_t scope,
+        VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+    // Takes the results of every slot, call once the device is idle.
+    void collectAll();
+
+    std::vector<GpuScopeStats> getStats() const;
+    void printStats() const;
+
+    // Appends the recorded scopes as trace events under 'pid', comma separated.
+    void appendTraceEvents(std::string& eventList, uint32_t pid) const;
+    bool writeChromeTrace(const std::string& filePath) const;
+
+private:
+    struct PendingScope {
+        uint32_t nameIndex;
+        bool ended;
+    };
+
+    struct FrameQueries {
+        VkQueryPool queryPool;
+        std::vector<PendingScope> scopes; // Scope i owns queries 2 * i and 2 * i + 1.
+        uint64_t frameNumber;
+    };
+
+    struct ScopeHistory {
+        std::string name;
+        uint64_t count;
+        double totalMs;
+        double minMs;
+        double maxMs;
+        uint64_t histogram[HISTOGRAM_BUCKETS];
+    };
+
+    void collectFrame(FrameQueries& frame);
+    void addSample(uint32_t nameIndex, double ms);
+    static uint32_t bucketOf(double ms);
+    static double bucketUpperMs(uint32_t bucket);
+
+    VulkanDevice* deviceObj;
+    std::vector<FrameQueries> frames;
+    uint32_t currentFrame;
+    uint32_t maxScopes;
+    uint64_t frameCounter;
+    uint64_t timestampMask; // Only the low timestampValidBits of a result are meaningful.
+    double nanosecondsPerTick;
+
+    std::unordered_map<std::string, uint32_t> nameIndices;
+    std::vector<ScopeHistory> histories;
+    uint64_t droppedScopes; // Out of queries, or the results were not available.
+
+    std::vector<TraceEvent> traceEvents;
+    uint64_t traceBaseTicks;
+    bool traceBaseSet;
+};
+
+// Times everything recorded into 'cmdBuffer' while it lives.
+class GpuProfileScope
+{
+public:
+    GpuProfileScope(GpuProfiler* inProfiler, VkCommandBuffer inCmdBuffer, const char* name)
+        : profiler(inProfiler), cmdBuffer(inCmdBuffer)
+    {
+        scope = profiler ? profiler->beginScope(cmdBuffer, name) : GpuProfiler::INVALID_SCOPE;
+    }
+    ~GpuProfileScope()
+    {
+        if (profiler) {
+            profiler->endScope(cmdBuffer, scope);
+        }
+    }
+
+private:
+    GpuProfileScope(const GpuProfileScope&) = delete;
+    GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+    GpuProfiler* profiler;
+    VkCommandBuffer cmdBuffer;
+    uint32_t scope;
+};
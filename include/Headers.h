@@ -10,13 +10,23 @@
 #define APP_NAME_STR_LEN 80
 #define _CRT_SECURE_NO_WARNINGS
 #else // _WIN32
+// HEADLESS_ONLY builds leave out the window system, for render nodes without X11 headers.
+#if !defined(HEADLESS_ONLY) && !defined(VK_USE_PLATFORM_XCB_KHR)
 #define VK_USE_PLATFORM_XCB_KHR
+#endif
 #include <unistd.h>
 #endif // _WIN32
 
+#if defined(VK_USE_PLATFORM_WIN32_KHR) || defined(VK_USE_PLATFORM_XCB_KHR)
+#define WSI_SUPPORTED // A surface and swapchain can be created, otherwise only headless mode is available.
+#endif
+
 #include <iostream>
 #include <vector>
 #include <cassert>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
 
 // Header files for signleton
 #include <memory>
@@ -0,0 +1,82 @@
+// Device memory sub-allocator. Instead of one vkAllocateMemory per resource, which is slow
+// and quickly runs into maxMemoryAllocationCount, memory is reserved in large blocks per
+// memory type and carved up with one of the SubAllocator strategies. Host visible blocks
+// stay persistently mapped.
+
+#pragma once
+
+#include "Headers.h"
+#include "SubAllocator.h"
+
+class VulkanDevice;
+
+enum AllocationStrategy {
+    ALLOCATION_STRATEGY_FREE_LIST = 0, // Independent lifetimes, best fit.
+    ALLOCATION_STRATEGY_BUDDY, // Fast alloc/free, power of two sizes.
+    ALLOCATION_STRATEGY_LINEAR, // Common lifetime, bump allocation.
+    ALLOCATION_STRATEGY_COUNT
+};
+
+struct MemoryBlock {
+    VkDeviceMemory memory;
+    uint32_t memoryTypeIndex;
+    AllocationStrategy strategy;
+    SubAllocator* subAllocator;
+    void* mappedData; // Whole block mapping for host visible memory, otherwise NULL.
+    bool dedicated; // Reserved for a single large resource.
+};
+
+struct MemoryAllocation {
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    uint32_t memoryTypeIndex;
+    void* mappedData; // Points at 'offset' inside the mapped block, NULL if not host visible.
+    MemoryBlock* block;
+
+    MemoryAllocation() : memory(VK_NULL_HANDLE), offset(0), size(0), memoryTypeIndex(0), mappedData(NULL), block(NULL) { }
+};
+
+struct MemoryAllocatorStats {
+    uint32_t blockCount;
+    uint32_t allocationCount;
+    VkDeviceSize reservedBytes; // Device memory held by all blocks.
+    VkDeviceSize usedBytes; // Of which handed out to resources.
+    VkDeviceSize largestFreeRange;
+    double fragmentation; // 0 when the free space of each block is contiguous.
+    double utilization; // usedBytes / reservedBytes
+};
+
+class MemoryAllocator {
+public:
+    static const VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+
+    MemoryAllocator();
+    ~MemoryAllocator();
+
+    void createAllocator(VulkanDevice* deviceObj, VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+    void destroyAllocator();
+
+    // Sub-allocates memory satisfying 'requirements' from a memory type that has 'requiredFlags'.
+    // 'linearResource' is true for buffers and linear tiled images, false for optimal tiled images.
+    VkResult allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags requiredFlags, bool linearResource,
+        AllocationStrategy strategy, MemoryAllocation* allocation);
+
+    // Allocates and binds memory for a buffer or image.
+    VkResult allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags requiredFlags, AllocationStrategy strategy, MemoryAllocation* allocation);
+    VkResult allocateForImage(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags requiredFlags, AllocationStrategy strategy, MemoryAllocation* allocation);
+
+    void free(MemoryAllocation& allocation);
+
+    MemoryAllocatorStats getStats();
+    void printStats();
+
+private:
+    MemoryBlock* createBlock(uint32_t memoryTypeIndex, AllocationStrategy strategy, VkDeviceSize size, bool dedicated);
+    void destroyBlock(MemoryBlock* block);
+
+    VulkanDevice* deviceObj;
+    VkDeviceSize blockSize;
+    std::vector<MemoryBlock*> blockList;
+    std::mutex allocatorMutex;
+};
@@ -0,0 +1,64 @@
+// On-disk layout of the streamed mesh files (.vkmesh), written by the meshConverter tool and
+// read in place by the MeshStreamer. Everything is stored the way the GPU consumes it: the
+// vertices are interleaved and quantized to vertex formats the input assembler decodes, the
+// indices are ordered meshlet by meshlet, and each LOD is one page aligned block of the file
+// (vertices, indices, meshlets) that is copied to the device as it is, without parsing.
+// Only the fixed size header is read on the CPU. Values are little endian.
+// This header does not depend on Vulkan, the converter builds without it.
+
+#pragma once
+
+#include <stdint.h>
+
+const uint32_t MESH_FILE_MAGIC = 0x48534D56; // "VMSH"
+const uint32_t MESH_FILE_VERSION = 1;
+const uint32_t MESH_MAX_LODS = 8;
+const uint32_t MESH_LOD_ALIGNMENT = 4096; // LOD blocks start on a page.
+const uint32_t MESH_SECTION_ALIGNMENT = 64; // Sections within a LOD block.
+const uint32_t MESH_MAX_MESHLET_VERTICES = 64;
+const uint32_t MESH_MAX_MESHLET_TRIANGLES = 124;
+
+// 16 bytes. position is VK_FORMAT_R16G16B16A16_SNORM, scaled by the header's position
+// scale and offset; normal is VK_FORMAT_R8G8B8A8_SNORM; uv is VK_FORMAT_R16G16_SFLOAT.
+struct MeshVertex {
+    int16_t position[4]; // w is 0.
+    int8_t normal[4]; // w is 0.
+    uint16_t uv[2];
+};
+
+// A cluster of triangles sharing few vertices, for culling and for vertex reuse.
+struct MeshMeshlet {
+    uint32_t firstIndex; // Into the indices of its LOD.
+    uint32_t indexCount;
+    float center[3]; // Bounding sphere, before quantization.
+    float radius;
+};
+
+struct MeshLod {
+    uint64_t blockOffset; // File offset of the block, the vertices come first.
+    uint64_t blockSize;
+    uint64_t indexOffset; // Relative to the block.
+    uint64_t meshletOffset; // Relative to the block.
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t meshletCount;
+    uint32_t indexSize; // 2 or 4 bytes.
+    float error; // Object space deviation from LOD 0, for picking a LOD by projected size.
+    uint32_t reserved;
+};
+
+struct MeshFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexStride; // sizeof(MeshVertex).
+    uint32_t lodCount; // LOD 0 is the most detailed.
+    float positionScale[3]; // position = positionOffset + snorm position * positionScale.
+    float positionOffset[3];
+    uint64_t fileSize;
+    MeshLod lods[MESH_MAX_LODS];
+};
+
+static_assert(sizeof(MeshVertex) == 16, "MeshVertex layout");
+static_assert(sizeof(MeshMeshlet) == 24, "MeshMeshlet layout");
+static_assert(sizeof(MeshLod) == 56, "MeshLod layout");
+static_assert(sizeof(MeshFileHeader) == 48 + MESH_MAX_LODS * sizeof(MeshLod), "MeshFileHeader layout");
@@ -0,0 +1,103 @@
+// Streams meshes in the .vkmesh format (MeshFormat.h) to the device. A mesh file is memory
+// mapped when it is opened and only its header is read, the LODs stay on disk until they are
+// requested. A requested LOD block goes from the mapped pages straight into the staging ring,
+// the only copy on the CPU, in slices of a per-update byte budget so a large mesh does not
+// stall a frame. LODs can be evicted again, their buffers are destroyed by the deletion queue.
+
+#pragma once
+
+#include "Headers.h"
+#include "MeshFormat.h"
+#include "MemoryAllocator.h"
+#include <string>
+#include <deque>
+
+class VulkanDevice;
+class StagingRing;
+
+enum MeshLodState {
+    MESH_LOD_UNLOADED = 0,
+    MESH_LOD_QUEUED, // Requested, its upload has not finished being queued.
+    MESH_LOD_RESIDENT // Usable by command buffers submitted after the next staging flush.
+};
+
+// One LOD on the device, its buffer holds the block of the file: vertices at offset 0, then
+// the indices and the meshlets at the offsets of the file's MeshLod.
+struct MeshLodBuffer {
+    MeshLodState state;
+    VkBuffer buffer;
+    MemoryAllocation allocation;
+    VkDeviceSize uploadedBytes; // Of the block, while queued.
+};
+
+struct StreamedMesh {
+    std::string path;
+    const MeshFileHeader* header; // In the mapping.
+    const uint8_t* fileData;
+    size_t fileSize;
+    MeshLodBuffer lods[MESH_MAX_LODS];
+    std::vector<uint8_t> fileCopy; // Without mmap, the file read into memory.
+};
+
+struct MeshStreamerStats {
+    uint32_t meshesOpened;
+    uint64_t bytesMapped;
+    uint32_t lodsUploaded;
+    uint32_t lodsEvicted;
+    uint64_t bytesUploaded;
+    double openMs; // Mapping and validating the files.
+    double uploadMs; // Copying the LOD blocks into the staging ring.
+};
+
+class MeshStreamer {
+public:
+    static const VkDeviceSize DEFAULT_BYTES_PER_UPDATE = 8 * 1024 * 1024;
+    static const uint32_t INVALID_LOD = UINT32_MAX;
+
+    MeshStreamer();
+    ~MeshStreamer();
+
+    // Uploads through 'stagingRing', whose queue is the one the meshes are drawn on.
+    void createMeshStreamer(VulkanDevice* deviceObj, StagingRing* stagingRing,
+        VkDeviceSize bytesPerUpdate = DEFAULT_BYTES_PER_UPDATE);
+    void destroyMeshStreamer(); // Closes every mesh.
+
+    // Maps 'path' and checks its header and offset table. NULL if the file cannot be read or
+    // is not a valid mesh file. Nothing is uploaded yet.
+    StreamedMesh* openMesh(const std::string& path);
+    void closeMesh(StreamedMesh* mesh);
+
+    // Queues the upload of a LOD, request the coarse LODs first to have something to draw early.
+    void requestLod(StreamedMesh* mesh, uint32_t lod);
+    void evictLod(StreamedMesh* mesh, uint32_t lod);
+
+    // The most detailed resident LOD no finer than 'preferredLod', or the closest finer one.
+    // INVALID_LOD when none is resident.
+    uint32_t getResidentLod(const StreamedMesh* mesh, uint32_t preferredLod) const;
+
+    // Queues the next slices of the requested LODs into the staging ring, up to the byte budget.
+    // Called once per frame before the staging ring is flushed.
+    void update();
+
+    bool isIdle() const { return requests.empty(); }
+    const MeshStreamerStats& getStats() const { return stats; }
+    void printStats() const;
+
+private:
+    struct LodRequest {
+        StreamedMesh* mesh;
+        uint32_t lod;
+    };
+
+    bool validateHeader(const StreamedMesh& mesh) const;
+    void createLodBuffer(StreamedMesh* mesh, uint32_t lod);
+    void destroyLodBuffer(MeshLodBuffer& lodBuffer);
+    void unmapMesh(StreamedMesh* mesh);
+
+    VulkanDevice* deviceObj;
+    StagingRing* stagingRing;
+    VkDeviceSize bytesPerUpdate;
+    std::vector<StreamedMesh*> meshes;
+    std::deque<LodRequest> requests; // Uploaded in order.
+    MeshStreamerStats stats;
+};
@@ -0,0 +1,51 @@
+// Render targets for headless rendering: one color image per frame slot with its own
+// render pass and framebuffer, no surface or swapchain involved. The render pass leaves
+// the image in TRANSFER_SRC_OPTIMAL, ready to be copied into a ReadbackPool.
+
+#pragma once
+
+#include "Headers.h"
+#include "MemoryAllocator.h"
+
+class VulkanDevice;
+
+struct OffscreenImage {
+    VkImage image;
+    VkImageView view;
+    VkFramebuffer framebuffer;
+    MemoryAllocation memory;
+};
+
+class OffscreenTarget {
+public:
+    static const VkFormat DEFAULT_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+    OffscreenTarget();
+    ~OffscreenTarget();
+
+    void createOffscreenTarget(VulkanDevice* deviceObj, uint32_t width, uint32_t height, uint32_t imageCount,
+        VkFormat format = DEFAULT_FORMAT);
+    void destroyOffscreenTarget(); // The caller makes sure no frame using the images is in flight.
+
+    // Begins the render pass on image 'imageIndex', clearing it to 'clearColor'.
+    void beginRenderPass(VkCommandBuffer cmdBuffer, uint32_t imageIndex, const float clearColor[4]);
+    void endRenderPass(VkCommandBuffer cmdBuffer);
+
+    VkRenderPass getRenderPass() const { return renderPass; }
+    VkImage getImage(uint32_t imageIndex) const { return images[imageIndex].image; }
+    VkImageLayout getFinalLayout() const { return VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL; }
+    VkFormat getFormat() const { return format; }
+    uint32_t getWidth() const { return width; }
+    uint32_t getHeight() const { return height; }
+    uint32_t getTexelSize() const { return 4; } // Of the supported 8 bit RGBA/BGRA formats.
+
+private:
+    void createRenderPass();
+
+    VulkanDevice* deviceObj;
+    VkRenderPass renderPass;
+    std::vector<OffscreenImage> images;
+    VkFormat format;
+    uint32_t width;
+    uint32_t height;
+};
@@ -0,0 +1,78 @@
+// This owns the VkPipelineCache of a device and the pipelines created through it.
+// The driver cache is loaded from disk at start up, so shader compiles done by an
+// earlier run are reused, and written back at shut down. On top of it an in-memory
+// map from the serialized pipeline state to the VkPipeline makes sure an identical
+// create request never reaches the driver twice. The state holds the handles of shader
+// modules, pipeline layouts and render passes, whose owners call evictObject() before
+// destroying them.
+
+#pragma once
+
+#include "Headers.h"
+#include <string>
+#include <unordered_map>
+
+class VulkanDevice;
+
+struct PipelineCacheStats {
+    uint64_t hits; // Requests served from the in-memory map.
+    uint64_t misses; // Requests that went to the driver.
+    uint64_t uncached; // Requests with a pNext chain, never put in the map.
+    uint64_t evicted; // Pipelines taken out of the map by evictObject().
+    size_t loadedBytes; // Size of the driver cache accepted from disk, 0 on a cold start.
+    size_t savedBytes;
+    double loadMs; // Reading, validating and creating the driver cache.
+    double createMs; // Total time spent in vkCreate*Pipelines.
+};
+
+class PipelineManager {
+public:
+    PipelineManager();
+    ~PipelineManager();
+
+    // Creates the driver cache, seeded from 'cacheFilePath' when that file was written
+    // for the same vendor, device and pipelineCacheUUID. An empty path disables the disk cache.
+    void createPipelineManager(VulkanDevice* deviceObj, const std::string& cacheFilePath);
+    void destroyPipelineManager(); // Destroys every pipeline it created and the driver cache.
+
+    // Writes the driver cache to disk, the file is replaced only once it is fully written.
+    bool saveCache();
+
+    // Returns the pipeline for this state, creating it on the first request. The returned
+    // pipeline is owned by the manager. Create infos with a pNext chain are not keyed and
+    // always create a new pipeline. 'name' labels the pipeline when it is created.
+    VkResult getGraphicsPipeline(const VkGraphicsPipelineCreateInfo& createInfo, VkPipeline* pipeline,
+        const char* name = "Graphics pipeline");
+    VkResult getComputePipeline(const VkComputePipelineCreateInfo& createInfo, VkPipeline* pipeline,
+        const char* name = "Compute pipeline");
+
+    // Takes the pipelines created with this shader module, pipeline layout or render pass out of
+    // the map, before the object is destroyed and its handle can be reused. They stay valid until
+    // destroyPipelineManager().
+    template <typename T>
+    void evictObject(T handle) { evictHandle((uint64_t)handle); }
+
+    // True if 'data' starts with a version one cache header written for this physical device.
+    static bool isCacheDataCompatible(const void* data, size_t size, const VkPhysicalDeviceProperties& gpuProps);
+
+    VkPipelineCache getPipelineCache() const { return pipelineCache; }
+    PipelineCacheStats getStats();
+    void printStats();
+
+private:
+    typedef std::unordered_multimap<uint64_t, std::string> KeyMultimap;
+
+    VkPipeline findPipeline(const std::string& key);
+    VkPipeline insertPipeline(const std::string& key, VkPipeline pipeline, const std::vector<uint64_t>& objects);
+    void evictHandle(uint64_t handle);
+
+    VulkanDevice* deviceObj;
+    VkPipelineCache pipelineCache;
+    std::string cacheFilePath;
+
+    std::unordered_map<std::string, VkPipeline> pipelines; // Keyed by the serialized create info.
+    KeyMultimap keysByObject; // Keys of the pipelines created with a shader module, layout or render pass.
+    std::vector<VkPipeline> uncachedPipelines; // Not in the map: created with a pNext chain, or evicted.
+    PipelineCacheStats stats;
+    std::mutex pipelineMutex; // Pipelines may be requested from the recording threads.
+};
@@ -0,0 +1,55 @@
+// Download path for rendered images. One persistently mapped, host visible buffer is
+// split into a region per frame slot; a frame records the copy of its image into its
+// slot's region, and the CPU reads the region once that slot's fence has signaled, so
+// reading back never waits on the queue. Host cached memory is preferred, CPU reads
+// from write-combined memory are very slow.
+
+#pragma once
+
+#include "Headers.h"
+#include "MemoryAllocator.h"
+
+class VulkanDevice;
+
+struct ReadbackStats {
+    uint64_t framesRead;
+    uint64_t bytesRead;
+};
+
+class ReadbackPool {
+public:
+    ReadbackPool();
+    ~ReadbackPool();
+
+    void createReadbackPool(VulkanDevice* deviceObj, uint32_t slotCount, VkDeviceSize slotSize);
+    void destroyReadbackPool(); // The caller makes sure no copy into the pool is in flight.
+
+    // Copies a tightly packed width x height image of 'texelSize' bytes per texel into the
+    // region of 'slot' and makes the copy visible to the host. 'image' must be in 'layout'.
+    void recordImageCopy(VkCommandBuffer cmdBuffer, uint32_t slot, uint64_t frameNumber,
+        VkImage image, VkImageLayout layout, uint32_t width, uint32_t height, uint32_t texelSize);
+
+    // Data of the last copy into 'slot', NULL if none is pending. The submission that made the
+    // copy must have completed. Valid until the next copy into the slot is recorded.
+    const void* acquireData(uint32_t slot, uint64_t* frameNumber = NULL, VkDeviceSize* size = NULL);
+
+    VkBuffer getBuffer() const { return buffer; }
+    const ReadbackStats& getStats() const { return stats; }
+    void printStats() const;
+
+private:
+    struct SlotRegion {
+        VkDeviceSize offset;
+        VkDeviceSize size; // Of the pending copy.
+        uint64_t frameNumber;
+        bool pending;
+    };
+
+    VulkanDevice* deviceObj;
+    VkBuffer buffer;
+    MemoryAllocation memory;
+    bool coherent; // Otherwise the mapped range has to be invalidated before reading.
+    VkDeviceSize slotSize;
+    std::vector<SlotRegion> slots;
+    ReadbackStats stats;
+};
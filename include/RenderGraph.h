@@ -0,0 +1,239 @@
+// Task graph of render and compute passes. Every pass declares the images and buffers it
+// reads and writes, with the stage, access and image layout of each use; the graph works
+// out the synchronization from that. Compiling culls the passes whose results nobody reads,
+// groups the remaining ones into one submission per run of passes on the same queue, and
+// records one merged vkCmdPipelineBarrier in front of a pass only for the hazards it really
+// has, with the layout transitions folded in. Passes on the graphics, compute and transfer
+// queues run concurrently and wait for each other on timeline semaphores. Transient images
+// and buffers are created by the graph and share memory when their lifetimes do not overlap.
+
+#pragma once
+
+#include "Headers.h"
+#include "MemoryAllocator.h"
+#include <functional>
+
+class VulkanDevice;
+
+enum RenderQueueType {
+    RENDER_QUEUE_GRAPHICS = 0,
+    RENDER_QUEUE_COMPUTE,
+    RENDER_QUEUE_TRANSFER,
+    RENDER_QUEUE_COUNT
+};
+
+// A transient image, its usage flags are completed from the declared uses.
+struct RenderImageDesc {
+    VkFormat format;
+    VkExtent3D extent;
+    uint32_t mipLevels;
+    uint32_t arrayLayers;
+    VkImageAspectFlags aspectMask;
+    VkImageUsageFlags usage;
+};
+
+struct RenderBufferDesc {
+    VkDeviceSize size;
+    VkBufferUsageFlags usage;
+};
+
+struct RenderGraphStats {
+    uint32_t passesDeclared;
+    uint32_t passesCulled;
+    uint32_t batches; // Submissions per execution.
+    uint32_t pipelineBarriers; // Per execution.
+    uint32_t imageBarriers;
+    uint32_t semaphoreWaits;
+    VkDeviceSize transientBytes; // Sum of the sizes of the transient resources.
+    VkDeviceSize allocatedBytes; // Memory they occupy after aliasing.
+    uint64_t executions;
+};
+
+class RenderGraph {
+public:
+    static const uint32_t INVALID_INDEX = UINT32_MAX;
+
+    // Records a pass, the graph has recorded its barriers already.
+    typedef std::function<void(VkCommandBuffer cmdBuffer, const RenderGraph& graph)> RecordFunction;
+
+    RenderGraph();
+    ~RenderGraph();
+
+    // Command buffers for 'frameSlotCount' executions in flight.
+    void createRenderGraph(VulkanDevice* deviceObj, uint32_t frameSlotCount);
+    void destroyRenderGraph(); // Waits for the executions in flight.
+
+    // Resources, the returned index names them in the passes. Transient resources are created
+    // by compile(), their contents do not survive from one execution to the next.
+    uint32_t createImage(const char* name, const RenderImageDesc& desc);
+    uint32_t createBuffer(const char* name, const RenderBufferDesc& desc);
+
+    // Resources owned by the caller. An imported image is in 'initialLayout' whenever an execution
+    // starts and is left in 'finalLayout', VK_IMAGE_LAYOUT_UNDEFINED leaves it as the last pass
+    // used it. Resources used on several queue families must be created VK_SHARING_MODE_CONCURRENT.
+    // Writing an imported resource keeps the pass from being culled.
+    uint32_t importImage(const char* name, VkImage image, VkImageAspectFlags aspectMask,
+        VkImageLayout initialLayout, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED);
+    uint32_t importBuffer(const char* name, VkBuffer buffer);
+
+    // Swaps the handle of an imported resource between executions, a swapchain image for example.
+    void setImportedImage(uint32_t resource, VkImage image);
+    void setImportedBuffer(uint32_t resource, VkBuffer buffer);
+
+    // Passes run in the order they are added, except that a pass may move ahead of passes on
+    // other queues it has no dependency on.
+    uint32_t addPass(const char* name, RenderQueueType queueType, const RecordFunction& record);
+    void readImage(uint32_t pass, uint32_t resource, VkPipelineStageFlags stageMask, VkAccessFlags accessMask, VkImageLayout layout);
+    void writeImage(uint32_t pass, uint32_t resource, VkPipelineStageFlags stageMask, VkAccessFlags accessMask, VkImageLayout layout);
+    void readBuffer(uint32_t pass, uint32_t resource, VkPipelineStageFlags stageMask, VkAccessFlags accessMask);
+    void writeBuffer(uint32_t pass, uint32_t resource, VkPipelineStageFlags stageMask, VkAccessFlags accessMask);
+    void setSideEffects(uint32_t pass); // Never culled, for passes with results outside the graph.
+
+    // Culls, schedules and creates the transient resources. Waits for the executions in flight
+    // when it replaces resources of a previous compile.
+    void compile();
+
+    // Records and submits the passes with the command buffers of 'frameSlot', after waiting for
+    // the slot's previous execution. Returns without waiting for the GPU.
+    void execute(uint32_t frameSlot);
+    void waitIdle();
+
+    // Forgets every pass and resource, for building another graph.
+    void reset();
+
+    // Valid while recording.
+    VkImage getImage(uint32_t resource) const { return resources[resource].image; }
+    VkImageView getImageView(uint32_t resource) const { return resources[resource].view; } // Transient images only.
+    VkBuffer getBuffer(uint32_t resource) const { return resources[resource].buffer; }
+
+    bool hasTimelineSemaphores() const { return waitSemaphoresFn != NULL; }
+    const RenderGraphStats& getStats() const { return stats; }
+    void printStats() const;
+
+private:
+    struct Access {
+        uint32_t resource;
+        VkPipelineStageFlags stageMask;
+        VkAccessFlags accessMask;
+        VkImageLayout layout;
+        bool write;
+    };
+
+    struct Pass {
+        std::string name;
+        RenderQueueType queueType;
+        RecordFunction record;
+        std::vector<Access> accesses; // At most one per resource.
+        bool sideEffects;
+        bool culled;
+        uint32_t batch;
+        uint32_t batchPosition; // Of the pass and its barrier in the batch.
+    };
+
+    struct Resource {
+        std::string name;
+        bool isImage;
+        bool imported;
+        RenderImageDesc imageDesc;
+        RenderBufferDesc bufferDesc;
+        VkImage image;
+        VkImageView view;
+        VkBuffer buffer;
+        VkImageLayout initialLayout;
+        VkImageLayout finalLayout;
+
+        // Set by compile().
+        VkMemoryRequirements requirements;
+        VkDeviceSize memoryOffset; // In the aliased heap.
+        bool aliased; // Placed in the heap, otherwise it has an allocation of its own.
+        MemoryAllocation allocation;
+        uint32_t firstPosition; // Of the passes using it, in execution order. INVALID_INDEX if unused.
+        uint32_t lastPosition;
+        uint32_t firstPass;
+        std::vector<uint32_t> batches; // Using it.
+        VkPipelineStageFlags queueStages[RENDER_QUEUE_COUNT]; // Stages using it on each queue.
+        VkAccessFlags writeAccess;
+    };
+
+    // One vkCmdPipelineBarrier: global memory barrier plus the image layout transitions.
+    struct ImageTransition {
+        uint32_t resource;
+        VkImageLayout oldLayout;
+        VkImageLayout newLayout;
+        VkAccessFlags srcAccessMask;
+        VkAccessFlags dstAccessMask;
+    };
+
+    struct Barrier {
+        VkPipelineStageFlags srcStageMask;
+        VkPipelineStageFlags dstStageMask;
+        VkAccessFlags srcAccessMask;
+        VkAccessFlags dstAccessMask;
+        std::vector<ImageTransition> transitions;
+    };
+
+    // Passes submitted together on one queue.
+    struct Batch {
+        uint32_t queue; // Index into queues.
+        uint32_t ordinal; // Among the batches of its queue, sets the timeline value it signals.
+        std::vector<uint32_t> passes;
+        std::vector<Barrier> barriers; // Before each pass.
+        Barrier endBarrier; // Final layouts of imported images.
+        uint32_t waitBatch[RENDER_QUEUE_COUNT]; // Latest batch of each other queue to wait for.
+        bool firstOnQueue; // Waits for the previous execution on the other queues.
+    };
+
+    struct Queue {
+        VkQueue queue;
+        uint32_t familyIndex;
+        VkSemaphore timeline; // VK_NULL_HANDLE without timeline semaphores.
+        uint64_t lastSignaled; // Value of the last submission.
+        uint32_t batchCount; // Per execution.
+    };
+
+    struct FrameCommands {
+        VkCommandPool pools[RENDER_QUEUE_COUNT];
+        std::vector<VkCommandBuffer> cmdBuffers[RENDER_QUEUE_COUNT];
+        uint64_t signaledValues[RENDER_QUEUE_COUNT]; // Of the slot's previous execution.
+        VkFence fence; // Without timeline semaphores, signaled by the slot's only submission.
+        bool submitted;
+    };
+
+    uint32_t addResource(const char* name, bool isImage, bool imported);
+    void addAccess(uint32_t pass, uint32_t resource, VkPipelineStageFlags stageMask, VkAccessFlags accessMask,
+        VkImageLayout layout, bool write);
+
+    // The earlier passes each pass not culled has a hazard with. 'producersOnly' keeps the
+    // passes whose writes it reads or overwrites, the ones that must run for its inputs.
+    void findDependencies(bool producersOnly, std::vector<std::vector<uint32_t> >& dependencies) const;
+    void cullPasses();
+    void scheduleBatches();
+    void createTransientResources();
+    void computeBarriers();
+    void addWait(uint32_t batch, uint32_t waitedBatch);
+    void placeTransientMemory(const std::vector<std::vector<bool> >& completeBefore);
+    void addAliasingBarriers();
+    void destroyTransientResources();
+
+    // Whether every use of 'earlier' is finished or ordered by a barrier before the first use of 'later'.
+    bool isOrderedBefore(const Resource& earlier, const Resource& later,
+        const std::vector<std::vector<bool> >& completeBefore) const;
+
+    void recordBarrier(VkCommandBuffer cmdBuffer, const Barrier& barrier);
+    void waitForSlot(FrameCommands& frame);
+
+    VulkanDevice* deviceObj;
+    std::vector<Pass> passes;
+    std::vector<Resource> resources;
+    std::vector<Batch> batches;
+    std::vector<uint32_t> executionOrder; // Passes not culled, batch by batch.
+    Queue queues[RENDER_QUEUE_COUNT]; // Distinct queues, 'queueCount' of them.
+    uint32_t queueCount;
+    uint32_t queueOfType[RENDER_QUEUE_COUNT];
+    std::vector<FrameCommands> frames;
+    MemoryAllocation heap; // Aliased memory of the transient resources.
+    bool compiled;
+    RenderGraphStats stats;
+
+    PFN_vkWaitSemaphoresKHR waitSemaphoresFn;
+};
@@ -0,0 +1,105 @@
+// Upload path for vertex, index and texture data. The staging memory is a single
+// persistently mapped, host visible ring buffer: callers write straight into it (the
+// only CPU copy), the copies into device local resources are queued and coalesced into
+// one command buffer per flush, and ring space is handed back once the fence of the
+// submission that read it has signaled, never by waiting for the queue to go idle.
+
+#pragma once
+
+#include "Headers.h"
+#include "FencePool.h"
+#include "MemoryAllocator.h"
+#include <map>
+#include <chrono>
+
+class VulkanDevice;
+
+struct StagingStats {
+    uint64_t bytesUploaded;
+    uint64_t copyCount; // Individual copy regions.
+    uint64_t submitCount; // Flushes that submitted work.
+    double activeSeconds; // Time from the first write to the latest flush.
+
+    double megabytesPerSecond() const { return activeSeconds > 0.0 ? bytesUploaded / (1024.0 * 1024.0) / activeSeconds : 0.0; }
+    double submitsPerMegabyte() const { return bytesUploaded ? submitCount / (bytesUploaded / (1024.0 * 1024.0)) : 0.0; }
+};
+
+class StagingRing {
+public:
+    static const VkDeviceSize DEFAULT_RING_SIZE = 32 * 1024 * 1024;
+
+    StagingRing();
+    ~StagingRing();
+
+    void createStagingRing(VulkanDevice* deviceObj, VkQueue queue, uint32_t queueFamilyIndex, VkDeviceSize ringSize = DEFAULT_RING_SIZE);
+    void destroyStagingRing(); // Waits for all outstanding uploads.
+
+    // Reserves 'size' bytes of ring space and returns the mapped pointer to write them to,
+    // 'ringOffset' receives the offset to use as copy source. Returns NULL when the ring
+    // is full of data still being read by the GPU (flush() and retry later).
+    void* reserve(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* ringOffset);
+
+    // Queue copies from previously reserved ring space, 'size' is the number of staged bytes read. Images must be in 'dstLayout'
+    // (normally TRANSFER_DST_OPTIMAL) when the flush executes.
+    void enqueueBufferCopy(VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize ringOffset, VkDeviceSize size);
+    void enqueueImageCopy(VkImage dstImage, VkImageLayout dstLayout, const VkBufferImageCopy& region, VkDeviceSize size);
+
+    // Convenience wrapper: reserve, memcpy and enqueue in one call. Flushes and waits
+    // for the oldest upload if the ring has no room. Returns false if 'size' exceeds the ring.
+    bool uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+    // Records every queued copy into one command buffer and submits it without waiting.
+    // Returns a token with serial 0 when there was nothing to upload.
+    SubmitToken flush();
+
+    // Hands ring space back for every flush whose fence has signaled.
+    void reclaim();
+
+    VkDeviceSize getRingSize() const { return ringSize; }
+    const StagingStats& getStats() const { return stats; }
+    void printStats() const;
+
+private:
+    struct PendingRegion {
+        SubmitToken token;
+        uint64_t end; // Ring position (see 'head') up to which this submission reads.
+    };
+
+    struct UploadCommandBuffer {
+        VkCommandBuffer cmdBuffer;
+        SubmitToken token; // Last submission that used this command buffer.
+    };
+
+    VkCommandBuffer acquireCommandBuffer(UploadCommandBuffer** owner);
+
+    // Ring position a reservation of 'size' bytes would start at, rewinds an empty ring.
+    uint64_t placeRequest(VkDeviceSize size, VkDeviceSize alignment);
+
+    VulkanDevice* deviceObj;
+    VkQueue queue;
+    VkCommandPool cmdPool;
+    FencePool fencePool;
+
+    VkBuffer ringBuffer;
+    MemoryAllocation ringMemory;
+    char* mappedData;
+    VkDeviceSize ringSize;
+
+    // Positions grow monotonically, the byte in the ring is 'position % ringSize'.
+    // 'tail' is the oldest byte the GPU may still read, 'head' the next byte to write.
+    uint64_t head;
+    uint64_t tail;
+    uint64_t flushedHead; // 'head' at the last flush.
+    std::deque<PendingRegion> pendingRegions;
+
+    // Queued copies, grouped by destination so each gets a single copy command.
+    std::map<VkBuffer, std::vector<VkBufferCopy> > bufferCopies;
+    std::map<std::pair<VkImage, VkImageLayout>, std::vector<VkBufferImageCopy> > imageCopies;
+    VkDeviceSize queuedBytes;
+
+    std::vector<UploadCommandBuffer> uploadCmdBuffers;
+
+    StagingStats stats;
+    bool hasUploaded;
+    std::chrono::steady_clock::time_point firstUploadTime;
+};
@@ -0,0 +1,128 @@
+// Placement strategies used to carve a VkDeviceMemory block into sub-allocations.
+// These only do offset bookkeeping and never call Vulkan, the MemoryAllocator owns
+// the actual device memory. All strategies respect the requested alignment and keep
+// linear (buffers, linear images) and optimal-tiling resources that share a block
+// at least 'bufferImageGranularity' apart.
+
+#pragma once
+
+#include "Headers.h"
+#include <map>
+#include <set>
+
+// Snapshot of a block's occupancy.
+struct SubAllocatorStats {
+    VkDeviceSize size; // Total managed bytes.
+    VkDeviceSize usedBytes; // Bytes handed out, including alignment padding.
+    VkDeviceSize largestFreeRange; // Biggest single range a request could still use.
+    uint32_t allocationCount;
+    uint32_t freeRangeCount;
+
+    // 0 when all free space is one contiguous range, close to 1 when it is scattered.
+    double fragmentation() const
+    {
+        VkDeviceSize freeBytes = size - usedBytes;
+        return freeBytes ? 1.0 - (double)largestFreeRange / (double)freeBytes : 0.0;
+    }
+
+    double utilization() const { return size ? (double)usedBytes / (double)size : 0.0; }
+};
+
+class SubAllocator {
+public:
+    SubAllocator(VkDeviceSize size, VkDeviceSize bufferImageGranularity);
+    virtual ~SubAllocator() { }
+
+    // Finds room for 'size' bytes, returns false when the block has no suitable range.
+    // 'linearResource' is true for buffers and linear tiled images.
+    virtual bool allocate(VkDeviceSize size, VkDeviceSize alignment, bool linearResource, VkDeviceSize* offset) = 0;
+    virtual void free(VkDeviceSize offset) = 0;
+    virtual SubAllocatorStats getStats() const = 0;
+
+    bool isEmpty() const { return getStats().allocationCount == 0; }
+    VkDeviceSize getSize() const { return size; }
+
+protected:
+    static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+    }
+
+    // True when two resources at these ranges would share a granularity page.
+    bool onSamePage(VkDeviceSize endOfFirst, VkDeviceSize startOfSecond) const
+    {
+        return (endOfFirst - 1) / granularity == startOfSecond / granularity;
+    }
+
+    VkDeviceSize size;
+    VkDeviceSize granularity;
+};
+
+// Bump allocator: allocation is an offset increment, memory is only reclaimed once
+// every allocation of the block has been freed (or reset() is called). Ideal for
+// per-frame or per-level data with a common lifetime.
+class LinearSubAllocator : public SubAllocator {
+public:
+    LinearSubAllocator(VkDeviceSize size, VkDeviceSize bufferImageGranularity);
+
+    bool allocate(VkDeviceSize size, VkDeviceSize alignment, bool linearResource, VkDeviceSize* offset);
+    void free(VkDeviceSize offset);
+    SubAllocatorStats getStats() const;
+    void reset();
+
+private:
+    VkDeviceSize head;
+    bool lastWasLinear;
+    uint32_t liveCount;
+};
+
+// Binary buddy allocator: sizes are rounded up to a power of two, which wastes some
+// memory but keeps allocation and free at O(log n) and coalesces automatically.
+// The minimum node size is at least the granularity, so neighbours never share a page.
+class BuddySubAllocator : public SubAllocator {
+public:
+    BuddySubAllocator(VkDeviceSize size, VkDeviceSize bufferImageGranularity, VkDeviceSize minNodeSize = 256);
+
+    bool allocate(VkDeviceSize size, VkDeviceSize alignment, bool linearResource, VkDeviceSize* offset);
+    void free(VkDeviceSize offset);
+    SubAllocatorStats getStats() const;
+
+private:
+    VkDeviceSize nodeSize(uint32_t order) const { return minNodeSize << order; }
+
+    VkDeviceSize minNodeSize;
+    uint32_t maxOrder;
+    std::vector<std::set<VkDeviceSize> > freeNodes; // Free node offsets per order.
+    std::map<VkDeviceSize, uint32_t> allocatedNodes; // Offset to order.
+    VkDeviceSize usedBytes;
+};
+
+// General purpose best-fit free-list allocator for resources with independent lifetimes.
+// Adjacent free ranges are merged on free.
+class FreeListSubAllocator : public SubAllocator {
+public:
+    FreeListSubAllocator(VkDeviceSize size, VkDeviceSize bufferImageGranularity);
+
+    bool allocate(VkDeviceSize size, VkDeviceSize alignment, bool linearResource, VkDeviceSize* offset);
+    void free(VkDeviceSize offset);
+    SubAllocatorStats getStats() const;
+
+private:
+    struct Range {
+        VkDeviceSize size;
+        bool isFree;
+        bool linearResource;
+    };
+
+    typedef std::map<VkDeviceSize, Range> RangeMap;
+
+    // Checks whether an allocation fits into the free range at 'it', returns the aligned offset.
+    bool fits(RangeMap::iterator it, VkDeviceSize size, VkDeviceSize alignment, bool linearResource, VkDeviceSize* offset);
+    void insertFree(VkDeviceSize offset, VkDeviceSize size);
+    void eraseFree(VkDeviceSize offset, VkDeviceSize size);
+
+    RangeMap ranges; // Every byte of the block belongs to exactly one range, keyed by offset.
+    std::multimap<VkDeviceSize, VkDeviceSize> freeBySize; // Size to offset, for best fit.
+    VkDeviceSize usedBytes;
+    uint32_t allocationCount;
+};
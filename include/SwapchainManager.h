@@ -0,0 +1,90 @@
+// Swapchain of a presentation surface. The present mode is chosen from what the surface
+// supports according to a latency versus power policy. A swapchain that went out of date
+// is replaced without draining the device: the new one is created from the old one through
+// 'oldSwapchain', and the old one goes to the device's deletion queue, which destroys it
+// once the frames that used it have retired. The choose* functions take plain query results, so they can be fed made-up data.
+
+#pragma once
+
+#include "Headers.h"
+
+class VulkanDevice;
+
+enum PresentPolicy {
+    PRESENT_POLICY_LOW_LATENCY, // MAILBOX, then IMMEDIATE which may tear, then FIFO.
+    PRESENT_POLICY_BALANCED, // MAILBOX, then FIFO, never tears.
+    PRESENT_POLICY_POWER_SAVING // FIFO, the CPU and GPU are throttled to the display rate.
+};
+
+struct SwapchainStats {
+    uint64_t imagesAcquired;
+    uint64_t imagesPresented;
+    uint32_t recreations;
+    uint32_t outOfDate; // OUT_OF_DATE results of acquire or present.
+    uint32_t suboptimal;
+};
+
+class SwapchainManager {
+public:
+    SwapchainManager();
+    ~SwapchainManager();
+
+    // Creates the swapchain for 'surface' at 'width' x 'height', or the surface's own size
+    // when it has one. The graphics queue family of the device must be able to present to it.
+    VkResult createSwapchain(VulkanDevice* deviceObj, VkSurfaceKHR surface, uint32_t width, uint32_t height,
+        PresentPolicy policy = PRESENT_POLICY_BALANCED);
+    void destroySwapchain(); // The caller makes sure no frame using the swapchain is in flight.
+
+    // Replaces the swapchain, the old one is destroyed after the frame being recorded.
+    // Returns VK_NOT_READY while the surface has a zero size, for example when minimized.
+    VkResult recreateSwapchain(uint32_t width, uint32_t height);
+
+    // Acquires the next image, 'semaphore' is signaled when it is ready to be written. Recreates
+    // an out of date swapchain first; returns VK_SUCCESS or VK_SUBOPTIMAL_KHR with an image,
+    // anything else means the frame has no image to render into.
+    VkResult acquireNextImage(VkSemaphore semaphore, uint32_t* imageIndex);
+
+    // Presents 'imageIndex' once 'waitSemaphore' is signaled. OUT_OF_DATE and SUBOPTIMAL mark the
+    // swapchain for recreation at the next acquire.
+    VkResult present(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore);
+
+    static VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR>& available, PresentPolicy policy);
+    static VkSurfaceFormatKHR chooseSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& available);
+    static VkExtent2D chooseExtent(const VkSurfaceCapabilitiesKHR& capabilities, uint32_t width, uint32_t height);
+    static uint32_t chooseImageCount(const VkSurfaceCapabilitiesKHR& capabilities, VkPresentModeKHR presentMode);
+
+    static const char* presentModeName(VkPresentModeKHR presentMode);
+
+    VkSwapchainKHR getSwapchain() const { return swapchain; }
+    VkImage getImage(uint32_t imageIndex) const { return images[imageIndex]; }
+    VkImageView getImageView(uint32_t imageIndex) const { return imageViews[imageIndex]; }
+    uint32_t getImageCount() const { return (uint32_t)images.size(); }
+    VkFormat getFormat() const { return surfaceFormat.format; }
+    VkExtent2D getExtent() const { return extent; }
+    VkPresentModeKHR getPresentMode() const { return presentMode; }
+    VkImageUsageFlags getImageUsage() const { return imageUsage; }
+    const SwapchainStats& getStats() const { return stats; }
+    void printStats() const;
+
+private:
+    // Creates the swapchain and its views from the current surface state, passing the
+    // current swapchain, if any, as the old one.
+    VkResult buildSwapchain(uint32_t width, uint32_t height);
+    void destroyImageViews(std::vector<VkImageView>& views);
+
+    VulkanDevice* deviceObj;
+    VkSurfaceKHR surface;
+    PresentPolicy policy;
+
+    VkSwapchainKHR swapchain;
+    std::vector<VkImage> images;
+    std::vector<VkImageView> imageViews;
+    VkSurfaceFormatKHR surfaceFormat;
+    VkExtent2D extent;
+    VkPresentModeKHR presentMode;
+    VkImageUsageFlags imageUsage;
+    uint32_t requestedWidth; // Size asked for by the last create or recreate.
+    uint32_t requestedHeight;
+    bool needsRecreate;
+    SwapchainStats stats;
+};
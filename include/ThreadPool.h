@@ -0,0 +1,44 @@
+// A small fixed-size pool of worker threads. Work is handed out as a parallel
+// for-loop: every task receives its index and the index of the worker that runs
+// it, so per-thread resources (command pools etc.) can be looked up without locks.
+
+#pragma once
+
+#include "Headers.h"
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+class ThreadPool {
+public:
+    ThreadPool();
+    ~ThreadPool();
+
+    // Starts 'threadCount' workers, 0 uses one worker per hardware thread.
+    void createThreads(uint32_t threadCount = 0);
+    void destroyThreads();
+
+    // Runs task(taskIndex, workerIndex) for every taskIndex in [0, taskCount)
+    // and returns once all tasks have finished.
+    void parallelFor(uint32_t taskCount, const std::function<void(uint32_t, uint32_t)>& task);
+
+    uint32_t getThreadCount() const { return (uint32_t)workers.size(); }
+
+private:
+    void workerLoop(uint32_t workerIndex);
+
+    std::vector<std::thread> workers;
+    std::mutex poolMutex;
+    std::mutex dispatchMutex; // Serializes concurrent parallelFor() callers.
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+
+    const std::function<void(uint32_t, uint32_t)>* currentTask;
+    uint32_t taskCount;
+    std::atomic<uint32_t> nextTask;
+    std::atomic<uint32_t> remainingTasks;
+    uint32_t activeWorkers;
+    uint64_t generation; // Incremented for every dispatched job.
+    bool stopping;
+};
@@ -3,28 +3,106 @@
 #include "VulkanInstance.h"
 #include "VulkanLayerAndExtension.h"
 #include "VulkanDevice.h"
+#include "FrameScheduler.h"
+#include "CommandPoolManager.h"
+#include "StagingRing.h"
+#include "CapabilityDatabase.h"
+#include "DeviceSelector.h"
+#include "GpuProfiler.h"
+#include "OffscreenTarget.h"
+#include "ReadbackPool.h"
+#include "SwapchainManager.h"
+#include "DescriptorAllocator.h"
+#include "ComputeEngine.h"
+#include "MeshStreamer.h"
+#include "BindlessTable.h"
+#include "GpuCuller.h"
+#include "CommandBufferManager.h"
 
+// A Vulkan context: the instance, its devices, the debug state and the frame loop. Nothing is
+// shared between contexts, several can be created and driven from different threads at once as
+// long as their cache and output files differ.
 class VulkanApplication {
 private:
-    // Variables for singleton implementation.
-    static std::unique_ptr<VulkanApplication> instance;
-    static std::once_flag onlyOnce;
+    FrameSlot* currentFrame; // Slot being recorded between update() and render().
     bool debugFlag; // Whether to debug.
 
-    VulkanApplication();
-
     // Wrapper function: create the Vulkan instance object
-    VkResult createVulkanInstance(std::vector<const char*>& layers, std::vector<const char*>& extensions, const char* applicationName);
+    VkResult createVulkanInstance(std::vector<const char*>& layers, std::vector<const char*>& extensions, const char* applicationName,
+        const std::vector<const char*>& optionalExtensions = std::vector<const char*>());
     VkResult handShakeWithDevice(VkPhysicalDevice* gpu, std::vector<const char*>& layers, std::vector<const char*> &extensions);
     VkResult enumeratePhysicalDevice(std::vector<VkPhysicalDevice>& gpus);
 
+    // Ranks the GPUs, best first, see DeviceSelector.
+    std::vector<uint32_t> selectPhysicalDevices();
+
+    // Headless mode: clears the slot's offscreen image, draws the bounds of the culled objects
+    // into it and copies it into the readback pool.
+    void recordOffscreenFrame(FrameSlot* frame);
+    bool writeLastReadback(const std::string& filePath);
+
+    // Clears the acquired swapchain image and hands it over to presentation.
+    void recordSwapchainFrame(FrameSlot* frame);
+
+    // Culls the generated scene for the frame's camera, ahead of its passes.
+    void recordCulling(FrameSlot* frame);
+    uint32_t currentImageIndex; // Swapchain image of 'currentFrame', valid if 'currentImageAcquired'.
+    bool currentImageAcquired;
+
+    // Extensions actually required, the WSI ones are left out in headless mode.
+    std::vector<const char*> requiredInstanceExtensions;
+    std::vector<const char*> requiredDeviceExtensions;
+
 public:
     VulkanInstance instanceObj;
-    VulkanDevice* deviceObj;
+    VulkanDevice* deviceObj; // Primary device, deviceList[0]. Frames are rendered on it.
+    std::vector<VulkanDevice*> deviceList; // Logical devices, in ranking order.
+    std::vector<VkPhysicalDevice> gpuList; // Enumerated physical devices, VulkanDevice::gpu points into it.
+    CapabilityDatabase capabilityDB; // Layers and extensions of the loader and every device.
+    FrameScheduler frameScheduler;
+    CommandPoolManager commandPoolMgr; // Per-thread, per-frame pools for parallel recording.
+    DescriptorAllocator descriptorAllocator; // Layout cache and per-frame descriptor sets, per recording thread.
+    StagingRing stagingRing; // Uploads vertex, index and texture data to the device.
+    ComputeEngine computeEngine; // Compute kernels dispatched on the compute queue.
+    MeshStreamer meshStreamer; // Mesh LODs streamed from mapped files through the staging ring.
+    StreamedMesh* mesh; // Opened from 'meshPath', NULL without one.
+    BindlessTable bindlessTable; // Textures and buffers referenced by index, without descriptor indexing not created.
+    GpuCuller gpuCuller; // Frustum culling of the generated scene into indirect draws.
+    BarrierBuilder barrierBuilder; // Pipeline barriers recorded by the main thread.
+    GpuProfiler gpuProfiler; // GPU time of the frames and of the scopes recorded into them.
+    OffscreenTarget offscreenTarget; // Render targets of headless mode.
+    ReadbackPool readbackPool; // Host copies of the headless frames.
+    VkSurfaceKHR surface; // Presentation surface, VK_NULL_HANDLE in headless mode.
+    SwapchainManager swapchainMgr;
 
-    ~VulkanApplication();
+    uint32_t framesInFlight; // Number of frames the CPU may record ahead of the GPU.
+    uint64_t frameLimit; // Number of frames to render before the loop ends, 0 renders forever.
+    std::string pipelineCachePath; // Pipeline cache file kept between runs, empty disables it.
+    std::string capabilityCachePath; // Capability database file kept between runs, empty disables it.
+    bool listCapabilities; // Print every layer and extension found.
+    DeviceSelectionPolicy devicePolicy;
+    uint32_t maxDeviceCount; // Logical devices to create on the best ranked GPUs, for split workloads.
+    std::string gpuTracePath; // Chrome trace of the GPU scopes written at shut down, empty disables it.
+    bool headless; // Render offscreen without surface or swapchain, forced when built without WSI.
+    uint32_t renderWidth; // Size of the offscreen images.
+    uint32_t renderHeight;
+    std::string readbackPath; // Headless mode writes its last frame to this PPM file, empty disables it.
+    PresentPolicy presentPolicy; // Present mode preference of the swapchain.
+    std::string meshPath; // Mesh file streamed in at start up, empty loads none.
+    uint32_t cullObjectCount; // Objects of the scene generated for GPU culling, 0 generates none.
+    std::string benchmarkName; // Device benchmark run instead of the frame loop, see DeviceBenchmarks.
+
+    // Layers and extensions the context asks for, set before initialize().
+    std::vector<const char*> layerNames; // Skipped when not installed.
+    std::vector<const char*> instanceExtensionNames; // Window system integration, left out in headless mode.
+    std::vector<const char*> debugInstanceExtensionNames; // Enabled when present and debugging is on.
+    std::vector<const char*> presentInstanceExtensionNames; // Enabled when present outside headless mode.
+    std::vector<const char*> featureInstanceExtensionNames; // Enabled when present.
+    std::vector<const char*> deviceExtensionNames; // Required, left out in headless mode.
+    std::vector<const char*> optionalDeviceExtensionNames; // Enabled where the device supports them.
 
-    static VulkanApplication* GetInstance();
+    VulkanApplication();
+    ~VulkanApplication();
 
     // Simple program life cycle
     void initialize(); // Initialize and allocate resources
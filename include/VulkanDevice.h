@@ -6,6 +6,46 @@
 
 #include "Headers.h"
 #include "VulkanLayerAndExtension.h"
+#include "MemoryAllocator.h"
+#include "PipelineManager.h"
+#include "DebugUtils.h"
+#include "DeletionQueue.h"
+
+// Which queue family, and which queue inside it, serves each kind of work.
+// When no dedicated family exists the work falls back to a spare queue of a
+// more general family, or shares that family's queue.
+struct QueueFamilySelection {
+    uint32_t graphicsFamily;
+    uint32_t computeFamily;
+    uint32_t transferFamily;
+    uint32_t graphicsQueue; // Queue index inside the family.
+    uint32_t computeQueue;
+    uint32_t transferQueue;
+    bool dedicatedComputeFamily; // Compute family without graphics.
+    bool dedicatedTransferFamily; // Transfer family without graphics or compute.
+    bool found; // False if the device has no graphics queue family.
+    std::vector<uint32_t> queueCounts; // Number of queues to create per family.
+};
+
+class VulkanDevice;
+
+// Device features, core and per extension, as a pNext chain headed by 'core'. Every member
+// after sType/pNext is a VkBool32, so feature sets combine field by field.
+struct DeviceFeatures {
+    VkPhysicalDeviceFeatures2KHR core;
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphore; // VK_KHR_timeline_semaphore
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexing; // VK_EXT_descriptor_indexing
+    VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2; // VK_KHR_synchronization2
+
+    DeviceFeatures(); // All features off.
+
+    // Links the structs of the extensions enabled on 'device' behind 'core' and returns the head.
+    // The links point into this object, chain again after copying it.
+    VkPhysicalDeviceFeatures2KHR* chain(const VulkanDevice& device);
+
+    // Turns off every feature that 'supported' does not have.
+    void intersect(const DeviceFeatures& supported);
+};
 
 class VulkanDevice {
 public:
@@ -21,14 +61,42 @@ public:
     uint32_t graphicsQueueWithPresentIndex;
     uint32_t queueFamilyCount;
 
+    // Async compute and transfer queues, these may alias 'queue' on devices without spare queues.
+    VkQueue computeQueue;
+    VkQueue transferQueue;
+    uint32_t computeQueueIndex; // Queue family indices, like graphicsQueueIndex.
+    uint32_t transferQueueIndex;
+    QueueFamilySelection queueSelection;
+
+    float graphicsQueuePriority;
+    float computeQueuePriority;
+    float transferQueuePriority;
+
     VulkanLayerAndExtension layerExtension;
+    MemoryAllocator memoryAllocator; // Sub-allocates device memory for the resources of this device.
+    PipelineManager pipelineManager; // Pipeline cache and the pipelines created on this device.
+    DeletionQueue deletionQueue; // Destroys objects once the submissions using them have completed.
+    const DebugUtils* debugUtils; // Entry points of the instance, NULL or disabled when not debugging.
+    VkInstance instance; // Owner of 'gpu', set before createDevice for the feature query.
+
+    // Set before createDevice: the features to enable where the device supports them. After it,
+    // 'enabledFeatures' tells which ones are on, features of extensions not enabled are off.
+    DeviceFeatures requestedFeatures;
+    DeviceFeatures enabledFeatures;
 
     VulkanDevice(VkPhysicalDevice* gpu);
     ~VulkanDevice();
 
 public:
+    // 'extensions' are required, 'optionalExtensions' are enabled where supported. Device extensions
+    // depending on instance extensions are checked against 'enabledInstanceExtensions' if given.
     VkResult createDevice(std::vector<const char*>& layers,
-        std::vector<const char*>& extensions);
+        std::vector<const char*>& extensions,
+        const std::vector<const char*>& optionalExtensions = std::vector<const char*>(),
+        const CapabilitySet* enabledInstanceExtensions = NULL);
+
+    // O(1) query of the extensions enabled on the device.
+    bool isExtensionEnabled(const char* extensionName) const { return layerExtension.enabled.hasExtension(extensionName); }
     void destroyDevice();
 
     // Get the available queues exposed by the physical devices
@@ -37,5 +105,25 @@ public:
     // Query physical device to retrive queue properties
     uint32_t getGraphicsQueueHandle();
 
+    // Choose the graphics, compute and transfer queues from a queue family table.
+    // Does not touch the device, so it can be fed with made-up tables.
+    static QueueFamilySelection selectQueueFamilies(const std::vector<VkQueueFamilyProperties>& families);
+
     void getDeviceQueue();
+
+    // Features of the device, for the extensions enabled so far. Only the core features are
+    // known without VK_KHR_get_physical_device_properties2 in 'enabledInstanceExtensions'.
+    void queryFeatures(const CapabilitySet* enabledInstanceExtensions, DeviceFeatures& supported) const;
+
+    // Names 'handle' in validation messages and frame captures, does nothing without debug utils.
+    template <typename T>
+    void setObjectName(VkObjectType objectType, T handle, const char* name) const
+    {
+        if (debugUtils) {
+            debugUtils->setObjectName(device, objectType, handle, name);
+        }
+    }
+
+    // Find the first memory type allowed by 'typeBits' that has all 'requirementsMask' property flags.
+    bool memoryTypeFromProperties(uint32_t typeBits, VkFlags requirementsMask, uint32_t* typeIndex);
 };
\ No newline at end of file
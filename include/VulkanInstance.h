@@ -8,17 +8,26 @@
 #pragma once
 
 #include "VulkanLayerAndExtension.h"
+#include "DebugUtils.h"
 
 class VulkanInstance {
 public:
     VkInstance instance;
     VulkanLayerAndExtension layerExtension; // Vulkan instance specific layer and extensions
+    DebugUtils debugUtils; // Object names and labels, disabled unless VK_EXT_debug_utils is enabled.
 
 public:
     VulkanInstance() { }
     ~VulkanInstance() { }
 
 public:
-    VkResult createInstance(std::vector<const char*>& layers, std::vector<const char*> &extensions, const char* applicationName);
+    // 'optionalExtensions' are enabled when the implementation or one of the layers provides them.
+    VkResult createInstance(std::vector<const char*>& layers, std::vector<const char*> &extensions, const char* applicationName,
+        const std::vector<const char*>& optionalExtensions = std::vector<const char*>());
     void destroyInstance();
+
+    // Surface without a window through VK_EXT_headless_surface, for presenting where no window
+    // system is available. Fails with VK_ERROR_EXTENSION_NOT_PRESENT if the extension is not enabled.
+    VkResult createHeadlessSurface(VkSurfaceKHR* surface);
+    void destroySurface(VkSurfaceKHR surface);
 };
\ No newline at end of file
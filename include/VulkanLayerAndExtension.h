@@ -4,11 +4,11 @@
 #pragma once
 
 #include "Headers.h"
+#include "CapabilitySet.h"
+#include "DebugReportSink.h"
 
-struct LayerProperties {
-    VkLayerProperties properties;
-    std::vector<VkExtensionProperties> extensions;
-};
+class CapabilityDatabase;
+class DebugUtils;
 
 class VulkanLayerAndExtension {
 public:
@@ -27,27 +27,48 @@ public:
 
     std::vector<LayerProperties> layerPropertyList; // system supported layer property info.
 
+    CapabilitySet supported; // Hashed layers and extensions of 'layerPropertyList' and the implementation.
+    CapabilitySet enabled; // Layers and extensions actually enabled.
+
     // Instance/global layer
-    VkResult getInstanceLayerProperties(); // This helper function will query either
+    VkResult getInstanceLayerProperties(CapabilityDatabase& capabilities); // This helper function will query either
                                            // instance or global layers. It gets the total
                                            // count of the layers and stores all of the
                                            // layer information in a VkLayerProperties
 
-    // Global extensions
-    VkResult getExtensionProperties(LayerProperties& layerProps,
+    // Global extensions, thread safe as it only writes 'layerProps'.
+    static VkResult getExtensionProperties(LayerProperties& layerProps,
         VkPhysicalDevice* gpu = NULL);
 
     // Device-based extensions
-    VkResult getDeviceExtensionProperties(VkPhysicalDevice* gpu);
+    VkResult getDeviceExtensionProperties(VkPhysicalDevice* gpu, CapabilityDatabase& capabilities);
+
+    // Prints 'layerPropertyList' with the extensions of every layer.
+    void printLayerProperties(const char* title, const char* extensionLabel);
 
     /******* VULKAN DEBUGGING MEMBER FUNCTION AND VARAIBLES *******/
 
     // This function inspects the incoming layer names against system-supported layers.
     VkBool32 areLayersSupported(std::vector<const char*>& layerNames);
-    VkResult createDebugReportCallback();
-    void destroyDebugReportCallback();
+
+    // Produces the ordered enable list in 'appRequestedExtensionNames', fails if a required extension is missing.
+    VkResult resolveExtensions(CapabilityLevel level,
+        const std::vector<const char*>& layerNames,
+        const std::vector<const char*>& requiredExtensions,
+        const std::vector<const char*>& optionalExtensions,
+        const CapabilitySet* enabledInstanceExtensions = NULL);
+
+    // Routes validation messages to 'debugSink' through VK_EXT_debug_utils when 'debugUtils' is
+    // loaded, otherwise through a debug report callback.
+    VkResult createDebugMessenger(VkInstance instance, DebugUtils& debugUtils);
+    void destroyDebugMessenger(VkInstance instance, DebugUtils& debugUtils);
+
+    VkResult createDebugReportCallback(VkInstance instance);
+    void destroyDebugReportCallback(VkInstance instance);
+    void fillDebugReportCreateInfo(); // Sets up 'dbgReportCreateInfo', also chained to the instance create info.
 
     // This user-defined funciton prints the retrieved bug infos in a user-friendly way.
+    // With a DebugReportSink as 'userData' the message is queued to it instead of printed.
     static VKAPI_ATTR VkBool32 VKAPI_CALL debugFunction(VkFlags msgFlags,
         VkDebugReportObjectTypeEXT objType,
         uint64_t srcObject,
@@ -62,6 +83,9 @@ private:
     PFN_vkDestroyDebugReportCallbackEXT dbgDestroyDebugReportCallback;
     VkDebugReportCallbackEXT debugReportCallback;
 
+public:
+    DebugReportSink debugSink; // Receives the messages of 'debugReportCallback' off the calling thread.
+
 public:
     VkDebugReportCallbackCreateInfoEXT dbgReportCreateInfo = {}; // Defines the behaviour of the debugging: what infos should be included.
 };
\ No newline at end of file
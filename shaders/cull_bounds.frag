@@ -0,0 +1,12 @@
+// Flat color per object for the boxes of shaders/cull_bounds.vert.
+#version 450
+
+layout(location = 0) flat in uint objectIndex;
+
+layout(location = 0) out vec4 color;
+
+void main()
+{
+    uint hash = objectIndex * 2654435761u;
+    color = vec4(vec3((hash >> 8) & 255u, (hash >> 16) & 255u, (hash >> 24) & 255u) / 255.0, 1.0);
+}
@@ -0,0 +1,32 @@
+// Bounding box of an object culled by shaders/cull.comp, drawn by GpuCuller::recordBoundsDraws().
+// The index buffer repeats the indices of a box, so the vertex index picks the corner, and the
+// culling pass set firstInstance to the object index.
+#version 450
+
+struct CullObject {
+    vec4 sphere; // Center and radius in world space.
+    uint drawIndex;
+    uint reserved0;
+    uint reserved1;
+    uint reserved2;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Objects { CullObject objects[]; };
+
+layout(push_constant) uniform View {
+    vec4 viewProjection[4]; // Rows, from world to clip space.
+} view;
+
+layout(location = 0) flat out uint objectIndex;
+
+void main()
+{
+    CullObject object = objects[gl_InstanceIndex];
+    uint corner = uint(gl_VertexIndex) & 7u;
+    vec3 offset = vec3(corner & 1u, (corner >> 1) & 1u, (corner >> 2) & 1u) * 2.0 - 1.0;
+    vec4 position = vec4(object.sphere.xyz + offset * object.sphere.w, 1.0);
+
+    gl_Position = vec4(dot(view.viewProjection[0], position), dot(view.viewProjection[1], position),
+        dot(view.viewProjection[2], position), dot(view.viewProjection[3], position));
+    objectIndex = uint(gl_InstanceIndex);
+}
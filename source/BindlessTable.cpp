@@ -0,0 +1,274 @@
+#include "BindlessTable.h"
+#include "VulkanDevice.h"
+
+BindlessTable::BindlessTable()
+{
+    deviceObj = NULL;
+    setLayout = VK_NULL_HANDLE;
+    pool = VK_NULL_HANDLE;
+    set = VK_NULL_HANDLE;
+    maxTextures = 0;
+    maxBuffers = 0;
+    textureHighWater = 0;
+    bufferHighWater = 0;
+    currentFrame = 0;
+    stats = {};
+}
+
+BindlessTable::~BindlessTable()
+{
+}
+
+void BindlessTable::requestFeatures(DeviceFeatures& features)
+{
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT& indexing = features.descriptorIndexing;
+    indexing.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    indexing.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+    indexing.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    indexing.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    indexing.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    indexing.descriptorBindingPartiallyBound = VK_TRUE;
+    indexing.runtimeDescriptorArray = VK_TRUE;
+}
+
+bool BindlessTable::isSupported(const VulkanDevice* deviceObj)
+{
+    const VkPhysicalDeviceDescriptorIndexingFeaturesEXT& indexing = deviceObj->enabledFeatures.descriptorIndexing;
+    return indexing.shaderSampledImageArrayNonUniformIndexing && indexing.shaderStorageBufferArrayNonUniformIndexing
+        && indexing.descriptorBindingSampledImageUpdateAfterBind && indexing.descriptorBindingStorageBufferUpdateAfterBind
+        && indexing.descriptorBindingUpdateUnusedWhilePending && indexing.descriptorBindingPartiallyBound
+        && indexing.runtimeDescriptorArray;
+}
+
+void BindlessTable::createBindlessTable(VulkanDevice* inDeviceObj, uint32_t inMaxTextures, uint32_t inMaxBuffers)
+{
+    VkResult result;
+
+    deviceObj = inDeviceObj;
+    assert(isSupported(deviceObj));
+
+    // The update after bind limits are at least the regular ones, which are known without
+    // VK_KHR_get_physical_device_properties2. Keep room for the other sets of the pipeline.
+    const VkPhysicalDeviceLimits& limits = deviceObj->gpuProps.limits;
+    maxTextures = std::min(inMaxTextures, std::min(limits.maxPerStageDescriptorSampledImages, limits.maxPerStageDescriptorSamplers) / 2);
+    maxTextures = std::min(maxTextures, std::min(limits.maxDescriptorSetSampledImages, limits.maxDescriptorSetSamplers) / 2);
+    maxBuffers = std::min(inMaxBuffers, std::min(limits.maxPerStageDescriptorStorageBuffers, limits.maxDescriptorSetStorageBuffers) / 2);
+    maxTextures = std::max(maxTextures, 1u);
+    maxBuffers = std::max(maxBuffers, 1u);
+
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    bindings[0].binding = TEXTURE_BINDING;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = maxTextures;
+    bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+    bindings[0].pImmutableSamplers = NULL;
+    bindings[1].binding = BUFFER_BINDING;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = maxBuffers;
+    bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+    bindings[1].pImmutableSamplers = NULL;
+
+    // Slots are written while the set is bound, and not every slot holds a resource.
+    VkDescriptorBindingFlagsEXT bindingFlags[2];
+    bindingFlags[0] = bindingFlags[1] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT
+        | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT;
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    bindingFlagsInfo.pNext = NULL;
+    bindingFlagsInfo.bindingCount = 2;
+    bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &bindingFlagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+
+    result = vkCreateDescriptorSetLayout(deviceObj->device, &layoutInfo, NULL, &setLayout);
+    assert(result == VK_SUCCESS);
+
+    VkDescriptorPoolSize poolSizes[2];
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = maxTextures;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = maxBuffers;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.pNext = NULL;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+
+    result = vkCreateDescriptorPool(deviceObj->device, &poolInfo, NULL, &pool);
+    assert(result == VK_SUCCESS);
+    deviceObj->setObjectName(VK_OBJECT_TYPE_DESCRIPTOR_POOL, pool, "Bindless pool");
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.pNext = NULL;
+    allocInfo.descriptorPool = pool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &setLayout;
+
+    result = vkAllocateDescriptorSets(deviceObj->device, &allocInfo, &set);
+    assert(result == VK_SUCCESS);
+    deviceObj->setObjectName(VK_OBJECT_TYPE_DESCRIPTOR_SET, set, "Bindless table");
+}
+
+void BindlessTable::destroyBindlessTable()
+{
+    vkDestroyDescriptorPool(deviceObj->device, pool, NULL);
+    vkDestroyDescriptorSetLayout(deviceObj->device, setLayout, NULL);
+    pool = VK_NULL_HANDLE;
+    setLayout = VK_NULL_HANDLE;
+    set = VK_NULL_HANDLE;
+
+    freeTextures.clear();
+    freeBuffers.clear();
+    releasedSlots.clear();
+    textureHighWater = bufferHighWater = 0;
+}
+
+void BindlessTable::writeTexture(BindlessHandle handle, VkImageView view, VkSampler sampler, VkImageLayout layout)
+{
+    VkDescriptorImageInfo imageInfo;
+    imageInfo.sampler = sampler;
+    imageInfo.imageView = view;
+    imageInfo.imageLayout = layout;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.pNext = NULL;
+    write.dstSet = set;
+    write.dstBinding = TEXTURE_BINDING;
+    write.dstArrayElement = handle;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &imageInfo;
+
+    vkUpdateDescriptorSets(deviceObj->device, 1, &write, 0, NULL);
+    stats.descriptorWrites++;
+}
+
+void BindlessTable::writeBuffer(BindlessHandle handle, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    VkDescriptorBufferInfo bufferInfo;
+    bufferInfo.buffer = buffer;
+    bufferInfo.offset = offset;
+    bufferInfo.range = range;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.pNext = NULL;
+    write.dstSet = set;
+    write.dstBinding = BUFFER_BINDING;
+    write.dstArrayElement = handle;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &bufferInfo;
+
+    vkUpdateDescriptorSets(deviceObj->device, 1, &write, 0, NULL);
+    stats.descriptorWrites++;
+}
+
+BindlessHandle BindlessTable::registerTexture(VkImageView view, VkSampler sampler, VkImageLayout layout)
+{
+    BindlessHandle handle;
+    if (!freeTextures.empty()) {
+        handle = freeTextures.back();
+        freeTextures.pop_back();
+    } else if (textureHighWater < maxTextures) {
+        handle = textureHighWater++;
+    } else {
+        return INVALID_BINDLESS_HANDLE;
+    }
+
+    writeTexture(handle, view, sampler, layout);
+    stats.texturesRegistered++;
+    stats.texturesInUse++;
+    stats.peakTextures = std::max(stats.peakTextures, stats.texturesInUse);
+    return handle;
+}
+
+BindlessHandle BindlessTable::registerBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    BindlessHandle handle;
+    if (!freeBuffers.empty()) {
+        handle = freeBuffers.back();
+        freeBuffers.pop_back();
+    } else if (bufferHighWater < maxBuffers) {
+        handle = bufferHighWater++;
+    } else {
+        return INVALID_BINDLESS_HANDLE;
+    }
+
+    writeBuffer(handle, buffer, offset, range);
+    stats.buffersRegistered++;
+    stats.buffersInUse++;
+    stats.peakBuffers = std::max(stats.peakBuffers, stats.buffersInUse);
+    return handle;
+}
+
+void BindlessTable::updateTexture(BindlessHandle handle, VkImageView view, VkSampler sampler, VkImageLayout layout)
+{
+    assert(handle < textureHighWater);
+    writeTexture(handle, view, sampler, layout);
+}
+
+void BindlessTable::updateBuffer(BindlessHandle handle, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    assert(handle < bufferHighWater);
+    writeBuffer(handle, buffer, offset, range);
+}
+
+void BindlessTable::releaseTexture(BindlessHandle handle)
+{
+    assert(handle < textureHighWater);
+    ReleasedSlot slot;
+    slot.binding = TEXTURE_BINDING;
+    slot.handle = handle;
+    slot.frameNumber = currentFrame;
+    releasedSlots.push_back(slot);
+    stats.texturesInUse--;
+}
+
+void BindlessTable::releaseBuffer(BindlessHandle handle)
+{
+    assert(handle < bufferHighWater);
+    ReleasedSlot slot;
+    slot.binding = BUFFER_BINDING;
+    slot.handle = handle;
+    slot.frameNumber = currentFrame;
+    releasedSlots.push_back(slot);
+    stats.buffersInUse--;
+}
+
+void BindlessTable::beginFrame(uint64_t frameNumber, uint64_t retiredFrameCount)
+{
+    currentFrame = frameNumber;
+
+    // Released in frame order, so the retired ones are at the front.
+    size_t retired = 0;
+    while (retired < releasedSlots.size() && releasedSlots[retired].frameNumber < retiredFrameCount) {
+        const ReleasedSlot& slot = releasedSlots[retired++];
+        (slot.binding == TEXTURE_BINDING ? freeTextures : freeBuffers).push_back(slot.handle);
+    }
+    releasedSlots.erase(releasedSlots.begin(), releasedSlots.begin() + retired);
+}
+
+void BindlessTable::bind(VkCommandBuffer cmdBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t setIndex) const
+{
+    vkCmdBindDescriptorSets(cmdBuffer, bindPoint, pipelineLayout, setIndex, 1, &set, 0, NULL);
+}
+
+void BindlessTable::printStats() const
+{
+    std::cout << "Bindless table: " << stats.texturesRegistered << " textures and " << stats.buffersRegistered
+              << " buffers registered, peak " << stats.peakTextures << "/" << maxTextures << " textures, "
+              << stats.peakBuffers << "/" << maxBuffers << " buffers, " << stats.descriptorWrites
+              << " descriptor writes" << std::endl;
+}
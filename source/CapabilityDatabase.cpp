@@ -0,0 +1,394 @@
+#include "CapabilityDatabase.h"
+#include "ThreadPool.h"
+#include "CpuProfiler.h"
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+
+// File layout: magic, format version, loader version, the instance layers, then the
+// devices. Properties are stored as raw structs, the file never leaves the machine.
+static const uint32_t DATABASE_MAGIC = 0x44435856; // "VXCD"
+static const uint32_t DATABASE_VERSION = 2;
+
+template <typename T>
+static void writeValue(std::ostream& out, const T& value)
+{
+    out.write((const char*)&value, sizeof(T));
+}
+
+template <typename T>
+static bool readValue(std::istream& in, T& value)
+{
+    return (bool)in.read((char*)&value, sizeof(T));
+}
+
+static void writeLayer(std::ostream& out, const LayerProperties& layer)
+{
+    writeValue(out, layer.properties);
+    writeValue(out, (uint32_t)layer.extensions.size());
+    if (!layer.extensions.empty()) {
+        out.write((const char*)layer.extensions.data(), layer.extensions.size() * sizeof(VkExtensionProperties));
+    }
+}
+
+static bool readLayer(std::istream& in, LayerProperties& layer)
+{
+    uint32_t extensionCount = 0;
+    if (!readValue(in, layer.properties) || !readValue(in, extensionCount)) {
+        return false;
+    }
+    layer.extensions.resize(extensionCount);
+    return !extensionCount || in.read((char*)layer.extensions.data(), extensionCount * sizeof(VkExtensionProperties));
+}
+
+static void writeLayers(std::ostream& out, const LayerProperties& implementation, const std::vector<LayerProperties>& layers)
+{
+    writeLayer(out, implementation);
+    writeValue(out, (uint32_t)layers.size());
+    for (size_t i = 0; i < layers.size(); i++) {
+        writeLayer(out, layers[i]);
+    }
+}
+
+static bool readLayers(std::istream& in, LayerProperties& implementation, std::vector<LayerProperties>& layers)
+{
+    uint32_t layerCount = 0;
+    if (!readLayer(in, implementation) || !readValue(in, layerCount)) {
+        return false;
+    }
+
+    layers.resize(layerCount);
+    for (uint32_t i = 0; i < layerCount; i++) {
+        if (!readLayer(in, layers[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The entry for the extensions that are not provided by any layer.
+static LayerProperties implementationEntry()
+{
+    LayerProperties implementation = {};
+    return implementation;
+}
+
+CapabilityDatabase::CapabilityDatabase()
+{
+    dirty = false;
+    loaderVersion = 0;
+    cachedLoaderVersion = 0;
+    instanceMs = 0.0;
+    deviceMs = 0.0;
+    instanceFromCache = false;
+    devicesFromCache = 0;
+}
+
+CapabilityDatabase::~CapabilityDatabase()
+{
+}
+
+void CapabilityDatabase::loadDatabase(const std::string& inFilePath)
+{
+    PROFILE_SCOPE("CapabilityDatabase::loadDatabase");
+    filePath = inFilePath;
+    if (filePath.empty()) {
+        return;
+    }
+
+    std::ifstream file(filePath.c_str(), std::ios::binary);
+    if (!file) {
+        return;
+    }
+
+    uint32_t magic = 0, version = 0, deviceCount = 0;
+    LayerProperties implementation;
+    std::vector<LayerProperties> layers;
+    std::vector<DeviceCapabilities> fileDevices;
+    bool valid = readValue(file, magic) && magic == DATABASE_MAGIC
+        && readValue(file, version) && version == DATABASE_VERSION
+        && readValue(file, cachedLoaderVersion)
+        && readLayers(file, implementation, layers)
+        && readValue(file, deviceCount);
+    for (uint32_t i = 0; valid && i < deviceCount; i++) {
+        DeviceCapabilities device;
+        valid = readValue(file, device.vendorID) && readValue(file, device.deviceID)
+            && readValue(file, device.driverVersion) && readValue(file, device.pipelineCacheUUID)
+            && readLayers(file, device.implementation, device.layers);
+        fileDevices.push_back(device);
+    }
+
+    // A truncated or foreign file is ignored as a whole.
+    if (!valid) {
+        std::cout << "Capability database " << filePath << " is unreadable, enumerating" << std::endl;
+        cachedLoaderVersion = 0;
+        return;
+    }
+
+    cachedInstanceImplementation = implementation;
+    cachedInstanceLayers.swap(layers);
+    devices.swap(fileDevices);
+}
+
+bool CapabilityDatabase::saveDatabase()
+{
+    PROFILE_SCOPE("CapabilityDatabase::saveDatabase");
+    if (!dirty || filePath.empty()) {
+        return false;
+    }
+
+    std::string tempPath = filePath + ".tmp";
+    {
+        std::ofstream file(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+
+        writeValue(file, DATABASE_MAGIC);
+        writeValue(file, DATABASE_VERSION);
+        writeValue(file, loaderVersion);
+        writeLayers(file, instanceImplementation, instanceLayers);
+
+        // Only the devices present in this run, entries of replaced drivers are dropped.
+        writeValue(file, (uint32_t)deviceIndices.size());
+        for (size_t i = 0; i < deviceIndices.size(); i++) {
+            const DeviceCapabilities& device = devices[deviceIndices[i].second];
+            writeValue(file, device.vendorID);
+            writeValue(file, device.deviceID);
+            writeValue(file, device.driverVersion);
+            writeValue(file, device.pipelineCacheUUID);
+            writeLayers(file, device.implementation, device.layers);
+        }
+        if (!file) {
+            return false;
+        }
+    }
+
+    std::remove(filePath.c_str());
+    if (std::rename(tempPath.c_str(), filePath.c_str()) != 0) {
+        return false;
+    }
+    dirty = false;
+    return true;
+}
+
+// vkEnumerateInstanceVersion only exists on 1.1 loaders, older ones are 1.0.
+uint32_t CapabilityDatabase::queryLoaderVersion()
+{
+    PFN_vkEnumerateInstanceVersion enumerateInstanceVersion =
+        (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(NULL, "vkEnumerateInstanceVersion");
+
+    uint32_t version = VK_MAKE_VERSION(1, 0, 0);
+    if (enumerateInstanceVersion) {
+        enumerateInstanceVersion(&version);
+    }
+    return version;
+}
+
+// The cached extensions are valid if the layers are the very same layers, in the same order.
+bool CapabilityDatabase::sameLayers(const std::vector<LayerProperties>& a, const std::vector<VkLayerProperties>& b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (strcmp(a[i].properties.layerName, b[i].layerName)
+            || a[i].properties.specVersion != b[i].specVersion
+            || a[i].properties.implementationVersion != b[i].implementationVersion) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CapabilityDatabase::sameExtensions(const LayerProperties& a, const LayerProperties& b)
+{
+    if (a.extensions.size() != b.extensions.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.extensions.size(); i++) {
+        if (strcmp(a.extensions[i].extensionName, b.extensions[i].extensionName)
+            || a.extensions[i].specVersion != b.extensions[i].specVersion) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Fills the extensions of every entry in 'layers', an entry with an empty layer name
+ * receives the extensions of the implementation. For device extensions 'layers' holds
+ * gpus.size() consecutive lists of the same length, one per GPU; for instance extensions
+ * 'gpus' is empty. The enumeration commands are thread safe and every task writes its
+ * own LayerProperties.
+ */
+void CapabilityDatabase::enumerateExtensions(std::vector<LayerProperties>& layers, const std::vector<VkPhysicalDevice>& gpus)
+{
+    uint32_t taskCount = (uint32_t)layers.size();
+    if (taskCount == 0) {
+        return;
+    }
+    uint32_t layersPerGpu = gpus.empty() ? taskCount : taskCount / (uint32_t)gpus.size();
+
+    ThreadPool threadPool;
+    threadPool.createThreads(std::min(taskCount, std::max(1u, std::thread::hardware_concurrency())));
+    threadPool.parallelFor(taskCount, [&](uint32_t taskIndex, uint32_t) {
+        PROFILE_SCOPE("CapabilityDatabase::enumerateExtensions task");
+        VkPhysicalDevice gpu = gpus.empty() ? VK_NULL_HANDLE : gpus[taskIndex / layersPerGpu];
+        VulkanLayerAndExtension::getExtensionProperties(layers[taskIndex], gpus.empty() ? NULL : &gpu);
+    });
+    threadPool.destroyThreads();
+}
+
+VkResult CapabilityDatabase::enumerateInstance()
+{
+    PROFILE_SCOPE("CapabilityDatabase::enumerateInstance");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    loaderVersion = queryLoaderVersion();
+
+    // 1. The layer list itself is cheap (manifest files only) and is what the cache is validated against.
+    uint32_t instanceLayerCount = 0;
+    std::vector<VkLayerProperties> layerProperties;
+    VkResult result;
+    do {
+        result = vkEnumerateInstanceLayerProperties(&instanceLayerCount, NULL);
+        if (result)
+            return result;
+
+        // No layers installed is a valid (and cacheable) configuration.
+        if (instanceLayerCount == 0)
+            break;
+
+        layerProperties.resize(instanceLayerCount);
+        result = vkEnumerateInstanceLayerProperties(&instanceLayerCount, layerProperties.data());
+    } while (result == VK_INCOMPLETE);
+
+    // 2. Reuse the stored extensions when nothing changed, otherwise query every layer in parallel.
+    // The extensions of the implementation come from the installed drivers, which can change
+    // without touching the loader or the layers. They take one call that loads no layer library,
+    // so they are enumerated every time and only compared against the file.
+    instanceFromCache = cachedLoaderVersion == loaderVersion && sameLayers(cachedInstanceLayers, layerProperties);
+    if (instanceFromCache) {
+        instanceImplementation = implementationEntry();
+        result = VulkanLayerAndExtension::getExtensionProperties(instanceImplementation);
+        if (result) {
+            return result;
+        }
+        if (!sameExtensions(instanceImplementation, cachedInstanceImplementation)) {
+            dirty = true;
+        }
+        instanceLayers.swap(cachedInstanceLayers);
+    } else {
+        // The implementation first, then one entry per layer.
+        std::vector<LayerProperties> entries(layerProperties.size() + 1, implementationEntry());
+        for (size_t i = 0; i < layerProperties.size(); i++) {
+            entries[i + 1].properties = layerProperties[i];
+        }
+        enumerateExtensions(entries, std::vector<VkPhysicalDevice>());
+
+        instanceImplementation = entries[0];
+        instanceLayers.assign(entries.begin() + 1, entries.end());
+
+        // Device entries were produced against other layers, they can not be trusted either.
+        devices.clear();
+        dirty = true;
+    }
+    cachedInstanceLayers.clear();
+    cachedInstanceImplementation = implementationEntry();
+
+    instanceMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return VK_SUCCESS;
+}
+
+VkResult CapabilityDatabase::enumerateDevices(const std::vector<VkPhysicalDevice>& gpus)
+{
+    PROFILE_SCOPE("CapabilityDatabase::enumerateDevices");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    deviceIndices.clear();
+    devicesFromCache = 0;
+    size_t storedCount = devices.size(); // Entries past this one are enumerated by this call.
+
+    // 1. Match every device with a stored entry of the same GPU and driver build.
+    std::vector<VkPhysicalDevice> missingGpus;
+    std::vector<size_t> missingIndices;
+    for (size_t i = 0; i < gpus.size(); i++) {
+        VkPhysicalDeviceProperties gpuProps;
+        vkGetPhysicalDeviceProperties(gpus[i], &gpuProps);
+
+        size_t index = 0;
+        while (index < devices.size()
+            && !(devices[index].vendorID == gpuProps.vendorID
+                && devices[index].deviceID == gpuProps.deviceID
+                && devices[index].driverVersion == gpuProps.driverVersion
+                && !memcmp(devices[index].pipelineCacheUUID, gpuProps.pipelineCacheUUID, VK_UUID_SIZE))) {
+            index++;
+        }
+
+        if (index == devices.size()) {
+            DeviceCapabilities device;
+            device.vendorID = gpuProps.vendorID;
+            device.deviceID = gpuProps.deviceID;
+            device.driverVersion = gpuProps.driverVersion;
+            memcpy(device.pipelineCacheUUID, gpuProps.pipelineCacheUUID, VK_UUID_SIZE);
+            device.implementation = implementationEntry();
+            device.layers.resize(instanceLayers.size());
+            for (size_t j = 0; j < instanceLayers.size(); j++) {
+                device.layers[j].properties = instanceLayers[j].properties;
+            }
+            devices.push_back(device);
+            missingGpus.push_back(gpus[i]);
+            missingIndices.push_back(index);
+        } else if (index < storedCount) {
+            devicesFromCache++;
+        }
+        deviceIndices.push_back(std::make_pair(gpus[i], index));
+    }
+
+    // 2. Enumerate all (device, implementation or layer) pairs of the new devices as one parallel job.
+    if (!missingGpus.empty()) {
+        std::vector<LayerProperties> entries;
+        for (size_t i = 0; i < missingIndices.size(); i++) {
+            const DeviceCapabilities& device = devices[missingIndices[i]];
+            entries.push_back(device.implementation);
+            entries.insert(entries.end(), device.layers.begin(), device.layers.end());
+        }
+
+        enumerateExtensions(entries, missingGpus);
+
+        size_t entryCount = instanceLayers.size() + 1;
+        for (size_t i = 0; i < missingIndices.size(); i++) {
+            DeviceCapabilities& device = devices[missingIndices[i]];
+            device.implementation = entries[i * entryCount];
+            device.layers.assign(entries.begin() + i * entryCount + 1, entries.begin() + (i + 1) * entryCount);
+        }
+        dirty = true;
+    }
+
+    deviceMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return VK_SUCCESS;
+}
+
+const DeviceCapabilities* CapabilityDatabase::findDevice(VkPhysicalDevice gpu) const
+{
+    for (size_t i = 0; i < deviceIndices.size(); i++) {
+        if (deviceIndices[i].first == gpu) {
+            return &devices[deviceIndices[i].second];
+        }
+    }
+    return NULL;
+}
+
+void CapabilityDatabase::printSummary() const
+{
+    size_t extensionCount = instanceImplementation.extensions.size();
+    for (size_t i = 0; i < instanceLayers.size(); i++) {
+        extensionCount += instanceLayers[i].extensions.size();
+    }
+
+    std::cout << "Capabilities: loader " << VK_VERSION_MAJOR(loaderVersion) << "." << VK_VERSION_MINOR(loaderVersion) << "." << VK_VERSION_PATCH(loaderVersion)
+              << ", " << instanceLayers.size() << " layers with " << extensionCount << " extensions "
+              << (instanceFromCache ? "from cache" : "enumerated") << " in " << instanceMs << " ms, "
+              << deviceIndices.size() << " devices (" << devicesFromCache << " from cache) in " << deviceMs << " ms" << std::endl;
+}
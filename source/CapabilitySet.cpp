@@ -0,0 +1,230 @@
+#include "CapabilitySet.h"
+
+// Extension dependencies as listed in the registry ("requires"), for the extensions this
+// application may enable. Extensions promoted to core in a later version still need them
+// on a 1.0 instance.
+struct ExtensionDependency {
+    const char* extensionName;
+    const char* dependencyName;
+    CapabilityLevel dependencyLevel;
+};
+
+static const ExtensionDependency extensionDependencies[] = {
+    // Instance extensions
+    { "VK_KHR_win32_surface", "VK_KHR_surface", CAPABILITY_LEVEL_INSTANCE },
+    { "VK_KHR_xcb_surface", "VK_KHR_surface", CAPABILITY_LEVEL_INSTANCE },
+    { "VK_KHR_xlib_surface", "VK_KHR_surface", CAPABILITY_LEVEL_INSTANCE },
+    { "VK_KHR_wayland_surface", "VK_KHR_surface", CAPABILITY_LEVEL_INSTANCE },
+    { "VK_EXT_headless_surface", "VK_KHR_surface", CAPABILITY_LEVEL_INSTANCE },
+    { "VK_KHR_get_surface_capabilities2", "VK_KHR_surface", CAPABILITY_LEVEL_INSTANCE },
+
+    // Device extensions
+    { "VK_KHR_swapchain", "VK_KHR_surface", CAPABILITY_LEVEL_INSTANCE },
+    { "VK_KHR_maintenance3", "VK_KHR_get_physical_device_properties2", CAPABILITY_LEVEL_INSTANCE },
+    { "VK_EXT_descriptor_indexing", "VK_KHR_get_physical_device_properties2", CAPABILITY_LEVEL_INSTANCE },
+    { "VK_EXT_descriptor_indexing", "VK_KHR_maintenance3", CAPABILITY_LEVEL_DEVICE },
+    { "VK_KHR_timeline_semaphore", "VK_KHR_get_physical_device_properties2", CAPABILITY_LEVEL_INSTANCE },
+    { "VK_KHR_synchronization2", "VK_KHR_get_physical_device_properties2", CAPABILITY_LEVEL_INSTANCE },
+    { "VK_KHR_multiview", "VK_KHR_get_physical_device_properties2", CAPABILITY_LEVEL_INSTANCE },
+    { "VK_KHR_create_renderpass2", "VK_KHR_multiview", CAPABILITY_LEVEL_DEVICE },
+    { "VK_KHR_create_renderpass2", "VK_KHR_maintenance2", CAPABILITY_LEVEL_DEVICE },
+    { "VK_KHR_depth_stencil_resolve", "VK_KHR_create_renderpass2", CAPABILITY_LEVEL_DEVICE },
+    { "VK_KHR_dynamic_rendering", "VK_KHR_depth_stencil_resolve", CAPABILITY_LEVEL_DEVICE },
+    { "VK_KHR_dynamic_rendering", "VK_KHR_get_physical_device_properties2", CAPABILITY_LEVEL_INSTANCE },
+    { "VK_KHR_device_group", "VK_KHR_device_group_creation", CAPABILITY_LEVEL_INSTANCE },
+    { "VK_KHR_buffer_device_address", "VK_KHR_get_physical_device_properties2", CAPABILITY_LEVEL_INSTANCE },
+    { "VK_KHR_buffer_device_address", "VK_KHR_device_group", CAPABILITY_LEVEL_DEVICE },
+    { "VK_KHR_shader_float_controls", "VK_KHR_get_physical_device_properties2", CAPABILITY_LEVEL_INSTANCE },
+    { "VK_KHR_spirv_1_4", "VK_KHR_shader_float_controls", CAPABILITY_LEVEL_DEVICE },
+    { "VK_KHR_8bit_storage", "VK_KHR_storage_buffer_storage_class", CAPABILITY_LEVEL_DEVICE },
+    { "VK_KHR_16bit_storage", "VK_KHR_storage_buffer_storage_class", CAPABILITY_LEVEL_DEVICE },
+    { "VK_KHR_shader_draw_parameters", "VK_KHR_get_physical_device_properties2", CAPABILITY_LEVEL_INSTANCE },
+    { "VK_EXT_memory_budget", "VK_KHR_get_physical_device_properties2", CAPABILITY_LEVEL_INSTANCE },
+    { "VK_EXT_host_query_reset", "VK_KHR_get_physical_device_properties2", CAPABILITY_LEVEL_INSTANCE },
+};
+
+CapabilitySet::CapabilitySet()
+{
+    level = CAPABILITY_LEVEL_INSTANCE;
+}
+
+CapabilitySet::~CapabilitySet()
+{
+}
+
+void CapabilitySet::clear()
+{
+    layers.clear();
+    extensions.clear();
+    names.clear();
+}
+
+const char* CapabilitySet::intern(const char* name)
+{
+    names.push_back(name);
+    return names.back().c_str();
+}
+
+void CapabilitySet::build(CapabilityLevel inLevel, const LayerProperties& implementation, const std::vector<LayerProperties>& layerList)
+{
+    clear();
+    level = inLevel;
+
+    size_t extensionCount = implementation.extensions.size();
+    for (size_t i = 0; i < layerList.size(); i++) {
+        extensionCount += layerList[i].extensions.size();
+    }
+    extensions.reserve(extensionCount);
+    layers.reserve(layerList.size());
+
+    // The implementation's own extensions win over the same extension exposed by a layer,
+    // they need no layer to be enabled.
+    for (size_t i = 0; i < implementation.extensions.size(); i++) {
+        const VkExtensionProperties& extension = implementation.extensions[i];
+        if (!hasExtension(extension.extensionName)) {
+            ExtensionInfo info = { extension.specVersion, NULL };
+            extensions[intern(extension.extensionName)] = info;
+        }
+    }
+
+    for (size_t i = 0; i < layerList.size(); i++) {
+        const char* layerName = intern(layerList[i].properties.layerName);
+        layers[layerName] = layerName;
+        for (size_t j = 0; j < layerList[i].extensions.size(); j++) {
+            const VkExtensionProperties& extension = layerList[i].extensions[j];
+            if (!hasExtension(extension.extensionName)) {
+                ExtensionInfo info = { extension.specVersion, layerName };
+                extensions[intern(extension.extensionName)] = info;
+            }
+        }
+    }
+}
+
+void CapabilitySet::buildEnabled(CapabilityLevel inLevel, const std::vector<const char*>& layerNames, const std::vector<const char*>& extensionNames)
+{
+    clear();
+    level = inLevel;
+
+    for (size_t i = 0; i < layerNames.size(); i++) {
+        const char* layerName = intern(layerNames[i]);
+        layers[layerName] = layerName;
+    }
+    for (size_t i = 0; i < extensionNames.size(); i++) {
+        ExtensionInfo info = { 1, NULL };
+        extensions[intern(extensionNames[i])] = info;
+    }
+}
+
+bool CapabilitySet::hasLayer(const char* layerName) const
+{
+    return layers.find(layerName) != layers.end();
+}
+
+bool CapabilitySet::hasExtension(const char* extensionName) const
+{
+    return extensions.find(extensionName) != extensions.end();
+}
+
+const char* CapabilitySet::getProvidingLayer(const char* extensionName) const
+{
+    std::unordered_map<const char*, ExtensionInfo, CStringHash, CStringEqual>::const_iterator it = extensions.find(extensionName);
+    return it == extensions.end() ? NULL : it->second.layerName;
+}
+
+uint32_t CapabilitySet::getExtensionSpecVersion(const char* extensionName) const
+{
+    std::unordered_map<const char*, ExtensionInfo, CStringHash, CStringEqual>::const_iterator it = extensions.find(extensionName);
+    return it == extensions.end() ? 0 : it->second.specVersion;
+}
+
+std::vector<const char*> CapabilitySet::filterLayers(const std::vector<const char*>& requestedLayers) const
+{
+    std::vector<const char*> supportedLayers;
+    supportedLayers.reserve(requestedLayers.size());
+    for (size_t i = 0; i < requestedLayers.size(); i++) {
+        if (hasLayer(requestedLayers[i])) {
+            supportedLayers.push_back(requestedLayers[i]);
+        }
+    }
+    return supportedLayers;
+}
+
+/*
+ * Depth first: the dependencies are appended before the extension itself. 'visited'
+ * holds true for extensions that are enabled (or being enabled, which breaks cycles)
+ * and false for the ones found unsupported.
+ */
+bool CapabilitySet::enableExtension(const char* name, std::vector<const char*>& enableList,
+    std::unordered_map<const char*, bool, CStringHash, CStringEqual>& visited,
+    std::vector<const char*>* missing, const CapabilitySet* enabledInstanceExtensions) const
+{
+    std::unordered_map<const char*, bool, CStringHash, CStringEqual>::iterator seen = visited.find(name);
+    if (seen != visited.end()) {
+        return seen->second;
+    }
+
+    std::unordered_map<const char*, ExtensionInfo, CStringHash, CStringEqual>::const_iterator it = extensions.find(name);
+    if (it == extensions.end()) {
+        if (missing) {
+            missing->push_back(name);
+        }
+        return false;
+    }
+
+    const char* internedName = it->first;
+    visited[internedName] = true;
+
+    bool supported = true;
+    for (size_t i = 0; i < sizeof(extensionDependencies) / sizeof(extensionDependencies[0]); i++) {
+        const ExtensionDependency& dependency = extensionDependencies[i];
+        if (strcmp(dependency.extensionName, internedName)) {
+            continue;
+        }
+
+        if (dependency.dependencyLevel == level) {
+            supported = enableExtension(dependency.dependencyName, enableList, visited, missing, enabledInstanceExtensions) && supported;
+        } else if (enabledInstanceExtensions && !enabledInstanceExtensions->hasExtension(dependency.dependencyName)) {
+            // Instance dependency of a device extension, it has to be enabled already.
+            if (missing) {
+                missing->push_back(dependency.dependencyName);
+            }
+            supported = false;
+        }
+    }
+
+    if (!supported) {
+        visited[internedName] = false;
+        return false;
+    }
+
+    enableList.push_back(internedName);
+    return true;
+}
+
+bool CapabilitySet::resolveExtensions(const std::vector<const char*>& required,
+    const std::vector<const char*>& optional,
+    std::vector<const char*>& enableList,
+    std::vector<const char*>* missing,
+    const CapabilitySet* enabledInstanceExtensions) const
+{
+    std::unordered_map<const char*, bool, CStringHash, CStringEqual> visited;
+    enableList.clear();
+
+    bool allRequired = true;
+    for (size_t i = 0; i < required.size(); i++) {
+        allRequired = enableExtension(required[i], enableList, visited, missing, enabledInstanceExtensions) && allRequired;
+    }
+
+    // An optional extension that fails must not leave its dependencies enabled.
+    for (size_t i = 0; i < optional.size(); i++) {
+        size_t enabledCount = enableList.size();
+        std::unordered_map<const char*, bool, CStringHash, CStringEqual> trialVisited = visited;
+        if (enableExtension(optional[i], enableList, trialVisited, NULL, enabledInstanceExtensions)) {
+            visited.swap(trialVisited);
+        } else {
+            enableList.resize(enabledCount);
+        }
+    }
+
+    return allRequired;
+}
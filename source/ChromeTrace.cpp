@@ -0,0 +1,69 @@
+#include "ChromeTrace.h"
+#include <fstream>
+#include <cstdio>
+
+void ChromeTrace::appendEscaped(std::string& json, const char* text)
+{
+    for (const char* c = text; *c; c++) {
+        switch (*c) {
+        case '"':
+            json += "\\\"";
+            break;
+        case '\\':
+            json += "\\\\";
+            break;
+        case '\n':
+            json += "\\n";
+            break;
+        default:
+            if ((unsigned char)*c < 0x20) {
+                char code[8];
+                snprintf(code, sizeof(code), "\\u%04x", (unsigned)*c);
+                json += code;
+            } else {
+                json += *c;
+            }
+        }
+    }
+}
+
+void ChromeTrace::appendEvent(std::string& json, const TraceEvent& event)
+{
+    json += "{\"name\":\"";
+    appendEscaped(json, event.name.c_str());
+
+    char fields[160];
+    snprintf(fields, sizeof(fields), "\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%u,\"tid\":%u}",
+        event.category, event.startUs, event.durationUs, event.pid, event.tid);
+    json += fields;
+}
+
+void ChromeTrace::appendTrackName(std::string& json, uint32_t pid, uint32_t tid, const char* name)
+{
+    char fields[96];
+    if (tid == UINT32_MAX) {
+        snprintf(fields, sizeof(fields), "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"", pid);
+    } else {
+        snprintf(fields, sizeof(fields), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"", pid, tid);
+    }
+    json += fields;
+    appendEscaped(json, name);
+    json += "\"}}";
+}
+
+bool ChromeTrace::writeTrace(const std::string& filePath, const std::string& eventList)
+{
+    std::string tempPath = filePath + ".tmp";
+    {
+        std::ofstream file(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+        file << "{\"traceEvents\":[\n" << eventList << "\n],\"displayTimeUnit\":\"ms\"}\n";
+        if (!file) {
+            return false;
+        }
+    }
+    std::remove(filePath.c_str());
+    return std::rename(tempPath.c_str(), filePath.c_str()) == 0;
+}
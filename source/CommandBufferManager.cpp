@@ -1,6 +1,9 @@
 #include "CommandBufferManager.h"
+#include "DebugUtils.h"
+#include "VulkanDevice.h"
 
-void CommandBufferMgr::allocCommandBuffer(const VkDevice* device, const VkCommandPool cmdPool, VkCommandBuffer* cmdBuffer, const VkCommandBufferAllocateInfo* inCmdBufferAllocateInfo)
+void CommandBufferMgr::allocCommandBuffer(const VkDevice* device, const VkCommandPool cmdPool, VkCommandBuffer* cmdBuffer, const VkCommandBufferAllocateInfo* inCmdBufferAllocateInfo,
+    const DebugUtils* debugUtils, const char* name)
 {
     VkResult result;
 
@@ -8,6 +11,9 @@ void CommandBufferMgr::allocCommandBuffer(const VkDevice* device, const VkComman
     if (inCmdBufferAllocateInfo) {
         result = vkAllocateCommandBuffers(*device, inCmdBufferAllocateInfo, cmdBuffer);
         assert(!result);
+        for (uint32_t i = 0; debugUtils && name && i < inCmdBufferAllocateInfo->commandBufferCount; i++) {
+            debugUtils->setObjectName(*device, VK_OBJECT_TYPE_COMMAND_BUFFER, cmdBuffer[i], name);
+        }
         return;
     }
 
@@ -22,6 +28,9 @@ void CommandBufferMgr::allocCommandBuffer(const VkDevice* device, const VkComman
 
     result = vkAllocateCommandBuffers(*device, &cmdBufferAllocateInfo, cmdBuffer);
     assert(!result);
+    if (debugUtils && name) {
+        debugUtils->setObjectName(*device, VK_OBJECT_TYPE_COMMAND_BUFFER, *cmdBuffer, name);
+    }
 }
 
 void CommandBufferMgr::beginCommandBuffer(VkCommandBuffer cmdBuffer, VkCommandBufferBeginInfo* inCmdBufferBeginInfo) {
@@ -95,4 +104,620 @@ void CommandBufferMgr::submitCommandBuffer(const VkQueue& queue, const VkCommand
     assert(!result);
     result = vkQueueWaitIdle(queue);
     assert(!result);
-}
\ No newline at end of file
+}
+
+SubmitToken CommandBufferMgr::submitCommandBufferAsync(const VkQueue& queue, FencePool& fencePool, const VkCommandBuffer* cmdBufferList, uint32_t cmdBufferCount, const VkSubmitInfo* inSubmitInfo)
+{
+    // If submit information is available, use it as it is.
+    // This assumes that the commands are already specified in the structure,
+    // hence ignore command buffer.
+    if (inSubmitInfo) {
+        return submitCommandBufferBatch(queue, fencePool, inSubmitInfo, 1);
+    }
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = NULL;
+    submitInfo.waitSemaphoreCount = 0;
+    submitInfo.pWaitSemaphores = NULL;
+    submitInfo.pWaitDstStageMask = NULL;
+    submitInfo.commandBufferCount = cmdBufferCount;
+    submitInfo.pCommandBuffers = cmdBufferList;
+    submitInfo.signalSemaphoreCount = 0;
+    submitInfo.pSignalSemaphores = NULL;
+
+    return submitCommandBufferBatch(queue, fencePool, &submitInfo, 1);
+}
+
+SubmitToken CommandBufferMgr::submitCommandBufferBatch(const VkQueue& queue, FencePool& fencePool, const VkSubmitInfo* submitInfoList, uint32_t submitInfoCount)
+{
+    SubmitToken token;
+
+    // The fence signals once every batch in the list has completed,
+    // there is no wait on the queue here.
+    VkFence fence = fencePool.acquireFence(&token);
+
+    VkResult result = vkQueueSubmit(queue, submitInfoCount, submitInfoList, fence);
+    if (result != VK_SUCCESS) {
+        // The fence would never signal, waiting on the token must not block.
+        std::cout << "vkQueueSubmit failed (VkResult " << result << "), nothing was submitted." << std::endl;
+        fencePool.releaseFence(token);
+        return SubmitToken();
+    }
+
+    return token;
+}
+
+void CommandBufferMgr::transferBufferOwnership(VkCommandBuffer releaseCmdBuffer, VkCommandBuffer acquireCmdBuffer,
+    VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t srcQueueFamily, uint32_t dstQueueFamily,
+    VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+{
+    if (srcQueueFamily == dstQueueFamily) {
+        return;
+    }
+
+    VkBufferMemoryBarrier bufferBarrier = {};
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferBarrier.pNext = NULL;
+    bufferBarrier.srcQueueFamilyIndex = srcQueueFamily;
+    bufferBarrier.dstQueueFamilyIndex = dstQueueFamily;
+    bufferBarrier.buffer = buffer;
+    bufferBarrier.offset = offset;
+    bufferBarrier.size = size;
+
+    // Release: make the writes available, the destination access is ignored on this side.
+    bufferBarrier.srcAccessMask = srcAccessMask;
+    bufferBarrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(releaseCmdBuffer, srcStageMask, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 1, &bufferBarrier, 0, NULL);
+
+    // Acquire: make them visible to the destination, the source access is ignored on this side.
+    bufferBarrier.srcAccessMask = 0;
+    bufferBarrier.dstAccessMask = dstAccessMask;
+    vkCmdPipelineBarrier(acquireCmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStageMask, 0, 0, NULL, 1, &bufferBarrier, 0, NULL);
+}
+
+void CommandBufferMgr::transferImageOwnership(VkCommandBuffer releaseCmdBuffer, VkCommandBuffer acquireCmdBuffer,
+    VkImage image, const VkImageSubresourceRange& range, VkImageLayout oldLayout, VkImageLayout newLayout,
+    uint32_t srcQueueFamily, uint32_t dstQueueFamily,
+    VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+{
+    if (srcQueueFamily == dstQueueFamily) {
+        return;
+    }
+
+    // Both halves must describe the same layout transition.
+    VkImageMemoryBarrier imageBarrier = {};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.pNext = NULL;
+    imageBarrier.oldLayout = oldLayout;
+    imageBarrier.newLayout = newLayout;
+    imageBarrier.srcQueueFamilyIndex = srcQueueFamily;
+    imageBarrier.dstQueueFamilyIndex = dstQueueFamily;
+    imageBarrier.image = image;
+    imageBarrier.subresourceRange = range;
+
+    imageBarrier.srcAccessMask = srcAccessMask;
+    imageBarrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(releaseCmdBuffer, srcStageMask, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0, NULL, 1, &imageBarrier);
+
+    imageBarrier.srcAccessMask = 0;
+    imageBarrier.dstAccessMask = dstAccessMask;
+    vkCmdPipelineBarrier(acquireCmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStageMask, 0, 0, NULL, 0, NULL, 1, &imageBarrier);
+}
+
+// Accesses that only read, any other bit is handled as a write.
+static const VkAccessFlags READ_ACCESS_MASK = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT
+    | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_INPUT_ATTACHMENT_READ_BIT
+    | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
+    | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_HOST_READ_BIT | VK_ACCESS_MEMORY_READ_BIT;
+
+static bool sameDependency(const VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask,
+    VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask,
+    VkPipelineStageFlags otherSrcStageMask, VkAccessFlags otherSrcAccessMask,
+    VkPipelineStageFlags otherDstStageMask, VkAccessFlags otherDstAccessMask)
+{
+    return srcStageMask == otherSrcStageMask && srcAccessMask == otherSrcAccessMask
+        && dstStageMask == otherDstStageMask && dstAccessMask == otherDstAccessMask;
+}
+
+BarrierBuilder::BarrierBuilder()
+{
+    pipelineBarrier2Fn = NULL;
+    stats = {};
+}
+
+BarrierBuilder::~BarrierBuilder()
+{
+}
+
+void BarrierBuilder::requestFeatures(DeviceFeatures& features)
+{
+    features.synchronization2.synchronization2 = VK_TRUE;
+}
+
+void BarrierBuilder::createBarrierBuilder(const VulkanDevice* deviceObj)
+{
+    pipelineBarrier2Fn = NULL;
+    if (deviceObj->isExtensionEnabled(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME) && deviceObj->enabledFeatures.synchronization2.synchronization2) {
+        pipelineBarrier2Fn = (PFN_vkCmdPipelineBarrier2KHR)vkGetDeviceProcAddr(deviceObj->device, "vkCmdPipelineBarrier2KHR");
+    }
+}
+
+void BarrierBuilder::trackImage(VkImage image, VkImageAspectFlags aspectMask, uint32_t mipLevels, uint32_t arrayLayers, VkImageLayout layout)
+{
+    assert(images.find(image) == images.end());
+
+    SubresourceState state = {};
+    state.layout = layout;
+
+    TrackedImage& tracked = images[image];
+    tracked.aspectMask = aspectMask;
+    tracked.mipLevels = mipLevels;
+    tracked.arrayLayers = arrayLayers;
+    tracked.subresources.assign((size_t)mipLevels * arrayLayers, state);
+    tracked.pending = false;
+}
+
+void BarrierBuilder::untrackImage(VkImage image)
+{
+    auto it = images.find(image);
+    if (it == images.end()) {
+        return;
+    }
+    if (it->second.pending) {
+        pendingImages.erase(std::find(pendingImages.begin(), pendingImages.end(), image));
+    }
+    images.erase(it);
+}
+
+VkImageLayout BarrierBuilder::getLayout(VkImage image, uint32_t mipLevel, uint32_t arrayLayer) const
+{
+    auto it = images.find(image);
+    assert(it != images.end());
+    return it->second.subresources[mipLevel * it->second.arrayLayers + arrayLayer].layout;
+}
+
+void BarrierBuilder::useImage(VkImage image, const VkImageSubresourceRange& range, VkImageLayout layout,
+    VkPipelineStageFlags stageMask, VkAccessFlags accessMask)
+{
+    auto it = images.find(image);
+    assert(it != images.end());
+    TrackedImage& tracked = it->second;
+
+    uint32_t levelCount = range.levelCount == VK_REMAINING_MIP_LEVELS ? tracked.mipLevels - range.baseMipLevel : range.levelCount;
+    uint32_t layerCount = range.layerCount == VK_REMAINING_ARRAY_LAYERS ? tracked.arrayLayers - range.baseArrayLayer : range.layerCount;
+    assert(range.baseMipLevel + levelCount <= tracked.mipLevels && range.baseArrayLayer + layerCount <= tracked.arrayLayers);
+
+    for (uint32_t mip = range.baseMipLevel; mip < range.baseMipLevel + levelCount; mip++) {
+        for (uint32_t layer = range.baseArrayLayer; layer < range.baseArrayLayer + layerCount; layer++) {
+            SubresourceState& state = tracked.subresources[mip * tracked.arrayLayers + layer];
+
+            // A second use in the batch: the transition to the first layout is never needed.
+            bool firstUse = state.pendingStages == 0;
+            if (!firstUse && state.pendingLayout != layout) {
+                stats.mergedBarriers++;
+            }
+            state.pendingLayout = layout;
+            state.pendingAccess = (firstUse ? 0 : state.pendingAccess) | accessMask;
+            state.pendingStages |= stageMask;
+        }
+    }
+
+    if (!tracked.pending) {
+        tracked.pending = true;
+        pendingImages.push_back(image);
+    }
+    stats.imageUses++;
+}
+
+void BarrierBuilder::useImage(VkImage image, VkImageLayout layout, VkPipelineStageFlags stageMask, VkAccessFlags accessMask)
+{
+    auto it = images.find(image);
+    assert(it != images.end());
+
+    VkImageSubresourceRange range;
+    range.aspectMask = it->second.aspectMask;
+    range.baseMipLevel = 0;
+    range.levelCount = VK_REMAINING_MIP_LEVELS;
+    range.baseArrayLayer = 0;
+    range.layerCount = VK_REMAINING_ARRAY_LAYERS;
+    useImage(image, range, layout, stageMask, accessMask);
+}
+
+void BarrierBuilder::addMemoryBarrier(VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask,
+    VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+{
+    Dependency dependency;
+    dependency.srcStageMask = srcStageMask;
+    dependency.srcAccessMask = srcAccessMask;
+    dependency.dstStageMask = dstStageMask;
+    dependency.dstAccessMask = dstAccessMask;
+    addDependency(dependency);
+}
+
+void BarrierBuilder::addBufferBarrier(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size,
+    VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask,
+    uint32_t srcQueueFamily, uint32_t dstQueueFamily)
+{
+    // Only an ownership transfer needs the buffer itself.
+    if (srcQueueFamily == dstQueueFamily) {
+        addMemoryBarrier(srcStageMask, srcAccessMask, dstStageMask, dstAccessMask);
+        return;
+    }
+
+    BufferBarrier barrier;
+    barrier.dependency.srcStageMask = srcStageMask;
+    barrier.dependency.srcAccessMask = srcAccessMask;
+    barrier.dependency.dstStageMask = dstStageMask;
+    barrier.dependency.dstAccessMask = dstAccessMask;
+    barrier.buffer = buffer;
+    barrier.offset = offset;
+    barrier.size = size;
+    barrier.srcQueueFamily = srcQueueFamily;
+    barrier.dstQueueFamily = dstQueueFamily;
+    bufferBarriers.push_back(barrier);
+}
+
+void BarrierBuilder::addImageBarrier(VkImage image, const VkImageSubresourceRange& range, VkImageLayout oldLayout, VkImageLayout newLayout,
+    VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask,
+    uint32_t srcQueueFamily, uint32_t dstQueueFamily)
+{
+    assert(images.find(image) == images.end()); // Tracked images go through useImage().
+    if (oldLayout == newLayout && srcQueueFamily == dstQueueFamily) {
+        addMemoryBarrier(srcStageMask, srcAccessMask, dstStageMask, dstAccessMask);
+        return;
+    }
+
+    ImageBarrier barrier;
+    barrier.dependency.srcStageMask = srcStageMask;
+    barrier.dependency.srcAccessMask = srcAccessMask;
+    barrier.dependency.dstStageMask = dstStageMask;
+    barrier.dependency.dstAccessMask = dstAccessMask;
+    barrier.image = image;
+    barrier.range = range;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamily = srcQueueFamily;
+    barrier.dstQueueFamily = dstQueueFamily;
+    imageBarriers.push_back(barrier);
+}
+
+void BarrierBuilder::addDependency(const Dependency& dependency)
+{
+    for (size_t i = 0; i < memoryBarriers.size(); i++) {
+        Dependency& merged = memoryBarriers[i];
+        if (merged.srcStageMask == dependency.srcStageMask && merged.dstStageMask == dependency.dstStageMask) {
+            merged.srcAccessMask |= dependency.srcAccessMask;
+            merged.dstAccessMask |= dependency.dstAccessMask;
+            stats.mergedBarriers++;
+            return;
+        }
+    }
+    memoryBarriers.push_back(dependency);
+}
+
+bool BarrierBuilder::resolveUse(SubresourceState& state, Dependency& dependency, VkImageLayout& oldLayout)
+{
+    VkPipelineStageFlags stages = state.pendingStages;
+    VkAccessFlags access = state.pendingAccess;
+    VkAccessFlags writeAccess = access & ~READ_ACCESS_MASK;
+    bool layoutChange = state.pendingLayout != state.layout;
+    state.pendingStages = 0;
+    state.pendingAccess = 0;
+
+    oldLayout = state.layout;
+    dependency.dstStageMask = stages;
+    dependency.dstAccessMask = access;
+
+    if (layoutChange || writeAccess) {
+        // Transitions and writes come after every access since the last write, which must be available.
+        dependency.srcStageMask = state.writeStages | state.readStages;
+        dependency.srcAccessMask = state.writeAccess;
+        bool needed = layoutChange || dependency.srcStageMask != 0;
+
+        // A transition is a write too, made visible to the stages of the use.
+        state.layout = state.pendingLayout;
+        state.writeStages = stages;
+        state.writeAccess = writeAccess;
+        state.readStages = writeAccess ? 0 : stages;
+        state.visibleStages = writeAccess ? 0 : stages;
+        state.visibleAccess = writeAccess ? 0 : access;
+        return needed;
+    }
+
+    // Reads in the same layout only wait for a write they do not see yet.
+    dependency.srcStageMask = state.writeStages;
+    dependency.srcAccessMask = state.writeAccess;
+    bool needed = state.writeStages && ((stages & ~state.visibleStages) || (access & ~state.visibleAccess));
+    state.readStages |= stages;
+    if (needed) {
+        state.visibleStages |= stages;
+        state.visibleAccess |= access;
+    }
+    return needed;
+}
+
+void BarrierBuilder::resolveImage(VkImage image, TrackedImage& tracked)
+{
+    struct Resolved {
+        bool used;
+        bool needed;
+        Dependency dependency;
+        VkImageLayout oldLayout;
+        VkImageLayout newLayout;
+    };
+
+    size_t firstBarrier = imageBarriers.size();
+    std::vector<Resolved> layers(tracked.arrayLayers);
+    for (uint32_t mip = 0; mip < tracked.mipLevels; mip++) {
+        for (uint32_t layer = 0; layer < tracked.arrayLayers; layer++) {
+            SubresourceState& state = tracked.subresources[mip * tracked.arrayLayers + layer];
+            Resolved& resolved = layers[layer];
+            resolved = Resolved(); // Unused layers compare equal, whatever the previous level left.
+            resolved.used = state.pendingStages != 0;
+            resolved.newLayout = state.pendingLayout;
+            resolved.needed = resolved.used && resolveUse(state, resolved.dependency, resolved.oldLayout);
+        }
+
+        // Runs of layers with the same barrier share one.
+        uint32_t layer = 0;
+        while (layer < tracked.arrayLayers) {
+            const Resolved& first = layers[layer];
+            uint32_t count = 1;
+            while (layer + count < tracked.arrayLayers) {
+                const Resolved& next = layers[layer + count];
+                if (next.used != first.used || next.needed != first.needed || next.oldLayout != first.oldLayout
+                    || next.newLayout != first.newLayout
+                    || !sameDependency(next.dependency.srcStageMask, next.dependency.srcAccessMask, next.dependency.dstStageMask,
+                        next.dependency.dstAccessMask, first.dependency.srcStageMask, first.dependency.srcAccessMask,
+                        first.dependency.dstStageMask, first.dependency.dstAccessMask)) {
+                    break;
+                }
+                count++;
+            }
+
+            if (!first.used) {
+                // Not in this batch.
+            } else if (!first.needed) {
+                stats.skippedBarriers++;
+            } else if (first.oldLayout == first.newLayout) {
+                addDependency(first.dependency);
+            } else {
+                stats.mergedBarriers += count - 1;
+
+                // Extends the same layers of the previous mip level when their barrier matches.
+                bool extended = false;
+                for (size_t i = firstBarrier; i < imageBarriers.size() && !extended; i++) {
+                    ImageBarrier& barrier = imageBarriers[i];
+                    const Dependency& dependency = barrier.dependency;
+                    if (barrier.range.baseArrayLayer == layer && barrier.range.layerCount == count
+                        && barrier.range.baseMipLevel + barrier.range.levelCount == mip
+                        && barrier.oldLayout == first.oldLayout && barrier.newLayout == first.newLayout
+                        && sameDependency(dependency.srcStageMask, dependency.srcAccessMask, dependency.dstStageMask,
+                            dependency.dstAccessMask, first.dependency.srcStageMask, first.dependency.srcAccessMask,
+                            first.dependency.dstStageMask, first.dependency.dstAccessMask)) {
+                        barrier.range.levelCount++;
+                        stats.mergedBarriers++;
+                        extended = true;
+                    }
+                }
+
+                if (!extended) {
+                    ImageBarrier barrier;
+                    barrier.dependency = first.dependency;
+                    barrier.image = image;
+                    barrier.range.aspectMask = tracked.aspectMask;
+                    barrier.range.baseMipLevel = mip;
+                    barrier.range.levelCount = 1;
+                    barrier.range.baseArrayLayer = layer;
+                    barrier.range.layerCount = count;
+                    barrier.oldLayout = first.oldLayout;
+                    barrier.newLayout = first.newLayout;
+                    barrier.srcQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.dstQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+                    imageBarriers.push_back(barrier);
+                }
+            }
+            layer += count;
+        }
+    }
+}
+
+void BarrierBuilder::flush(VkCommandBuffer cmdBuffer)
+{
+    for (size_t i = 0; i < pendingImages.size(); i++) {
+        TrackedImage& tracked = images[pendingImages[i]];
+        resolveImage(pendingImages[i], tracked);
+        tracked.pending = false;
+    }
+    pendingImages.clear();
+
+    if (memoryBarriers.empty() && bufferBarriers.empty() && imageBarriers.empty()) {
+        return;
+    }
+
+    if (pipelineBarrier2Fn) {
+        recordBarrier2(cmdBuffer);
+    } else {
+        recordBarrier(cmdBuffer);
+    }
+
+    stats.flushes++;
+    stats.bufferBarriers += bufferBarriers.size();
+    stats.imageBarriers += imageBarriers.size();
+    memoryBarriers.clear();
+    bufferBarriers.clear();
+    imageBarriers.clear();
+}
+
+void BarrierBuilder::recordBarrier(VkCommandBuffer cmdBuffer)
+{
+    // One stage mask pair for everything, the access masks stay per barrier.
+    VkPipelineStageFlags srcStageMask = 0;
+    VkPipelineStageFlags dstStageMask = 0;
+
+    VkMemoryBarrier memoryBarrier = {};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.pNext = NULL;
+    for (size_t i = 0; i < memoryBarriers.size(); i++) {
+        srcStageMask |= memoryBarriers[i].srcStageMask;
+        dstStageMask |= memoryBarriers[i].dstStageMask;
+        memoryBarrier.srcAccessMask |= memoryBarriers[i].srcAccessMask;
+        memoryBarrier.dstAccessMask |= memoryBarriers[i].dstAccessMask;
+    }
+    bool memory = memoryBarrier.srcAccessMask || memoryBarrier.dstAccessMask;
+
+    std::vector<VkBufferMemoryBarrier> buffers(bufferBarriers.size());
+    for (size_t i = 0; i < bufferBarriers.size(); i++) {
+        const BufferBarrier& barrier = bufferBarriers[i];
+        srcStageMask |= barrier.dependency.srcStageMask;
+        dstStageMask |= barrier.dependency.dstStageMask;
+
+        VkBufferMemoryBarrier& bufferBarrier = buffers[i];
+        bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        bufferBarrier.pNext = NULL;
+        bufferBarrier.srcAccessMask = barrier.dependency.srcAccessMask;
+        bufferBarrier.dstAccessMask = barrier.dependency.dstAccessMask;
+        bufferBarrier.srcQueueFamilyIndex = barrier.srcQueueFamily;
+        bufferBarrier.dstQueueFamilyIndex = barrier.dstQueueFamily;
+        bufferBarrier.buffer = barrier.buffer;
+        bufferBarrier.offset = barrier.offset;
+        bufferBarrier.size = barrier.size;
+    }
+
+    std::vector<VkImageMemoryBarrier> images(imageBarriers.size());
+    for (size_t i = 0; i < imageBarriers.size(); i++) {
+        const ImageBarrier& barrier = imageBarriers[i];
+        srcStageMask |= barrier.dependency.srcStageMask;
+        dstStageMask |= barrier.dependency.dstStageMask;
+
+        VkImageMemoryBarrier& imageBarrier = images[i];
+        imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarrier.pNext = NULL;
+        imageBarrier.srcAccessMask = barrier.dependency.srcAccessMask;
+        imageBarrier.dstAccessMask = barrier.dependency.dstAccessMask;
+        imageBarrier.oldLayout = barrier.oldLayout;
+        imageBarrier.newLayout = barrier.newLayout;
+        imageBarrier.srcQueueFamilyIndex = barrier.srcQueueFamily;
+        imageBarrier.dstQueueFamilyIndex = barrier.dstQueueFamily;
+        imageBarrier.image = barrier.image;
+        imageBarrier.subresourceRange = barrier.range;
+    }
+
+    // The first use of an image waits for nothing, an empty mask is not allowed here.
+    if (!srcStageMask) {
+        srcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    }
+    if (!dstStageMask) {
+        dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    }
+
+    vkCmdPipelineBarrier(cmdBuffer, srcStageMask, dstStageMask, 0,
+        memory ? 1 : 0, memory ? &memoryBarrier : NULL,
+        (uint32_t)buffers.size(), buffers.size() ? buffers.data() : NULL,
+        (uint32_t)images.size(), images.size() ? images.data() : NULL);
+    stats.memoryBarriers += memory ? 1 : 0;
+}
+
+void BarrierBuilder::recordBarrier2(VkCommandBuffer cmdBuffer)
+{
+    // Every barrier keeps its stage masks, the legacy flags have the same values in the 64-bit masks.
+    std::vector<VkMemoryBarrier2KHR> memories(memoryBarriers.size());
+    for (size_t i = 0; i < memoryBarriers.size(); i++) {
+        VkMemoryBarrier2KHR& memoryBarrier = memories[i];
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR;
+        memoryBarrier.pNext = NULL;
+        memoryBarrier.srcStageMask = memoryBarriers[i].srcStageMask;
+        memoryBarrier.srcAccessMask = memoryBarriers[i].srcAccessMask;
+        memoryBarrier.dstStageMask = memoryBarriers[i].dstStageMask;
+        memoryBarrier.dstAccessMask = memoryBarriers[i].dstAccessMask;
+    }
+
+    std::vector<VkBufferMemoryBarrier2KHR> buffers(bufferBarriers.size());
+    for (size_t i = 0; i < bufferBarriers.size(); i++) {
+        const BufferBarrier& barrier = bufferBarriers[i];
+        VkBufferMemoryBarrier2KHR& bufferBarrier = buffers[i];
+        bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR;
+        bufferBarrier.pNext = NULL;
+        bufferBarrier.srcStageMask = barrier.dependency.srcStageMask;
+        bufferBarrier.srcAccessMask = barrier.dependency.srcAccessMask;
+        bufferBarrier.dstStageMask = barrier.dependency.dstStageMask;
+        bufferBarrier.dstAccessMask = barrier.dependency.dstAccessMask;
+        bufferBarrier.srcQueueFamilyIndex = barrier.srcQueueFamily;
+        bufferBarrier.dstQueueFamilyIndex = barrier.dstQueueFamily;
+        bufferBarrier.buffer = barrier.buffer;
+        bufferBarrier.offset = barrier.offset;
+        bufferBarrier.size = barrier.size;
+    }
+
+    std::vector<VkImageMemoryBarrier2KHR> images(imageBarriers.size());
+    for (size_t i = 0; i < imageBarriers.size(); i++) {
+        const ImageBarrier& barrier = imageBarriers[i];
+        VkImageMemoryBarrier2KHR& imageBarrier = images[i];
+        imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+        imageBarrier.pNext = NULL;
+        imageBarrier.srcStageMask = barrier.dependency.srcStageMask;
+        imageBarrier.srcAccessMask = barrier.dependency.srcAccessMask;
+        imageBarrier.dstStageMask = barrier.dependency.dstStageMask;
+        imageBarrier.dstAccessMask = barrier.dependency.dstAccessMask;
+        imageBarrier.oldLayout = barrier.oldLayout;
+        imageBarrier.newLayout = barrier.newLayout;
+        imageBarrier.srcQueueFamilyIndex = barrier.srcQueueFamily;
+        imageBarrier.dstQueueFamilyIndex = barrier.dstQueueFamily;
+        imageBarrier.image = barrier.image;
+        imageBarrier.subresourceRange = barrier.range;
+    }
+
+    VkDependencyInfoKHR dependencyInfo = {};
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+    dependencyInfo.pNext = NULL;
+    dependencyInfo.dependencyFlags = 0;
+    dependencyInfo.memoryBarrierCount = (uint32_t)memories.size();
+    dependencyInfo.pMemoryBarriers = memories.size() ? memories.data() : NULL;
+    dependencyInfo.bufferMemoryBarrierCount = (uint32_t)buffers.size();
+    dependencyInfo.pBufferMemoryBarriers = buffers.size() ? buffers.data() : NULL;
+    dependencyInfo.imageMemoryBarrierCount = (uint32_t)images.size();
+    dependencyInfo.pImageMemoryBarriers = images.size() ? images.data() : NULL;
+    pipelineBarrier2Fn(cmdBuffer, &dependencyInfo);
+    stats.memoryBarriers += memories.size();
+}
+
+void BarrierBuilder::printStats() const
+{
+    std::cout << "Barriers: " << stats.flushes << " pipeline barriers (" << (usesSynchronization2() ? "synchronization2" : "legacy")
+              << "), " << stats.imageBarriers << " image, " << stats.bufferBarriers << " buffer and " << stats.memoryBarriers
+              << " memory barriers for " << stats.imageUses << " image uses, " << stats.skippedBarriers << " skipped, "
+              << stats.mergedBarriers << " merged" << std::endl;
+}
+
+CommandBufferLabel::CommandBufferLabel(const DebugUtils* inDebugUtils, VkCommandBuffer inCmdBuffer, const char* name, const float color[4])
+{
+    debugUtils = (inDebugUtils && inDebugUtils->isEnabled()) ? inDebugUtils : NULL;
+    cmdBuffer = inCmdBuffer;
+    if (debugUtils) {
+        debugUtils->beginLabel(cmdBuffer, name, color);
+    }
+}
+
+CommandBufferLabel::~CommandBufferLabel()
+{
+    if (debugUtils) {
+        debugUtils->endLabel(cmdBuffer);
+    }
+}
+
+QueueLabel::QueueLabel(const DebugUtils* inDebugUtils, VkQueue inQueue, const char* name, const float color[4])
+{
+    debugUtils = (inDebugUtils && inDebugUtils->isEnabled()) ? inDebugUtils : NULL;
+    queue = inQueue;
+    if (debugUtils) {
+        debugUtils->beginLabel(queue, name, color);
+    }
+}
+
+QueueLabel::~QueueLabel()
+{
+    if (debugUtils) {
+        debugUtils->endLabel(queue);
+    }
+}
@@ -0,0 +1,155 @@
+#include "CommandPoolManager.h"
+#include "CommandBufferManager.h"
+#include "VulkanDevice.h"
+
+// Command buffers are allocated from a pool in chunks of this size.
+static const uint32_t CMD_BUFFER_ALLOCATION_CHUNK = 8;
+
+// Number of secondary command buffers recorded per worker thread by recordParallel(),
+// more than one per thread balances batches of uneven cost.
+static const uint32_t SECONDARIES_PER_WORKER = 4;
+
+CommandPoolManager::CommandPoolManager()
+{
+    deviceObj = NULL;
+    workerCount = 0;
+}
+
+CommandPoolManager::~CommandPoolManager()
+{
+}
+
+void CommandPoolManager::createCommandPools(VulkanDevice* inDeviceObj, uint32_t queueFamilyIndex, uint32_t frameSlotCount, uint32_t inWorkerCount)
+{
+    deviceObj = inDeviceObj;
+
+    threadPool.createThreads(inWorkerCount);
+    workerCount = threadPool.getThreadCount();
+
+    threadPools.resize(frameSlotCount * workerCount);
+    for (size_t i = 0; i < threadPools.size(); i++) {
+        ThreadCommandPool& pool = threadPools[i];
+        VkCommandPoolCreateInfo cmdPoolInfo = {};
+        cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        cmdPoolInfo.pNext = NULL;
+        cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
+
+        VkResult result = vkCreateCommandPool(deviceObj->device, &cmdPoolInfo, NULL, &pool.cmdPool);
+        assert(result == VK_SUCCESS);
+
+        char name[64];
+        snprintf(name, sizeof(name), "Worker %u frame slot %u command pool", (uint32_t)(i % workerCount), (uint32_t)(i / workerCount));
+        deviceObj->setObjectName(VK_OBJECT_TYPE_COMMAND_POOL, pool.cmdPool, name);
+
+        pool.usedCount[VK_COMMAND_BUFFER_LEVEL_PRIMARY] = 0;
+        pool.usedCount[VK_COMMAND_BUFFER_LEVEL_SECONDARY] = 0;
+    }
+}
+
+void CommandPoolManager::destroyCommandPools()
+{
+    threadPool.destroyThreads();
+
+    // Destroying a pool frees all of its command buffers.
+    for (auto& pool : threadPools) {
+        vkDestroyCommandPool(deviceObj->device, pool.cmdPool, NULL);
+    }
+    threadPools.clear();
+}
+
+CommandPoolManager::ThreadCommandPool& CommandPoolManager::getPool(uint32_t frameSlot, uint32_t workerIndex)
+{
+    assert(workerIndex < workerCount);
+    return threadPools[frameSlot * workerCount + workerIndex];
+}
+
+void CommandPoolManager::resetFramePools(uint32_t frameSlot)
+{
+    for (uint32_t i = 0; i < workerCount; i++) {
+        ThreadCommandPool& pool = getPool(frameSlot, i);
+
+        // One reset returns every command buffer of the pool to the initial state,
+        // the buffers stay allocated and are handed out again.
+        VkResult result = vkResetCommandPool(deviceObj->device, pool.cmdPool, 0);
+        assert(result == VK_SUCCESS);
+
+        pool.usedCount[VK_COMMAND_BUFFER_LEVEL_PRIMARY] = 0;
+        pool.usedCount[VK_COMMAND_BUFFER_LEVEL_SECONDARY] = 0;
+    }
+}
+
+VkCommandBuffer CommandPoolManager::acquireCommandBuffer(uint32_t frameSlot, uint32_t workerIndex, VkCommandBufferLevel level)
+{
+    ThreadCommandPool& pool = getPool(frameSlot, workerIndex);
+    std::vector<VkCommandBuffer>& cmdBuffers = pool.cmdBuffers[level];
+    uint32_t& usedCount = pool.usedCount[level];
+
+    if (usedCount == cmdBuffers.size()) {
+        VkCommandBufferAllocateInfo cmdBufferAllocateInfo = {};
+        cmdBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cmdBufferAllocateInfo.pNext = NULL;
+        cmdBufferAllocateInfo.commandPool = pool.cmdPool;
+        cmdBufferAllocateInfo.level = level;
+        cmdBufferAllocateInfo.commandBufferCount = CMD_BUFFER_ALLOCATION_CHUNK;
+
+        char name[64];
+        snprintf(name, sizeof(name), "Worker %u frame slot %u command buffer", workerIndex, frameSlot);
+        cmdBuffers.resize(usedCount + CMD_BUFFER_ALLOCATION_CHUNK);
+        CommandBufferMgr::allocCommandBuffer(&deviceObj->device, pool.cmdPool, &cmdBuffers[usedCount], &cmdBufferAllocateInfo,
+            deviceObj->debugUtils, name);
+    }
+
+    return cmdBuffers[usedCount++];
+}
+
+void CommandPoolManager::recordParallel(uint32_t frameSlot, VkCommandBuffer primary, uint32_t batchCount,
+    const VkCommandBufferInheritanceInfo* inheritanceInfo,
+    const std::function<void(VkCommandBuffer, uint32_t, uint32_t)>& recordBatches)
+{
+    if (batchCount == 0) {
+        return;
+    }
+
+    uint32_t secondaryCount = std::min(batchCount, workerCount * SECONDARIES_PER_WORKER);
+    uint32_t batchesPerSecondary = (batchCount + secondaryCount - 1) / secondaryCount;
+    secondaryCount = (batchCount + batchesPerSecondary - 1) / batchesPerSecondary;
+
+    std::vector<VkCommandBuffer> secondaries(secondaryCount);
+
+    VkCommandBufferInheritanceInfo defaultInheritanceInfo = {};
+    defaultInheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    defaultInheritanceInfo.pNext = NULL;
+    defaultInheritanceInfo.renderPass = VK_NULL_HANDLE;
+    defaultInheritanceInfo.subpass = 0;
+    defaultInheritanceInfo.framebuffer = VK_NULL_HANDLE;
+    defaultInheritanceInfo.occlusionQueryEnable = VK_FALSE;
+    defaultInheritanceInfo.queryFlags = 0;
+    defaultInheritanceInfo.pipelineStatistics = 0;
+
+    VkCommandBufferBeginInfo cmdBufferBeginInfo = {};
+    cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmdBufferBeginInfo.pNext = NULL;
+    cmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    cmdBufferBeginInfo.pInheritanceInfo = inheritanceInfo ? inheritanceInfo : &defaultInheritanceInfo;
+    if (inheritanceInfo && inheritanceInfo->renderPass != VK_NULL_HANDLE) {
+        cmdBufferBeginInfo.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    }
+
+    // Each worker only ever touches its own pool, so no locking is needed while recording.
+    threadPool.parallelFor(secondaryCount, [&](uint32_t secondaryIndex, uint32_t workerIndex) {
+        VkCommandBuffer secondary = acquireCommandBuffer(frameSlot, workerIndex, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+        uint32_t firstBatch = secondaryIndex * batchesPerSecondary;
+        uint32_t count = std::min(batchesPerSecondary, batchCount - firstBatch);
+
+        CommandBufferMgr::beginCommandBuffer(secondary, &cmdBufferBeginInfo);
+        recordBatches(secondary, firstBatch, count);
+        CommandBufferMgr::endCommandBuffer(secondary);
+
+        secondaries[secondaryIndex] = secondary;
+    });
+
+    // Stitch the secondaries into the primary in batch order.
+    vkCmdExecuteCommands(primary, secondaryCount, secondaries.data());
+}
@@ -0,0 +1,431 @@
+#include "ComputeEngine.h"
+#include "VulkanDevice.h"
+#include "CommandBufferManager.h"
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static const uint32_t SPIRV_MAGIC = 0x07230203;
+
+bool SpecializationConstants::has(uint32_t constantId) const
+{
+    for (auto& entry : entries) {
+        if (entry.constantID == constantId) {
+            return true;
+        }
+    }
+    return false;
+}
+
+VkSpecializationInfo SpecializationConstants::getInfo() const
+{
+    VkSpecializationInfo info = {};
+    info.mapEntryCount = (uint32_t)entries.size();
+    info.pMapEntries = entries.empty() ? NULL : entries.data();
+    info.dataSize = data.size();
+    info.pData = data.empty() ? NULL : data.data();
+    return info;
+}
+
+ComputeEngine::ComputeEngine()
+{
+    deviceObj = NULL;
+    queue = VK_NULL_HANDLE;
+    cmdPool = VK_NULL_HANDLE;
+    nextSlot = 0;
+    recordingSlot = BATCH_SLOT_COUNT;
+    boundPipeline = VK_NULL_HANDLE;
+    stats = {};
+}
+
+ComputeEngine::~ComputeEngine()
+{
+}
+
+void ComputeEngine::createComputeEngine(VulkanDevice* inDeviceObj, VkQueue inQueue, uint32_t queueFamilyIndex)
+{
+    VkResult result;
+
+    deviceObj = inDeviceObj;
+    queue = inQueue;
+
+    fencePool.createFencePool(deviceObj->device, 4, deviceObj->debugUtils, "Compute fence");
+
+    // Kernels bind storage buffers only.
+    std::vector<DescriptorPoolRatio> ratios(1);
+    ratios[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    ratios[0].descriptorsPerSet = 4.0f;
+    descriptors.createDescriptorAllocator(deviceObj, BATCH_SLOT_COUNT, 1, ratios);
+
+    VkCommandPoolCreateInfo cmdPoolInfo = {};
+    cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmdPoolInfo.pNext = NULL;
+    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
+
+    result = vkCreateCommandPool(deviceObj->device, &cmdPoolInfo, NULL, &cmdPool);
+    assert(result == VK_SUCCESS);
+    deviceObj->setObjectName(VK_OBJECT_TYPE_COMMAND_POOL, cmdPool, "Compute command pool");
+
+    VkCommandBufferAllocateInfo cmdBufferAllocateInfo = {};
+    cmdBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdBufferAllocateInfo.pNext = NULL;
+    cmdBufferAllocateInfo.commandPool = cmdPool;
+    cmdBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmdBufferAllocateInfo.commandBufferCount = 1;
+
+    for (uint32_t i = 0; i < BATCH_SLOT_COUNT; i++) {
+        CommandBufferMgr::allocCommandBuffer(&deviceObj->device, cmdPool, &batchSlots[i].cmdBuffer, &cmdBufferAllocateInfo,
+            deviceObj->debugUtils, "Compute command buffer");
+        batchSlots[i].token = SubmitToken();
+    }
+    nextSlot = 0;
+    recordingSlot = BATCH_SLOT_COUNT;
+}
+
+void ComputeEngine::destroyComputeEngine()
+{
+    submit();
+
+    // Waits for the batches in flight before anything is released.
+    fencePool.destroyFencePool();
+
+    vkDestroyCommandPool(deviceObj->device, cmdPool, NULL);
+    cmdPool = VK_NULL_HANDLE;
+
+    for (auto* kernel : kernels) {
+        delete kernel;
+    }
+    kernels.clear();
+
+    // The handles may come back for other objects, the kernels' pipelines must not be found by them.
+    for (auto& layout : pipelineLayouts) {
+        deviceObj->pipelineManager.evictObject(layout.second);
+        vkDestroyPipelineLayout(deviceObj->device, layout.second, NULL);
+    }
+    pipelineLayouts.clear();
+
+    for (auto& module : shaderModules) {
+        if (module.second != VK_NULL_HANDLE) {
+            deviceObj->pipelineManager.evictObject(module.second);
+            vkDestroyShaderModule(deviceObj->device, module.second, NULL);
+        }
+    }
+    shaderModules.clear();
+
+    descriptors.destroyDescriptorAllocator();
+}
+
+VkShaderModule ComputeEngine::loadShaderModule(const std::string& spirvPath)
+{
+    auto found = shaderModules.find(spirvPath);
+    if (found != shaderModules.end()) {
+        return found->second;
+    }
+
+    // The code is read by the driver straight from the page cache, without a copy on our side.
+    const uint32_t* code = NULL;
+    size_t size = 0;
+#ifndef _WIN32
+    void* mapping = MAP_FAILED;
+    int fd = open(spirvPath.c_str(), O_RDONLY);
+    struct stat fileStat;
+    if (fd >= 0 && fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+        size = (size_t)fileStat.st_size;
+        mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    if (fd >= 0) {
+        close(fd); // The mapping stays valid.
+    }
+    if (mapping != MAP_FAILED) {
+        code = (const uint32_t*)mapping;
+    }
+#else
+    std::vector<uint32_t> fileData;
+    std::ifstream file(spirvPath.c_str(), std::ios::binary | std::ios::ate);
+    if (file.is_open()) {
+        size = (size_t)file.tellg();
+        fileData.resize((size + 3) / 4);
+        file.seekg(0);
+        if (file.read((char*)fileData.data(), size)) {
+            code = fileData.data();
+        }
+    }
+#endif
+
+    VkShaderModule module = VK_NULL_HANDLE;
+    if (!code) {
+        std::cout << "Cannot read SPIR-V file " << spirvPath << std::endl;
+    } else if (size < 5 * sizeof(uint32_t) || size % sizeof(uint32_t) != 0 || code[0] != SPIRV_MAGIC) {
+        std::cout << spirvPath << " is not a SPIR-V module" << std::endl;
+    } else {
+        VkShaderModuleCreateInfo moduleInfo = {};
+        moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleInfo.pNext = NULL;
+        moduleInfo.flags = 0;
+        moduleInfo.codeSize = size;
+        moduleInfo.pCode = code;
+
+        VkResult result = vkCreateShaderModule(deviceObj->device, &moduleInfo, NULL, &module);
+        assert(result == VK_SUCCESS);
+        deviceObj->setObjectName(VK_OBJECT_TYPE_SHADER_MODULE, module, spirvPath.c_str());
+
+        stats.shaderModules++;
+        stats.spirvBytes += size;
+    }
+
+#ifndef _WIN32
+    if (code) {
+        munmap((void*)code, size);
+    }
+#endif
+
+    // Failures are remembered too, so a missing file is reported once.
+    shaderModules[spirvPath] = module;
+    return module;
+}
+
+void ComputeEngine::chooseWorkgroupSize(uint32_t dimensions, uint32_t workgroupSize[3]) const
+{
+    const VkPhysicalDeviceLimits& limits = deviceObj->gpuProps.limits;
+
+    // 256 invocations keep every vendor's SIMD width busy, shrunk to what the device allows.
+    workgroupSize[0] = dimensions == 1 ? 256 : (dimensions == 2 ? 16 : 8);
+    workgroupSize[1] = dimensions == 1 ? 1 : (dimensions == 2 ? 16 : 8);
+    workgroupSize[2] = dimensions <= 2 ? 1 : 4;
+    for (uint32_t i = 0; i < 3; i++) {
+        workgroupSize[i] = std::max(1u, std::min(workgroupSize[i], limits.maxComputeWorkGroupSize[i]));
+    }
+    while (workgroupSize[0] * workgroupSize[1] * workgroupSize[2] > limits.maxComputeWorkGroupInvocations) {
+        uint32_t largest = 0;
+        for (uint32_t i = 1; i < 3; i++) {
+            if (workgroupSize[i] > workgroupSize[largest]) {
+                largest = i;
+            }
+        }
+        workgroupSize[largest] /= 2;
+    }
+}
+
+VkPipelineLayout ComputeEngine::getPipelineLayout(VkDescriptorSetLayout setLayout, uint32_t pushConstantSize)
+{
+    std::pair<VkDescriptorSetLayout, uint32_t> key(setLayout, pushConstantSize);
+    auto found = pipelineLayouts.find(key);
+    if (found != pipelineLayouts.end()) {
+        return found->second;
+    }
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = pushConstantSize;
+
+    VkPipelineLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = NULL;
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &setLayout;
+    layoutInfo.pushConstantRangeCount = pushConstantSize ? 1 : 0;
+    layoutInfo.pPushConstantRanges = pushConstantSize ? &pushConstantRange : NULL;
+
+    VkPipelineLayout layout;
+    VkResult result = vkCreatePipelineLayout(deviceObj->device, &layoutInfo, NULL, &layout);
+    assert(result == VK_SUCCESS);
+
+    pipelineLayouts[key] = layout;
+    return layout;
+}
+
+const ComputeKernel* ComputeEngine::createKernel(const ComputeKernelDesc& desc)
+{
+    assert(desc.pushConstantSize % 4 == 0 && desc.pushConstantSize <= deviceObj->gpuProps.limits.maxPushConstantsSize);
+
+    VkShaderModule module = loadShaderModule(desc.spirvPath);
+    if (module == VK_NULL_HANDLE) {
+        return NULL;
+    }
+
+    ComputeKernel* kernel = new ComputeKernel();
+    kernel->name = desc.spirvPath + ":" + desc.entryPoint;
+    kernel->storageBufferCount = desc.storageBufferCount;
+    kernel->pushConstantSize = desc.pushConstantSize;
+    chooseWorkgroupSize(desc.dimensions, kernel->workgroupSize);
+
+    // Storage buffers at bindings 0 to count - 1, written from an array of VkDescriptorBufferInfo.
+    std::vector<VkDescriptorSetLayoutBinding> bindings(desc.storageBufferCount);
+    std::vector<VkDescriptorUpdateTemplateEntryKHR> entries(desc.storageBufferCount);
+    for (uint32_t i = 0; i < desc.storageBufferCount; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[i].pImmutableSamplers = NULL;
+
+        entries[i].dstBinding = i;
+        entries[i].dstArrayElement = 0;
+        entries[i].descriptorCount = 1;
+        entries[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        entries[i].offset = i * sizeof(VkDescriptorBufferInfo);
+        entries[i].stride = sizeof(VkDescriptorBufferInfo);
+    }
+    kernel->setLayout = descriptors.getLayout(bindings, 0, kernel->name.c_str());
+    kernel->bufferTemplate = desc.storageBufferCount ? descriptors.createTemplate(kernel->setLayout, entries) : NULL;
+    kernel->pipelineLayout = getPipelineLayout(kernel->setLayout, desc.pushConstantSize);
+
+    // The workgroup size is the engine's to choose, the kernel's own constants come on top.
+    SpecializationConstants constants = desc.constants;
+    assert(!desc.constants.has(WORKGROUP_SIZE_X_ID) && !desc.constants.has(WORKGROUP_SIZE_Y_ID)
+        && !desc.constants.has(WORKGROUP_SIZE_Z_ID));
+    constants.set(WORKGROUP_SIZE_X_ID, kernel->workgroupSize[0]);
+    constants.set(WORKGROUP_SIZE_Y_ID, kernel->workgroupSize[1]);
+    constants.set(WORKGROUP_SIZE_Z_ID, kernel->workgroupSize[2]);
+    VkSpecializationInfo specializationInfo = constants.getInfo();
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = NULL;
+    pipelineInfo.flags = 0;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.pNext = NULL;
+    pipelineInfo.stage.flags = 0;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = module;
+    pipelineInfo.stage.pName = desc.entryPoint.c_str();
+    pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+    pipelineInfo.layout = kernel->pipelineLayout;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+
+    VkResult result = deviceObj->pipelineManager.getComputePipeline(pipelineInfo, &kernel->pipeline, kernel->name.c_str());
+    if (result != VK_SUCCESS) {
+        std::cout << "Cannot create the compute pipeline of " << kernel->name << std::endl;
+        delete kernel;
+        return NULL;
+    }
+
+    kernels.push_back(kernel);
+    stats.kernels++;
+    return kernel;
+}
+
+VkCommandBuffer ComputeEngine::beginBatch()
+{
+    if (recordingSlot != BATCH_SLOT_COUNT) {
+        return batchSlots[recordingSlot].cmdBuffer;
+    }
+
+    // The oldest slot comes back around, it can be reused once its batch has run.
+    BatchSlot& slot = batchSlots[nextSlot];
+    if (slot.token.serial != 0) {
+        VkResult result = fencePool.wait(slot.token);
+        assert(result == VK_SUCCESS);
+        fencePool.retireCompleted();
+    }
+    descriptors.resetFrame(nextSlot);
+
+    VkResult result = vkResetCommandBuffer(slot.cmdBuffer, 0);
+    assert(result == VK_SUCCESS);
+
+    VkCommandBufferBeginInfo cmdBufferBeginInfo = {};
+    cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmdBufferBeginInfo.pNext = NULL;
+    cmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    cmdBufferBeginInfo.pInheritanceInfo = NULL;
+    CommandBufferMgr::beginCommandBuffer(slot.cmdBuffer, &cmdBufferBeginInfo);
+
+    recordingSlot = nextSlot;
+    nextSlot = (nextSlot + 1) % BATCH_SLOT_COUNT;
+    boundPipeline = VK_NULL_HANDLE;
+    return slot.cmdBuffer;
+}
+
+void ComputeEngine::dispatch(const ComputeKernel* kernel, const VkDescriptorBufferInfo* buffers, const void* pushConstants,
+    uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+{
+    if (groupCountX == 0 || groupCountY == 0 || groupCountZ == 0) {
+        return;
+    }
+
+    VkCommandBuffer cmdBuffer = beginBatch();
+    CommandBufferLabel cmdLabel(deviceObj->debugUtils, cmdBuffer, kernel->name.c_str());
+
+    if (kernel->pipeline != boundPipeline) {
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernel->pipeline);
+        boundPipeline = kernel->pipeline;
+    }
+
+    if (kernel->storageBufferCount) {
+        VkDescriptorSet set = descriptors.allocate(recordingSlot, kernel->setLayout);
+        descriptors.update(set, kernel->bufferTemplate, buffers);
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernel->pipelineLayout, 0, 1, &set, 0, NULL);
+    }
+
+    if (kernel->pushConstantSize) {
+        vkCmdPushConstants(cmdBuffer, kernel->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, kernel->pushConstantSize, pushConstants);
+    }
+
+    vkCmdDispatch(cmdBuffer, groupCountX, groupCountY, groupCountZ);
+
+    stats.dispatches++;
+    stats.workgroups += (uint64_t)groupCountX * groupCountY * groupCountZ;
+}
+
+void ComputeEngine::dispatchItems(const ComputeKernel* kernel, const VkDescriptorBufferInfo* buffers, const void* pushConstants,
+    uint32_t itemCountX, uint32_t itemCountY, uint32_t itemCountZ)
+{
+    const uint32_t* size = kernel->workgroupSize;
+    dispatch(kernel, buffers, pushConstants,
+        (itemCountX + size[0] - 1) / size[0], (itemCountY + size[1] - 1) / size[1], (itemCountZ + size[2] - 1) / size[2]);
+}
+
+void ComputeEngine::barrier()
+{
+    if (recordingSlot == BATCH_SLOT_COUNT) {
+        return; // Submissions are ordered by submit() already.
+    }
+
+    VkMemoryBarrier memoryBarrier = {};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.pNext = NULL;
+    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(batchSlots[recordingSlot].cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, NULL, 0, NULL);
+}
+
+SubmitToken ComputeEngine::submit()
+{
+    if (recordingSlot == BATCH_SLOT_COUNT) {
+        return SubmitToken();
+    }
+
+    BatchSlot& slot = batchSlots[recordingSlot];
+
+    // Make the results visible to everything submitted after this batch, and to the host.
+    VkMemoryBarrier memoryBarrier = {};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.pNext = NULL;
+    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(slot.cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, NULL, 0, NULL);
+
+    CommandBufferMgr::endCommandBuffer(slot.cmdBuffer);
+
+    slot.token = CommandBufferMgr::submitCommandBufferAsync(queue, fencePool, &slot.cmdBuffer, 1);
+    recordingSlot = BATCH_SLOT_COUNT;
+    stats.batches++;
+    return slot.token;
+}
+
+void ComputeEngine::printStats() const
+{
+    std::cout << "Compute engine: " << stats.shaderModules << " shader modules mapped ("
+              << stats.spirvBytes << " bytes), " << stats.kernels << " kernels, "
+              << stats.dispatches << " dispatches of " << stats.workgroups << " workgroups in "
+              << stats.batches << " batches" << std::endl;
+}
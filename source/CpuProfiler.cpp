@@ -0,0 +1,180 @@
+#include "CpuProfiler.h"
+
+#if ENABLE_CPU_PROFILING
+
+#include "ChromeTrace.h"
+#include <chrono>
+#include <cstdio>
+#include <unordered_map>
+
+struct CpuTraceRecord {
+    const char* name;
+    uint64_t startNs;
+    uint64_t endNs;
+};
+
+// Written by its thread only. A reader that loads 'count' with acquire semantics sees the
+// records below it and the chunks holding them.
+struct ThreadBuffer {
+    uint32_t tid;
+    char threadName[32];
+    std::atomic<bool> named; // Publishes 'threadName'.
+    CpuTraceRecord* chunks[CpuProfiler::MAX_CHUNKS];
+    std::atomic<uint32_t> count;
+    std::atomic<uint64_t> dropped;
+};
+
+static std::mutex& registryMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+// Buffers stay alive after their thread exits, so the scopes of joined workers are exported too.
+static std::vector<ThreadBuffer*>& registry()
+{
+    static std::vector<ThreadBuffer*> buffers;
+    return buffers;
+}
+
+static thread_local ThreadBuffer* localBuffer = NULL;
+
+static ThreadBuffer* getLocalBuffer()
+{
+    if (!localBuffer) {
+        ThreadBuffer* buffer = new ThreadBuffer();
+        buffer->threadName[0] = '\0';
+        buffer->named = false;
+        for (uint32_t i = 0; i < CpuProfiler::MAX_CHUNKS; i++) {
+            buffer->chunks[i] = NULL;
+        }
+        buffer->count = 0;
+        buffer->dropped = 0;
+
+        // Once per thread, the only lock on the recording side.
+        std::lock_guard<std::mutex> lock(registryMutex());
+        buffer->tid = (uint32_t)registry().size();
+        registry().push_back(buffer);
+        localBuffer = buffer;
+    }
+    return localBuffer;
+}
+
+uint64_t CpuProfiler::nowNanoseconds()
+{
+    static const std::chrono::steady_clock::time_point processStart = std::chrono::steady_clock::now();
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - processStart).count();
+}
+
+void CpuProfiler::record(const char* name, uint64_t startNs, uint64_t endNs)
+{
+    ThreadBuffer* buffer = getLocalBuffer();
+    uint32_t index = buffer->count.load(std::memory_order_relaxed);
+    uint32_t chunk = index / CHUNK_RECORDS;
+    if (chunk >= MAX_CHUNKS) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (!buffer->chunks[chunk]) {
+        buffer->chunks[chunk] = new CpuTraceRecord[CHUNK_RECORDS];
+    }
+
+    CpuTraceRecord& record = buffer->chunks[chunk][index % CHUNK_RECORDS];
+    record.name = name;
+    record.startNs = startNs;
+    record.endNs = endNs;
+    buffer->count.store(index + 1, std::memory_order_release);
+}
+
+void CpuProfiler::setThreadName(const char* name)
+{
+    ThreadBuffer* buffer = getLocalBuffer();
+    snprintf(buffer->threadName, sizeof(buffer->threadName), "%s", name);
+    buffer->named.store(true, std::memory_order_release);
+}
+
+void CpuProfiler::appendTraceEvents(std::string& eventList, uint32_t pid)
+{
+    std::lock_guard<std::mutex> lock(registryMutex());
+
+    if (!eventList.empty()) {
+        eventList += ",\n";
+    }
+    ChromeTrace::appendTrackName(eventList, pid, UINT32_MAX, "CPU");
+
+    for (const ThreadBuffer* buffer : registry()) {
+        const char* threadName = buffer->threadName;
+        char defaultName[32];
+        if (!buffer->named.load(std::memory_order_acquire)) {
+            snprintf(defaultName, sizeof(defaultName), "Thread %u", buffer->tid);
+            threadName = defaultName;
+        }
+        eventList += ",\n";
+        ChromeTrace::appendTrackName(eventList, pid, buffer->tid, threadName);
+
+        uint32_t count = buffer->count.load(std::memory_order_acquire);
+        for (uint32_t i = 0; i < count; i++) {
+            const CpuTraceRecord& record = buffer->chunks[i / CHUNK_RECORDS][i % CHUNK_RECORDS];
+
+            TraceEvent event;
+            event.name = record.name;
+            event.category = "cpu";
+            event.startUs = record.startNs * 1e-3;
+            event.durationUs = (record.endNs - record.startNs) * 1e-3;
+            event.pid = pid;
+            event.tid = buffer->tid;
+            eventList += ",\n";
+            ChromeTrace::appendEvent(eventList, event);
+        }
+    }
+}
+
+bool CpuProfiler::writeChromeTrace(const std::string& filePath)
+{
+    std::string eventList;
+    appendTraceEvents(eventList, 0);
+    return ChromeTrace::writeTrace(filePath, eventList);
+}
+
+void CpuProfiler::printStats()
+{
+    struct NameTotals {
+        uint64_t count;
+        uint64_t totalNs;
+        uint64_t maxNs;
+    };
+    std::unordered_map<const char*, NameTotals> totals; // Scope names are long-lived, key by address.
+    uint64_t dropped = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        for (const ThreadBuffer* buffer : registry()) {
+            dropped += buffer->dropped.load(std::memory_order_relaxed);
+            uint32_t count = buffer->count.load(std::memory_order_acquire);
+            for (uint32_t i = 0; i < count; i++) {
+                const CpuTraceRecord& record = buffer->chunks[i / CHUNK_RECORDS][i % CHUNK_RECORDS];
+                NameTotals& entry = totals[record.name];
+                uint64_t elapsedNs = record.endNs - record.startNs;
+                entry.count++;
+                entry.totalNs += elapsedNs;
+                entry.maxNs = std::max(entry.maxNs, elapsedNs);
+            }
+        }
+    }
+
+    std::vector<std::pair<const char*, NameTotals> > sorted(totals.begin(), totals.end());
+    std::sort(sorted.begin(), sorted.end(), [](const std::pair<const char*, NameTotals>& a, const std::pair<const char*, NameTotals>& b) {
+        return a.second.totalNs > b.second.totalNs;
+    });
+
+    std::cout << "CPU scopes: " << sorted.size() << " names, " << dropped << " dropped" << std::endl;
+    char line[192];
+    for (const auto& entry : sorted) {
+        snprintf(line, sizeof(line), "  %-32s %8llu x  total %10.3f  avg %8.3f  max %8.3f ms",
+            entry.first, (unsigned long long)entry.second.count, entry.second.totalNs * 1e-6,
+            entry.second.totalNs * 1e-6 / entry.second.count, entry.second.maxNs * 1e-6);
+        std::cout << line << std::endl;
+    }
+}
+
+#endif // ENABLE_CPU_PROFILING
@@ -0,0 +1,257 @@
+#include "DebugReportSink.h"
+#include <chrono>
+#include <cstdio>
+
+static const char* severityNames[DEBUG_SEVERITY_COUNT] = { "ERROR", "WARNING", "PERFORMANCE", "INFORMATION", "DEBUG" };
+
+// Copies at most 'size - 1' characters and always terminates, 'src' may be NULL.
+static void copyString(char* dst, size_t size, const char* src)
+{
+    size_t length = src ? strlen(src) : 0;
+    if (length >= size) {
+        length = size - 1;
+    }
+    if (length) {
+        memcpy(dst, src, length);
+    }
+    dst[length] = '\0';
+}
+
+DebugReportSink::DebugReportSink()
+{
+    ring = new Slot[RING_CAPACITY];
+    for (uint32_t i = 0; i < RING_CAPACITY; i++) {
+        ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    enqueuePos = 0;
+    dequeuePos = 0;
+
+    for (uint32_t i = 0; i < DEBUG_SEVERITY_COUNT; i++) {
+        received[i] = 0;
+    }
+    dropped = 0;
+    printed = 0;
+    suppressed = 0;
+
+    maxPerWindow = 4;
+    windowMs = 1000;
+    stopping = false;
+    running = false;
+}
+
+DebugReportSink::~DebugReportSink()
+{
+    stopSink();
+    delete[] ring;
+}
+
+DebugSeverity DebugReportSink::severityOf(VkFlags msgFlags)
+{
+    if (msgFlags & VK_DEBUG_REPORT_ERROR_BIT_EXT)
+        return DEBUG_SEVERITY_ERROR;
+    if (msgFlags & VK_DEBUG_REPORT_WARNING_BIT_EXT)
+        return DEBUG_SEVERITY_WARNING;
+    if (msgFlags & VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT)
+        return DEBUG_SEVERITY_PERFORMANCE;
+    if (msgFlags & VK_DEBUG_REPORT_INFORMATION_BIT_EXT)
+        return DEBUG_SEVERITY_INFORMATION;
+    return DEBUG_SEVERITY_DEBUG;
+}
+
+uint64_t DebugReportSink::nowMilliseconds()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void DebugReportSink::startSink(uint32_t inMaxPerWindow, uint32_t inWindowMs)
+{
+    if (running) {
+        return;
+    }
+
+    maxPerWindow = inMaxPerWindow;
+    windowMs = inWindowMs;
+    stopping = false;
+    running = true;
+    drainThread = std::thread(&DebugReportSink::drainLoop, this);
+}
+
+void DebugReportSink::stopSink()
+{
+    if (!running) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wakeCondition.notify_one();
+    drainThread.join();
+    running = false;
+}
+
+void DebugReportSink::push(VkFlags msgFlags, VkDebugReportObjectTypeEXT objType, uint64_t srcObject,
+    size_t location, int32_t msgCode, const char* layerPrefix, const char* msg)
+{
+    received[severityOf(msgFlags)].fetch_add(1, std::memory_order_relaxed);
+
+    // Claim a slot, or give up at once if the consumer is a full ring behind.
+    uint64_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &ring[pos & (RING_CAPACITY - 1)];
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        int64_t difference = (int64_t)(sequence - pos);
+        if (difference == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    DebugRecord& record = slot->record;
+    record.msgFlags = msgFlags;
+    record.objType = objType;
+    record.srcObject = srcObject;
+    record.location = location;
+    record.msgCode = msgCode;
+    copyString(record.layerPrefix, sizeof(record.layerPrefix), layerPrefix);
+    copyString(record.msg, sizeof(record.msg), msg);
+
+    // Publish the record to the consumer.
+    slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+bool DebugReportSink::pop(DebugRecord& record)
+{
+    Slot& slot = ring[dequeuePos & (RING_CAPACITY - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeuePos + 1) {
+        return false; // Empty, or the producer of this slot has not finished writing.
+    }
+
+    record = slot.record;
+
+    // Hand the slot back to the producers for the next lap.
+    slot.sequence.store(dequeuePos + RING_CAPACITY, std::memory_order_release);
+    dequeuePos++;
+    return true;
+}
+
+void DebugReportSink::formatRecord(const DebugRecord& record, std::string& batch)
+{
+    char line[96];
+    snprintf(line, sizeof(line), "[VK_DEBUG_REPORT] %s: [", severityNames[severityOf(record.msgFlags)]);
+    batch += line;
+    batch += record.layerPrefix;
+    snprintf(line, sizeof(line), "] Code%d:", record.msgCode);
+    batch += line;
+    batch += record.msg;
+    batch += '\n';
+}
+
+uint32_t DebugReportSink::drain(std::string& batch)
+{
+    uint64_t nowMs = nowMilliseconds();
+    uint32_t count = 0;
+
+    DebugRecord record;
+    while (pop(record)) {
+        count++;
+
+        RepeatKey key = { record.msgCode, record.srcObject, (uint32_t)severityOf(record.msgFlags) };
+        std::unordered_map<RepeatKey, RepeatState, RepeatKeyHash>::iterator it = repeats.find(key);
+        if (it == repeats.end()) {
+            RepeatState state = { nowMs, 0, 0 };
+            it = repeats.insert(std::make_pair(key, state)).first;
+        }
+
+        RepeatState& state = it->second;
+        if (state.printedInWindow < maxPerWindow) {
+            state.printedInWindow++;
+            printed.fetch_add(1, std::memory_order_relaxed);
+            formatRecord(record, batch);
+        } else {
+            state.suppressedInWindow++;
+            suppressed.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    return count;
+}
+
+// Reports how many repeats each expired window swallowed and forgets the window.
+void DebugReportSink::closeWindows(uint64_t nowMs, bool all, std::string& batch)
+{
+    std::unordered_map<RepeatKey, RepeatState, RepeatKeyHash>::iterator it = repeats.begin();
+    while (it != repeats.end()) {
+        if (!all && nowMs - it->second.windowStart < windowMs) {
+            ++it;
+            continue;
+        }
+
+        if (it->second.suppressedInWindow) {
+            char line[160];
+            snprintf(line, sizeof(line), "[VK_DEBUG_REPORT] %s: Code%d on object 0x%llx repeated %u more times\n",
+                severityNames[it->first.severity], it->first.msgCode,
+                (unsigned long long)it->first.srcObject, it->second.suppressedInWindow);
+            batch += line;
+        }
+        it = repeats.erase(it);
+    }
+}
+
+void DebugReportSink::drainLoop()
+{
+    std::string batch;
+    for (;;) {
+        bool stop;
+        {
+            // Producers never signal, the sink polls so the callback stays lock-free.
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wakeCondition.wait_for(lock, std::chrono::milliseconds(10), [this]() { return stopping; });
+            stop = stopping;
+        }
+
+        batch.clear();
+        drain(batch);
+        closeWindows(nowMilliseconds(), stop, batch);
+
+        // One write and one flush for the whole batch.
+        if (!batch.empty()) {
+            std::cout.write(batch.data(), batch.size());
+            std::cout.flush();
+        }
+
+        if (stop) {
+            break;
+        }
+    }
+}
+
+DebugSinkStats DebugReportSink::getStats() const
+{
+    DebugSinkStats stats;
+    for (uint32_t i = 0; i < DEBUG_SEVERITY_COUNT; i++) {
+        stats.received[i] = received[i].load(std::memory_order_relaxed);
+    }
+    stats.printed = printed.load(std::memory_order_relaxed);
+    stats.suppressed = suppressed.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void DebugReportSink::printStats() const
+{
+    DebugSinkStats stats = getStats();
+    std::cout << "Debug report:";
+    for (uint32_t i = 0; i < DEBUG_SEVERITY_COUNT; i++) {
+        std::cout << " " << stats.received[i] << " " << severityNames[i] << (i + 1 < DEBUG_SEVERITY_COUNT ? "," : "");
+    }
+    std::cout << "; " << stats.printed << " printed, " << stats.suppressed << " repeats folded, "
+              << stats.dropped << " dropped (ring full)" << std::endl;
+}
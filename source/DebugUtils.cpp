@@ -0,0 +1,189 @@
+#include "DebugUtils.h"
+#include "DebugReportSink.h"
+
+DebugUtils::DebugUtils()
+{
+    createMessengerFn = NULL;
+    destroyMessengerFn = NULL;
+    setObjectNameFn = NULL;
+    cmdBeginLabelFn = NULL;
+    cmdEndLabelFn = NULL;
+    cmdInsertLabelFn = NULL;
+    queueBeginLabelFn = NULL;
+    queueEndLabelFn = NULL;
+    messenger = VK_NULL_HANDLE;
+}
+
+DebugUtils::~DebugUtils()
+{
+}
+
+bool DebugUtils::loadFunctions(VkInstance instance)
+{
+    createMessengerFn = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
+    destroyMessengerFn = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
+    setObjectNameFn = (PFN_vkSetDebugUtilsObjectNameEXT)vkGetInstanceProcAddr(instance, "vkSetDebugUtilsObjectNameEXT");
+    cmdBeginLabelFn = (PFN_vkCmdBeginDebugUtilsLabelEXT)vkGetInstanceProcAddr(instance, "vkCmdBeginDebugUtilsLabelEXT");
+    cmdEndLabelFn = (PFN_vkCmdEndDebugUtilsLabelEXT)vkGetInstanceProcAddr(instance, "vkCmdEndDebugUtilsLabelEXT");
+    cmdInsertLabelFn = (PFN_vkCmdInsertDebugUtilsLabelEXT)vkGetInstanceProcAddr(instance, "vkCmdInsertDebugUtilsLabelEXT");
+    queueBeginLabelFn = (PFN_vkQueueBeginDebugUtilsLabelEXT)vkGetInstanceProcAddr(instance, "vkQueueBeginDebugUtilsLabelEXT");
+    queueEndLabelFn = (PFN_vkQueueEndDebugUtilsLabelEXT)vkGetInstanceProcAddr(instance, "vkQueueEndDebugUtilsLabelEXT");
+
+    // All or nothing, so callers only need to test isEnabled().
+    if (!createMessengerFn || !destroyMessengerFn || !setObjectNameFn || !cmdBeginLabelFn || !cmdEndLabelFn
+        || !cmdInsertLabelFn || !queueBeginLabelFn || !queueEndLabelFn) {
+        std::cout << "VK_EXT_debug_utils entry points not found, object names and labels disabled." << std::endl;
+        createMessengerFn = NULL;
+        destroyMessengerFn = NULL;
+        setObjectNameFn = NULL;
+        cmdBeginLabelFn = NULL;
+        cmdEndLabelFn = NULL;
+        cmdInsertLabelFn = NULL;
+        queueBeginLabelFn = NULL;
+        queueEndLabelFn = NULL;
+        return false;
+    }
+    return true;
+}
+
+VkDebugUtilsMessengerCreateInfoEXT DebugUtils::messengerCreateInfo(DebugReportSink* sink)
+{
+    VkDebugUtilsMessengerCreateInfoEXT createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+    createInfo.pNext = NULL;
+    createInfo.flags = 0;
+    // Same selection as the debug report path: warnings, performance warnings, errors and debug.
+    createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+    createInfo.pfnUserCallback = messengerFunction;
+    createInfo.pUserData = sink;
+    return createInfo;
+}
+
+VkResult DebugUtils::createMessenger(VkInstance instance, DebugReportSink* sink)
+{
+    if (!createMessengerFn) {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+
+    VkDebugUtilsMessengerCreateInfoEXT createInfo = messengerCreateInfo(sink);
+    VkResult result = createMessengerFn(instance, &createInfo, NULL, &messenger);
+    if (result == VK_SUCCESS) {
+        std::cout << "Debug utils messenger created successfully." << std::endl;
+    }
+    return result;
+}
+
+void DebugUtils::destroyMessenger(VkInstance instance)
+{
+    if (destroyMessengerFn && messenger != VK_NULL_HANDLE) {
+        destroyMessengerFn(instance, messenger, NULL);
+        messenger = VK_NULL_HANDLE;
+    }
+}
+
+/*
+ * Translates the message into the fields of a debug report message, so both backends
+ * share the sink with its rate limiting and counters. The first object of the message
+ * stands in for the report's source object; core object type values are the same in
+ * VkObjectType and VkDebugReportObjectTypeEXT.
+ */
+VKAPI_ATTR VkBool32 VKAPI_CALL DebugUtils::messengerFunction(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
+    VkDebugUtilsMessageTypeFlagsEXT messageTypes,
+    const VkDebugUtilsMessengerCallbackDataEXT* callbackData,
+    void* userData)
+{
+    VkFlags msgFlags;
+    if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+        msgFlags = VK_DEBUG_REPORT_ERROR_BIT_EXT;
+    } else if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+        msgFlags = (messageTypes & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT) ? VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT : VK_DEBUG_REPORT_WARNING_BIT_EXT;
+    } else if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) {
+        msgFlags = VK_DEBUG_REPORT_INFORMATION_BIT_EXT;
+    } else {
+        msgFlags = VK_DEBUG_REPORT_DEBUG_BIT_EXT;
+    }
+
+    VkDebugReportObjectTypeEXT objType = (VkDebugReportObjectTypeEXT)0;
+    uint64_t srcObject = 0;
+    if (callbackData->objectCount > 0) {
+        objType = (VkDebugReportObjectTypeEXT)callbackData->pObjects[0].objectType;
+        srcObject = callbackData->pObjects[0].objectHandle;
+    }
+    const char* idName = callbackData->pMessageIdName ? callbackData->pMessageIdName : "";
+
+    if (userData) {
+        ((DebugReportSink*)userData)->push(msgFlags, objType, srcObject, 0, callbackData->messageIdNumber, idName, callbackData->pMessage);
+    } else {
+        std::cout << "[VK_DEBUG_UTILS] [" << idName << "] Code"
+                  << callbackData->messageIdNumber << ":" << callbackData->pMessage << std::endl;
+    }
+
+    // Never abort the call that triggered the message.
+    return VK_FALSE;
+}
+
+void DebugUtils::setObjectName(VkDevice device, VkObjectType objectType, uint64_t objectHandle, const char* name) const
+{
+    if (!setObjectNameFn || !objectHandle) {
+        return;
+    }
+
+    VkDebugUtilsObjectNameInfoEXT nameInfo = {};
+    nameInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+    nameInfo.pNext = NULL;
+    nameInfo.objectType = objectType;
+    nameInfo.objectHandle = objectHandle;
+    nameInfo.pObjectName = name;
+    setObjectNameFn(device, &nameInfo);
+}
+
+VkDebugUtilsLabelEXT DebugUtils::makeLabel(const char* name, const float color[4])
+{
+    VkDebugUtilsLabelEXT label = {};
+    label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+    label.pNext = NULL;
+    label.pLabelName = name;
+    if (color) {
+        memcpy(label.color, color, sizeof(label.color));
+    }
+    return label;
+}
+
+void DebugUtils::beginLabel(VkCommandBuffer cmdBuffer, const char* name, const float color[4]) const
+{
+    if (cmdBeginLabelFn) {
+        VkDebugUtilsLabelEXT label = makeLabel(name, color);
+        cmdBeginLabelFn(cmdBuffer, &label);
+    }
+}
+
+void DebugUtils::endLabel(VkCommandBuffer cmdBuffer) const
+{
+    if (cmdEndLabelFn) {
+        cmdEndLabelFn(cmdBuffer);
+    }
+}
+
+void DebugUtils::insertLabel(VkCommandBuffer cmdBuffer, const char* name, const float color[4]) const
+{
+    if (cmdInsertLabelFn) {
+        VkDebugUtilsLabelEXT label = makeLabel(name, color);
+        cmdInsertLabelFn(cmdBuffer, &label);
+    }
+}
+
+void DebugUtils::beginLabel(VkQueue queue, const char* name, const float color[4]) const
+{
+    if (queueBeginLabelFn) {
+        VkDebugUtilsLabelEXT label = makeLabel(name, color);
+        queueBeginLabelFn(queue, &label);
+    }
+}
+
+void DebugUtils::endLabel(VkQueue queue) const
+{
+    if (queueEndLabelFn) {
+        queueEndLabelFn(queue);
+    }
+}
@@ -0,0 +1,197 @@
+#include "DeletionQueue.h"
+#include "VulkanDevice.h"
+
+DeletionQueue::DeletionQueue()
+{
+    deviceObj = NULL;
+    frameList.fencePool = NULL;
+    currentFrame = 0;
+    retiredFrames = 0;
+    pendingCount = 0;
+    stats = {};
+}
+
+DeletionQueue::~DeletionQueue()
+{
+}
+
+void DeletionQueue::createDeletionQueue(VulkanDevice* inDeviceObj)
+{
+    deviceObj = inDeviceObj;
+    currentFrame = 0;
+    retiredFrames = 0;
+}
+
+void DeletionQueue::destroyDeletionQueue()
+{
+    std::vector<DeferredObject> ready;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        // The fence pools may be gone already, the device being idle is all that counts now.
+        takeCompleted(frameList, UINT64_MAX, ready);
+        for (auto& list : fenceLists) {
+            takeCompleted(list, UINT64_MAX, ready);
+        }
+        fenceLists.clear();
+        pendingCount = 0;
+        stats.destroyed += ready.size();
+    }
+
+    for (size_t i = 0; i < ready.size(); i++) {
+        destroy(ready[i]);
+    }
+}
+
+void DeletionQueue::freeAllocation(const MemoryAllocation& allocation, const DeletionKey& key)
+{
+    if (allocation.memory != VK_NULL_HANDLE) {
+        push(VK_OBJECT_TYPE_UNKNOWN, 0, allocation, key);
+    }
+}
+
+void DeletionQueue::push(VkObjectType objectType, uint64_t handle, const MemoryAllocation& allocation, const DeletionKey& key)
+{
+    DeferredObject object;
+    object.objectType = objectType;
+    object.handle = handle;
+    object.allocation = allocation;
+
+    std::lock_guard<std::mutex> lock(queueMutex);
+    object.value = key.value == DeletionKey::CURRENT_FRAME && !key.fencePool ? currentFrame : key.value;
+
+    PendingList* list = &frameList;
+    if (key.fencePool) {
+        list = NULL;
+        for (auto& fenceList : fenceLists) {
+            if (fenceList.fencePool == key.fencePool) {
+                list = &fenceList;
+                break;
+            }
+        }
+        if (!list) {
+            fenceLists.push_back(PendingList());
+            list = &fenceLists.back();
+            list->fencePool = key.fencePool;
+        }
+    }
+    list->objects.push_back(object);
+
+    pendingCount++;
+    stats.queued++;
+    stats.maxPending = std::max(stats.maxPending, pendingCount);
+}
+
+void DeletionQueue::beginFrame(uint64_t frameNumber, uint64_t retiredFrameCount)
+{
+    std::vector<DeferredObject> ready;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        currentFrame = frameNumber;
+        retiredFrames = retiredFrameCount;
+        collectLocked(retiredFrames, ready);
+    }
+
+    // Destroyed outside the lock, other threads keep queueing meanwhile.
+    for (size_t i = 0; i < ready.size(); i++) {
+        destroy(ready[i]);
+    }
+}
+
+void DeletionQueue::collect()
+{
+    std::vector<DeferredObject> ready;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        collectLocked(retiredFrames, ready);
+    }
+
+    for (size_t i = 0; i < ready.size(); i++) {
+        destroy(ready[i]);
+    }
+}
+
+void DeletionQueue::collectLocked(uint64_t retiredFrameCount, std::vector<DeferredObject>& ready)
+{
+    size_t readyBefore = ready.size();
+
+    // A frame number below the retired count has completed, a serial up to the
+    // completed serial has.
+    if (retiredFrameCount > 0) {
+        takeCompleted(frameList, retiredFrameCount - 1, ready);
+    }
+    for (auto& list : fenceLists) {
+        if (!list.objects.empty()) {
+            takeCompleted(list, list.fencePool->retireCompleted(), ready);
+        }
+    }
+
+    pendingCount -= (uint32_t)(ready.size() - readyBefore);
+    stats.destroyed += ready.size() - readyBefore;
+}
+
+void DeletionQueue::takeCompleted(PendingList& list, uint64_t completedValue, std::vector<DeferredObject>& ready)
+{
+    while (!list.objects.empty() && list.objects.front().value <= completedValue) {
+        ready.push_back(list.objects.front());
+        list.objects.pop_front();
+    }
+}
+
+uint32_t DeletionQueue::getPendingCount()
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return pendingCount;
+}
+
+void DeletionQueue::destroy(const DeferredObject& object)
+{
+    VkDevice device = deviceObj->device;
+    uint64_t handle = object.handle;
+
+    switch (object.objectType) {
+    case VK_OBJECT_TYPE_UNKNOWN: {
+        MemoryAllocation allocation = object.allocation;
+        deviceObj->memoryAllocator.free(allocation);
+        break;
+    }
+    case VK_OBJECT_TYPE_SEMAPHORE: vkDestroySemaphore(device, (VkSemaphore)handle, NULL); break;
+    case VK_OBJECT_TYPE_FENCE: vkDestroyFence(device, (VkFence)handle, NULL); break;
+    case VK_OBJECT_TYPE_DEVICE_MEMORY: vkFreeMemory(device, (VkDeviceMemory)handle, NULL); break;
+    case VK_OBJECT_TYPE_BUFFER: vkDestroyBuffer(device, (VkBuffer)handle, NULL); break;
+    case VK_OBJECT_TYPE_IMAGE: vkDestroyImage(device, (VkImage)handle, NULL); break;
+    case VK_OBJECT_TYPE_EVENT: vkDestroyEvent(device, (VkEvent)handle, NULL); break;
+    case VK_OBJECT_TYPE_QUERY_POOL: vkDestroyQueryPool(device, (VkQueryPool)handle, NULL); break;
+    case VK_OBJECT_TYPE_BUFFER_VIEW: vkDestroyBufferView(device, (VkBufferView)handle, NULL); break;
+    case VK_OBJECT_TYPE_IMAGE_VIEW: vkDestroyImageView(device, (VkImageView)handle, NULL); break;
+    // Pipelines are keyed by these handles, the next object with the same one must not find them.
+    case VK_OBJECT_TYPE_SHADER_MODULE:
+        deviceObj->pipelineManager.evictObject(handle);
+        vkDestroyShaderModule(device, (VkShaderModule)handle, NULL);
+        break;
+    case VK_OBJECT_TYPE_PIPELINE_LAYOUT:
+        deviceObj->pipelineManager.evictObject(handle);
+        vkDestroyPipelineLayout(device, (VkPipelineLayout)handle, NULL);
+        break;
+    case VK_OBJECT_TYPE_RENDER_PASS:
+        deviceObj->pipelineManager.evictObject(handle);
+        vkDestroyRenderPass(device, (VkRenderPass)handle, NULL);
+        break;
+    case VK_OBJECT_TYPE_PIPELINE: vkDestroyPipeline(device, (VkPipeline)handle, NULL); break;
+    case VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT: vkDestroyDescriptorSetLayout(device, (VkDescriptorSetLayout)handle, NULL); break;
+    case VK_OBJECT_TYPE_SAMPLER: vkDestroySampler(device, (VkSampler)handle, NULL); break;
+    case VK_OBJECT_TYPE_DESCRIPTOR_POOL: vkDestroyDescriptorPool(device, (VkDescriptorPool)handle, NULL); break;
+    case VK_OBJECT_TYPE_FRAMEBUFFER: vkDestroyFramebuffer(device, (VkFramebuffer)handle, NULL); break;
+    case VK_OBJECT_TYPE_COMMAND_POOL: vkDestroyCommandPool(device, (VkCommandPool)handle, NULL); break;
+    case VK_OBJECT_TYPE_SWAPCHAIN_KHR: vkDestroySwapchainKHR(device, (VkSwapchainKHR)handle, NULL); break;
+    default:
+        std::cout << "DeletionQueue: cannot destroy objects of type " << object.objectType << std::endl;
+        assert(false);
+        break;
+    }
+}
+
+void DeletionQueue::printStats() const
+{
+    std::cout << "Deletion queue: " << stats.queued << " objects queued, " << stats.destroyed << " destroyed, "
+              << "at most " << stats.maxPending << " pending" << std::endl;
+}
@@ -0,0 +1,457 @@
+#include "DescriptorAllocator.h"
+#include "VulkanDevice.h"
+
+// A mix that fits typical material and per-draw sets.
+static const DescriptorPoolRatio DEFAULT_POOL_RATIOS[] = {
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+    { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.0f },
+    { VK_DESCRIPTOR_TYPE_SAMPLER, 1.0f },
+    { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f }
+};
+
+static size_t hashCombine(size_t hash, uint64_t value)
+{
+    // FNV-1a over the bytes of 'value'.
+    for (int i = 0; i < 8; i++) {
+        hash ^= (size_t)((value >> (i * 8)) & 0xff);
+        hash *= (size_t)16777619u;
+    }
+    return hash;
+}
+
+bool DescriptorAllocator::LayoutKey::operator==(const LayoutKey& other) const
+{
+    if (flags != other.flags || bindings.size() != other.bindings.size() ||
+        samplerBindings != other.samplerBindings || immutableSamplers != other.immutableSamplers) {
+        return false;
+    }
+    for (size_t i = 0; i < bindings.size(); i++) {
+        const VkDescriptorSetLayoutBinding& a = bindings[i];
+        const VkDescriptorSetLayoutBinding& b = other.bindings[i];
+        if (a.binding != b.binding || a.descriptorType != b.descriptorType || a.descriptorCount != b.descriptorCount ||
+            a.stageFlags != b.stageFlags) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t DescriptorAllocator::LayoutKeyHash::operator()(const LayoutKey& key) const
+{
+    size_t hash = (size_t)2166136261u;
+    hash = hashCombine(hash, key.flags);
+    for (size_t i = 0; i < key.bindings.size(); i++) {
+        const VkDescriptorSetLayoutBinding& binding = key.bindings[i];
+        hash = hashCombine(hash, ((uint64_t)binding.binding << 32) | (uint64_t)binding.descriptorType);
+        hash = hashCombine(hash, ((uint64_t)binding.descriptorCount << 32) | (uint64_t)binding.stageFlags);
+    }
+    for (size_t i = 0; i < key.samplerBindings.size(); i++) {
+        hash = hashCombine(hash, key.samplerBindings[i]);
+    }
+    for (size_t i = 0; i < key.immutableSamplers.size(); i++) {
+        hash = hashCombine(hash, (uint64_t)(uintptr_t)key.immutableSamplers[i]);
+    }
+    return hash;
+}
+
+DescriptorAllocator::DescriptorAllocator()
+{
+    deviceObj = NULL;
+    workerCount = 1;
+    poolsCreated = 0;
+    poolResets = 0;
+    layoutCacheHits = 0;
+    createTemplateFn = NULL;
+    destroyTemplateFn = NULL;
+    updateWithTemplateFn = NULL;
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+}
+
+void DescriptorAllocator::createDescriptorAllocator(VulkanDevice* inDeviceObj, uint32_t frameSlotCount, uint32_t inWorkerCount,
+    const std::vector<DescriptorPoolRatio>& poolRatios)
+{
+    deviceObj = inDeviceObj;
+    workerCount = std::max(inWorkerCount, 1u);
+    ratios = poolRatios;
+    if (ratios.empty()) {
+        ratios.assign(DEFAULT_POOL_RATIOS, DEFAULT_POOL_RATIOS + sizeof(DEFAULT_POOL_RATIOS) / sizeof(DEFAULT_POOL_RATIOS[0]));
+    }
+
+    // Chains start without a pool, the first allocation takes one.
+    chains.resize(frameSlotCount * workerCount);
+    for (auto& chain : chains) {
+        chain.currentPool = VK_NULL_HANDLE;
+        chain.setsPerPool = INITIAL_SETS_PER_POOL;
+        chain.setsAllocated = 0;
+    }
+
+    // Device extension entry points, all or nothing.
+    if (deviceObj->isExtensionEnabled(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME)) {
+        VkDevice device = deviceObj->device;
+        createTemplateFn = (PFN_vkCreateDescriptorUpdateTemplateKHR)vkGetDeviceProcAddr(device, "vkCreateDescriptorUpdateTemplateKHR");
+        destroyTemplateFn = (PFN_vkDestroyDescriptorUpdateTemplateKHR)vkGetDeviceProcAddr(device, "vkDestroyDescriptorUpdateTemplateKHR");
+        updateWithTemplateFn = (PFN_vkUpdateDescriptorSetWithTemplateKHR)vkGetDeviceProcAddr(device, "vkUpdateDescriptorSetWithTemplateKHR");
+        if (!createTemplateFn || !destroyTemplateFn || !updateWithTemplateFn) {
+            createTemplateFn = NULL;
+            destroyTemplateFn = NULL;
+            updateWithTemplateFn = NULL;
+        }
+    }
+    if (!createTemplateFn) {
+        std::cout << "Descriptor update templates not available, descriptor sets are written with vkUpdateDescriptorSets." << std::endl;
+    }
+}
+
+void DescriptorAllocator::destroyDescriptorAllocator()
+{
+    VkDevice device = deviceObj->device;
+
+    // Destroying a pool frees its sets.
+    for (auto& chain : chains) {
+        for (size_t i = 0; i < chain.fullPools.size(); i++) {
+            vkDestroyDescriptorPool(device, chain.fullPools[i], NULL);
+        }
+        if (chain.currentPool != VK_NULL_HANDLE) {
+            vkDestroyDescriptorPool(device, chain.currentPool, NULL);
+        }
+    }
+    chains.clear();
+    for (auto& freePool : freePools) {
+        vkDestroyDescriptorPool(device, freePool.second, NULL);
+    }
+    freePools.clear();
+    poolMaxSets.clear();
+
+    for (size_t i = 0; i < templates.size(); i++) {
+        if (templates[i]->handle != VK_NULL_HANDLE) {
+            destroyTemplateFn(device, templates[i]->handle, NULL);
+        }
+        delete templates[i];
+    }
+    templates.clear();
+
+    for (auto& entry : layouts) {
+        vkDestroyDescriptorSetLayout(device, entry.second, NULL);
+    }
+    layouts.clear();
+}
+
+VkDescriptorSetLayout DescriptorAllocator::getLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+    VkDescriptorSetLayoutCreateFlags flags, const char* name)
+{
+    // The same bindings listed in another order make the same layout.
+    std::vector<VkDescriptorSetLayoutBinding> sortedBindings = bindings;
+    std::sort(sortedBindings.begin(), sortedBindings.end(),
+        [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+
+    LayoutKey key;
+    key.flags = flags;
+    key.bindings = sortedBindings;
+    for (size_t i = 0; i < key.bindings.size(); i++) {
+        VkDescriptorSetLayoutBinding& binding = key.bindings[i];
+        if (binding.pImmutableSamplers) {
+            key.samplerBindings.push_back(binding.binding);
+            key.immutableSamplers.insert(key.immutableSamplers.end(), binding.pImmutableSamplers,
+                binding.pImmutableSamplers + binding.descriptorCount);
+            binding.pImmutableSamplers = NULL;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(layoutMutex);
+    auto found = layouts.find(key);
+    if (found != layouts.end()) {
+        layoutCacheHits++;
+        return found->second;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = NULL;
+    layoutInfo.flags = flags;
+    layoutInfo.bindingCount = (uint32_t)sortedBindings.size();
+    layoutInfo.pBindings = sortedBindings.size() ? sortedBindings.data() : NULL;
+
+    VkDescriptorSetLayout layout;
+    VkResult result = vkCreateDescriptorSetLayout(deviceObj->device, &layoutInfo, NULL, &layout);
+    assert(result == VK_SUCCESS);
+    deviceObj->setObjectName(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, layout, name);
+    layouts[key] = layout;
+    return layout;
+}
+
+const DescriptorTemplate* DescriptorAllocator::createTemplate(VkDescriptorSetLayout layout,
+    const std::vector<VkDescriptorUpdateTemplateEntryKHR>& entries)
+{
+    DescriptorTemplate* descriptorTemplate = new DescriptorTemplate();
+    descriptorTemplate->handle = VK_NULL_HANDLE;
+    descriptorTemplate->layout = layout;
+    descriptorTemplate->entries = entries;
+
+    if (createTemplateFn) {
+        VkDescriptorUpdateTemplateCreateInfoKHR templateInfo = {};
+        templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+        templateInfo.pNext = NULL;
+        templateInfo.flags = 0;
+        templateInfo.descriptorUpdateEntryCount = (uint32_t)entries.size();
+        templateInfo.pDescriptorUpdateEntries = entries.data();
+        templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR;
+        templateInfo.descriptorSetLayout = layout;
+        templateInfo.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS; // Only used by push descriptor templates.
+        templateInfo.pipelineLayout = VK_NULL_HANDLE;
+        templateInfo.set = 0;
+
+        VkResult result = createTemplateFn(deviceObj->device, &templateInfo, NULL, &descriptorTemplate->handle);
+        assert(result == VK_SUCCESS);
+    }
+
+    std::lock_guard<std::mutex> lock(layoutMutex);
+    templates.push_back(descriptorTemplate);
+    return descriptorTemplate;
+}
+
+DescriptorAllocator::PoolChain& DescriptorAllocator::getChain(uint32_t frameSlot, uint32_t workerIndex)
+{
+    assert(workerIndex < workerCount);
+    return chains[frameSlot * workerCount + workerIndex];
+}
+
+VkDescriptorPool DescriptorAllocator::acquirePool(uint32_t setsPerPool)
+{
+    {
+        // The smallest free pool of at least the size asked for, a smaller one would undo the
+        // doubling of a chain that keeps running out.
+        std::lock_guard<std::mutex> lock(poolMutex);
+        std::multimap<uint32_t, VkDescriptorPool>::iterator freePool = freePools.lower_bound(setsPerPool);
+        if (freePool != freePools.end()) {
+            VkDescriptorPool pool = freePool->second;
+            freePools.erase(freePool);
+            return pool;
+        }
+        poolsCreated++;
+    }
+
+    std::vector<VkDescriptorPoolSize> poolSizes(ratios.size());
+    for (size_t i = 0; i < ratios.size(); i++) {
+        poolSizes[i].type = ratios[i].type;
+        poolSizes[i].descriptorCount = std::max(1u, (uint32_t)(ratios[i].descriptorsPerSet * setsPerPool));
+    }
+
+    // No FREE_DESCRIPTOR_SET_BIT, the sets are only ever given back by resetting the pool.
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.pNext = NULL;
+    poolInfo.flags = 0;
+    poolInfo.maxSets = setsPerPool;
+    poolInfo.poolSizeCount = (uint32_t)poolSizes.size();
+    poolInfo.pPoolSizes = poolSizes.data();
+
+    VkDescriptorPool pool;
+    VkResult result = vkCreateDescriptorPool(deviceObj->device, &poolInfo, NULL, &pool);
+    assert(result == VK_SUCCESS);
+    deviceObj->setObjectName(VK_OBJECT_TYPE_DESCRIPTOR_POOL, pool, "Frame descriptor pool");
+
+    std::lock_guard<std::mutex> lock(poolMutex);
+    poolMaxSets[pool] = setsPerPool;
+    return pool;
+}
+
+void DescriptorAllocator::switchPool(PoolChain& chain)
+{
+    if (chain.currentPool != VK_NULL_HANDLE) {
+        chain.fullPools.push_back(chain.currentPool);
+        // The chain ran out, give it larger pools from now on.
+        chain.setsPerPool = std::min(chain.setsPerPool * 2, (uint32_t)MAX_SETS_PER_POOL);
+    }
+    chain.currentPool = acquirePool(chain.setsPerPool);
+}
+
+VkResult DescriptorAllocator::allocateFromChain(PoolChain& chain, const VkDescriptorSetLayout* setLayouts, uint32_t count, VkDescriptorSet* sets)
+{
+    if (chain.currentPool == VK_NULL_HANDLE) {
+        switchPool(chain);
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.pNext = NULL;
+    allocInfo.descriptorPool = chain.currentPool;
+    allocInfo.descriptorSetCount = count;
+    allocInfo.pSetLayouts = setLayouts;
+
+    VkResult result = vkAllocateDescriptorSets(deviceObj->device, &allocInfo, sets);
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY_KHR || result == VK_ERROR_FRAGMENTED_POOL) {
+        // Exhausted, continue in a fresh pool.
+        switchPool(chain);
+        allocInfo.descriptorPool = chain.currentPool;
+        result = vkAllocateDescriptorSets(deviceObj->device, &allocInfo, sets);
+    }
+    if (result == VK_SUCCESS) {
+        chain.setsAllocated += count;
+    }
+    return result;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(uint32_t frameSlot, VkDescriptorSetLayout layout, uint32_t workerIndex)
+{
+    VkDescriptorSet set;
+    VkResult result = allocateFromChain(getChain(frameSlot, workerIndex), &layout, 1, &set);
+    if (result != VK_SUCCESS) {
+        std::cout << "Descriptor set does not fit an empty pool, raise the pool ratios." << std::endl;
+    }
+    assert(result == VK_SUCCESS);
+    return set;
+}
+
+void DescriptorAllocator::allocate(uint32_t frameSlot, VkDescriptorSetLayout layout, uint32_t count, VkDescriptorSet* sets,
+    uint32_t workerIndex)
+{
+    PoolChain& chain = getChain(frameSlot, workerIndex);
+
+    // One call per batch that fits a pool, a batch larger than a fresh pool is split.
+    VkDescriptorSetLayout setLayouts[64];
+    const uint32_t maxBatch = sizeof(setLayouts) / sizeof(setLayouts[0]);
+    std::fill(setLayouts, setLayouts + std::min(count, maxBatch), layout);
+
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t batch = std::min(count - done, maxBatch);
+        VkResult result = allocateFromChain(chain, setLayouts, batch, sets + done);
+        if (result != VK_SUCCESS) {
+            // Not even a fresh pool holds the batch, fall back to single sets.
+            for (uint32_t i = 0; i < batch; i++) {
+                sets[done + i] = allocate(frameSlot, layout, workerIndex);
+            }
+        }
+        done += batch;
+    }
+}
+
+void DescriptorAllocator::update(VkDescriptorSet set, const DescriptorTemplate* descriptorTemplate, const void* data)
+{
+    if (descriptorTemplate->handle != VK_NULL_HANDLE) {
+        updateWithTemplateFn(deviceObj->device, set, descriptorTemplate->handle, data);
+    } else {
+        updateWithWrites(set, descriptorTemplate, data);
+    }
+}
+
+void DescriptorAllocator::updateWithWrites(VkDescriptorSet set, const DescriptorTemplate* descriptorTemplate, const void* data)
+{
+    std::vector<VkWriteDescriptorSet> writes;
+    writes.reserve(descriptorTemplate->entries.size());
+
+    for (size_t i = 0; i < descriptorTemplate->entries.size(); i++) {
+        const VkDescriptorUpdateTemplateEntryKHR& entry = descriptorTemplate->entries[i];
+
+        // Image and buffer infos have the same size on 64-bit platforms, the type picks the member.
+        size_t infoSize;
+        bool imageInfo = false;
+        bool texelBufferView = false;
+        switch (entry.descriptorType) {
+        case VK_DESCRIPTOR_TYPE_SAMPLER:
+        case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+        case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+        case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+        case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+            infoSize = sizeof(VkDescriptorImageInfo);
+            imageInfo = true;
+            break;
+        case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+        case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+            infoSize = sizeof(VkBufferView);
+            texelBufferView = true;
+            break;
+        default:
+            infoSize = sizeof(VkDescriptorBufferInfo);
+            break;
+        }
+
+        // Tightly packed infos go in one write, otherwise one write per element.
+        bool packed = entry.stride == infoSize || entry.descriptorCount == 1;
+        uint32_t writeCount = packed ? 1 : entry.descriptorCount;
+        for (uint32_t element = 0; element < writeCount; element++) {
+            const char* info = (const char*)data + entry.offset + element * entry.stride;
+
+            VkWriteDescriptorSet write = {};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.pNext = NULL;
+            write.dstSet = set;
+            write.dstBinding = entry.dstBinding;
+            write.dstArrayElement = entry.dstArrayElement + element;
+            write.descriptorCount = packed ? entry.descriptorCount : 1;
+            write.descriptorType = entry.descriptorType;
+            if (imageInfo) {
+                write.pImageInfo = (const VkDescriptorImageInfo*)info;
+            } else if (texelBufferView) {
+                write.pTexelBufferView = (const VkBufferView*)info;
+            } else {
+                write.pBufferInfo = (const VkDescriptorBufferInfo*)info;
+            }
+            writes.push_back(write);
+        }
+    }
+
+    vkUpdateDescriptorSets(deviceObj->device, (uint32_t)writes.size(), writes.data(), 0, NULL);
+}
+
+void DescriptorAllocator::resetFrame(uint32_t frameSlot)
+{
+    std::vector<VkDescriptorPool> releasedPools;
+    uint32_t resetCount = 0;
+    for (uint32_t worker = 0; worker < workerCount; worker++) {
+        PoolChain& chain = getChain(frameSlot, worker);
+
+        // The current pool stays with the chain, the exhausted ones go back to the free list.
+        if (chain.currentPool != VK_NULL_HANDLE) {
+            VkResult result = vkResetDescriptorPool(deviceObj->device, chain.currentPool, 0);
+            assert(result == VK_SUCCESS);
+            resetCount++;
+        }
+        for (size_t i = 0; i < chain.fullPools.size(); i++) {
+            VkResult result = vkResetDescriptorPool(deviceObj->device, chain.fullPools[i], 0);
+            assert(result == VK_SUCCESS);
+            releasedPools.push_back(chain.fullPools[i]);
+            resetCount++;
+        }
+        chain.fullPools.clear();
+    }
+
+    std::lock_guard<std::mutex> lock(poolMutex);
+    for (size_t i = 0; i < releasedPools.size(); i++) {
+        freePools.insert(std::make_pair(poolMaxSets[releasedPools[i]], releasedPools[i]));
+    }
+    poolResets += resetCount;
+}
+
+DescriptorAllocatorStats DescriptorAllocator::getStats()
+{
+    DescriptorAllocatorStats stats = {};
+    for (auto& chain : chains) {
+        stats.setsAllocated += chain.setsAllocated;
+    }
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        stats.poolsCreated = poolsCreated;
+        stats.poolResets = poolResets;
+    }
+    std::lock_guard<std::mutex> lock(layoutMutex);
+    stats.layoutsCreated = (uint32_t)layouts.size();
+    stats.layoutCacheHits = layoutCacheHits;
+    stats.templatesCreated = (uint32_t)templates.size();
+    return stats;
+}
+
+void DescriptorAllocator::printStats()
+{
+    DescriptorAllocatorStats stats = getStats();
+    std::cout << "Descriptor sets: " << stats.setsAllocated << " allocated from " << stats.poolsCreated << " pools, "
+              << stats.poolResets << " pool resets" << std::endl;
+    std::cout << "\tLayouts: " << stats.layoutsCreated << " created, " << stats.layoutCacheHits << " cache hits, "
+              << stats.templatesCreated << " update templates" << std::endl;
+}
@@ -0,0 +1,601 @@
+#include "DeviceBenchmarks.h"
+#include "VulkanApplication.h"
+#include "CommandBufferManager.h"
+#include "GpuCuller.h"
+#include "GpuProfiler.h"
+#include <chrono>
+
+// Milliseconds since 'start'.
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/***************SUBMISSION***************/
+// Submits per second of the blocking path, which waits for the queue to idle after every
+// submit, against the fence pool path with several submissions in flight, one per vkQueueSubmit
+// and batched. The command buffers are empty, the numbers are the cost of a submission.
+static bool benchmarkSubmit(VulkanApplication* appObj)
+{
+    const uint32_t submitCount = 4000;
+    const uint32_t inFlightCount = 8;
+    const uint32_t batchSize = 8;
+    VulkanDevice* deviceObj = appObj->deviceObj;
+    VkQueue queue = deviceObj->queue;
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = deviceObj->graphicsQueueIndex;
+    VkCommandPool cmdPool;
+    VkResult result = vkCreateCommandPool(deviceObj->device, &poolInfo, NULL, &cmdPool);
+    assert(result == VK_SUCCESS);
+
+    // Recorded once, a command buffer is submitted again once its previous submission completed.
+    VkCommandBufferAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocateInfo.commandPool = cmdPool;
+    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocateInfo.commandBufferCount = inFlightCount * batchSize;
+    std::vector<VkCommandBuffer> cmdBuffers(allocateInfo.commandBufferCount);
+    CommandBufferMgr::allocCommandBuffer(&deviceObj->device, cmdPool, cmdBuffers.data(), &allocateInfo,
+        deviceObj->debugUtils, "Submit benchmark command buffer");
+    for (VkCommandBuffer cmdBuffer : cmdBuffers) {
+        CommandBufferMgr::beginCommandBuffer(cmdBuffer);
+        CommandBufferMgr::endCommandBuffer(cmdBuffer);
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < submitCount; i++) {
+        CommandBufferMgr::submitCommandBuffer(queue, &cmdBuffers[i % inFlightCount]);
+    }
+    double blockingRate = submitCount / (elapsedMs(start) / 1000.0);
+
+    FencePool fencePool;
+    fencePool.createFencePool(deviceObj->device, inFlightCount, deviceObj->debugUtils, "Submit benchmark fence");
+    std::vector<SubmitToken> tokens(inFlightCount);
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < submitCount; i++) {
+        SubmitToken& token = tokens[i % inFlightCount];
+        fencePool.wait(token);
+        token = CommandBufferMgr::submitCommandBufferAsync(queue, fencePool, &cmdBuffers[i % inFlightCount]);
+        fencePool.retireCompleted();
+    }
+    fencePool.wait(tokens[(submitCount - 1) % inFlightCount]);
+    double asyncRate = submitCount / (elapsedMs(start) / 1000.0);
+
+    // 'batchSize' submit infos of one command buffer each go in one vkQueueSubmit.
+    std::vector<VkSubmitInfo> submitInfos(batchSize);
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < submitCount; i += batchSize) {
+        uint32_t slot = (i / batchSize) % inFlightCount;
+        fencePool.wait(tokens[slot]);
+        for (uint32_t j = 0; j < batchSize; j++) {
+            submitInfos[j] = {};
+            submitInfos[j].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfos[j].commandBufferCount = 1;
+            submitInfos[j].pCommandBuffers = &cmdBuffers[slot * batchSize + j];
+        }
+        tokens[slot] = CommandBufferMgr::submitCommandBufferBatch(queue, fencePool, submitInfos.data(), batchSize);
+        fencePool.retireCompleted();
+    }
+    vkQueueWaitIdle(queue);
+    double batchedRate = submitCount / (elapsedMs(start) / 1000.0);
+
+    bool passed = fencePool.retireCompleted() == fencePool.lastSubmittedSerial();
+    fencePool.destroyFencePool();
+    vkDestroyCommandPool(deviceObj->device, cmdPool, NULL);
+
+    std::cout << "Submit benchmark, " << submitCount << " command buffers:" << std::endl;
+    std::cout << "\tblocking: " << blockingRate << " submits/s" << std::endl;
+    std::cout << "\tfence pool, " << inFlightCount << " in flight: " << asyncRate << " submits/s ("
+              << asyncRate / blockingRate << "x blocking)" << std::endl;
+    std::cout << "\tfence pool, batches of " << batchSize << ": " << batchedRate << " command buffers/s ("
+              << batchedRate / blockingRate << "x blocking)" << std::endl;
+    return passed;
+}
+
+/***************FRAME LOOP***************/
+// Frames per second of the headless frame loop with the context's frames in flight (--frames,
+// default 1000, and --frames-in-flight). The frames clear and read back the offscreen image.
+static bool benchmarkFrames(VulkanApplication* appObj)
+{
+    uint64_t frameCount = appObj->frameLimit ? appObj->frameLimit : 1000;
+    appObj->frameLimit = frameCount;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool isWindowOpen = true;
+    while (isWindowOpen) {
+        appObj->update();
+        isWindowOpen = appObj->render();
+    }
+    double ms = elapsedMs(start);
+
+    const FramePacingStats& stats = appObj->frameScheduler.getStats();
+    std::cout << "Frame benchmark, " << frameCount << " frames, " << appObj->frameScheduler.getFramesInFlight()
+              << " in flight: " << frameCount / (ms / 1000.0) << " frames/s" << std::endl;
+    std::cout << "	CPU record time: " << stats.cpuRecordMs << " ms"
+              << ", submit to complete: " << stats.submitToCompleteMs << " ms" << std::endl;
+    return stats.framesSubmitted == frameCount;
+}
+
+/***************PIPELINE CACHE***************/
+// Compiles the same set of pipelines cold, with no cache file, and warm, from the file the cold
+// run saved, each time through a fresh PipelineManager. The pipelines are the culling shader with
+// every workgroup size from 1 to 64 and both compaction modes.
+static bool benchmarkPipelines(VulkanApplication* appObj)
+{
+    const uint32_t maxWorkgroupSize = 64;
+    const char* cachePath = "pipeline_benchmark_cache.bin";
+    VulkanDevice* deviceObj = appObj->deviceObj;
+
+    // Only the layout of this kernel is used, it matches the bindings and push constants of the shader.
+    ComputeKernelDesc desc;
+    desc.spirvPath = GpuCuller::DEFAULT_SHADER_PATH;
+    desc.entryPoint = "main";
+    desc.storageBufferCount = 4;
+    desc.pushConstantSize = 6 * 4 * sizeof(float) + sizeof(uint32_t); // Frustum planes and object count.
+    desc.dimensions = 1;
+    const ComputeKernel* kernel = appObj->computeEngine.createKernel(desc);
+    VkShaderModule module = appObj->computeEngine.loadShaderModule(desc.spirvPath);
+    if (!kernel || !module) {
+        std::cout << "Pipeline benchmark needs " << desc.spirvPath << std::endl;
+        return false;
+    }
+
+    std::remove(cachePath);
+    PipelineCacheStats runStats[2];
+    for (uint32_t run = 0; run < 2; run++) {
+        PipelineManager pipelineMgr;
+        pipelineMgr.createPipelineManager(deviceObj, cachePath);
+        for (uint32_t size = 1; size <= maxWorkgroupSize; size++) {
+            for (VkBool32 compact = VK_FALSE; compact <= VK_TRUE; compact++) {
+                SpecializationConstants constants;
+                constants.set(ComputeEngine::WORKGROUP_SIZE_X_ID, size);
+                constants.set(ComputeEngine::WORKGROUP_SIZE_Y_ID, 1u);
+                constants.set(ComputeEngine::WORKGROUP_SIZE_Z_ID, 1u);
+                constants.set(GpuCuller::COMPACT_CONSTANT_ID, compact);
+                VkSpecializationInfo specializationInfo = constants.getInfo();
+
+                VkComputePipelineCreateInfo pipelineInfo = {};
+                pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+                pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+                pipelineInfo.stage.module = module;
+                pipelineInfo.stage.pName = desc.entryPoint.c_str();
+                pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+                pipelineInfo.layout = kernel->pipelineLayout;
+                pipelineInfo.basePipelineIndex = -1;
+                VkPipeline pipeline;
+                if (pipelineMgr.getComputePipeline(pipelineInfo, &pipeline) != VK_SUCCESS) {
+                    pipelineMgr.destroyPipelineManager();
+                    return false;
+                }
+            }
+        }
+        pipelineMgr.saveCache();
+        runStats[run] = pipelineMgr.getStats();
+        pipelineMgr.destroyPipelineManager();
+    }
+    std::remove(cachePath);
+
+    const PipelineCacheStats& cold = runStats[0];
+    const PipelineCacheStats& warm = runStats[1];
+    std::cout << "Pipeline benchmark, " << cold.misses << " compute pipelines:" << std::endl;
+    std::cout << "\tcold: " << cold.createMs << " ms to create, " << cold.savedBytes << " bytes saved" << std::endl;
+    std::cout << "\twarm: " << warm.createMs << " ms to create (" << cold.createMs / std::max(warm.createMs, 1e-3)
+              << "x faster), " << warm.loadMs << " ms to load " << warm.loadedBytes << " bytes" << std::endl;
+    return cold.loadedBytes == 0 && warm.loadedBytes > 0;
+}
+
+/***************DESCRIPTORS***************/
+// Sets allocated and written per second, 20000 a frame, through a DescriptorAllocator, one set
+// per call and in batches, against a naive pool with FREE_DESCRIPTOR_SET_BIT where every set is
+// allocated, written with vkUpdateDescriptorSets and freed on its own. The sets hold a uniform
+// and a storage buffer, nothing is submitted.
+static bool benchmarkDescriptors(VulkanApplication* appObj)
+{
+    const uint32_t setsPerFrame = 20000;
+    const uint32_t frameCount = 10;
+    const uint32_t frameSlotCount = 2;
+    VulkanDevice* deviceObj = appObj->deviceObj;
+    VkDevice device = deviceObj->device;
+
+    VkBufferCreateInfo bufInfo = {};
+    bufInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufInfo.size = 256;
+    bufInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkBuffer buffer;
+    VkResult result = vkCreateBuffer(device, &bufInfo, NULL, &buffer);
+    assert(result == VK_SUCCESS);
+    MemoryAllocation allocation;
+    result = deviceObj->memoryAllocator.allocateForBuffer(buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ALLOCATION_STRATEGY_FREE_LIST, &allocation);
+    assert(result == VK_SUCCESS);
+
+    std::vector<DescriptorPoolRatio> ratios(2);
+    ratios[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    ratios[0].descriptorsPerSet = 1.0f;
+    ratios[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    ratios[1].descriptorsPerSet = 1.0f;
+
+    DescriptorAllocator allocator;
+    allocator.createDescriptorAllocator(deviceObj, frameSlotCount, 1, ratios);
+    std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+    for (uint32_t i = 0; i < 2; i++) {
+        bindings[i] = {};
+        bindings[i].binding = i;
+        bindings[i].descriptorType = ratios[i].type;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+    }
+    VkDescriptorSetLayout layout = allocator.getLayout(bindings);
+
+    // Both buffer infos in one block, as the template reads them.
+    VkDescriptorBufferInfo bufferInfos[2];
+    std::vector<VkDescriptorUpdateTemplateEntryKHR> entries(2);
+    for (uint32_t i = 0; i < 2; i++) {
+        bufferInfos[i].buffer = buffer;
+        bufferInfos[i].offset = 0;
+        bufferInfos[i].range = VK_WHOLE_SIZE;
+        entries[i].dstBinding = i;
+        entries[i].dstArrayElement = 0;
+        entries[i].descriptorCount = 1;
+        entries[i].descriptorType = ratios[i].type;
+        entries[i].offset = i * sizeof(VkDescriptorBufferInfo);
+        entries[i].stride = sizeof(VkDescriptorBufferInfo);
+    }
+    const DescriptorTemplate* descriptorTemplate = allocator.createTemplate(layout, entries);
+
+    // The first frame of each slot grows its pool chain, it is not timed.
+    std::vector<VkDescriptorSet> sets(setsPerFrame);
+    double allocatorMs[2] = { 0.0, 0.0 };
+    for (uint32_t batched = 0; batched < 2; batched++) {
+        for (uint32_t frame = 0; frame < frameCount + frameSlotCount; frame++) {
+            uint32_t slot = frame % frameSlotCount;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            allocator.resetFrame(slot);
+            if (batched) {
+                allocator.allocate(slot, layout, setsPerFrame, sets.data());
+            } else {
+                for (uint32_t i = 0; i < setsPerFrame; i++) {
+                    sets[i] = allocator.allocate(slot, layout);
+                }
+            }
+            for (uint32_t i = 0; i < setsPerFrame; i++) {
+                allocator.update(sets[i], descriptorTemplate, bufferInfos);
+            }
+            if (frame >= frameSlotCount) {
+                allocatorMs[batched] += elapsedMs(start);
+            }
+        }
+    }
+    DescriptorAllocatorStats stats = allocator.getStats();
+    bool templates = allocator.hasUpdateTemplates();
+    allocator.destroyDescriptorAllocator();
+
+    VkDescriptorPoolSize poolSizes[2];
+    for (uint32_t i = 0; i < 2; i++) {
+        poolSizes[i].type = ratios[i].type;
+        poolSizes[i].descriptorCount = setsPerFrame;
+    }
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    poolInfo.maxSets = setsPerFrame;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    VkDescriptorPool naivePool;
+    result = vkCreateDescriptorPool(device, &poolInfo, NULL, &naivePool);
+    assert(result == VK_SUCCESS);
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings.data();
+    VkDescriptorSetLayout naiveLayout;
+    result = vkCreateDescriptorSetLayout(device, &layoutInfo, NULL, &naiveLayout);
+    assert(result == VK_SUCCESS);
+
+    bool naivePassed = true;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frameCount; frame++) {
+        for (uint32_t i = 0; i < setsPerFrame; i++) {
+            VkDescriptorSetAllocateInfo allocInfo = {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            allocInfo.descriptorPool = naivePool;
+            allocInfo.descriptorSetCount = 1;
+            allocInfo.pSetLayouts = &naiveLayout;
+            naivePassed = vkAllocateDescriptorSets(device, &allocInfo, &sets[i]) == VK_SUCCESS && naivePassed;
+
+            VkWriteDescriptorSet writes[2] = {};
+            for (uint32_t j = 0; j < 2; j++) {
+                writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[j].dstSet = sets[i];
+                writes[j].dstBinding = j;
+                writes[j].descriptorCount = 1;
+                writes[j].descriptorType = ratios[j].type;
+                writes[j].pBufferInfo = &bufferInfos[j];
+            }
+            vkUpdateDescriptorSets(device, 2, writes, 0, NULL);
+        }
+        for (uint32_t i = 0; i < setsPerFrame; i++) {
+            vkFreeDescriptorSets(device, naivePool, 1, &sets[i]);
+        }
+    }
+    double naiveMs = elapsedMs(start);
+
+    vkDestroyDescriptorSetLayout(device, naiveLayout, NULL);
+    vkDestroyDescriptorPool(device, naivePool, NULL);
+    vkDestroyBuffer(device, buffer, NULL);
+    deviceObj->memoryAllocator.free(allocation);
+
+    double setCount = (double)setsPerFrame * frameCount;
+    double naiveRate = setCount / (naiveMs / 1000.0);
+    std::cout << "Descriptor benchmark, " << setsPerFrame << " sets a frame, written with "
+              << (templates ? "update templates" : "vkUpdateDescriptorSets") << ":" << std::endl;
+    std::cout << "	free per set: " << naiveRate << " sets/s" << std::endl;
+    for (uint32_t batched = 0; batched < 2; batched++) {
+        double rate = setCount / (allocatorMs[batched] / 1000.0);
+        std::cout << "	allocator, " << (batched ? "batched" : "one per call") << ": " << rate << " sets/s ("
+                  << rate / naiveRate << "x free per set)" << std::endl;
+    }
+    std::cout << "	" << stats.poolsCreated << " pools created, " << stats.poolResets << " resets" << std::endl;
+    return naivePassed && stats.setsAllocated == 2 * (uint64_t)setsPerFrame * (frameCount + frameSlotCount);
+}
+
+/***************REDUCTION***************/
+// Bytes per second summed by shaders/reduce.comp on the compute engine, 16M uints reduced in two
+// dispatches, 20 reductions a batch. The values are host visible, device local if the device has
+// such memory, and every result is checked against the sum computed on the CPU.
+static bool benchmarkReduce(VulkanApplication* appObj)
+{
+    const uint32_t valueCount = 1 << 24;
+    const uint32_t valuesPerInvocation = 16;
+    const uint32_t reductionCount = 20;
+    VulkanDevice* deviceObj = appObj->deviceObj;
+    ComputeEngine& computeEngine = appObj->computeEngine;
+
+    ComputeKernelDesc desc;
+    desc.spirvPath = "shaders/reduce.comp.spv";
+    desc.entryPoint = "main";
+    desc.storageBufferCount = 2;
+    desc.pushConstantSize = sizeof(uint32_t);
+    desc.dimensions = 1;
+    const ComputeKernel* kernel = computeEngine.createKernel(desc);
+    if (!kernel) {
+        std::cout << "Reduction benchmark needs " << desc.spirvPath << std::endl;
+        return false;
+    }
+
+    // Enough workgroups for each invocation to sum a few values, few enough for one workgroup to sum the partials.
+    uint32_t workgroupSize = kernel->workgroupSize[0];
+    uint32_t groupCount = (valueCount + workgroupSize * valuesPerInvocation - 1) / (workgroupSize * valuesPerInvocation);
+    groupCount = std::min(groupCount, deviceObj->gpuProps.limits.maxComputeWorkGroupCount[0]);
+
+    VkBuffer buffers[3];
+    MemoryAllocation allocations[3];
+    const VkDeviceSize sizes[3] = { valueCount * sizeof(uint32_t), groupCount * sizeof(uint32_t), sizeof(uint32_t) };
+    // Values and result are written and read by the host, the partial sums stay on the device.
+    const VkMemoryPropertyFlags hostFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    const VkMemoryPropertyFlags requiredFlags[3] = { hostFlags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, hostFlags };
+    const VkMemoryPropertyFlags preferredFlags[3] = { hostFlags | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, 0 };
+    for (uint32_t i = 0; i < 3; i++) {
+        VkBufferCreateInfo bufInfo = {};
+        bufInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufInfo.size = sizes[i];
+        bufInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        bufInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        VkResult result = vkCreateBuffer(deviceObj->device, &bufInfo, NULL, &buffers[i]);
+        assert(result == VK_SUCCESS);
+
+        result = VK_ERROR_FEATURE_NOT_PRESENT;
+        if (preferredFlags[i]) {
+            result = deviceObj->memoryAllocator.allocateForBuffer(buffers[i], preferredFlags[i], ALLOCATION_STRATEGY_FREE_LIST, &allocations[i]);
+        }
+        if (result != VK_SUCCESS) {
+            result = deviceObj->memoryAllocator.allocateForBuffer(buffers[i], requiredFlags[i], ALLOCATION_STRATEGY_FREE_LIST, &allocations[i]);
+        }
+        assert(result == VK_SUCCESS);
+    }
+
+    uint32_t* values = (uint32_t*)allocations[0].mappedData;
+    uint64_t expected = 0;
+    for (uint32_t i = 0; i < valueCount; i++) {
+        values[i] = i & 0xff;
+        expected += values[i];
+    }
+    volatile uint32_t* sum = (volatile uint32_t*)allocations[2].mappedData;
+
+    VkDescriptorBufferInfo firstPass[2] = { { buffers[0], 0, sizes[0] }, { buffers[1], 0, sizes[1] } };
+    VkDescriptorBufferInfo secondPass[2] = { { buffers[1], 0, sizes[1] }, { buffers[2], 0, sizes[2] } };
+
+    // One reduction on its own for the latency, then a batch of them for the throughput.
+    bool passed = true;
+    double latencyMs = 0.0;
+    double batchMs = 0.0;
+    for (uint32_t run = 0; run < 2; run++) {
+        uint32_t count = run ? reductionCount : 1;
+        *sum = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < count; i++) {
+            computeEngine.dispatch(kernel, firstPass, &valueCount, groupCount);
+            computeEngine.barrier();
+            computeEngine.dispatch(kernel, secondPass, &groupCount, 1);
+            computeEngine.barrier();
+        }
+        passed = computeEngine.wait(computeEngine.submit()) == VK_SUCCESS && passed;
+        if (run) {
+            batchMs = elapsedMs(start);
+        } else {
+            latencyMs = elapsedMs(start);
+        }
+        if (*sum != expected) {
+            std::cout << "Reduction result " << *sum << ", expected " << expected << std::endl;
+            passed = false;
+        }
+    }
+
+    for (uint32_t i = 0; i < 3; i++) {
+        vkDestroyBuffer(deviceObj->device, buffers[i], NULL);
+        deviceObj->memoryAllocator.free(allocations[i]);
+    }
+
+    double gigabytes = (double)sizes[0] / (1024.0 * 1024.0 * 1024.0);
+    std::cout << "Reduction benchmark, " << valueCount << " uints, " << groupCount << " workgroups of " << workgroupSize << ":" << std::endl;
+    std::cout << "	one reduction: " << latencyMs << " ms, submit to result" << std::endl;
+    std::cout << "	" << reductionCount << " a batch: " << gigabytes * reductionCount / (batchMs / 1000.0) << " GB/s" << std::endl;
+    return passed;
+}
+
+/***************CULLING***************/
+// Frustum culling of 100k objects of the generated scene: shaders/cull.comp through GpuCuller,
+// one culling pass on its own for the latency and 20 in one command buffer for the throughput,
+// against GpuCuller::cullOnCpu() writing the same compacted commands. The visible counts of
+// both have to agree. The GPU time comes from timestamps around the dispatches, the record
+// time from the recordCulling() loop alone.
+static bool benchmarkCulling(VulkanApplication* appObj)
+{
+    const uint32_t objectCount = 100000;
+    const uint32_t cullCount = 20;
+    VulkanDevice* deviceObj = appObj->deviceObj;
+    if (!GpuCuller::isSupported(deviceObj)) {
+        std::cout << "Culling benchmark needs drawIndirectFirstInstance" << std::endl;
+        return false;
+    }
+
+    std::vector<CullDraw> draws;
+    std::vector<CullObject> objects;
+    GpuCuller::buildTestScene(objectCount, draws, objects);
+    float planes[6][4];
+    GpuCuller::cameraFrustum(0.0f, 16.0f / 9.0f, GpuCuller::testSceneExtent(objectCount) * 2.0f, planes);
+
+    std::vector<VkDrawIndexedIndirectCommand> commands;
+    commands.reserve(objectCount);
+    uint32_t cpuVisible = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < cullCount; i++) {
+        commands.clear();
+        cpuVisible = GpuCuller::cullOnCpu(draws, objects, planes, commands);
+    }
+    double cpuMs = elapsedMs(start) / cullCount;
+
+    // Frame slot 0 of the context's descriptor allocator, no frame is in flight.
+    GpuCuller culler;
+    if (!culler.createGpuCuller(deviceObj, &appObj->computeEngine, &appObj->descriptorAllocator, &appObj->stagingRing, 1)) {
+        std::cout << "Culling benchmark needs " << GpuCuller::DEFAULT_SHADER_PATH << std::endl;
+        return false;
+    }
+    culler.setScene(draws, objects);
+    appObj->stagingRing.flush(); // On the queue the culling passes are submitted to.
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = deviceObj->graphicsQueueIndex;
+    VkCommandPool cmdPool;
+    VkResult result = vkCreateCommandPool(deviceObj->device, &poolInfo, NULL, &cmdPool);
+    assert(result == VK_SUCCESS);
+    VkCommandBuffer cmdBuffer;
+    CommandBufferMgr::allocCommandBuffer(&deviceObj->device, cmdPool, &cmdBuffer, NULL, deviceObj->debugUtils, "Culling benchmark command buffer");
+
+    GpuProfiler profiler;
+    profiler.createProfiler(deviceObj, 1, deviceObj->graphicsQueueIndex);
+
+    bool passed = true;
+    double latencyMs = 0.0;
+    double recordMs = 0.0;
+    for (uint32_t run = 0; run < 2; run++) {
+        uint32_t count = run ? cullCount : 1;
+        std::chrono::steady_clock::time_point submitStart = std::chrono::steady_clock::now();
+        CommandBufferMgr::beginCommandBuffer(cmdBuffer);
+        profiler.beginFrame(0, cmdBuffer);
+        {
+            GpuProfileScope scope(&profiler, cmdBuffer, run ? "Batched culling" : "Single culling");
+            start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < count; i++) {
+                culler.recordCulling(cmdBuffer, 0, planes);
+            }
+            if (run) {
+                recordMs = elapsedMs(start) / count;
+            }
+        }
+        CommandBufferMgr::endCommandBuffer(cmdBuffer);
+        CommandBufferMgr::submitCommandBuffer(deviceObj->queue, &cmdBuffer);
+        if (!run) {
+            latencyMs = elapsedMs(submitStart);
+        }
+
+        // Float rounding may differ between the shader and the CPU for spheres touching a plane.
+        culler.beginFrame(0);
+        uint32_t gpuVisible = culler.getStats().lastVisibleDraws;
+        if (std::max(gpuVisible, cpuVisible) - std::min(gpuVisible, cpuVisible) > cpuVisible / 1000) {
+            std::cout << "GPU culling kept " << gpuVisible << " objects, the CPU " << cpuVisible << std::endl;
+            passed = false;
+        }
+        appObj->descriptorAllocator.resetFrame(0);
+    }
+
+    // Both submits waited for the queue, every timestamp is available.
+    profiler.collectAll();
+    bool timestamps = profiler.isEnabled();
+    double singleGpuMs = 0.0;
+    double batchGpuMs = 0.0;
+    for (const GpuScopeStats& stats : profiler.getStats()) {
+        if (stats.name == "Single culling") {
+            singleGpuMs = stats.avgMs;
+        } else if (stats.name == "Batched culling") {
+            batchGpuMs = stats.avgMs / cullCount;
+        }
+    }
+    profiler.destroyProfiler();
+    vkDestroyCommandPool(deviceObj->device, cmdPool, NULL);
+    culler.destroyGpuCuller();
+
+    std::cout << "Culling benchmark, " << objectCount << " objects, " << cpuVisible << " visible:" << std::endl;
+    std::cout << "	CPU: " << cpuMs << " ms per pass" << std::endl;
+    std::cout << "	record: " << recordMs << " ms per pass" << std::endl;
+    std::cout << "	one pass: " << latencyMs << " ms, record to result" << std::endl;
+    if (timestamps) {
+        std::cout << "	GPU, one pass: " << singleGpuMs << " ms" << std::endl;
+        std::cout << "	GPU, " << cullCount << " a submit: " << batchGpuMs << " ms per pass (" << cpuMs / batchGpuMs
+                  << "x the CPU)" << std::endl;
+    } else {
+        std::cout << "	GPU: no timestamps on the graphics queue" << std::endl;
+    }
+    return passed;
+}
+
+struct NamedBenchmark {
+    const char* name;
+    DeviceBenchmarks::BenchmarkFunction function;
+};
+
+static const NamedBenchmark benchmarks[] = {
+    { "submit", benchmarkSubmit },
+    { "frames", benchmarkFrames },
+    { "pipelines", benchmarkPipelines },
+    { "descriptors", benchmarkDescriptors },
+    { "reduce", benchmarkReduce },
+    { "culling", benchmarkCulling }
+};
+
+bool DeviceBenchmarks::run(VulkanApplication* appObj, const std::string& name)
+{
+    for (const NamedBenchmark& benchmark : benchmarks) {
+        if (name == benchmark.name) {
+            bool passed = benchmark.function(appObj);
+            std::cout << "Benchmark " << name << (passed ? " passed" : " FAILED") << std::endl;
+            return passed;
+        }
+    }
+    std::cout << "Unknown benchmark " << name << ", the benchmarks are:";
+    printNames();
+    return false;
+}
+
+void DeviceBenchmarks::printNames()
+{
+    for (const NamedBenchmark& benchmark : benchmarks) {
+        std::cout << " " << benchmark.name;
+    }
+    std::cout << std::endl;
+}
@@ -0,0 +1,164 @@
+#include "DeviceSelector.h"
+
+static uint32_t deviceTypeRank(VkPhysicalDeviceType deviceType)
+{
+    switch (deviceType) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        return 4;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        return 3;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        return 2;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static const char* deviceTypeName(VkPhysicalDeviceType deviceType)
+{
+    switch (deviceType) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        return "discrete";
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        return "integrated";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        return "virtual";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        return "cpu";
+    default:
+        return "other";
+    }
+}
+
+// Lexicographic: suitability, type, memory, queues, API version. Lower index wins ties.
+bool DeviceScore::betterThan(const DeviceScore& other) const
+{
+    if (suitable != other.suitable)
+        return suitable;
+    if (typeRank != other.typeRank)
+        return typeRank > other.typeRank;
+    if (deviceLocalBytes != other.deviceLocalBytes)
+        return deviceLocalBytes > other.deviceLocalBytes;
+    if (dedicatedQueueFamilies != other.dedicatedQueueFamilies)
+        return dedicatedQueueFamilies > other.dedicatedQueueFamilies;
+    if (apiVersion != other.apiVersion)
+        return apiVersion > other.apiVersion;
+    return gpuIndex < other.gpuIndex;
+}
+
+void DeviceSelector::queryCandidate(VkPhysicalDevice gpu, uint32_t gpuIndex, DeviceCandidate& candidate)
+{
+    candidate.gpuIndex = gpuIndex;
+    vkGetPhysicalDeviceProperties(gpu, &candidate.properties);
+    vkGetPhysicalDeviceMemoryProperties(gpu, &candidate.memoryProperties);
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queueFamilyCount, NULL);
+    candidate.queueFamilies.resize(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queueFamilyCount, candidate.queueFamilies.data());
+
+    candidate.hasRequiredExtensions = true;
+}
+
+DeviceScore DeviceSelector::scoreDevice(const DeviceCandidate& candidate, const DeviceSelectionPolicy& policy)
+{
+    DeviceScore score = {};
+    score.gpuIndex = candidate.gpuIndex;
+    score.apiVersion = candidate.properties.apiVersion;
+    score.typeRank = deviceTypeRank(candidate.properties.deviceType);
+
+    // Preferred vendors rank above every other device type.
+    if (policy.preferredVendorID && candidate.properties.vendorID == policy.preferredVendorID) {
+        score.typeRank += 8;
+    }
+
+    for (uint32_t i = 0; i < candidate.memoryProperties.memoryHeapCount; i++) {
+        const VkMemoryHeap& heap = candidate.memoryProperties.memoryHeaps[i];
+        if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            score.deviceLocalBytes = std::max(score.deviceLocalBytes, heap.size);
+        }
+    }
+
+    for (size_t i = 0; i < candidate.queueFamilies.size(); i++) {
+        VkQueueFlags flags = candidate.queueFamilies[i].queueFlags;
+        if (candidate.queueFamilies[i].queueCount == 0) {
+            continue;
+        }
+        if (!(flags & VK_QUEUE_GRAPHICS_BIT) && ((flags & VK_QUEUE_COMPUTE_BIT) || (flags & VK_QUEUE_TRANSFER_BIT))) {
+            score.dedicatedQueueFamilies++;
+        }
+    }
+
+    score.suitable = getRejectionReason(candidate, policy) == NULL;
+    return score;
+}
+
+const char* DeviceSelector::getRejectionReason(const DeviceCandidate& candidate, const DeviceSelectionPolicy& policy)
+{
+    if (!policy.allowCpuDevices && candidate.properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU) {
+        return "CPU devices not allowed";
+    }
+    if (!candidate.hasRequiredExtensions) {
+        return "missing required extensions";
+    }
+    for (size_t i = 0; i < candidate.queueFamilies.size(); i++) {
+        if (candidate.queueFamilies[i].queueCount && (candidate.queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+            return NULL;
+        }
+    }
+    return "no graphics queue";
+}
+
+std::vector<uint32_t> DeviceSelector::rankDevices(const std::vector<DeviceCandidate>& candidates, const DeviceSelectionPolicy& policy)
+{
+    std::vector<DeviceScore> scores;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        DeviceScore score = scoreDevice(candidates[i], policy);
+        if (score.suitable) {
+            scores.push_back(score);
+        }
+    }
+
+    std::sort(scores.begin(), scores.end(), [](const DeviceScore& a, const DeviceScore& b) { return a.betterThan(b); });
+
+    std::vector<uint32_t> ranking;
+    for (size_t i = 0; i < scores.size(); i++) {
+        ranking.push_back(scores[i].gpuIndex);
+    }
+
+    // A forced device goes first, as long as it can run the application at all.
+    if (policy.forcedGpuIndex >= 0) {
+        std::vector<uint32_t>::iterator forced = std::find(ranking.begin(), ranking.end(), (uint32_t)policy.forcedGpuIndex);
+        if (forced != ranking.end()) {
+            std::rotate(ranking.begin(), forced, forced + 1);
+        } else {
+            std::cout << "Requested GPU " << policy.forcedGpuIndex << " is not usable, falling back to the ranking" << std::endl;
+        }
+    }
+    return ranking;
+}
+
+void DeviceSelector::printRanking(const std::vector<DeviceCandidate>& candidates, const DeviceSelectionPolicy& policy)
+{
+    std::vector<uint32_t> ranking = rankDevices(candidates, policy);
+
+    std::cout << "\nPhysical devices" << std::endl;
+    std::cout << "===================" << std::endl;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        const DeviceCandidate& candidate = candidates[i];
+        DeviceScore score = scoreDevice(candidate, policy);
+        std::vector<uint32_t>::iterator rank = std::find(ranking.begin(), ranking.end(), candidate.gpuIndex);
+
+        std::cout << "[" << candidate.gpuIndex << "] " << candidate.properties.deviceName
+                  << " (" << deviceTypeName(candidate.properties.deviceType) << ", "
+                  << score.deviceLocalBytes / (1024 * 1024) << " MB device local, "
+                  << score.dedicatedQueueFamilies << " dedicated queue families) ";
+        if (rank != ranking.end()) {
+            std::cout << "rank " << (rank - ranking.begin()) << std::endl;
+        } else {
+            std::cout << getRejectionReason(candidate, policy) << std::endl;
+        }
+    }
+}
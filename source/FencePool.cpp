@@ -0,0 +1,202 @@
+#include "FencePool.h"
+#include "DebugUtils.h"
+
+FencePool::FencePool()
+{
+    device = VK_NULL_HANDLE;
+    debugUtils = NULL;
+    nextSerial = 1;
+    completedSerial = 0;
+}
+
+FencePool::~FencePool()
+{
+}
+
+void FencePool::createFencePool(const VkDevice& inDevice, uint32_t initialFenceCount, const DebugUtils* inDebugUtils,
+    const char* name)
+{
+    device = inDevice;
+    debugUtils = inDebugUtils;
+    fenceName = name;
+
+    // Pre-create a few fences so that the first submissions do not hit the driver.
+    for (uint32_t i = 0; i < initialFenceCount; i++) {
+        freeFences.push_back(createFence());
+    }
+}
+
+void FencePool::destroyFencePool()
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+
+    for (auto& inFlight : inFlightFences) {
+        if (!inFlight.released) {
+            VkResult result = vkWaitForFences(device, 1, &inFlight.fence, VK_TRUE, UINT64_MAX);
+            assert(result == VK_SUCCESS);
+        }
+        vkDestroyFence(device, inFlight.fence, NULL);
+    }
+    inFlightFences.clear();
+
+    for (auto fence : freeFences) {
+        vkDestroyFence(device, fence, NULL);
+    }
+    freeFences.clear();
+
+    completedSerial = nextSerial - 1;
+}
+
+VkFence FencePool::createFence()
+{
+    VkFenceCreateInfo fenceCreateInfo = {};
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceCreateInfo.pNext = NULL;
+    fenceCreateInfo.flags = 0;
+
+    VkFence fence;
+    VkResult result = vkCreateFence(device, &fenceCreateInfo, NULL, &fence);
+    assert(result == VK_SUCCESS);
+    if (debugUtils) {
+        debugUtils->setObjectName(device, VK_OBJECT_TYPE_FENCE, fence, fenceName.c_str());
+    }
+    return fence;
+}
+
+VkFence FencePool::acquireFence(SubmitToken* token)
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+
+    // Try to recycle finished fences before growing the pool.
+    if (freeFences.empty()) {
+        retireCompletedLocked();
+    }
+
+    VkFence fence;
+    if (freeFences.empty()) {
+        fence = createFence();
+    } else {
+        fence = freeFences.back();
+        freeFences.pop_back();
+    }
+
+    InFlightFence inFlight;
+    inFlight.fence = fence;
+    inFlight.serial = nextSerial++;
+    inFlight.waiters = 0;
+    inFlight.released = false;
+    inFlightFences.push_back(inFlight);
+
+    token->serial = inFlight.serial;
+    return fence;
+}
+
+void FencePool::releaseFence(const SubmitToken& token)
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+
+    for (auto& inFlight : inFlightFences) {
+        if (inFlight.serial == token.serial) {
+            inFlight.released = true;
+            break;
+        }
+    }
+    retireCompletedLocked();
+}
+
+bool FencePool::isComplete(const SubmitToken& token)
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+
+    if (token.serial <= completedSerial) {
+        return true;
+    }
+
+    // Submissions on different queues may finish out of order,
+    // so check the fence of this particular serial.
+    for (auto& inFlight : inFlightFences) {
+        if (inFlight.serial == token.serial) {
+            return inFlight.released || vkGetFenceStatus(device, inFlight.fence) == VK_SUCCESS;
+        }
+    }
+    return false;
+}
+
+VkResult FencePool::wait(const SubmitToken& token, uint64_t timeout)
+{
+    VkFence fence = VK_NULL_HANDLE;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (token.serial <= completedSerial) {
+            return VK_SUCCESS;
+        }
+
+        // The waiter count keeps the fence from being retired and handed out to another
+        // submission while the lock is released for the wait.
+        for (auto& inFlight : inFlightFences) {
+            if (inFlight.serial == token.serial && !inFlight.released) {
+                inFlight.waiters++;
+                fence = inFlight.fence;
+                break;
+            }
+        }
+    }
+    if (fence == VK_NULL_HANDLE) {
+        return VK_SUCCESS;
+    }
+
+    // Other threads keep acquiring fences and polling while this one blocks.
+    VkResult result = vkWaitForFences(device, 1, &fence, VK_TRUE, timeout);
+
+    std::lock_guard<std::mutex> lock(poolMutex);
+    for (auto& inFlight : inFlightFences) {
+        if (inFlight.serial == token.serial) {
+            inFlight.waiters--;
+            break;
+        }
+    }
+    if (result == VK_SUCCESS) {
+        retireCompletedLocked();
+    }
+    return result;
+}
+
+uint64_t FencePool::retireCompleted()
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return retireCompletedLocked();
+}
+
+uint64_t FencePool::retireCompletedLocked()
+{
+    // Only the contiguous finished prefix is retired, this keeps 'completedSerial'
+    // meaningful: every serial less or equal to it has finished.
+    while (!inFlightFences.empty()) {
+        InFlightFence& oldest = inFlightFences.front();
+        if (oldest.waiters || (!oldest.released && vkGetFenceStatus(device, oldest.fence) != VK_SUCCESS)) {
+            break;
+        }
+
+        if (!oldest.released) {
+            VkResult result = vkResetFences(device, 1, &oldest.fence);
+            assert(result == VK_SUCCESS);
+        }
+
+        freeFences.push_back(oldest.fence);
+        completedSerial = oldest.serial;
+        inFlightFences.pop_front();
+    }
+    return completedSerial;
+}
+
+uint64_t FencePool::lastCompletedSerial()
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return completedSerial;
+}
+
+uint64_t FencePool::lastSubmittedSerial()
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return nextSerial - 1;
+}
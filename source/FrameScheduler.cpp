@@ -0,0 +1,290 @@
+#include "FrameScheduler.h"
+#include "VulkanDevice.h"
+#include "CommandBufferManager.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+
+// Weight of the newest sample in the moving averages.
+static const double STATS_SMOOTHING = 0.1;
+
+static double elapsedMs(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+{
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+static double smooth(double average, double sample, uint64_t sampleCount)
+{
+    // Take the first sample as it is, afterwards blend the new samples in.
+    return sampleCount <= 1 ? sample : average + STATS_SMOOTHING * (sample - average);
+}
+
+FrameScheduler::FrameScheduler()
+{
+    deviceObj = NULL;
+    profiler = NULL;
+    currentSlot = 0;
+    frameNumber = 0;
+    recording = false;
+    stats = {};
+    fpsWindowFrames = 0;
+}
+
+FrameScheduler::~FrameScheduler()
+{
+}
+
+void FrameScheduler::createFrameSlots(VulkanDevice* inDeviceObj, uint32_t framesInFlight)
+{
+    VkResult result;
+
+    deviceObj = inDeviceObj;
+    assert(framesInFlight > 0);
+    frameSlots.resize(framesInFlight);
+
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        FrameSlot& slot = frameSlots[i];
+        slot.slotIndex = i;
+
+        // A transient pool per slot, the whole pool is reset once the slot's frame has retired.
+        VkCommandPoolCreateInfo cmdPoolInfo = {};
+        cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        cmdPoolInfo.pNext = NULL;
+        cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        cmdPoolInfo.queueFamilyIndex = deviceObj->graphicsQueueIndex;
+
+        result = vkCreateCommandPool(deviceObj->device, &cmdPoolInfo, NULL, &slot.cmdPool);
+        assert(result == VK_SUCCESS);
+
+        VkCommandBufferAllocateInfo cmdBufferAllocateInfo = {};
+        cmdBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cmdBufferAllocateInfo.pNext = NULL;
+        cmdBufferAllocateInfo.commandPool = slot.cmdPool;
+        cmdBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cmdBufferAllocateInfo.commandBufferCount = 1;
+        char name[64];
+        snprintf(name, sizeof(name), "Frame slot %u command buffer", i);
+        CommandBufferMgr::allocCommandBuffer(&deviceObj->device, slot.cmdPool, &slot.cmdBuffer, &cmdBufferAllocateInfo,
+            deviceObj->debugUtils, name);
+
+        // Created signaled so that the first wait on every slot returns at once.
+        VkFenceCreateInfo fenceCreateInfo = {};
+        fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceCreateInfo.pNext = NULL;
+        fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        result = vkCreateFence(deviceObj->device, &fenceCreateInfo, NULL, &slot.inFlightFence);
+        assert(result == VK_SUCCESS);
+
+        VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+        semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreCreateInfo.pNext = NULL;
+        semaphoreCreateInfo.flags = 0;
+
+        result = vkCreateSemaphore(deviceObj->device, &semaphoreCreateInfo, NULL, &slot.imageAcquiredSemaphore);
+        assert(result == VK_SUCCESS);
+        result = vkCreateSemaphore(deviceObj->device, &semaphoreCreateInfo, NULL, &slot.renderCompleteSemaphore);
+        assert(result == VK_SUCCESS);
+
+        snprintf(name, sizeof(name), "Frame slot %u command pool", i);
+        deviceObj->setObjectName(VK_OBJECT_TYPE_COMMAND_POOL, slot.cmdPool, name);
+        snprintf(name, sizeof(name), "Frame slot %u in-flight fence", i);
+        deviceObj->setObjectName(VK_OBJECT_TYPE_FENCE, slot.inFlightFence, name);
+        snprintf(name, sizeof(name), "Frame slot %u image acquired", i);
+        deviceObj->setObjectName(VK_OBJECT_TYPE_SEMAPHORE, slot.imageAcquiredSemaphore, name);
+        snprintf(name, sizeof(name), "Frame slot %u render complete", i);
+        deviceObj->setObjectName(VK_OBJECT_TYPE_SEMAPHORE, slot.renderCompleteSemaphore, name);
+
+        slot.frameNumber = 0;
+        slot.submitted = false;
+        slot.gpuFrameScope = GpuProfiler::INVALID_SCOPE;
+    }
+
+    currentSlot = 0;
+    fpsWindowStart = std::chrono::steady_clock::now();
+}
+
+void FrameScheduler::destroyFrameSlots()
+{
+    waitIdle();
+
+    for (auto& slot : frameSlots) {
+        vkDestroySemaphore(deviceObj->device, slot.renderCompleteSemaphore, NULL);
+        vkDestroySemaphore(deviceObj->device, slot.imageAcquiredSemaphore, NULL);
+        vkDestroyFence(deviceObj->device, slot.inFlightFence, NULL);
+        // Destroying the pool frees its command buffers as well.
+        vkDestroyCommandPool(deviceObj->device, slot.cmdPool, NULL);
+    }
+    frameSlots.clear();
+}
+
+FrameSlot* FrameScheduler::beginFrame()
+{
+    VkResult result;
+    FrameSlot& slot = frameSlots[currentSlot];
+
+    // Record the completion of everything that already finished,
+    // this keeps the latency samples close to the real completion time.
+    collectCompletedFrames();
+
+    // Only block if the GPU is still behind by a full ring of frames.
+    if (slot.submitted) {
+        PROFILE_SCOPE("FrameScheduler::waitForFrameSlot");
+        result = vkWaitForFences(deviceObj->device, 1, &slot.inFlightFence, VK_TRUE, UINT64_MAX);
+        checkResult(result, "vkWaitForFences");
+        onFrameCompleted(slot, std::chrono::steady_clock::now());
+    }
+
+    result = vkResetFences(deviceObj->device, 1, &slot.inFlightFence);
+    checkResult(result, "vkResetFences");
+
+    // Reset the whole pool instead of the individual command buffers.
+    result = vkResetCommandPool(deviceObj->device, slot.cmdPool, 0);
+    checkResult(result, "vkResetCommandPool");
+
+    slot.frameNumber = frameNumber++;
+    recording = true;
+    slot.recordStartTime = std::chrono::steady_clock::now();
+
+    VkCommandBufferBeginInfo cmdBufferBeginInfo = {};
+    cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmdBufferBeginInfo.pNext = NULL;
+    cmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    cmdBufferBeginInfo.pInheritanceInfo = NULL;
+    CommandBufferMgr::beginCommandBuffer(slot.cmdBuffer, &cmdBufferBeginInfo);
+
+    // The slot's previous frame has retired, so its timestamps are ready to be read.
+    slot.gpuFrameScope = GpuProfiler::INVALID_SCOPE;
+    if (profiler) {
+        profiler->beginFrame(slot.slotIndex, slot.cmdBuffer);
+        slot.gpuFrameScope = profiler->beginScope(slot.cmdBuffer, "Frame");
+    }
+
+    return &slot;
+}
+
+void FrameScheduler::endFrame(FrameSlot* slot, VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage, bool signalRenderComplete)
+{
+    if (profiler) {
+        profiler->endScope(slot->cmdBuffer, slot->gpuFrameScope);
+    }
+    CommandBufferMgr::endCommandBuffer(slot->cmdBuffer);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = NULL;
+    submitInfo.waitSemaphoreCount = waitSemaphore != VK_NULL_HANDLE ? 1 : 0;
+    submitInfo.pWaitSemaphores = waitSemaphore != VK_NULL_HANDLE ? &waitSemaphore : NULL;
+    submitInfo.pWaitDstStageMask = waitSemaphore != VK_NULL_HANDLE ? &waitStage : NULL;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &slot->cmdBuffer;
+    submitInfo.signalSemaphoreCount = signalRenderComplete ? 1 : 0;
+    submitInfo.pSignalSemaphores = signalRenderComplete ? &slot->renderCompleteSemaphore : NULL;
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    char label[32];
+    snprintf(label, sizeof(label), "Frame %llu", (unsigned long long)slot->frameNumber);
+
+    // No queue wait here, the slot's fence is checked when the slot comes around again.
+    VkResult result;
+    {
+        QueueLabel queueLabel(deviceObj->debugUtils, deviceObj->queue, label);
+        result = vkQueueSubmit(deviceObj->queue, 1, &submitInfo, slot->inFlightFence);
+    }
+    checkResult(result, "vkQueueSubmit");
+
+    // A failed submit leaves the fence unsignaled with nothing queued to signal it,
+    // so the slot is not waited on when it comes around again.
+    slot->submitted = result == VK_SUCCESS;
+    if (slot->submitted) {
+        slot->submitTime = now;
+        stats.framesSubmitted++;
+        stats.cpuRecordMs = smooth(stats.cpuRecordMs, elapsedMs(slot->recordStartTime, now), stats.framesSubmitted);
+    }
+    recording = false;
+
+    currentSlot = (currentSlot + 1) % (uint32_t)frameSlots.size();
+}
+
+void FrameScheduler::waitIdle()
+{
+    for (auto& slot : frameSlots) {
+        if (!slot.submitted) {
+            continue;
+        }
+        VkResult result = vkWaitForFences(deviceObj->device, 1, &slot.inFlightFence, VK_TRUE, UINT64_MAX);
+        checkResult(result, "vkWaitForFences");
+        onFrameCompleted(slot, std::chrono::steady_clock::now());
+    }
+}
+
+uint64_t FrameScheduler::getRetiredFrameCount() const
+{
+    // The oldest frame still recording or not observed as completed bounds the retired ones.
+    uint64_t retiredCount = frameNumber;
+    for (auto& slot : frameSlots) {
+        bool pending = slot.submitted || (recording && slot.slotIndex == currentSlot);
+        if (pending && slot.frameNumber < retiredCount) {
+            retiredCount = slot.frameNumber;
+        }
+    }
+    return retiredCount;
+}
+
+void FrameScheduler::collectCompletedFrames()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    for (auto& slot : frameSlots) {
+        if (!slot.submitted) {
+            continue;
+        }
+        VkResult result = vkGetFenceStatus(deviceObj->device, slot.inFlightFence);
+        if (result == VK_SUCCESS) {
+            onFrameCompleted(slot, now);
+        } else if (result != VK_NOT_READY) {
+            checkResult(result, "vkGetFenceStatus");
+        }
+    }
+}
+
+void FrameScheduler::onFrameCompleted(FrameSlot& slot, std::chrono::steady_clock::time_point now)
+{
+    slot.submitted = false;
+
+    stats.framesCompleted++;
+    stats.submitToCompleteMs = smooth(stats.submitToCompleteMs, elapsedMs(slot.submitTime, now), stats.framesCompleted);
+
+    // Refresh the frame rate about once per second.
+    fpsWindowFrames++;
+    double windowMs = elapsedMs(fpsWindowStart, now);
+    if (windowMs >= 1000.0) {
+        stats.framesPerSecond = fpsWindowFrames * 1000.0 / windowMs;
+        fpsWindowStart = now;
+        fpsWindowFrames = 0;
+    } else if (stats.framesCompleted == fpsWindowFrames && windowMs > 0.0) {
+        // No full window measured yet, report the rate so far.
+        stats.framesPerSecond = fpsWindowFrames * 1000.0 / windowMs;
+    }
+}
+
+void FrameScheduler::checkResult(VkResult result, const char* call)
+{
+    if (result != VK_SUCCESS) {
+        stats.failedCalls++;
+        stats.lastFailure = result;
+        std::cout << "Error: " << call << " returned " << result << " around frame " << frameNumber << std::endl;
+    }
+}
+
+void FrameScheduler::printStats() const
+{
+    std::cout << "Frames in flight: " << frameSlots.size()
+              << ", submitted: " << stats.framesSubmitted
+              << ", completed: " << stats.framesCompleted << std::endl;
+    std::cout << "\tCPU record time: " << stats.cpuRecordMs << " ms"
+              << ", submit to complete: " << stats.submitToCompleteMs << " ms"
+              << ", frames per second: " << stats.framesPerSecond << std::endl;
+    if (stats.failedCalls) {
+        std::cout << "\t" << stats.failedCalls << " failed Vulkan calls, the last one returned " << stats.lastFailure << std::endl;
+    }
+}
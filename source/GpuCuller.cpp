@@ -0,0 +1,565 @@
+#include "GpuCuller.h"
+#include "VulkanDevice.h"
+#include "DescriptorAllocator.h"
+#include "StagingRing.h"
+#include "CommandBufferManager.h"
+#include <chrono>
+#include <cmath>
+
+const char* const GpuCuller::DEFAULT_SHADER_PATH = "shaders/cull.comp.spv";
+const char* const GpuCuller::DEFAULT_BOUNDS_VERTEX_PATH = "shaders/cull_bounds.vert.spv";
+const char* const GpuCuller::DEFAULT_BOUNDS_FRAGMENT_PATH = "shaders/cull_bounds.frag.spv";
+
+// Two triangles per face of a box whose corner i is at (i & 1, (i >> 1) & 1, (i >> 2) & 1).
+static const uint32_t BOX_INDEX_COUNT = 36;
+static const uint32_t boxIndices[BOX_INDEX_COUNT] = {
+    0, 4, 6, 0, 6, 2, 1, 3, 7, 1, 7, 5,
+    0, 1, 5, 0, 5, 4, 2, 6, 7, 2, 7, 3,
+    0, 2, 3, 0, 3, 1, 4, 5, 7, 4, 7, 6
+};
+
+GpuCuller::GpuCuller()
+{
+    deviceObj = NULL;
+    computeEngine = NULL;
+    descriptors = NULL;
+    stagingRing = NULL;
+    kernel = NULL;
+    drawIndirectCountFn = NULL;
+    objectBuffer = VK_NULL_HANDLE;
+    drawBuffer = VK_NULL_HANDLE;
+    objectCount = 0;
+    boundsSetLayout = VK_NULL_HANDLE;
+    boundsTemplate = NULL;
+    boundsPipelineLayout = VK_NULL_HANDLE;
+    boundsPipeline = VK_NULL_HANDLE;
+    boundsIndexBuffer = VK_NULL_HANDLE;
+    stats = {};
+}
+
+GpuCuller::~GpuCuller()
+{
+}
+
+void GpuCuller::requestFeatures(DeviceFeatures& features)
+{
+    features.core.features.multiDrawIndirect = VK_TRUE;
+    features.core.features.drawIndirectFirstInstance = VK_TRUE;
+}
+
+bool GpuCuller::isSupported(const VulkanDevice* deviceObj)
+{
+    // Without multiDrawIndirect the commands are drawn one call each, slower but correct.
+    return deviceObj->enabledFeatures.core.features.drawIndirectFirstInstance == VK_TRUE;
+}
+
+bool GpuCuller::createGpuCuller(VulkanDevice* inDeviceObj, ComputeEngine* inComputeEngine, DescriptorAllocator* inDescriptors,
+    StagingRing* inStagingRing, uint32_t frameSlotCount, const std::string& shaderPath)
+{
+    deviceObj = inDeviceObj;
+    computeEngine = inComputeEngine;
+    descriptors = inDescriptors;
+    stagingRing = inStagingRing;
+    assert(isSupported(deviceObj));
+
+    if (deviceObj->isExtensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+        drawIndirectCountFn = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(deviceObj->device, "vkCmdDrawIndexedIndirectCountKHR");
+    }
+
+    // Compaction only pays off when the count can come from the device.
+    ComputeKernelDesc desc;
+    desc.spirvPath = shaderPath;
+    desc.entryPoint = "main";
+    desc.storageBufferCount = 4;
+    desc.pushConstantSize = sizeof(CullPushConstants);
+    desc.dimensions = 1;
+    desc.constants.set<VkBool32>(COMPACT_CONSTANT_ID, isCompacting() ? VK_TRUE : VK_FALSE);
+    kernel = computeEngine->createKernel(desc);
+    if (!kernel) {
+        std::cout << "GPU culling disabled, " << shaderPath << " could not be loaded." << std::endl;
+        return false;
+    }
+
+    outputs.resize(frameSlotCount);
+    for (uint32_t i = 0; i < frameSlotCount; i++) {
+        FrameOutput& output = outputs[i];
+        output.commandBuffer = VK_NULL_HANDLE;
+        output.countBuffer = createBuffer(sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "Draw count", &output.countAllocation);
+        output.pending = false;
+    }
+    return true;
+}
+
+void GpuCuller::destroyGpuCuller()
+{
+    for (size_t i = 0; i < outputs.size(); i++) {
+        destroyBuffer(outputs[i].commandBuffer, outputs[i].commandAllocation);
+        destroyBuffer(outputs[i].countBuffer, outputs[i].countAllocation);
+    }
+    outputs.clear();
+    destroyBuffer(objectBuffer, objectAllocation);
+    destroyBuffer(drawBuffer, drawAllocation);
+    destroyBuffer(boundsIndexBuffer, boundsIndexAllocation);
+    objectCount = 0;
+    kernel = NULL; // Owned by the compute engine.
+
+    // The pipeline stays with the pipeline manager, evicted with its layout.
+    if (boundsPipelineLayout != VK_NULL_HANDLE) {
+        deviceObj->deletionQueue.destroyObject(VK_OBJECT_TYPE_PIPELINE_LAYOUT, boundsPipelineLayout);
+    }
+    boundsSetLayout = VK_NULL_HANDLE;
+    boundsTemplate = NULL;
+    boundsPipelineLayout = VK_NULL_HANDLE;
+    boundsPipeline = VK_NULL_HANDLE;
+}
+
+bool GpuCuller::createBoundsPipeline(VkRenderPass renderPass, uint32_t width, uint32_t height,
+    const std::string& vertexPath, const std::string& fragmentPath)
+{
+    assert(kernel && boundsPipeline == VK_NULL_HANDLE);
+    VkShaderModule vertexModule = computeEngine->loadShaderModule(vertexPath);
+    VkShaderModule fragmentModule = computeEngine->loadShaderModule(fragmentPath);
+    if (vertexModule == VK_NULL_HANDLE || fragmentModule == VK_NULL_HANDLE) {
+        std::cout << "Bounding boxes not drawn, " << vertexPath << " or " << fragmentPath << " could not be loaded." << std::endl;
+        return false;
+    }
+
+    // The vertex shader reads the object buffer, the view-projection rows are push constants.
+    VkDescriptorSetLayoutBinding binding = {};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    binding.pImmutableSamplers = NULL;
+    boundsSetLayout = descriptors->getLayout(std::vector<VkDescriptorSetLayoutBinding>(1, binding), 0, "Cull bounds");
+
+    VkDescriptorUpdateTemplateEntryKHR entry = {};
+    entry.dstBinding = 0;
+    entry.dstArrayElement = 0;
+    entry.descriptorCount = 1;
+    entry.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    entry.offset = 0;
+    entry.stride = sizeof(VkDescriptorBufferInfo);
+    boundsTemplate = descriptors->createTemplate(boundsSetLayout, std::vector<VkDescriptorUpdateTemplateEntryKHR>(1, entry));
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(float) * 16;
+
+    VkPipelineLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = NULL;
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &boundsSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+    VkResult result = vkCreatePipelineLayout(deviceObj->device, &layoutInfo, NULL, &boundsPipelineLayout);
+    assert(result == VK_SUCCESS);
+
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    const VkShaderStageFlagBits stageBits[2] = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT };
+    const VkShaderModule modules[2] = { vertexModule, fragmentModule };
+    for (uint32_t i = 0; i < 2; i++) {
+        stages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages[i].stage = stageBits[i];
+        stages[i].module = modules[i];
+        stages[i].pName = "main";
+    }
+
+    // No vertex buffers, the corners come from the indices.
+    VkPipelineVertexInputStateCreateInfo vertexInput = {};
+    vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkViewport viewport = { 0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f };
+    VkRect2D scissor = { { 0, 0 }, { width, height } };
+    VkPipelineViewportStateCreateInfo viewportState = {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.pViewports = &viewport;
+    viewportState.scissorCount = 1;
+    viewportState.pScissors = &scissor;
+
+    // Boxes are seen from inside as well, the camera sits in the middle of the scene.
+    VkPipelineRasterizationStateCreateInfo rasterization = {};
+    rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterization.cullMode = VK_CULL_MODE_NONE;
+    rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterization.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample = {};
+    multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState blendAttachment = {};
+    blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT
+        | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo colorBlend = {};
+    colorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlend.attachmentCount = 1;
+    colorBlend.pAttachments = &blendAttachment;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = stages;
+    pipelineInfo.pVertexInputState = &vertexInput;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterization;
+    pipelineInfo.pMultisampleState = &multisample;
+    pipelineInfo.pColorBlendState = &colorBlend;
+    pipelineInfo.layout = boundsPipelineLayout;
+    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.subpass = 0;
+    result = deviceObj->pipelineManager.getGraphicsPipeline(pipelineInfo, &boundsPipeline, "Cull bounds");
+    assert(result == VK_SUCCESS);
+    return true;
+}
+
+VkBuffer GpuCuller::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryFlags,
+    const char* name, MemoryAllocation* allocation)
+{
+    VkBufferCreateInfo bufInfo = {};
+    bufInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufInfo.pNext = NULL;
+    bufInfo.flags = 0;
+    bufInfo.size = size;
+    bufInfo.usage = usage;
+    bufInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    bufInfo.queueFamilyIndexCount = 0;
+    bufInfo.pQueueFamilyIndices = NULL;
+
+    VkBuffer buffer;
+    VkResult result = vkCreateBuffer(deviceObj->device, &bufInfo, NULL, &buffer);
+    assert(result == VK_SUCCESS);
+    deviceObj->setObjectName(VK_OBJECT_TYPE_BUFFER, buffer, name);
+
+    result = deviceObj->memoryAllocator.allocateForBuffer(buffer, memoryFlags, ALLOCATION_STRATEGY_FREE_LIST, allocation);
+    assert(result == VK_SUCCESS);
+    return buffer;
+}
+
+void GpuCuller::destroyBuffer(VkBuffer& buffer, MemoryAllocation& allocation)
+{
+    if (buffer == VK_NULL_HANDLE) {
+        return;
+    }
+
+    // Frames in flight may still cull or draw with it.
+    deviceObj->deletionQueue.destroyObject(VK_OBJECT_TYPE_BUFFER, buffer);
+    deviceObj->deletionQueue.freeAllocation(allocation);
+    buffer = VK_NULL_HANDLE;
+    allocation = MemoryAllocation();
+}
+
+void GpuCuller::upload(VkBuffer buffer, const void* data, VkDeviceSize size)
+{
+    // Slices well below the ring size, as the mesh streamer does.
+    VkDeviceSize maxSlice = std::max<VkDeviceSize>(stagingRing->getRingSize() / 4, 4);
+    for (VkDeviceSize offset = 0; offset < size; offset += maxSlice) {
+        VkDeviceSize slice = std::min(maxSlice, size - offset);
+        bool queued = stagingRing->uploadBuffer(buffer, offset, (const uint8_t*)data + offset, slice);
+        assert(queued);
+    }
+}
+
+void GpuCuller::setScene(const std::vector<CullDraw>& draws, const std::vector<CullObject>& objects)
+{
+    assert(kernel);
+    destroyBuffer(objectBuffer, objectAllocation);
+    destroyBuffer(drawBuffer, drawAllocation);
+    destroyBuffer(boundsIndexBuffer, boundsIndexAllocation);
+    for (size_t i = 0; i < outputs.size(); i++) {
+        destroyBuffer(outputs[i].commandBuffer, outputs[i].commandAllocation);
+        outputs[i].pending = false;
+    }
+
+    objectCount = (uint32_t)objects.size();
+    stats.objects = objectCount;
+    if (objects.empty() || draws.empty()) {
+        objectCount = 0;
+        return;
+    }
+
+    // Vertex shaders read the objects too, by instance index.
+    objectBuffer = createBuffer(objects.size() * sizeof(CullObject),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Cull objects", &objectAllocation);
+    drawBuffer = createBuffer(draws.size() * sizeof(CullDraw),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Cull draws", &drawAllocation);
+    upload(objectBuffer, objects.data(), objects.size() * sizeof(CullObject));
+    upload(drawBuffer, draws.data(), draws.size() * sizeof(CullDraw));
+
+    for (size_t i = 0; i < outputs.size(); i++) {
+        outputs[i].commandBuffer = createBuffer(objects.size() * sizeof(VkDrawIndexedIndirectCommand),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Draw commands", &outputs[i].commandAllocation);
+    }
+
+    // Every range of the draw table draws boxes, the vertex shader takes the corner from the index.
+    if (boundsPipeline != VK_NULL_HANDLE) {
+        uint32_t indexCount = 0;
+        for (const CullDraw& draw : draws) {
+            indexCount = std::max(indexCount, draw.firstIndex + draw.indexCount);
+        }
+        std::vector<uint32_t> indices(indexCount, 0);
+        for (const CullDraw& draw : draws) {
+            for (uint32_t i = 0; i < draw.indexCount; i++) {
+                indices[draw.firstIndex + i] = boxIndices[i % BOX_INDEX_COUNT];
+            }
+        }
+        boundsIndexBuffer = createBuffer(indices.size() * sizeof(uint32_t),
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Bounds indices", &boundsIndexAllocation);
+        upload(boundsIndexBuffer, indices.data(), indices.size() * sizeof(uint32_t));
+    }
+}
+
+void GpuCuller::beginFrame(uint32_t frameSlot)
+{
+    FrameOutput& output = outputs[frameSlot];
+    if (!output.pending) {
+        return;
+    }
+    output.pending = false;
+
+    stats.lastVisibleDraws = *(const uint32_t*)output.countAllocation.mappedData;
+    stats.visibleDraws += stats.lastVisibleDraws;
+    stats.framesRead++;
+}
+
+void GpuCuller::recordCulling(VkCommandBuffer cmdBuffer, uint32_t frameSlot, const float planes[6][4])
+{
+    if (objectCount == 0) {
+        return;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    CommandBufferLabel cmdLabel(deviceObj->debugUtils, cmdBuffer, "GPU culling");
+    FrameOutput& output = outputs[frameSlot];
+
+    // The slot has retired, nothing reads its previous commands or count any more.
+    vkCmdFillBuffer(cmdBuffer, output.countBuffer, 0, sizeof(uint32_t), 0);
+
+    VkMemoryBarrier memoryBarrier = {};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.pNext = NULL;
+    memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        1, &memoryBarrier, 0, NULL, 0, NULL);
+
+    VkDescriptorBufferInfo buffers[4];
+    VkBuffer handles[4] = { objectBuffer, drawBuffer, output.commandBuffer, output.countBuffer };
+    for (uint32_t i = 0; i < 4; i++) {
+        buffers[i].buffer = handles[i];
+        buffers[i].offset = 0;
+        buffers[i].range = VK_WHOLE_SIZE;
+    }
+    VkDescriptorSet set = descriptors->allocate(frameSlot, kernel->setLayout);
+    descriptors->update(set, kernel->bufferTemplate, buffers);
+
+    CullPushConstants pushConstants;
+    memcpy(pushConstants.planes, planes, sizeof(pushConstants.planes));
+    pushConstants.objectCount = objectCount;
+
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernel->pipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernel->pipelineLayout, 0, 1, &set, 0, NULL);
+    vkCmdPushConstants(cmdBuffer, kernel->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDispatch(cmdBuffer, (objectCount + kernel->workgroupSize[0] - 1) / kernel->workgroupSize[0], 1, 1);
+
+    // The draws read the commands and the count, and beginFrame() reads the count once the
+    // slot has retired: the fence wait alone does not make the writes visible to the host.
+    // A following pass on the same slot refills the count and rewrites the commands, so its
+    // fill and dispatch wait for this one too.
+    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT |
+        VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT |
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, NULL, 0, NULL);
+
+    output.pending = true;
+    stats.framesCulled++;
+    stats.recordMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void GpuCuller::recordDraws(VkCommandBuffer cmdBuffer, uint32_t frameSlot)
+{
+    if (objectCount == 0) {
+        return;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const FrameOutput& output = outputs[frameSlot];
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    uint32_t maxDrawCount = deviceObj->gpuProps.limits.maxDrawIndirectCount;
+
+    if (drawIndirectCountFn) {
+        drawIndirectCountFn(cmdBuffer, output.commandBuffer, 0, output.countBuffer, 0, std::min(objectCount, maxDrawCount), stride);
+        stats.drawCalls++;
+    } else {
+        // Culled objects have no instance. Without multiDrawIndirect maxDrawIndirectCount is 1.
+        if (!deviceObj->enabledFeatures.core.features.multiDrawIndirect) {
+            maxDrawCount = 1;
+        }
+        for (uint32_t first = 0; first < objectCount; first += maxDrawCount) {
+            vkCmdDrawIndexedIndirect(cmdBuffer, output.commandBuffer, (VkDeviceSize)first * stride,
+                std::min(maxDrawCount, objectCount - first), stride);
+            stats.drawCalls++;
+        }
+    }
+
+    stats.recordMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void GpuCuller::recordBoundsDraws(VkCommandBuffer cmdBuffer, uint32_t frameSlot, const float viewProjection[4][4])
+{
+    if (objectCount == 0 || boundsPipeline == VK_NULL_HANDLE) {
+        return;
+    }
+
+    VkDescriptorBufferInfo objects;
+    objects.buffer = objectBuffer;
+    objects.offset = 0;
+    objects.range = VK_WHOLE_SIZE;
+    VkDescriptorSet set = descriptors->allocate(frameSlot, boundsSetLayout);
+    descriptors->update(set, boundsTemplate, &objects);
+
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, boundsPipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, boundsPipelineLayout, 0, 1, &set, 0, NULL);
+    vkCmdPushConstants(cmdBuffer, boundsPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(float) * 16, viewProjection);
+    vkCmdBindIndexBuffer(cmdBuffer, boundsIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    recordDraws(cmdBuffer, frameSlot);
+}
+
+uint32_t GpuCuller::cullOnCpu(const std::vector<CullDraw>& draws, const std::vector<CullObject>& objects,
+    const float planes[6][4], std::vector<VkDrawIndexedIndirectCommand>& commands)
+{
+    uint32_t visibleCount = 0;
+    for (uint32_t i = 0; i < (uint32_t)objects.size(); i++) {
+        const CullObject& object = objects[i];
+        bool visible = true;
+        for (uint32_t p = 0; p < 6 && visible; p++) {
+            visible = planes[p][0] * object.center[0] + planes[p][1] * object.center[1] + planes[p][2] * object.center[2]
+                + planes[p][3] >= -object.radius;
+        }
+        if (!visible) {
+            continue;
+        }
+
+        const CullDraw& draw = draws[object.drawIndex];
+        VkDrawIndexedIndirectCommand command;
+        command.indexCount = draw.indexCount;
+        command.instanceCount = 1;
+        command.firstIndex = draw.firstIndex;
+        command.vertexOffset = draw.vertexOffset;
+        command.firstInstance = i;
+        commands.push_back(command);
+        visibleCount++;
+    }
+    return visibleCount;
+}
+
+float GpuCuller::testSceneExtent(uint32_t objectCount)
+{
+    return 2.0f * std::cbrt((float)objectCount); // About 4 units per object.
+}
+
+void GpuCuller::buildTestScene(uint32_t objectCount, std::vector<CullDraw>& draws, std::vector<CullObject>& objects)
+{
+    const uint32_t drawCount = 8;
+    draws.resize(drawCount);
+    for (uint32_t i = 0; i < drawCount; i++) {
+        draws[i].indexCount = 36 << i;
+        draws[i].firstIndex = i == 0 ? 0 : draws[i - 1].firstIndex + draws[i - 1].indexCount;
+        draws[i].vertexOffset = 0;
+        draws[i].reserved = 0;
+    }
+
+    float extent = testSceneExtent(objectCount);
+    uint32_t seed = 12345;
+    objects.resize(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++) {
+        CullObject& object = objects[i];
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            seed = seed * 1664525u + 1013904223u;
+            object.center[axis] = ((seed >> 8) / 16777216.0f * 2.0f - 1.0f) * extent;
+        }
+        seed = seed * 1664525u + 1013904223u;
+        object.radius = 0.25f + (seed >> 8) / 16777216.0f;
+        object.drawIndex = i % drawCount;
+        object.reserved[0] = object.reserved[1] = object.reserved[2] = 0;
+    }
+}
+
+static const float CAMERA_HALF_FOV_Y = 30.0f * 3.14159265f / 180.0f;
+static const float CAMERA_NEAR_DISTANCE = 0.1f;
+
+void GpuCuller::cameraFrustum(float yaw, float aspect, float farDistance, float planes[6][4])
+{
+    const float halfFovX = std::atan(std::tan(CAMERA_HALF_FOV_Y) * aspect);
+    const float forward[3] = { std::sin(yaw), 0.0f, std::cos(yaw) };
+    const float right[3] = { std::cos(yaw), 0.0f, -std::sin(yaw) };
+    const float up[3] = { 0.0f, 1.0f, 0.0f };
+
+    // Side planes go through the camera: their normal leans from the side axis towards forward.
+    const float* sideAxis[4] = { right, right, up, up };
+    const float sideSign[4] = { 1.0f, -1.0f, 1.0f, -1.0f };
+    const float halfFov[4] = { halfFovX, halfFovX, CAMERA_HALF_FOV_Y, CAMERA_HALF_FOV_Y };
+    for (uint32_t i = 0; i < 4; i++) {
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            planes[i][axis] = sideSign[i] * std::cos(halfFov[i]) * sideAxis[i][axis] + std::sin(halfFov[i]) * forward[axis];
+        }
+        planes[i][3] = 0.0f;
+    }
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        planes[4][axis] = forward[axis];
+        planes[5][axis] = -forward[axis];
+    }
+    planes[4][3] = -CAMERA_NEAR_DISTANCE;
+    planes[5][3] = farDistance;
+}
+
+void GpuCuller::cameraViewProjection(float yaw, float aspect, float farDistance, float rows[4][4])
+{
+    const float focal = 1.0f / std::tan(CAMERA_HALF_FOV_Y);
+    const float forward[3] = { std::sin(yaw), 0.0f, std::cos(yaw) };
+    const float right[3] = { std::cos(yaw), 0.0f, -std::sin(yaw) };
+    const float up[3] = { 0.0f, 1.0f, 0.0f };
+
+    // Clip space Y points down and depth goes from 0 at the near plane to 1 at the far one.
+    const float depthScale = farDistance / (farDistance - CAMERA_NEAR_DISTANCE);
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        rows[0][axis] = focal / aspect * right[axis];
+        rows[1][axis] = -focal * up[axis];
+        rows[2][axis] = depthScale * forward[axis];
+        rows[3][axis] = forward[axis];
+    }
+    rows[0][3] = 0.0f;
+    rows[1][3] = 0.0f;
+    rows[2][3] = -depthScale * CAMERA_NEAR_DISTANCE;
+    rows[3][3] = 0.0f;
+}
+
+void GpuCuller::printStats() const
+{
+    std::cout << "GPU culling: " << stats.objects << " objects, " << stats.framesCulled << " frames culled ("
+              << (isCompacting() ? "compacted" : "in place") << "), "
+              << (stats.framesRead ? stats.visibleDraws / stats.framesRead : 0) << " visible per frame on average, "
+              << stats.lastVisibleDraws << " in the last one read, " << stats.drawCalls << " indirect draw calls, "
+              << stats.recordMs << " ms recording";
+    if (stats.framesCulled) {
+        std::cout << " (" << stats.recordMs * 1000.0 / stats.framesCulled << " us per frame)";
+    }
+    std::cout << std::endl;
+}
@@ -0,0 +1,270 @@
+#include "GpuProfiler.h"
+#include "VulkanDevice.h"
+#include <cmath>
+#include <cstdio>
+
+GpuProfiler::GpuProfiler()
+{
+    deviceObj = NULL;
+    currentFrame = 0;
+    maxScopes = 0;
+    frameCounter = 0;
+    timestampMask = ~0ull;
+    nanosecondsPerTick = 1.0;
+    droppedScopes = 0;
+    traceBaseTicks = 0;
+    traceBaseSet = false;
+}
+
+GpuProfiler::~GpuProfiler()
+{
+}
+
+void GpuProfiler::createProfiler(VulkanDevice* inDeviceObj, uint32_t frameSlotCount, uint32_t queueFamilyIndex, uint32_t maxScopesPerFrame)
+{
+    deviceObj = inDeviceObj;
+    maxScopes = maxScopesPerFrame;
+
+    uint32_t validBits = deviceObj->queueFamilyProps[queueFamilyIndex].timestampValidBits;
+    if (validBits == 0) {
+        std::cout << "GPU profiler disabled: queue family " << queueFamilyIndex << " does not support timestamps." << std::endl;
+        return;
+    }
+    timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+    nanosecondsPerTick = deviceObj->gpuProps.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo queryPoolInfo = {};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.pNext = NULL;
+    queryPoolInfo.flags = 0;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = 2 * maxScopes;
+    queryPoolInfo.pipelineStatistics = 0;
+
+    frames.resize(frameSlotCount);
+    for (uint32_t i = 0; i < frameSlotCount; i++) {
+        VkResult result = vkCreateQueryPool(deviceObj->device, &queryPoolInfo, NULL, &frames[i].queryPool);
+        assert(result == VK_SUCCESS);
+        frames[i].frameNumber = 0;
+
+        char name[64];
+        snprintf(name, sizeof(name), "Frame slot %u timestamps", i);
+        deviceObj->setObjectName(VK_OBJECT_TYPE_QUERY_POOL, frames[i].queryPool, name);
+    }
+}
+
+void GpuProfiler::destroyProfiler()
+{
+    for (auto& frame : frames) {
+        vkDestroyQueryPool(deviceObj->device, frame.queryPool, NULL);
+    }
+    frames.clear();
+}
+
+void GpuProfiler::beginFrame(uint32_t slotIndex, VkCommandBuffer cmdBuffer)
+{
+    if (frames.empty()) {
+        return;
+    }
+
+    FrameQueries& frame = frames[slotIndex];
+    collectFrame(frame);
+
+    vkCmdResetQueryPool(cmdBuffer, frame.queryPool, 0, 2 * maxScopes);
+    frame.frameNumber = frameCounter++;
+    currentFrame = slotIndex;
+}
+
+uint32_t GpuProfiler::beginScope(VkCommandBuffer cmdBuffer, const char* name, VkPipelineStageFlagBits stage)
+{
+    if (frames.empty()) {
+        return INVALID_SCOPE;
+    }
+
+    FrameQueries& frame = frames[currentFrame];
+    if (frame.scopes.size() >= maxScopes) {
+        droppedScopes++;
+        return INVALID_SCOPE;
+    }
+
+    std::unordered_map<std::string, uint32_t>::iterator it = nameIndices.find(name);
+    if (it == nameIndices.end()) {
+        ScopeHistory history = {};
+        history.name = name;
+        history.minMs = HUGE_VAL;
+        histories.push_back(history);
+        it = nameIndices.insert(std::make_pair(std::string(name), (uint32_t)histories.size() - 1)).first;
+    }
+
+    uint32_t scope = (uint32_t)frame.scopes.size();
+    PendingScope pending = { it->second, false };
+    frame.scopes.push_back(pending);
+
+    vkCmdWriteTimestamp(cmdBuffer, stage, frame.queryPool, 2 * scope);
+    return scope;
+}
+
+void GpuProfiler::endScope(VkCommandBuffer cmdBuffer, uint32_t scope, VkPipelineStageFlagBits stage)
+{
+    if (scope == INVALID_SCOPE) {
+        return;
+    }
+
+    FrameQueries& frame = frames[currentFrame];
+    vkCmdWriteTimestamp(cmdBuffer, stage, frame.queryPool, 2 * scope + 1);
+    frame.scopes[scope].ended = true;
+}
+
+void GpuProfiler::collectFrame(FrameQueries& frame)
+{
+    if (frame.scopes.empty()) {
+        return;
+    }
+
+    // No wait flag, the caller has already seen the frame's fence signaled.
+    uint32_t queryCount = 2 * (uint32_t)frame.scopes.size();
+    std::vector<uint64_t> ticks(queryCount);
+    VkResult result = vkGetQueryPoolResults(deviceObj->device, frame.queryPool, 0, queryCount,
+        ticks.size() * sizeof(uint64_t), ticks.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+    if (result != VK_SUCCESS) {
+        droppedScopes += frame.scopes.size();
+        frame.scopes.clear();
+        return;
+    }
+
+    for (uint32_t i = 0; i < (uint32_t)frame.scopes.size(); i++) {
+        const PendingScope& scope = frame.scopes[i];
+        if (!scope.ended) {
+            droppedScopes++;
+            continue;
+        }
+
+        uint64_t begin = ticks[2 * i] & timestampMask;
+        uint64_t end = ticks[2 * i + 1] & timestampMask;
+        uint64_t elapsedTicks = (end - begin) & timestampMask; // Survives one wrap of the counter.
+        double ms = (double)elapsedTicks * nanosecondsPerTick * 1e-6;
+        addSample(scope.nameIndex, ms);
+
+        if (traceEvents.size() < MAX_TRACE_EVENTS) {
+            if (!traceBaseSet) {
+                traceBaseTicks = begin;
+                traceBaseSet = true;
+            }
+            TraceEvent event;
+            event.name = histories[scope.nameIndex].name;
+            event.category = "gpu";
+            event.startUs = (double)(int64_t)(begin - traceBaseTicks) * nanosecondsPerTick * 1e-3;
+            event.durationUs = ms * 1e3;
+            event.pid = 0;
+            event.tid = 0;
+            traceEvents.push_back(event);
+        }
+    }
+    frame.scopes.clear();
+}
+
+void GpuProfiler::collectAll()
+{
+    for (auto& frame : frames) {
+        collectFrame(frame);
+    }
+}
+
+uint32_t GpuProfiler::bucketOf(double ms)
+{
+    double us = ms * 1e3;
+    if (us < 1.0) {
+        return 0;
+    }
+    uint32_t bucket = (uint32_t)(4.0 * std::log2(us)) + 1;
+    return std::min(bucket, HISTOGRAM_BUCKETS - 1);
+}
+
+double GpuProfiler::bucketUpperMs(uint32_t bucket)
+{
+    // Bucket b > 0 holds [2^((b - 1) / 4), 2^(b / 4)) us.
+    return std::pow(2.0, bucket / 4.0) * 1e-3;
+}
+
+void GpuProfiler::addSample(uint32_t nameIndex, double ms)
+{
+    ScopeHistory& history = histories[nameIndex];
+    history.count++;
+    history.totalMs += ms;
+    history.minMs = std::min(history.minMs, ms);
+    history.maxMs = std::max(history.maxMs, ms);
+    history.histogram[bucketOf(ms)]++;
+}
+
+std::vector<GpuScopeStats> GpuProfiler::getStats() const
+{
+    std::vector<GpuScopeStats> statsList;
+    for (const auto& history : histories) {
+        if (!history.count) {
+            continue;
+        }
+
+        GpuScopeStats stats;
+        stats.name = history.name;
+        stats.count = history.count;
+        stats.minMs = history.minMs;
+        stats.avgMs = history.totalMs / history.count;
+        stats.maxMs = history.maxMs;
+
+        // The open ended last bucket reports the maximum instead of its edge.
+        uint64_t rank = (history.count * 99 + 99) / 100;
+        uint64_t seen = 0;
+        stats.p99Ms = history.maxMs;
+        for (uint32_t b = 0; b < HISTOGRAM_BUCKETS - 1; b++) {
+            seen += history.histogram[b];
+            if (seen >= rank) {
+                stats.p99Ms = std::min(bucketUpperMs(b), history.maxMs);
+                break;
+            }
+        }
+        statsList.push_back(stats);
+    }
+    return statsList;
+}
+
+void GpuProfiler::printStats() const
+{
+    if (frames.empty() && histories.empty()) {
+        return;
+    }
+
+    std::vector<GpuScopeStats> statsList = getStats();
+    std::cout << "GPU scopes: " << statsList.size() << " names, " << droppedScopes << " dropped" << std::endl;
+
+    char line[192];
+    for (const auto& stats : statsList) {
+        snprintf(line, sizeof(line), "  %-32s %8llu x  min %8.3f  avg %8.3f  p99 %8.3f  max %8.3f ms",
+            stats.name.c_str(), (unsigned long long)stats.count, stats.minMs, stats.avgMs, stats.p99Ms, stats.maxMs);
+        std::cout << line << std::endl;
+    }
+}
+
+void GpuProfiler::appendTraceEvents(std::string& eventList, uint32_t pid) const
+{
+    if (!eventList.empty()) {
+        eventList += ",\n";
+    }
+    ChromeTrace::appendTrackName(eventList, pid, UINT32_MAX, "GPU");
+    eventList += ",\n";
+    ChromeTrace::appendTrackName(eventList, pid, 0, "Graphics queue");
+
+    for (const auto& event : traceEvents) {
+        TraceEvent gpuEvent = event;
+        gpuEvent.pid = pid;
+        eventList += ",\n";
+        ChromeTrace::appendEvent(eventList, gpuEvent);
+    }
+}
+
+bool GpuProfiler::writeChromeTrace(const std::string& filePath) const
+{
+    std::string eventList;
+    appendTraceEvents(eventList, 0);
+    return ChromeTrace::writeTrace(filePath, eventList);
+}
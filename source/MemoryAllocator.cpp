@@ -0,0 +1,242 @@
+#include "MemoryAllocator.h"
+#include "VulkanDevice.h"
+
+MemoryAllocator::MemoryAllocator()
+{
+    deviceObj = NULL;
+    blockSize = DEFAULT_BLOCK_SIZE;
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+}
+
+void MemoryAllocator::createAllocator(VulkanDevice* inDeviceObj, VkDeviceSize inBlockSize)
+{
+    deviceObj = inDeviceObj;
+    blockSize = inBlockSize;
+}
+
+void MemoryAllocator::destroyAllocator()
+{
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+
+    for (auto block : blockList) {
+        if (!block->subAllocator->isEmpty()) {
+            std::cout << "Warning: memory block of type " << block->memoryTypeIndex << " destroyed with live allocations." << std::endl;
+        }
+        destroyBlock(block);
+    }
+    blockList.clear();
+}
+
+MemoryBlock* MemoryAllocator::createBlock(uint32_t memoryTypeIndex, AllocationStrategy strategy, VkDeviceSize size, bool dedicated)
+{
+    VkMemoryAllocateInfo memAllocInfo = {};
+    memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memAllocInfo.pNext = NULL;
+    memAllocInfo.allocationSize = size;
+    memAllocInfo.memoryTypeIndex = memoryTypeIndex;
+
+    VkDeviceMemory memory;
+    VkResult result = vkAllocateMemory(deviceObj->device, &memAllocInfo, NULL, &memory);
+    if (result != VK_SUCCESS) {
+        return NULL;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "%s block, memory type %u", dedicated ? "Dedicated" : "Shared", memoryTypeIndex);
+    deviceObj->setObjectName(VK_OBJECT_TYPE_DEVICE_MEMORY, memory, name);
+
+    MemoryBlock* block = new MemoryBlock();
+    block->memory = memory;
+    block->memoryTypeIndex = memoryTypeIndex;
+    block->strategy = strategy;
+    block->dedicated = dedicated;
+    block->mappedData = NULL;
+
+    VkDeviceSize granularity = deviceObj->gpuProps.limits.bufferImageGranularity;
+    switch (strategy) {
+    case ALLOCATION_STRATEGY_BUDDY:
+        block->subAllocator = new BuddySubAllocator(size, granularity);
+        break;
+    case ALLOCATION_STRATEGY_LINEAR:
+        block->subAllocator = new LinearSubAllocator(size, granularity);
+        break;
+    default:
+        block->subAllocator = new FreeListSubAllocator(size, granularity);
+        break;
+    }
+
+    // Keep host visible blocks mapped for their whole lifetime.
+    VkMemoryPropertyFlags flags = deviceObj->memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+    if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        result = vkMapMemory(deviceObj->device, memory, 0, VK_WHOLE_SIZE, 0, &block->mappedData);
+        assert(result == VK_SUCCESS);
+    }
+
+    blockList.push_back(block);
+    return block;
+}
+
+void MemoryAllocator::destroyBlock(MemoryBlock* block)
+{
+    if (block->mappedData) {
+        vkUnmapMemory(deviceObj->device, block->memory);
+    }
+    vkFreeMemory(deviceObj->device, block->memory, NULL);
+    delete block->subAllocator;
+    delete block;
+}
+
+VkResult MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags requiredFlags, bool linearResource,
+    AllocationStrategy strategy, MemoryAllocation* allocation)
+{
+    uint32_t memoryTypeIndex;
+    if (!deviceObj->memoryTypeFromProperties(requirements.memoryTypeBits, requiredFlags, &memoryTypeIndex)) {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+
+    VkDeviceSize offset = 0;
+    MemoryBlock* target = NULL;
+
+    // Don't let a block take more than an eighth of a small heap. The size is a power of two,
+    // the buddy allocator could not use the rest of the block.
+    uint32_t heapIndex = deviceObj->memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    VkDeviceSize typeBlockSize = 1;
+    while (typeBlockSize * 2 <= std::min(blockSize, deviceObj->memoryProperties.memoryHeaps[heapIndex].size / 8)) {
+        typeBlockSize *= 2;
+    }
+
+    if (requirements.size > typeBlockSize / 2) {
+        // Large resources get a block of their own, they would fragment shared blocks.
+        target = createBlock(memoryTypeIndex, ALLOCATION_STRATEGY_FREE_LIST, requirements.size, true);
+        if (!target) {
+            return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        }
+        target->subAllocator->allocate(requirements.size, requirements.alignment, linearResource, &offset);
+    } else {
+        for (auto block : blockList) {
+            if (block->memoryTypeIndex == memoryTypeIndex && block->strategy == strategy && !block->dedicated &&
+                block->subAllocator->allocate(requirements.size, requirements.alignment, linearResource, &offset)) {
+                target = block;
+                break;
+            }
+        }
+
+        // No room in the existing blocks, reserve a new one.
+        if (!target) {
+            target = createBlock(memoryTypeIndex, strategy, typeBlockSize, false);
+            if (!target) {
+                return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+            }
+            if (!target->subAllocator->allocate(requirements.size, requirements.alignment, linearResource, &offset)) {
+                // Even an empty block cannot hold it, e.g. for its alignment. Don't keep the block.
+                blockList.pop_back();
+                destroyBlock(target);
+                return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+            }
+        }
+    }
+
+    allocation->memory = target->memory;
+    allocation->offset = offset;
+    allocation->size = requirements.size;
+    allocation->memoryTypeIndex = memoryTypeIndex;
+    allocation->mappedData = target->mappedData ? (char*)target->mappedData + offset : NULL;
+    allocation->block = target;
+    return VK_SUCCESS;
+}
+
+VkResult MemoryAllocator::allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags requiredFlags, AllocationStrategy strategy, MemoryAllocation* allocation)
+{
+    VkMemoryRequirements memRqrmnt;
+    vkGetBufferMemoryRequirements(deviceObj->device, buffer, &memRqrmnt);
+
+    VkResult result = allocate(memRqrmnt, requiredFlags, true, strategy, allocation);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+    return vkBindBufferMemory(deviceObj->device, buffer, allocation->memory, allocation->offset);
+}
+
+VkResult MemoryAllocator::allocateForImage(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags requiredFlags, AllocationStrategy strategy, MemoryAllocation* allocation)
+{
+    VkMemoryRequirements memRqrmnt;
+    vkGetImageMemoryRequirements(deviceObj->device, image, &memRqrmnt);
+
+    VkResult result = allocate(memRqrmnt, requiredFlags, tiling == VK_IMAGE_TILING_LINEAR, strategy, allocation);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+    return vkBindImageMemory(deviceObj->device, image, allocation->memory, allocation->offset);
+}
+
+void MemoryAllocator::free(MemoryAllocation& allocation)
+{
+    if (!allocation.block) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+
+    MemoryBlock* block = allocation.block;
+    block->subAllocator->free(allocation.offset);
+    allocation = MemoryAllocation();
+
+    if (!block->subAllocator->isEmpty()) {
+        return;
+    }
+
+    // Release empty blocks, but keep one spare per memory type and strategy
+    // so that alternating alloc/free does not hit vkAllocateMemory every time.
+    bool keepAsSpare = !block->dedicated;
+    for (auto other : blockList) {
+        if (other != block && other->memoryTypeIndex == block->memoryTypeIndex && other->strategy == block->strategy &&
+            !other->dedicated && other->subAllocator->isEmpty()) {
+            keepAsSpare = false;
+            break;
+        }
+    }
+
+    if (!keepAsSpare) {
+        blockList.erase(std::find(blockList.begin(), blockList.end(), block));
+        destroyBlock(block);
+    }
+}
+
+MemoryAllocatorStats MemoryAllocator::getStats()
+{
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+
+    MemoryAllocatorStats stats = {};
+    VkDeviceSize largestFreeSum = 0;
+    for (auto block : blockList) {
+        SubAllocatorStats blockStats = block->subAllocator->getStats();
+        stats.blockCount++;
+        stats.allocationCount += blockStats.allocationCount;
+        stats.reservedBytes += blockStats.size;
+        stats.usedBytes += blockStats.usedBytes;
+        stats.largestFreeRange = std::max(stats.largestFreeRange, blockStats.largestFreeRange);
+        largestFreeSum += blockStats.largestFreeRange;
+    }
+
+    // A block's free space can only be used up to its largest range,
+    // the rest counts as fragmented.
+    VkDeviceSize freeBytes = stats.reservedBytes - stats.usedBytes;
+    stats.fragmentation = freeBytes ? 1.0 - (double)largestFreeSum / (double)freeBytes : 0.0;
+    stats.utilization = stats.reservedBytes ? (double)stats.usedBytes / (double)stats.reservedBytes : 0.0;
+    return stats;
+}
+
+void MemoryAllocator::printStats()
+{
+    MemoryAllocatorStats stats = getStats();
+    std::cout << "Device memory: " << stats.blockCount << " blocks, "
+              << stats.allocationCount << " allocations, "
+              << stats.usedBytes << " / " << stats.reservedBytes << " bytes used" << std::endl;
+    std::cout << "\tUtilization: " << stats.utilization * 100.0 << "%"
+              << ", fragmentation: " << stats.fragmentation * 100.0 << "%" << std::endl;
+}
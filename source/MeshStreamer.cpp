@@ -0,0 +1,302 @@
+#include "MeshStreamer.h"
+#include "VulkanDevice.h"
+#include "StagingRing.h"
+#include <fstream>
+#include <chrono>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MeshStreamer::MeshStreamer()
+{
+    deviceObj = NULL;
+    stagingRing = NULL;
+    bytesPerUpdate = DEFAULT_BYTES_PER_UPDATE;
+    stats = {};
+}
+
+MeshStreamer::~MeshStreamer()
+{
+}
+
+void MeshStreamer::createMeshStreamer(VulkanDevice* inDeviceObj, StagingRing* inStagingRing, VkDeviceSize inBytesPerUpdate)
+{
+    deviceObj = inDeviceObj;
+    stagingRing = inStagingRing;
+    bytesPerUpdate = inBytesPerUpdate;
+}
+
+void MeshStreamer::destroyMeshStreamer()
+{
+    while (!meshes.empty()) {
+        closeMesh(meshes.back());
+    }
+}
+
+StreamedMesh* MeshStreamer::openMesh(const std::string& path)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    StreamedMesh* mesh = new StreamedMesh();
+    mesh->path = path;
+    mesh->header = NULL;
+    mesh->fileData = NULL;
+    mesh->fileSize = 0;
+    for (uint32_t i = 0; i < MESH_MAX_LODS; i++) {
+        mesh->lods[i].state = MESH_LOD_UNLOADED;
+        mesh->lods[i].buffer = VK_NULL_HANDLE;
+        mesh->lods[i].uploadedBytes = 0;
+    }
+
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat fileStat;
+    if (fd >= 0 && fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+        void* mapping = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            mesh->fileData = (const uint8_t*)mapping;
+            mesh->fileSize = (size_t)fileStat.st_size;
+        }
+    }
+    if (fd >= 0) {
+        close(fd); // The mapping stays valid.
+    }
+#else
+    std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+    if (file.is_open()) {
+        mesh->fileCopy.resize((size_t)file.tellg());
+        file.seekg(0);
+        if (!mesh->fileCopy.empty() && file.read((char*)mesh->fileCopy.data(), mesh->fileCopy.size())) {
+            mesh->fileData = mesh->fileCopy.data();
+            mesh->fileSize = mesh->fileCopy.size();
+        }
+    }
+#endif
+
+    if (!mesh->fileData) {
+        std::cout << "Cannot read mesh file " << path << std::endl;
+        delete mesh;
+        return NULL;
+    }
+
+    mesh->header = (const MeshFileHeader*)mesh->fileData;
+    if (!validateHeader(*mesh)) {
+        std::cout << path << " is not a valid mesh file" << std::endl;
+        unmapMesh(mesh);
+        delete mesh;
+        return NULL;
+    }
+
+    meshes.push_back(mesh);
+    stats.meshesOpened++;
+    stats.bytesMapped += mesh->fileSize;
+    stats.openMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return mesh;
+}
+
+bool MeshStreamer::validateHeader(const StreamedMesh& mesh) const
+{
+    if (mesh.fileSize < sizeof(MeshFileHeader)) {
+        return false;
+    }
+
+    const MeshFileHeader& header = *mesh.header;
+    if (header.magic != MESH_FILE_MAGIC || header.version != MESH_FILE_VERSION
+        || header.vertexStride != sizeof(MeshVertex) || header.fileSize != mesh.fileSize
+        || header.lodCount == 0 || header.lodCount > MESH_MAX_LODS) {
+        return false;
+    }
+
+    // Every section must lie inside its block, and every block inside the file.
+    for (uint32_t i = 0; i < header.lodCount; i++) {
+        const MeshLod& lod = header.lods[i];
+        if (lod.blockOffset % MESH_LOD_ALIGNMENT != 0 || lod.blockOffset > mesh.fileSize
+            || lod.blockSize == 0 || lod.blockSize > mesh.fileSize - lod.blockOffset) {
+            return false;
+        }
+        if (lod.indexSize != 2 && lod.indexSize != 4) {
+            return false;
+        }
+        if ((uint64_t)lod.vertexCount * sizeof(MeshVertex) > lod.indexOffset
+            || lod.indexOffset > lod.meshletOffset
+            || (uint64_t)lod.indexCount * lod.indexSize > lod.meshletOffset - lod.indexOffset
+            || lod.meshletOffset > lod.blockSize
+            || (uint64_t)lod.meshletCount * sizeof(MeshMeshlet) > lod.blockSize - lod.meshletOffset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void MeshStreamer::unmapMesh(StreamedMesh* mesh)
+{
+#ifndef _WIN32
+    if (mesh->fileData) {
+        munmap((void*)mesh->fileData, mesh->fileSize);
+    }
+#else
+    mesh->fileCopy.clear();
+#endif
+    mesh->fileData = NULL;
+    mesh->header = NULL;
+}
+
+void MeshStreamer::closeMesh(StreamedMesh* mesh)
+{
+    for (uint32_t i = 0; i < mesh->header->lodCount; i++) {
+        evictLod(mesh, i);
+    }
+
+    unmapMesh(mesh);
+    meshes.erase(std::find(meshes.begin(), meshes.end(), mesh));
+    delete mesh;
+}
+
+void MeshStreamer::createLodBuffer(StreamedMesh* mesh, uint32_t lod)
+{
+    const MeshLod& fileLod = mesh->header->lods[lod];
+    MeshLodBuffer& lodBuffer = mesh->lods[lod];
+
+    // One buffer for the whole block, bound as vertex, index and meshlet data at its offsets.
+    VkBufferCreateInfo bufInfo = {};
+    bufInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufInfo.pNext = NULL;
+    bufInfo.flags = 0;
+    bufInfo.size = fileLod.blockSize;
+    bufInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+        | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    bufInfo.queueFamilyIndexCount = 0;
+    bufInfo.pQueueFamilyIndices = NULL;
+
+    VkResult result = vkCreateBuffer(deviceObj->device, &bufInfo, NULL, &lodBuffer.buffer);
+    assert(result == VK_SUCCESS);
+    deviceObj->setObjectName(VK_OBJECT_TYPE_BUFFER, lodBuffer.buffer, mesh->path.c_str());
+
+    result = deviceObj->memoryAllocator.allocateForBuffer(lodBuffer.buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        ALLOCATION_STRATEGY_FREE_LIST, &lodBuffer.allocation);
+    assert(result == VK_SUCCESS);
+}
+
+void MeshStreamer::destroyLodBuffer(MeshLodBuffer& lodBuffer)
+{
+    // Frames in flight may still draw from it, and copies into it may still be queued
+    // for the frame being recorded.
+    deviceObj->deletionQueue.destroyObject(VK_OBJECT_TYPE_BUFFER, lodBuffer.buffer);
+    deviceObj->deletionQueue.freeAllocation(lodBuffer.allocation);
+    lodBuffer.buffer = VK_NULL_HANDLE;
+    lodBuffer.allocation = MemoryAllocation();
+    lodBuffer.state = MESH_LOD_UNLOADED;
+    lodBuffer.uploadedBytes = 0;
+}
+
+void MeshStreamer::requestLod(StreamedMesh* mesh, uint32_t lod)
+{
+    assert(lod < mesh->header->lodCount);
+    MeshLodBuffer& lodBuffer = mesh->lods[lod];
+    if (lodBuffer.state != MESH_LOD_UNLOADED) {
+        return;
+    }
+
+    createLodBuffer(mesh, lod);
+    lodBuffer.state = MESH_LOD_QUEUED;
+    lodBuffer.uploadedBytes = 0;
+
+#ifndef _WIN32
+    // Start reading the block from disk now, so the copies do not fault page by page.
+    const MeshLod& fileLod = mesh->header->lods[lod];
+    madvise((void*)(mesh->fileData + fileLod.blockOffset), (size_t)fileLod.blockSize, MADV_WILLNEED);
+#endif
+
+    LodRequest request;
+    request.mesh = mesh;
+    request.lod = lod;
+    requests.push_back(request);
+}
+
+void MeshStreamer::evictLod(StreamedMesh* mesh, uint32_t lod)
+{
+    MeshLodBuffer& lodBuffer = mesh->lods[lod];
+    if (lodBuffer.state == MESH_LOD_UNLOADED) {
+        return;
+    }
+
+    if (lodBuffer.state == MESH_LOD_QUEUED) {
+        for (auto it = requests.begin(); it != requests.end(); ++it) {
+            if (it->mesh == mesh && it->lod == lod) {
+                requests.erase(it);
+                break;
+            }
+        }
+    }
+
+    destroyLodBuffer(lodBuffer);
+    stats.lodsEvicted++;
+}
+
+uint32_t MeshStreamer::getResidentLod(const StreamedMesh* mesh, uint32_t preferredLod) const
+{
+    uint32_t lodCount = mesh->header->lodCount;
+    for (uint32_t i = std::min(preferredLod, lodCount - 1); i < lodCount; i++) {
+        if (mesh->lods[i].state == MESH_LOD_RESIDENT) {
+            return i;
+        }
+    }
+    for (uint32_t i = std::min(preferredLod, lodCount); i-- > 0;) {
+        if (mesh->lods[i].state == MESH_LOD_RESIDENT) {
+            return i;
+        }
+    }
+    return INVALID_LOD;
+}
+
+void MeshStreamer::update()
+{
+    if (requests.empty()) {
+        return;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Slices well below the ring size, so one slice never waits for the whole ring to drain.
+    VkDeviceSize maxSlice = std::max<VkDeviceSize>(stagingRing->getRingSize() / 4, 4);
+    VkDeviceSize budget = bytesPerUpdate;
+    while (!requests.empty() && budget > 0) {
+        LodRequest request = requests.front();
+        const MeshLod& fileLod = request.mesh->header->lods[request.lod];
+        MeshLodBuffer& lodBuffer = request.mesh->lods[request.lod];
+
+        // The block is copied as it is stored, the mapped pages are the copy source.
+        VkDeviceSize slice = std::min(std::min(budget, maxSlice), fileLod.blockSize - lodBuffer.uploadedBytes);
+        const uint8_t* source = request.mesh->fileData + fileLod.blockOffset + lodBuffer.uploadedBytes;
+        bool queued = stagingRing->uploadBuffer(lodBuffer.buffer, lodBuffer.uploadedBytes, source, slice);
+        assert(queued);
+
+        lodBuffer.uploadedBytes += slice;
+        budget -= slice;
+        stats.bytesUploaded += slice;
+
+        if (lodBuffer.uploadedBytes == fileLod.blockSize) {
+            lodBuffer.state = MESH_LOD_RESIDENT;
+            stats.lodsUploaded++;
+            requests.pop_front();
+#ifndef _WIN32
+            // The device has its own copy, the pages can leave the process.
+            madvise((void*)(request.mesh->fileData + fileLod.blockOffset), (size_t)fileLod.blockSize, MADV_DONTNEED);
+#endif
+        }
+    }
+
+    stats.uploadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void MeshStreamer::printStats() const
+{
+    std::cout << "Mesh streaming: " << stats.meshesOpened << " meshes mapped (" << stats.bytesMapped
+              << " bytes) in " << stats.openMs << " ms, " << stats.lodsUploaded << " LODs uploaded ("
+              << stats.bytesUploaded << " bytes) in " << stats.uploadMs << " ms, "
+              << stats.lodsEvicted << " evicted" << std::endl;
+}
@@ -0,0 +1,202 @@
+#include "OffscreenTarget.h"
+#include "VulkanDevice.h"
+#include <cstdio>
+
+OffscreenTarget::OffscreenTarget()
+{
+    deviceObj = NULL;
+    renderPass = VK_NULL_HANDLE;
+    format = DEFAULT_FORMAT;
+    width = 0;
+    height = 0;
+}
+
+OffscreenTarget::~OffscreenTarget()
+{
+}
+
+void OffscreenTarget::createRenderPass()
+{
+    VkAttachmentDescription colorAttachment = {};
+    colorAttachment.flags = 0;
+    colorAttachment.format = format;
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; // Every frame overwrites the whole image.
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+    VkAttachmentReference colorReference = {};
+    colorReference.attachment = 0;
+    colorReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass = {};
+    subpass.flags = 0;
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.inputAttachmentCount = 0;
+    subpass.pInputAttachments = NULL;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorReference;
+    subpass.pResolveAttachments = NULL;
+    subpass.pDepthStencilAttachment = NULL;
+    subpass.preserveAttachmentCount = 0;
+    subpass.pPreserveAttachments = NULL;
+
+    // The previous readback of the image must finish before it is cleared again, and the
+    // rendering must finish before the image is copied out.
+    VkSubpassDependency dependencies[2] = {};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].srcAccessMask = 0;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    VkRenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.pNext = NULL;
+    renderPassInfo.flags = 0;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &colorAttachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 2;
+    renderPassInfo.pDependencies = dependencies;
+
+    VkResult result = vkCreateRenderPass(deviceObj->device, &renderPassInfo, NULL, &renderPass);
+    assert(result == VK_SUCCESS);
+    deviceObj->setObjectName(VK_OBJECT_TYPE_RENDER_PASS, renderPass, "Offscreen render pass");
+}
+
+void OffscreenTarget::createOffscreenTarget(VulkanDevice* inDeviceObj, uint32_t inWidth, uint32_t inHeight, uint32_t imageCount, VkFormat inFormat)
+{
+    VkResult result;
+
+    deviceObj = inDeviceObj;
+    width = inWidth;
+    height = inHeight;
+    format = inFormat;
+
+    createRenderPass();
+
+    images.resize(imageCount);
+    for (uint32_t i = 0; i < imageCount; i++) {
+        OffscreenImage& target = images[i];
+
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.pNext = NULL;
+        imageInfo.flags = 0;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = format;
+        imageInfo.extent.width = width;
+        imageInfo.extent.height = height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.queueFamilyIndexCount = 0;
+        imageInfo.pQueueFamilyIndices = NULL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        result = vkCreateImage(deviceObj->device, &imageInfo, NULL, &target.image);
+        assert(result == VK_SUCCESS);
+
+        result = deviceObj->memoryAllocator.allocateForImage(target.image, VK_IMAGE_TILING_OPTIMAL,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ALLOCATION_STRATEGY_FREE_LIST, &target.memory);
+        assert(result == VK_SUCCESS);
+
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.pNext = NULL;
+        viewInfo.flags = 0;
+        viewInfo.image = target.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+        viewInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+        viewInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+        viewInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        result = vkCreateImageView(deviceObj->device, &viewInfo, NULL, &target.view);
+        assert(result == VK_SUCCESS);
+
+        VkFramebufferCreateInfo framebufferInfo = {};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.pNext = NULL;
+        framebufferInfo.flags = 0;
+        framebufferInfo.renderPass = renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &target.view;
+        framebufferInfo.width = width;
+        framebufferInfo.height = height;
+        framebufferInfo.layers = 1;
+
+        result = vkCreateFramebuffer(deviceObj->device, &framebufferInfo, NULL, &target.framebuffer);
+        assert(result == VK_SUCCESS);
+
+        char name[64];
+        snprintf(name, sizeof(name), "Offscreen image %u", i);
+        deviceObj->setObjectName(VK_OBJECT_TYPE_IMAGE, target.image, name);
+        snprintf(name, sizeof(name), "Offscreen framebuffer %u", i);
+        deviceObj->setObjectName(VK_OBJECT_TYPE_FRAMEBUFFER, target.framebuffer, name);
+    }
+}
+
+void OffscreenTarget::destroyOffscreenTarget()
+{
+    for (auto& target : images) {
+        vkDestroyFramebuffer(deviceObj->device, target.framebuffer, NULL);
+        vkDestroyImageView(deviceObj->device, target.view, NULL);
+        vkDestroyImage(deviceObj->device, target.image, NULL);
+        deviceObj->memoryAllocator.free(target.memory);
+    }
+    images.clear();
+
+    if (renderPass != VK_NULL_HANDLE) {
+        deviceObj->pipelineManager.evictObject(renderPass);
+        vkDestroyRenderPass(deviceObj->device, renderPass, NULL);
+        renderPass = VK_NULL_HANDLE;
+    }
+}
+
+void OffscreenTarget::beginRenderPass(VkCommandBuffer cmdBuffer, uint32_t imageIndex, const float clearColor[4])
+{
+    VkClearValue clearValue = {};
+    memcpy(clearValue.color.float32, clearColor, sizeof(clearValue.color.float32));
+
+    VkRenderPassBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    beginInfo.pNext = NULL;
+    beginInfo.renderPass = renderPass;
+    beginInfo.framebuffer = images[imageIndex].framebuffer;
+    beginInfo.renderArea.offset.x = 0;
+    beginInfo.renderArea.offset.y = 0;
+    beginInfo.renderArea.extent.width = width;
+    beginInfo.renderArea.extent.height = height;
+    beginInfo.clearValueCount = 1;
+    beginInfo.pClearValues = &clearValue;
+
+    vkCmdBeginRenderPass(cmdBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+}
+
+void OffscreenTarget::endRenderPass(VkCommandBuffer cmdBuffer)
+{
+    vkCmdEndRenderPass(cmdBuffer);
+}
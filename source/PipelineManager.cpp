@@ -0,0 +1,489 @@
+#include "PipelineManager.h"
+#include "VulkanDevice.h"
+#include "CpuProfiler.h"
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+
+// Size of VkPipelineCacheHeaderVersionOne: headerSize, headerVersion, vendorID, deviceID, UUID.
+static const size_t CACHE_HEADER_SIZE = 16 + VK_UUID_SIZE;
+
+// Appends the raw bytes of plain values, handles and arrays to the pipeline key.
+// Pointers inside the create infos are followed, never stored, so two requests
+// with equal state but different addresses produce the same key.
+class PipelineKeyWriter {
+public:
+    explicit PipelineKeyWriter(std::string& inKey) : key(inKey) { }
+
+    template <typename T>
+    void write(const T& value) { key.append((const char*)&value, sizeof(T)); }
+
+    void writeBytes(const void* data, size_t size)
+    {
+        write(size);
+        if (size) {
+            key.append((const char*)data, size);
+        }
+    }
+
+    template <typename T>
+    void writeArray(const T* items, uint32_t count) { writeBytes(items, items ? count * sizeof(T) : 0); }
+
+    void writeString(const char* str) { writeBytes(str, str ? strlen(str) : 0); }
+
+    // Optional state is prefixed by a presence flag, so a missing struct differs from a zeroed one.
+    bool writePresent(const void* ptr)
+    {
+        write((uint8_t)(ptr != NULL));
+        return ptr != NULL;
+    }
+
+    void writeStage(const VkPipelineShaderStageCreateInfo& stage)
+    {
+        write(stage.flags);
+        write(stage.stage);
+        write(stage.module);
+        writeString(stage.pName);
+        if (writePresent(stage.pSpecializationInfo)) {
+            const VkSpecializationInfo& spec = *stage.pSpecializationInfo;
+            writeArray(spec.pMapEntries, spec.mapEntryCount);
+            writeBytes(spec.pData, spec.dataSize);
+        }
+    }
+
+private:
+    std::string& key;
+};
+
+static bool hasExtensionChain(const VkGraphicsPipelineCreateInfo& info)
+{
+    if (info.pNext) {
+        return true;
+    }
+    for (uint32_t i = 0; i < info.stageCount; i++) {
+        if (info.pStages[i].pNext) {
+            return true;
+        }
+    }
+    return (info.pVertexInputState && info.pVertexInputState->pNext)
+        || (info.pInputAssemblyState && info.pInputAssemblyState->pNext)
+        || (info.pTessellationState && info.pTessellationState->pNext)
+        || (info.pViewportState && info.pViewportState->pNext)
+        || (info.pRasterizationState && info.pRasterizationState->pNext)
+        || (info.pMultisampleState && info.pMultisampleState->pNext)
+        || (info.pDepthStencilState && info.pDepthStencilState->pNext)
+        || (info.pColorBlendState && info.pColorBlendState->pNext)
+        || (info.pDynamicState && info.pDynamicState->pNext);
+}
+
+static void buildGraphicsKey(const VkGraphicsPipelineCreateInfo& info, std::string& key)
+{
+    PipelineKeyWriter writer(key);
+    writer.write((uint8_t)VK_PIPELINE_BIND_POINT_GRAPHICS);
+    writer.write(info.flags);
+
+    writer.write(info.stageCount);
+    for (uint32_t i = 0; i < info.stageCount; i++) {
+        writer.writeStage(info.pStages[i]);
+    }
+
+    if (writer.writePresent(info.pVertexInputState)) {
+        const VkPipelineVertexInputStateCreateInfo& state = *info.pVertexInputState;
+        writer.write(state.flags);
+        writer.writeArray(state.pVertexBindingDescriptions, state.vertexBindingDescriptionCount);
+        writer.writeArray(state.pVertexAttributeDescriptions, state.vertexAttributeDescriptionCount);
+    }
+    if (writer.writePresent(info.pInputAssemblyState)) {
+        const VkPipelineInputAssemblyStateCreateInfo& state = *info.pInputAssemblyState;
+        writer.write(state.flags);
+        writer.write(state.topology);
+        writer.write(state.primitiveRestartEnable);
+    }
+    if (writer.writePresent(info.pTessellationState)) {
+        writer.write(info.pTessellationState->flags);
+        writer.write(info.pTessellationState->patchControlPoints);
+    }
+    if (writer.writePresent(info.pViewportState)) {
+        const VkPipelineViewportStateCreateInfo& state = *info.pViewportState;
+        writer.write(state.flags);
+        writer.write(state.viewportCount);
+        writer.write(state.scissorCount);
+        // Viewports and scissors are usually dynamic, the arrays are ignored then.
+        writer.writeArray(state.pViewports, state.viewportCount);
+        writer.writeArray(state.pScissors, state.scissorCount);
+    }
+    if (writer.writePresent(info.pRasterizationState)) {
+        const VkPipelineRasterizationStateCreateInfo& state = *info.pRasterizationState;
+        writer.write(state.flags);
+        writer.write(state.depthClampEnable);
+        writer.write(state.rasterizerDiscardEnable);
+        writer.write(state.polygonMode);
+        writer.write(state.cullMode);
+        writer.write(state.frontFace);
+        writer.write(state.depthBiasEnable);
+        writer.write(state.depthBiasConstantFactor);
+        writer.write(state.depthBiasClamp);
+        writer.write(state.depthBiasSlopeFactor);
+        writer.write(state.lineWidth);
+    }
+    if (writer.writePresent(info.pMultisampleState)) {
+        const VkPipelineMultisampleStateCreateInfo& state = *info.pMultisampleState;
+        writer.write(state.flags);
+        writer.write(state.rasterizationSamples);
+        writer.write(state.sampleShadingEnable);
+        writer.write(state.minSampleShading);
+        writer.writeArray(state.pSampleMask, (state.rasterizationSamples + 31) / 32);
+        writer.write(state.alphaToCoverageEnable);
+        writer.write(state.alphaToOneEnable);
+    }
+    if (writer.writePresent(info.pDepthStencilState)) {
+        const VkPipelineDepthStencilStateCreateInfo& state = *info.pDepthStencilState;
+        writer.write(state.flags);
+        writer.write(state.depthTestEnable);
+        writer.write(state.depthWriteEnable);
+        writer.write(state.depthCompareOp);
+        writer.write(state.depthBoundsTestEnable);
+        writer.write(state.stencilTestEnable);
+        writer.write(state.front);
+        writer.write(state.back);
+        writer.write(state.minDepthBounds);
+        writer.write(state.maxDepthBounds);
+    }
+    if (writer.writePresent(info.pColorBlendState)) {
+        const VkPipelineColorBlendStateCreateInfo& state = *info.pColorBlendState;
+        writer.write(state.flags);
+        writer.write(state.logicOpEnable);
+        writer.write(state.logicOp);
+        for (uint32_t i = 0; i < state.attachmentCount; i++) {
+            const VkPipelineColorBlendAttachmentState& attachment = state.pAttachments[i];
+            writer.write(attachment.blendEnable);
+            writer.write(attachment.srcColorBlendFactor);
+            writer.write(attachment.dstColorBlendFactor);
+            writer.write(attachment.colorBlendOp);
+            writer.write(attachment.srcAlphaBlendFactor);
+            writer.write(attachment.dstAlphaBlendFactor);
+            writer.write(attachment.alphaBlendOp);
+            writer.write(attachment.colorWriteMask);
+        }
+        writer.write(state.blendConstants);
+    }
+    if (writer.writePresent(info.pDynamicState)) {
+        writer.write(info.pDynamicState->flags);
+        writer.writeArray(info.pDynamicState->pDynamicStates, info.pDynamicState->dynamicStateCount);
+    }
+
+    writer.write(info.layout);
+    writer.write(info.renderPass);
+    writer.write(info.subpass);
+    writer.write(info.basePipelineHandle);
+}
+
+// Objects the key refers to by handle. The handle of a destroyed object may come back for
+// another one, so the pipelines keyed on it are evicted when it is destroyed.
+static void getGraphicsKeyObjects(const VkGraphicsPipelineCreateInfo& info, std::vector<uint64_t>& objects)
+{
+    for (uint32_t i = 0; i < info.stageCount; i++) {
+        objects.push_back((uint64_t)info.pStages[i].module);
+    }
+    objects.push_back((uint64_t)info.layout);
+    objects.push_back((uint64_t)info.renderPass);
+}
+
+static void buildComputeKey(const VkComputePipelineCreateInfo& info, std::string& key)
+{
+    PipelineKeyWriter writer(key);
+    writer.write((uint8_t)VK_PIPELINE_BIND_POINT_COMPUTE);
+    writer.write(info.flags);
+    writer.writeStage(info.stage);
+    writer.write(info.layout);
+    writer.write(info.basePipelineHandle);
+}
+
+PipelineManager::PipelineManager()
+{
+    deviceObj = NULL;
+    pipelineCache = VK_NULL_HANDLE;
+    stats = {};
+}
+
+PipelineManager::~PipelineManager()
+{
+}
+
+bool PipelineManager::isCacheDataCompatible(const void* data, size_t size, const VkPhysicalDeviceProperties& gpuProps)
+{
+    if (!data || size < CACHE_HEADER_SIZE) {
+        return false;
+    }
+
+    // The header is a sequence of little endian words followed by the UUID bytes.
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint32_t words[4];
+    for (uint32_t i = 0; i < 4; i++) {
+        words[i] = bytes[i * 4] | (bytes[i * 4 + 1] << 8) | (bytes[i * 4 + 2] << 16) | ((uint32_t)bytes[i * 4 + 3] << 24);
+    }
+    uint32_t headerSize = words[0];
+    uint32_t headerVersion = words[1];
+    uint32_t vendorID = words[2];
+    uint32_t deviceID = words[3];
+
+    return headerSize >= CACHE_HEADER_SIZE && headerSize <= size
+        && headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && vendorID == gpuProps.vendorID
+        && deviceID == gpuProps.deviceID
+        && memcmp(bytes + 16, gpuProps.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void PipelineManager::createPipelineManager(VulkanDevice* inDeviceObj, const std::string& inCacheFilePath)
+{
+    PROFILE_SCOPE("PipelineManager::createPipelineManager");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    deviceObj = inDeviceObj;
+    cacheFilePath = inCacheFilePath;
+
+    // 1. Read the previous run's cache, if there is one.
+    std::vector<char> cacheData;
+    if (!cacheFilePath.empty()) {
+        std::ifstream file(cacheFilePath.c_str(), std::ios::binary | std::ios::ate);
+        if (file) {
+            std::streamoff fileSize = file.tellg();
+            if (fileSize > 0) {
+                cacheData.resize((size_t)fileSize);
+                file.seekg(0);
+                if (!file.read(cacheData.data(), fileSize)) {
+                    cacheData.clear();
+                }
+            }
+        }
+    }
+
+    // 2. Drop it if it was written by another driver or GPU, the driver would reject
+    //    or, worse, misinterpret it.
+    if (!cacheData.empty() && !isCacheDataCompatible(cacheData.data(), cacheData.size(), deviceObj->gpuProps)) {
+        std::cout << "Pipeline cache " << cacheFilePath << " belongs to another device or driver, starting cold" << std::endl;
+        cacheData.clear();
+    }
+
+    // 3. Create the driver cache seeded with the accepted data.
+    VkPipelineCacheCreateInfo cacheInfo = {};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.pNext = NULL;
+    cacheInfo.flags = 0;
+    cacheInfo.initialDataSize = cacheData.size();
+    cacheInfo.pInitialData = cacheData.empty() ? NULL : cacheData.data();
+
+    VkResult result = vkCreatePipelineCache(deviceObj->device, &cacheInfo, NULL, &pipelineCache);
+    if (result != VK_SUCCESS && !cacheData.empty()) {
+        // Corrupt payload behind a valid header, retry without it.
+        cacheData.clear();
+        cacheInfo.initialDataSize = 0;
+        cacheInfo.pInitialData = NULL;
+        result = vkCreatePipelineCache(deviceObj->device, &cacheInfo, NULL, &pipelineCache);
+    }
+    assert(result == VK_SUCCESS);
+    deviceObj->setObjectName(VK_OBJECT_TYPE_PIPELINE_CACHE, pipelineCache, "Pipeline cache");
+
+    stats.loadedBytes = cacheData.size();
+    stats.loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void PipelineManager::destroyPipelineManager()
+{
+    if (!deviceObj) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    for (std::unordered_map<std::string, VkPipeline>::iterator it = pipelines.begin(); it != pipelines.end(); ++it) {
+        vkDestroyPipeline(deviceObj->device, it->second, NULL);
+    }
+    pipelines.clear();
+    keysByObject.clear();
+    for (size_t i = 0; i < uncachedPipelines.size(); i++) {
+        vkDestroyPipeline(deviceObj->device, uncachedPipelines[i], NULL);
+    }
+    uncachedPipelines.clear();
+
+    vkDestroyPipelineCache(deviceObj->device, pipelineCache, NULL);
+    pipelineCache = VK_NULL_HANDLE;
+    deviceObj = NULL;
+}
+
+bool PipelineManager::saveCache()
+{
+    if (!deviceObj || cacheFilePath.empty()) {
+        return false;
+    }
+
+    size_t dataSize = 0;
+    VkResult result = vkGetPipelineCacheData(deviceObj->device, pipelineCache, &dataSize, NULL);
+    if (result != VK_SUCCESS || dataSize == 0) {
+        return false;
+    }
+
+    std::vector<char> cacheData(dataSize);
+    result = vkGetPipelineCacheData(deviceObj->device, pipelineCache, &dataSize, cacheData.data());
+    if (result != VK_SUCCESS) {
+        return false;
+    }
+
+    // Write next to the old file and swap, a crash halfway leaves the previous cache intact.
+    // On Windows rename does not replace an existing file, the old one goes first there.
+    std::string tempPath = cacheFilePath + ".tmp";
+    {
+        std::ofstream file(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+        if (!file || !file.write(cacheData.data(), dataSize)) {
+            return false;
+        }
+    }
+#ifdef _WIN32
+    std::remove(cacheFilePath.c_str());
+#endif
+    if (std::rename(tempPath.c_str(), cacheFilePath.c_str()) != 0) {
+        return false;
+    }
+
+    stats.savedBytes = dataSize;
+    return true;
+}
+
+VkPipeline PipelineManager::findPipeline(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    std::unordered_map<std::string, VkPipeline>::iterator it = pipelines.find(key);
+    if (it == pipelines.end()) {
+        return VK_NULL_HANDLE;
+    }
+    stats.hits++;
+    return it->second;
+}
+
+// Two threads may compile the same state at once, the first one stored wins.
+VkPipeline PipelineManager::insertPipeline(const std::string& key, VkPipeline pipeline, const std::vector<uint64_t>& objects)
+{
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    std::pair<std::unordered_map<std::string, VkPipeline>::iterator, bool> inserted = pipelines.insert(std::make_pair(key, pipeline));
+    if (!inserted.second) {
+        vkDestroyPipeline(deviceObj->device, pipeline, NULL);
+        return inserted.first->second;
+    }
+
+    for (size_t i = 0; i < objects.size(); i++) {
+        if (objects[i] != 0) {
+            keysByObject.insert(std::make_pair(objects[i], key));
+        }
+    }
+    return pipeline;
+}
+
+void PipelineManager::evictHandle(uint64_t handle)
+{
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    std::pair<KeyMultimap::iterator, KeyMultimap::iterator> keys = keysByObject.equal_range(handle);
+    for (KeyMultimap::iterator it = keys.first; it != keys.second; ++it) {
+        // The pipeline may still be used, it is kept until the manager is destroyed. The entries
+        // of the key's other objects stay behind, they evict at most a later pipeline of the same key.
+        std::unordered_map<std::string, VkPipeline>::iterator found = pipelines.find(it->second);
+        if (found != pipelines.end()) {
+            uncachedPipelines.push_back(found->second);
+            pipelines.erase(found);
+            stats.evicted++;
+        }
+    }
+    keysByObject.erase(keys.first, keys.second);
+}
+
+VkResult PipelineManager::getGraphicsPipeline(const VkGraphicsPipelineCreateInfo& createInfo, VkPipeline* pipeline,
+    const char* name)
+{
+    bool keyed = !hasExtensionChain(createInfo);
+    std::string key;
+    if (keyed) {
+        buildGraphicsKey(createInfo, key);
+        *pipeline = findPipeline(key);
+        if (*pipeline != VK_NULL_HANDLE) {
+            return VK_SUCCESS;
+        }
+    }
+
+    // Compile outside the lock, creation may take milliseconds.
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    VkResult result = vkCreateGraphicsPipelines(deviceObj->device, pipelineCache, 1, &createInfo, NULL, pipeline);
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+    deviceObj->setObjectName(VK_OBJECT_TYPE_PIPELINE, *pipeline, name);
+
+    if (keyed) {
+        std::vector<uint64_t> objects;
+        getGraphicsKeyObjects(createInfo, objects);
+        *pipeline = insertPipeline(key, *pipeline, objects);
+    }
+
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    stats.createMs += elapsedMs;
+    if (keyed) {
+        stats.misses++;
+    } else {
+        stats.uncached++;
+        uncachedPipelines.push_back(*pipeline);
+    }
+    return result;
+}
+
+VkResult PipelineManager::getComputePipeline(const VkComputePipelineCreateInfo& createInfo, VkPipeline* pipeline,
+    const char* name)
+{
+    bool keyed = !createInfo.pNext && !createInfo.stage.pNext;
+    std::string key;
+    if (keyed) {
+        buildComputeKey(createInfo, key);
+        *pipeline = findPipeline(key);
+        if (*pipeline != VK_NULL_HANDLE) {
+            return VK_SUCCESS;
+        }
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    VkResult result = vkCreateComputePipelines(deviceObj->device, pipelineCache, 1, &createInfo, NULL, pipeline);
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+    deviceObj->setObjectName(VK_OBJECT_TYPE_PIPELINE, *pipeline, name);
+
+    if (keyed) {
+        std::vector<uint64_t> objects;
+        objects.push_back((uint64_t)createInfo.stage.module);
+        objects.push_back((uint64_t)createInfo.layout);
+        *pipeline = insertPipeline(key, *pipeline, objects);
+    }
+
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    stats.createMs += elapsedMs;
+    if (keyed) {
+        stats.misses++;
+    } else {
+        stats.uncached++;
+        uncachedPipelines.push_back(*pipeline);
+    }
+    return result;
+}
+
+PipelineCacheStats PipelineManager::getStats()
+{
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    return stats;
+}
+
+void PipelineManager::printStats()
+{
+    PipelineCacheStats current = getStats();
+    std::cout << "Pipeline cache: " << (current.loadedBytes ? "warm" : "cold") << " start, "
+              << current.loadedBytes << " bytes loaded in " << current.loadMs << " ms, "
+              << current.misses << " pipelines compiled in " << current.createMs << " ms, "
+              << current.hits << " map hits, " << current.uncached << " uncached, " << current.evicted << " evicted, "
+              << current.savedBytes << " bytes saved" << std::endl;
+}
@@ -0,0 +1,155 @@
+#include "ReadbackPool.h"
+#include "VulkanDevice.h"
+
+ReadbackPool::ReadbackPool()
+{
+    deviceObj = NULL;
+    buffer = VK_NULL_HANDLE;
+    coherent = true;
+    slotSize = 0;
+    stats = {};
+}
+
+ReadbackPool::~ReadbackPool()
+{
+}
+
+void ReadbackPool::createReadbackPool(VulkanDevice* inDeviceObj, uint32_t slotCount, VkDeviceSize inSlotSize)
+{
+    VkResult result;
+
+    deviceObj = inDeviceObj;
+
+    // Regions start at a non-coherent atom boundary, so each one can be invalidated on its own.
+    VkDeviceSize atomSize = std::max<VkDeviceSize>(deviceObj->gpuProps.limits.nonCoherentAtomSize, 16);
+    slotSize = (inSlotSize + atomSize - 1) / atomSize * atomSize;
+
+    VkBufferCreateInfo bufInfo = {};
+    bufInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufInfo.pNext = NULL;
+    bufInfo.flags = 0;
+    bufInfo.size = slotSize * slotCount;
+    bufInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    bufInfo.queueFamilyIndexCount = 0;
+    bufInfo.pQueueFamilyIndices = NULL;
+
+    result = vkCreateBuffer(deviceObj->device, &bufInfo, NULL, &buffer);
+    assert(result == VK_SUCCESS);
+    deviceObj->setObjectName(VK_OBJECT_TYPE_BUFFER, buffer, "Readback pool");
+
+    // Cached memory for fast CPU reads, any host visible memory otherwise.
+    result = deviceObj->memoryAllocator.allocateForBuffer(buffer,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+        ALLOCATION_STRATEGY_FREE_LIST, &memory);
+    if (result != VK_SUCCESS) {
+        result = deviceObj->memoryAllocator.allocateForBuffer(buffer,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            ALLOCATION_STRATEGY_FREE_LIST, &memory);
+    }
+    assert(result == VK_SUCCESS);
+    assert(memory.mappedData);
+
+    VkMemoryPropertyFlags memoryFlags = deviceObj->memoryProperties.memoryTypes[memory.memoryTypeIndex].propertyFlags;
+    coherent = (memoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+    slots.resize(slotCount);
+    for (uint32_t i = 0; i < slotCount; i++) {
+        slots[i].offset = slotSize * i;
+        slots[i].size = 0;
+        slots[i].frameNumber = 0;
+        slots[i].pending = false;
+    }
+}
+
+void ReadbackPool::destroyReadbackPool()
+{
+    slots.clear();
+    vkDestroyBuffer(deviceObj->device, buffer, NULL);
+    deviceObj->memoryAllocator.free(memory);
+    buffer = VK_NULL_HANDLE;
+}
+
+void ReadbackPool::recordImageCopy(VkCommandBuffer cmdBuffer, uint32_t slot, uint64_t frameNumber,
+    VkImage image, VkImageLayout layout, uint32_t width, uint32_t height, uint32_t texelSize)
+{
+    SlotRegion& region = slots[slot];
+    VkDeviceSize size = (VkDeviceSize)width * height * texelSize;
+    assert(size <= slotSize);
+
+    VkBufferImageCopy copyRegion = {};
+    copyRegion.bufferOffset = region.offset;
+    copyRegion.bufferRowLength = 0; // Tightly packed.
+    copyRegion.bufferImageHeight = 0;
+    copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copyRegion.imageSubresource.mipLevel = 0;
+    copyRegion.imageSubresource.baseArrayLayer = 0;
+    copyRegion.imageSubresource.layerCount = 1;
+    copyRegion.imageOffset.x = 0;
+    copyRegion.imageOffset.y = 0;
+    copyRegion.imageOffset.z = 0;
+    copyRegion.imageExtent.width = width;
+    copyRegion.imageExtent.height = height;
+    copyRegion.imageExtent.depth = 1;
+    vkCmdCopyImageToBuffer(cmdBuffer, image, layout, buffer, 1, &copyRegion);
+
+    // The fence wait alone does not make device writes visible to host reads.
+    VkBufferMemoryBarrier hostBarrier = {};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    hostBarrier.pNext = NULL;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.buffer = buffer;
+    hostBarrier.offset = region.offset;
+    hostBarrier.size = size;
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+        0, NULL, 1, &hostBarrier, 0, NULL);
+
+    region.size = size;
+    region.frameNumber = frameNumber;
+    region.pending = true;
+}
+
+const void* ReadbackPool::acquireData(uint32_t slot, uint64_t* frameNumber, VkDeviceSize* size)
+{
+    SlotRegion& region = slots[slot];
+    if (!region.pending) {
+        return NULL;
+    }
+    region.pending = false;
+
+    // Only the copied bytes, widened to whole atoms as the allocation offset need not be atom
+    // aligned. Past the end of the block memory only VK_WHOLE_SIZE is a valid end.
+    if (!coherent) {
+        VkDeviceSize atomSize = std::max<VkDeviceSize>(deviceObj->gpuProps.limits.nonCoherentAtomSize, 1);
+        VkDeviceSize start = memory.offset + region.offset;
+        VkDeviceSize end = (start + region.size + atomSize - 1) / atomSize * atomSize;
+
+        VkMappedMemoryRange range = {};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.pNext = NULL;
+        range.memory = memory.memory;
+        range.offset = start / atomSize * atomSize;
+        range.size = end <= memory.block->subAllocator->getSize() ? end - range.offset : VK_WHOLE_SIZE;
+        VkResult result = vkInvalidateMappedMemoryRanges(deviceObj->device, 1, &range);
+        assert(result == VK_SUCCESS);
+    }
+
+    stats.framesRead++;
+    stats.bytesRead += region.size;
+
+    if (frameNumber) {
+        *frameNumber = region.frameNumber;
+    }
+    if (size) {
+        *size = region.size;
+    }
+    return (const char*)memory.mappedData + region.offset;
+}
+
+void ReadbackPool::printStats() const
+{
+    std::cout << "Readback: " << stats.framesRead << " frames, " << stats.bytesRead / (1024 * 1024) << " MB read back" << std::endl;
+}
@@ -0,0 +1,1324 @@
+#include "RenderGraph.h"
+#include "VulkanDevice.h"
+#include "CommandBufferManager.h"
+
+namespace {
+
+const VkAccessFlags WRITE_ACCESS_MASK = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+    | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT
+    | VK_ACCESS_MEMORY_WRITE_BIT;
+
+// Where the hazards of a resource stand while the passes are walked in execution order.
+struct ResourceState {
+    VkImageLayout layout;
+    bool external; // Imported and not used yet in this execution, anything may have written it.
+    uint32_t writeBatch; // Of the last write or layout transition, INVALID_INDEX if none.
+    uint32_t writeQueue;
+    VkPipelineStageFlags writeStages;
+    VkAccessFlags writeAccess;
+    VkPipelineStageFlags visibleStages; // Stages of 'writeQueue' a barrier made the write visible to.
+    VkAccessFlags visibleAccess;
+    uint32_t visibleQueues; // Other queues that waited for the write, one bit each.
+    uint32_t readBatch[RENDER_QUEUE_COUNT]; // Latest read since the write on each queue.
+    VkPipelineStageFlags readStages[RENDER_QUEUE_COUNT];
+};
+
+VkImageUsageFlags imageUsageOf(VkAccessFlags accessMask, VkImageLayout layout)
+{
+    VkImageUsageFlags usage = 0;
+    if (accessMask & (VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT)) {
+        usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    }
+    if (accessMask & (VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT)) {
+        usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    }
+    if (accessMask & VK_ACCESS_INPUT_ATTACHMENT_READ_BIT) {
+        usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+    }
+    if (accessMask & (VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT)) {
+        usage |= layout == VK_IMAGE_LAYOUT_GENERAL ? VK_IMAGE_USAGE_STORAGE_BIT : VK_IMAGE_USAGE_SAMPLED_BIT;
+    }
+    if (accessMask & VK_ACCESS_TRANSFER_READ_BIT) {
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+    if (accessMask & VK_ACCESS_TRANSFER_WRITE_BIT) {
+        usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
+    return usage;
+}
+
+VkBufferUsageFlags bufferUsageOf(VkAccessFlags accessMask)
+{
+    VkBufferUsageFlags usage = 0;
+    if (accessMask & (VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT)) {
+        usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    }
+    if (accessMask & VK_ACCESS_UNIFORM_READ_BIT) {
+        usage |= VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    }
+    if (accessMask & VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT) {
+        usage |= VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    }
+    if (accessMask & VK_ACCESS_INDEX_READ_BIT) {
+        usage |= VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    }
+    if (accessMask & VK_ACCESS_INDIRECT_COMMAND_READ_BIT) {
+        usage |= VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    }
+    if (accessMask & VK_ACCESS_TRANSFER_READ_BIT) {
+        usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    }
+    if (accessMask & VK_ACCESS_TRANSFER_WRITE_BIT) {
+        usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    }
+    return usage;
+}
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+const uint32_t RenderGraph::INVALID_INDEX;
+
+RenderGraph::RenderGraph()
+{
+    deviceObj = NULL;
+    queueCount = 0;
+    for (uint32_t i = 0; i < RENDER_QUEUE_COUNT; i++) {
+        queues[i].queue = VK_NULL_HANDLE;
+        queues[i].familyIndex = 0;
+        queues[i].timeline = VK_NULL_HANDLE;
+        queues[i].lastSignaled = 0;
+        queues[i].batchCount = 0;
+        queueOfType[i] = 0;
+    }
+    compiled = false;
+    stats = {};
+    waitSemaphoresFn = NULL;
+}
+
+RenderGraph::~RenderGraph()
+{
+}
+
+void RenderGraph::createRenderGraph(VulkanDevice* inDeviceObj, uint32_t frameSlotCount)
+{
+    deviceObj = inDeviceObj;
+    VkDevice device = deviceObj->device;
+    VkResult result;
+
+    if (deviceObj->enabledFeatures.timelineSemaphore.timelineSemaphore) {
+        waitSemaphoresFn = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR");
+    }
+    if (!waitSemaphoresFn) {
+        std::cout << "Timeline semaphores not available, the render graph runs every pass on the graphics queue." << std::endl;
+    }
+
+    // Kinds of work sharing a queue, because the device has no separate one or because passes
+    // cannot wait for each other across queues, are scheduled as one queue.
+    VkQueue typeQueues[RENDER_QUEUE_COUNT] = { deviceObj->queue, deviceObj->computeQueue, deviceObj->transferQueue };
+    uint32_t typeFamilies[RENDER_QUEUE_COUNT] = { deviceObj->graphicsQueueIndex, deviceObj->computeQueueIndex, deviceObj->transferQueueIndex };
+    queueCount = 0;
+    for (uint32_t type = 0; type < RENDER_QUEUE_COUNT; type++) {
+        bool separate = waitSemaphoresFn && typeQueues[type] != VK_NULL_HANDLE;
+        VkQueue queue = separate ? typeQueues[type] : deviceObj->queue;
+        uint32_t familyIndex = separate ? typeFamilies[type] : deviceObj->graphicsQueueIndex;
+
+        uint32_t index = 0;
+        while (index < queueCount && queues[index].queue != queue) {
+            index++;
+        }
+        if (index == queueCount) {
+            queues[index].queue = queue;
+            queues[index].familyIndex = familyIndex;
+            queues[index].timeline = VK_NULL_HANDLE;
+            queues[index].lastSignaled = 0;
+            queues[index].batchCount = 0;
+            queueCount++;
+        }
+        queueOfType[type] = index;
+    }
+
+    // Each queue counts its submissions on a timeline, the other queues wait for the values.
+    if (waitSemaphoresFn) {
+        for (uint32_t i = 0; i < queueCount; i++) {
+            VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+            typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+            typeInfo.pNext = NULL;
+            typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+            typeInfo.initialValue = 0;
+
+            VkSemaphoreCreateInfo semaphoreInfo = {};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            semaphoreInfo.pNext = &typeInfo;
+            semaphoreInfo.flags = 0;
+
+            result = vkCreateSemaphore(device, &semaphoreInfo, NULL, &queues[i].timeline);
+            assert(result == VK_SUCCESS);
+            deviceObj->setObjectName(VK_OBJECT_TYPE_SEMAPHORE, queues[i].timeline, "Render graph timeline");
+        }
+    }
+
+    frames.resize(frameSlotCount);
+    for (auto& frame : frames) {
+        for (uint32_t i = 0; i < RENDER_QUEUE_COUNT; i++) {
+            frame.pools[i] = VK_NULL_HANDLE;
+            frame.signaledValues[i] = 0;
+        }
+        for (uint32_t i = 0; i < queueCount; i++) {
+            VkCommandPoolCreateInfo cmdPoolInfo = {};
+            cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            cmdPoolInfo.pNext = NULL;
+            cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            cmdPoolInfo.queueFamilyIndex = queues[i].familyIndex;
+
+            result = vkCreateCommandPool(device, &cmdPoolInfo, NULL, &frame.pools[i]);
+            assert(result == VK_SUCCESS);
+        }
+
+        // Only needed when all passes go in a single submission without a timeline to wait on.
+        frame.fence = VK_NULL_HANDLE;
+        if (!waitSemaphoresFn) {
+            VkFenceCreateInfo fenceInfo = {};
+            fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            fenceInfo.pNext = NULL;
+            fenceInfo.flags = 0;
+
+            result = vkCreateFence(device, &fenceInfo, NULL, &frame.fence);
+            assert(result == VK_SUCCESS);
+        }
+        frame.submitted = false;
+    }
+}
+
+void RenderGraph::destroyRenderGraph()
+{
+    if (!deviceObj) {
+        return;
+    }
+
+    reset();
+
+    VkDevice device = deviceObj->device;
+    for (auto& frame : frames) {
+        for (uint32_t i = 0; i < queueCount; i++) {
+            vkDestroyCommandPool(device, frame.pools[i], NULL); // Frees its command buffers.
+        }
+        if (frame.fence != VK_NULL_HANDLE) {
+            vkDestroyFence(device, frame.fence, NULL);
+        }
+    }
+    frames.clear();
+
+    for (uint32_t i = 0; i < queueCount; i++) {
+        if (queues[i].timeline != VK_NULL_HANDLE) {
+            vkDestroySemaphore(device, queues[i].timeline, NULL);
+            queues[i].timeline = VK_NULL_HANDLE;
+        }
+    }
+    queueCount = 0;
+    waitSemaphoresFn = NULL;
+    deviceObj = NULL;
+}
+
+uint32_t RenderGraph::addResource(const char* name, bool isImage, bool imported)
+{
+    Resource resource = {};
+    resource.name = name;
+    resource.isImage = isImage;
+    resource.imported = imported;
+    resource.image = VK_NULL_HANDLE;
+    resource.view = VK_NULL_HANDLE;
+    resource.buffer = VK_NULL_HANDLE;
+    resource.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    resource.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    resource.firstPosition = INVALID_INDEX;
+    resources.push_back(resource);
+    compiled = false;
+    return (uint32_t)resources.size() - 1;
+}
+
+uint32_t RenderGraph::createImage(const char* name, const RenderImageDesc& desc)
+{
+    uint32_t index = addResource(name, true, false);
+    resources[index].imageDesc = desc;
+    return index;
+}
+
+uint32_t RenderGraph::createBuffer(const char* name, const RenderBufferDesc& desc)
+{
+    uint32_t index = addResource(name, false, false);
+    resources[index].bufferDesc = desc;
+    return index;
+}
+
+uint32_t RenderGraph::importImage(const char* name, VkImage image, VkImageAspectFlags aspectMask,
+    VkImageLayout initialLayout, VkImageLayout finalLayout)
+{
+    uint32_t index = addResource(name, true, true);
+    Resource& resource = resources[index];
+    resource.image = image;
+    resource.imageDesc.aspectMask = aspectMask;
+    resource.initialLayout = initialLayout;
+    resource.finalLayout = finalLayout;
+    return index;
+}
+
+uint32_t RenderGraph::importBuffer(const char* name, VkBuffer buffer)
+{
+    uint32_t index = addResource(name, false, true);
+    resources[index].buffer = buffer;
+    return index;
+}
+
+void RenderGraph::setImportedImage(uint32_t resource, VkImage image)
+{
+    assert(resources[resource].imported && resources[resource].isImage);
+    resources[resource].image = image;
+}
+
+void RenderGraph::setImportedBuffer(uint32_t resource, VkBuffer buffer)
+{
+    assert(resources[resource].imported && !resources[resource].isImage);
+    resources[resource].buffer = buffer;
+}
+
+uint32_t RenderGraph::addPass(const char* name, RenderQueueType queueType, const RecordFunction& record)
+{
+    Pass pass;
+    pass.name = name;
+    pass.queueType = queueType;
+    pass.record = record;
+    pass.sideEffects = false;
+    pass.culled = false;
+    pass.batch = INVALID_INDEX;
+    pass.batchPosition = 0;
+    passes.push_back(pass);
+    compiled = false;
+    return (uint32_t)passes.size() - 1;
+}
+
+void RenderGraph::addAccess(uint32_t pass, uint32_t resource, VkPipelineStageFlags stageMask, VkAccessFlags accessMask,
+    VkImageLayout layout, bool write)
+{
+    assert(pass < passes.size() && resource < resources.size());
+
+    // A resource both read and written by a pass is one use, in one layout.
+    for (auto& access : passes[pass].accesses) {
+        if (access.resource == resource) {
+            assert(access.layout == layout);
+            access.stageMask |= stageMask;
+            access.accessMask |= accessMask;
+            access.write = access.write || write;
+            return;
+        }
+    }
+
+    Access access;
+    access.resource = resource;
+    access.stageMask = stageMask;
+    access.accessMask = accessMask;
+    access.layout = layout;
+    access.write = write;
+    passes[pass].accesses.push_back(access);
+    compiled = false;
+}
+
+void RenderGraph::readImage(uint32_t pass, uint32_t resource, VkPipelineStageFlags stageMask, VkAccessFlags accessMask, VkImageLayout layout)
+{
+    addAccess(pass, resource, stageMask, accessMask, layout, false);
+}
+
+void RenderGraph::writeImage(uint32_t pass, uint32_t resource, VkPipelineStageFlags stageMask, VkAccessFlags accessMask, VkImageLayout layout)
+{
+    addAccess(pass, resource, stageMask, accessMask, layout, true);
+}
+
+void RenderGraph::readBuffer(uint32_t pass, uint32_t resource, VkPipelineStageFlags stageMask, VkAccessFlags accessMask)
+{
+    addAccess(pass, resource, stageMask, accessMask, VK_IMAGE_LAYOUT_UNDEFINED, false);
+}
+
+void RenderGraph::writeBuffer(uint32_t pass, uint32_t resource, VkPipelineStageFlags stageMask, VkAccessFlags accessMask)
+{
+    addAccess(pass, resource, stageMask, accessMask, VK_IMAGE_LAYOUT_UNDEFINED, true);
+}
+
+void RenderGraph::setSideEffects(uint32_t pass)
+{
+    passes[pass].sideEffects = true;
+    compiled = false;
+}
+
+void RenderGraph::findDependencies(bool producersOnly, std::vector<std::vector<uint32_t> >& dependencies) const
+{
+    // Per resource the last pass writing it, or changing its layout, and the passes reading it since.
+    std::vector<uint32_t> lastWriter(resources.size(), INVALID_INDEX);
+    std::vector<std::vector<uint32_t> > readers(resources.size());
+    std::vector<VkImageLayout> layouts(resources.size());
+    for (size_t i = 0; i < resources.size(); i++) {
+        layouts[i] = resources[i].initialLayout;
+    }
+
+    dependencies.assign(passes.size(), std::vector<uint32_t>());
+    for (uint32_t p = 0; p < passes.size(); p++) {
+        if (passes[p].culled) {
+            continue;
+        }
+
+        std::vector<uint32_t>& passDependencies = dependencies[p];
+        for (const auto& access : passes[p].accesses) {
+            uint32_t r = access.resource;
+            bool layoutChange = resources[r].isImage && access.layout != layouts[r];
+
+            // Read or write after write.
+            if (lastWriter[r] != INVALID_INDEX && lastWriter[r] != p) {
+                passDependencies.push_back(lastWriter[r]);
+            }
+
+            // A layout transition orders the later uses like a write, but produces nothing.
+            if (access.write || (layoutChange && !producersOnly)) {
+                // Write after read.
+                if (!producersOnly) {
+                    for (uint32_t reader : readers[r]) {
+                        if (reader != p) {
+                            passDependencies.push_back(reader);
+                        }
+                    }
+                }
+                lastWriter[r] = p;
+                readers[r].clear();
+            } else {
+                readers[r].push_back(p);
+            }
+            layouts[r] = access.layout;
+        }
+
+        std::sort(passDependencies.begin(), passDependencies.end());
+        passDependencies.erase(std::unique(passDependencies.begin(), passDependencies.end()), passDependencies.end());
+    }
+}
+
+void RenderGraph::cullPasses()
+{
+    for (auto& pass : passes) {
+        pass.culled = false;
+    }
+
+    std::vector<std::vector<uint32_t> > producers;
+    findDependencies(true, producers);
+
+    // Passes with effects outside the graph are kept, and whatever produces their inputs.
+    std::vector<bool> alive(passes.size(), false);
+    std::vector<uint32_t> pending;
+    for (uint32_t p = 0; p < passes.size(); p++) {
+        bool writesImport = false;
+        for (const auto& access : passes[p].accesses) {
+            writesImport = writesImport || (access.write && resources[access.resource].imported);
+        }
+        if (passes[p].sideEffects || writesImport) {
+            alive[p] = true;
+            pending.push_back(p);
+        }
+    }
+    while (!pending.empty()) {
+        uint32_t p = pending.back();
+        pending.pop_back();
+        for (uint32_t producer : producers[p]) {
+            if (!alive[producer]) {
+                alive[producer] = true;
+                pending.push_back(producer);
+            }
+        }
+    }
+
+    stats.passesCulled = 0;
+    for (uint32_t p = 0; p < passes.size(); p++) {
+        passes[p].culled = !alive[p];
+        if (passes[p].culled) {
+            stats.passesCulled++;
+        }
+    }
+}
+
+void RenderGraph::scheduleBatches()
+{
+    std::vector<std::vector<uint32_t> > dependencies;
+    findDependencies(false, dependencies);
+
+    batches.clear();
+    for (uint32_t i = 0; i < queueCount; i++) {
+        queues[i].batchCount = 0;
+    }
+
+    // A pass joins the latest batch of its queue unless it depends on a pass of another queue
+    // submitted after that batch. A batch waits for other queues only when it starts, so it
+    // cannot wait for work that comes after it.
+    uint32_t latestBatch[RENDER_QUEUE_COUNT] = { INVALID_INDEX, INVALID_INDEX, INVALID_INDEX };
+    for (uint32_t p = 0; p < passes.size(); p++) {
+        Pass& pass = passes[p];
+        if (pass.culled) {
+            continue;
+        }
+
+        uint32_t queue = queueOfType[pass.queueType];
+        uint32_t batchIndex = latestBatch[queue];
+        for (uint32_t dependency : dependencies[p]) {
+            uint32_t dependencyBatch = passes[dependency].batch;
+            if (batchIndex != INVALID_INDEX && batches[dependencyBatch].queue != queue && dependencyBatch > batchIndex) {
+                batchIndex = INVALID_INDEX;
+            }
+        }
+
+        if (batchIndex == INVALID_INDEX) {
+            Batch batch;
+            batch.queue = queue;
+            batch.ordinal = queues[queue].batchCount++;
+            batch.endBarrier = Barrier();
+            for (uint32_t i = 0; i < RENDER_QUEUE_COUNT; i++) {
+                batch.waitBatch[i] = INVALID_INDEX;
+            }
+            batch.firstOnQueue = batch.ordinal == 0;
+            batches.push_back(batch);
+            batchIndex = (uint32_t)batches.size() - 1;
+            latestBatch[queue] = batchIndex;
+        }
+
+        pass.batch = batchIndex;
+        pass.batchPosition = (uint32_t)batches[batchIndex].passes.size();
+        batches[batchIndex].passes.push_back(p);
+        batches[batchIndex].barriers.push_back(Barrier());
+    }
+
+    // Lifetimes of the resources in execution order.
+    executionOrder.clear();
+    for (const auto& batch : batches) {
+        executionOrder.insert(executionOrder.end(), batch.passes.begin(), batch.passes.end());
+    }
+    for (auto& resource : resources) {
+        resource.firstPosition = INVALID_INDEX;
+        resource.lastPosition = 0;
+        resource.firstPass = INVALID_INDEX;
+        resource.batches.clear();
+        for (uint32_t i = 0; i < RENDER_QUEUE_COUNT; i++) {
+            resource.queueStages[i] = 0;
+        }
+        resource.writeAccess = 0;
+    }
+    for (uint32_t position = 0; position < executionOrder.size(); position++) {
+        const Pass& pass = passes[executionOrder[position]];
+        for (const auto& access : pass.accesses) {
+            Resource& resource = resources[access.resource];
+            if (resource.firstPosition == INVALID_INDEX) {
+                resource.firstPosition = position;
+                resource.firstPass = executionOrder[position];
+            }
+            resource.lastPosition = position;
+            if (std::find(resource.batches.begin(), resource.batches.end(), pass.batch) == resource.batches.end()) {
+                resource.batches.push_back(pass.batch);
+            }
+            resource.queueStages[batches[pass.batch].queue] |= access.stageMask;
+            if (access.write) {
+                resource.writeAccess |= access.accessMask & WRITE_ACCESS_MASK;
+            }
+        }
+    }
+}
+
+void RenderGraph::createTransientResources()
+{
+    VkDevice device = deviceObj->device;
+    VkResult result;
+
+    for (auto& resource : resources) {
+        if (resource.imported || resource.firstPosition == INVALID_INDEX) {
+            continue;
+        }
+
+        // Usage of every declared use, and concurrent sharing between the families using it.
+        VkFlags usage = 0;
+        for (const auto& pass : passes) {
+            if (pass.culled) {
+                continue;
+            }
+            for (const auto& access : pass.accesses) {
+                if (&resources[access.resource] == &resource) {
+                    usage |= resource.isImage ? imageUsageOf(access.accessMask, access.layout) : bufferUsageOf(access.accessMask);
+                }
+            }
+        }
+        std::vector<uint32_t> families;
+        for (uint32_t batch : resource.batches) {
+            uint32_t family = queues[batches[batch].queue].familyIndex;
+            if (std::find(families.begin(), families.end(), family) == families.end()) {
+                families.push_back(family);
+            }
+        }
+        bool concurrent = families.size() > 1;
+
+        if (resource.isImage) {
+            const RenderImageDesc& desc = resource.imageDesc;
+
+            VkImageCreateInfo imageInfo = {};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.pNext = NULL;
+            imageInfo.flags = 0;
+            imageInfo.imageType = desc.extent.depth > 1 ? VK_IMAGE_TYPE_3D : VK_IMAGE_TYPE_2D;
+            imageInfo.format = desc.format;
+            imageInfo.extent = desc.extent;
+            imageInfo.mipLevels = std::max(desc.mipLevels, 1u);
+            imageInfo.arrayLayers = std::max(desc.arrayLayers, 1u);
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.usage = desc.usage | usage;
+            resource.imageDesc.usage = imageInfo.usage;
+            imageInfo.sharingMode = concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.queueFamilyIndexCount = concurrent ? (uint32_t)families.size() : 0;
+            imageInfo.pQueueFamilyIndices = concurrent ? families.data() : NULL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            result = vkCreateImage(device, &imageInfo, NULL, &resource.image);
+            assert(result == VK_SUCCESS);
+            vkGetImageMemoryRequirements(device, resource.image, &resource.requirements);
+            deviceObj->setObjectName(VK_OBJECT_TYPE_IMAGE, resource.image, resource.name.c_str());
+        } else {
+            VkBufferCreateInfo bufferInfo = {};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.pNext = NULL;
+            bufferInfo.flags = 0;
+            bufferInfo.size = resource.bufferDesc.size;
+            bufferInfo.usage = resource.bufferDesc.usage | usage;
+            bufferInfo.sharingMode = concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+            bufferInfo.queueFamilyIndexCount = concurrent ? (uint32_t)families.size() : 0;
+            bufferInfo.pQueueFamilyIndices = concurrent ? families.data() : NULL;
+
+            result = vkCreateBuffer(device, &bufferInfo, NULL, &resource.buffer);
+            assert(result == VK_SUCCESS);
+            vkGetBufferMemoryRequirements(device, resource.buffer, &resource.requirements);
+            deviceObj->setObjectName(VK_OBJECT_TYPE_BUFFER, resource.buffer, resource.name.c_str());
+        }
+        stats.transientBytes += resource.requirements.size;
+    }
+}
+
+void RenderGraph::addWait(uint32_t batch, uint32_t waitedBatch)
+{
+    uint32_t queue = batches[waitedBatch].queue;
+    if (queue == batches[batch].queue) {
+        return;
+    }
+    assert(waitedBatch < batch);
+
+    uint32_t& wait = batches[batch].waitBatch[queue];
+    if (wait == INVALID_INDEX || wait < waitedBatch) {
+        wait = waitedBatch;
+    }
+}
+
+void RenderGraph::computeBarriers()
+{
+    std::vector<ResourceState> states(resources.size());
+    for (size_t i = 0; i < resources.size(); i++) {
+        ResourceState& state = states[i];
+        state.layout = resources[i].initialLayout;
+        state.external = resources[i].imported;
+        state.writeBatch = INVALID_INDEX;
+        state.writeQueue = 0;
+        state.writeStages = 0;
+        state.writeAccess = 0;
+        state.visibleStages = 0;
+        state.visibleAccess = 0;
+        state.visibleQueues = 0;
+        for (uint32_t q = 0; q < RENDER_QUEUE_COUNT; q++) {
+            state.readBatch[q] = INVALID_INDEX;
+            state.readStages[q] = 0;
+        }
+    }
+
+    for (uint32_t p : executionOrder) {
+        const Pass& pass = passes[p];
+        uint32_t batchIndex = pass.batch;
+        uint32_t queue = batches[batchIndex].queue;
+        Barrier& barrier = batches[batchIndex].barriers[pass.batchPosition];
+
+        for (const auto& access : pass.accesses) {
+            ResourceState& state = states[access.resource];
+            bool layoutChange = resources[access.resource].isImage && access.layout != state.layout;
+            bool writes = access.write || layoutChange;
+            VkPipelineStageFlags srcStages = 0;
+            VkAccessFlags srcAccess = 0;
+            bool waited = false;
+
+            // Used before the execution started, by anything.
+            if (state.external) {
+                srcStages |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+                srcAccess |= VK_ACCESS_MEMORY_WRITE_BIT;
+                state.external = false;
+            }
+
+            // The last write, on this queue a barrier covers it unless an earlier one did, from
+            // another queue the semaphore wait makes it visible to everything.
+            if (state.writeBatch != INVALID_INDEX) {
+                if (state.writeQueue != queue) {
+                    if (!(state.visibleQueues & (1u << queue))) {
+                        addWait(batchIndex, state.writeBatch);
+                        state.visibleQueues |= 1u << queue;
+                    }
+                    waited = true;
+                } else {
+                    bool visible = (access.stageMask & ~state.visibleStages) == 0
+                        && (access.write || (access.accessMask & ~state.visibleAccess) == 0);
+                    if (!visible) {
+                        srcStages |= state.writeStages;
+                        srcAccess |= state.writeAccess;
+                    }
+                }
+            }
+
+            // Writes and layout transitions wait for the reads since the last write.
+            if (writes) {
+                for (uint32_t q = 0; q < queueCount; q++) {
+                    if (state.readBatch[q] == INVALID_INDEX) {
+                        continue;
+                    }
+                    if (q == queue) {
+                        srcStages |= state.readStages[q];
+                    } else {
+                        addWait(batchIndex, state.readBatch[q]);
+                        waited = true;
+                    }
+                }
+            }
+
+            if (layoutChange) {
+                // After a semaphore wait the transition is chained on the waiting stages.
+                if (srcStages == 0) {
+                    srcStages = waited ? access.stageMask : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+                }
+                ImageTransition transition;
+                transition.resource = access.resource;
+                transition.oldLayout = state.layout;
+                transition.newLayout = access.layout;
+                transition.srcAccessMask = srcAccess;
+                transition.dstAccessMask = access.accessMask;
+                barrier.transitions.push_back(transition);
+            } else if (srcStages != 0) {
+                barrier.srcAccessMask |= srcAccess;
+                barrier.dstAccessMask |= srcAccess ? access.accessMask : 0;
+            }
+            if (srcStages != 0) {
+                barrier.srcStageMask |= srcStages;
+                barrier.dstStageMask |= access.stageMask;
+            }
+
+            if (writes) {
+                state.layout = access.layout;
+                state.writeBatch = batchIndex;
+                state.writeQueue = queue;
+                state.writeStages = access.stageMask;
+                state.writeAccess = access.write ? access.accessMask & WRITE_ACCESS_MASK : 0;
+                // A transition alone is visible to the use it was made for.
+                state.visibleStages = access.write ? 0 : access.stageMask;
+                state.visibleAccess = access.write ? 0 : access.accessMask;
+                state.visibleQueues = 0;
+                for (uint32_t q = 0; q < RENDER_QUEUE_COUNT; q++) {
+                    state.readBatch[q] = INVALID_INDEX;
+                    state.readStages[q] = 0;
+                }
+                if (!access.write) {
+                    state.readBatch[queue] = batchIndex;
+                    state.readStages[queue] = access.stageMask;
+                }
+            } else {
+                if (srcStages != 0) {
+                    state.visibleStages |= access.stageMask;
+                    state.visibleAccess |= access.accessMask;
+                }
+                state.readBatch[queue] = batchIndex;
+                state.readStages[queue] |= access.stageMask;
+            }
+        }
+    }
+
+    // Imported images are handed back in their final layout, after their last use on any queue.
+    for (uint32_t r = 0; r < resources.size(); r++) {
+        const Resource& resource = resources[r];
+        ResourceState& state = states[r];
+        if (!resource.imported || !resource.isImage || resource.firstPosition == INVALID_INDEX
+            || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || resource.finalLayout == state.layout) {
+            continue;
+        }
+
+        uint32_t lastBatch = state.writeBatch;
+        for (uint32_t q = 0; q < queueCount; q++) {
+            if (state.readBatch[q] != INVALID_INDEX && (lastBatch == INVALID_INDEX || state.readBatch[q] > lastBatch)) {
+                lastBatch = state.readBatch[q];
+            }
+        }
+        uint32_t queue = batches[lastBatch].queue;
+
+        VkPipelineStageFlags srcStages = 0;
+        VkAccessFlags srcAccess = 0;
+        if (state.writeBatch != INVALID_INDEX) {
+            if (state.writeQueue == queue) {
+                srcStages |= state.writeStages;
+                srcAccess |= state.writeAccess;
+            } else if (!(state.visibleQueues & (1u << queue))) {
+                addWait(lastBatch, state.writeBatch);
+            }
+        }
+        for (uint32_t q = 0; q < queueCount; q++) {
+            if (state.readBatch[q] == INVALID_INDEX) {
+                continue;
+            }
+            if (q == queue) {
+                srcStages |= state.readStages[q];
+            } else {
+                addWait(lastBatch, state.readBatch[q]);
+            }
+        }
+
+        Barrier& barrier = batches[lastBatch].endBarrier;
+        ImageTransition transition;
+        transition.resource = r;
+        transition.oldLayout = state.layout;
+        transition.newLayout = resource.finalLayout;
+        transition.srcAccessMask = srcAccess;
+        transition.dstAccessMask = 0;
+        barrier.transitions.push_back(transition);
+        barrier.srcStageMask |= srcStages ? srcStages : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        barrier.dstStageMask |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    }
+
+    // completeBefore[b][u]: batch u has finished when batch b starts, through the semaphore waits
+    // of b and of the batches before it on its queue. Waits block every stage, so the chain holds.
+    std::vector<std::vector<bool> > completeBefore(batches.size(), std::vector<bool>(batches.size(), false));
+    uint32_t previousOnQueue[RENDER_QUEUE_COUNT] = { INVALID_INDEX, INVALID_INDEX, INVALID_INDEX };
+    for (uint32_t b = 0; b < batches.size(); b++) {
+        std::vector<bool>& complete = completeBefore[b];
+        uint32_t previous = previousOnQueue[batches[b].queue];
+        if (previous != INVALID_INDEX) {
+            complete = completeBefore[previous];
+        }
+        for (uint32_t q = 0; q < queueCount; q++) {
+            uint32_t waited = batches[b].waitBatch[q];
+            if (waited == INVALID_INDEX) {
+                continue;
+            }
+            for (uint32_t u = 0; u <= waited; u++) {
+                if (batches[u].queue == q || completeBefore[waited][u]) {
+                    complete[u] = true;
+                }
+            }
+        }
+        previousOnQueue[batches[b].queue] = b;
+    }
+
+    placeTransientMemory(completeBefore);
+    addAliasingBarriers();
+
+    // Without other work to chain on, a transition made after a semaphore wait would not wait for it.
+    stats.pipelineBarriers = 0;
+    stats.imageBarriers = 0;
+    stats.semaphoreWaits = 0;
+    for (auto& batch : batches) {
+        bool waits = batch.firstOnQueue && queueCount > 1;
+        for (uint32_t q = 0; q < queueCount; q++) {
+            if (batch.waitBatch[q] != INVALID_INDEX) {
+                waits = true;
+                stats.semaphoreWaits++;
+            }
+        }
+        for (auto& barrier : batch.barriers) {
+            if (waits && barrier.srcStageMask == VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT) {
+                barrier.srcStageMask = barrier.dstStageMask;
+            }
+            if (barrier.srcStageMask) {
+                stats.pipelineBarriers++;
+                stats.imageBarriers += (uint32_t)barrier.transitions.size();
+            }
+        }
+        if (batch.endBarrier.srcStageMask) {
+            stats.pipelineBarriers++;
+            stats.imageBarriers += (uint32_t)batch.endBarrier.transitions.size();
+        }
+    }
+}
+
+bool RenderGraph::isOrderedBefore(const Resource& earlier, const Resource& later,
+    const std::vector<std::vector<bool> >& completeBefore) const
+{
+    if (earlier.lastPosition >= later.firstPosition) {
+        return false;
+    }
+
+    // Each use of 'earlier' either precedes the first use of 'later' on the same queue, where
+    // the first use's barrier waits for it, or has completed through the semaphore waits.
+    uint32_t firstBatch = passes[later.firstPass].batch;
+    for (uint32_t batch : earlier.batches) {
+        bool sameQueue = batches[batch].queue == batches[firstBatch].queue && batch <= firstBatch;
+        if (!sameQueue && !completeBefore[firstBatch][batch]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void RenderGraph::placeTransientMemory(const std::vector<std::vector<bool> >& completeBefore)
+{
+    VkResult result;
+
+    // Largest first, each at the lowest offset where it overlaps nothing that is in use at the same time.
+    std::vector<uint32_t> order;
+    bool hasImages = false;
+    bool hasBuffers = false;
+    for (uint32_t r = 0; r < resources.size(); r++) {
+        if (!resources[r].imported && resources[r].firstPosition != INVALID_INDEX) {
+            order.push_back(r);
+            hasImages = hasImages || resources[r].isImage;
+            hasBuffers = hasBuffers || !resources[r].isImage;
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        return resources[a].requirements.size > resources[b].requirements.size;
+    });
+
+    // Buffers and images side by side in the heap keep bufferImageGranularity apart.
+    VkDeviceSize granularity = hasImages && hasBuffers ? deviceObj->gpuProps.limits.bufferImageGranularity : 1;
+    VkMemoryRequirements heapRequirements = {};
+    heapRequirements.alignment = granularity;
+    heapRequirements.memoryTypeBits = ~0u;
+    std::vector<uint32_t> placed;
+
+    for (uint32_t r : order) {
+        Resource& resource = resources[r];
+        resource.aliased = false;
+        uint32_t typeBits = heapRequirements.memoryTypeBits & resource.requirements.memoryTypeBits;
+        if (!typeBits) {
+            continue; // Gets memory of its own.
+        }
+
+        VkDeviceSize alignment = std::max(resource.requirements.alignment, granularity);
+        VkDeviceSize size = alignUp(resource.requirements.size, granularity);
+        std::vector<VkDeviceSize> offsets(1, 0);
+        for (uint32_t other : placed) {
+            offsets.push_back(alignUp(resources[other].memoryOffset + alignUp(resources[other].requirements.size, granularity), alignment));
+        }
+        std::sort(offsets.begin(), offsets.end());
+
+        for (VkDeviceSize offset : offsets) {
+            bool fits = true;
+            for (uint32_t other : placed) {
+                const Resource& placedResource = resources[other];
+                VkDeviceSize otherEnd = placedResource.memoryOffset + alignUp(placedResource.requirements.size, granularity);
+                bool overlaps = offset < otherEnd && placedResource.memoryOffset < offset + size;
+                if (overlaps && !isOrderedBefore(placedResource, resource, completeBefore)
+                    && !isOrderedBefore(resource, placedResource, completeBefore)) {
+                    fits = false;
+                    break;
+                }
+            }
+            if (fits) {
+                resource.memoryOffset = offset;
+                break;
+            }
+        }
+
+        resource.aliased = true;
+        heapRequirements.size = std::max(heapRequirements.size, resource.memoryOffset + size);
+        heapRequirements.alignment = std::max(heapRequirements.alignment, alignment);
+        heapRequirements.memoryTypeBits = typeBits;
+        placed.push_back(r);
+    }
+
+    stats.allocatedBytes = 0;
+    if (!placed.empty()) {
+        result = deviceObj->memoryAllocator.allocate(heapRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, !hasImages,
+            ALLOCATION_STRATEGY_FREE_LIST, &heap);
+        assert(result == VK_SUCCESS);
+        stats.allocatedBytes += heapRequirements.size;
+    }
+
+    VkDevice device = deviceObj->device;
+    for (uint32_t r : order) {
+        Resource& resource = resources[r];
+        if (resource.aliased) {
+            if (resource.isImage) {
+                result = vkBindImageMemory(device, resource.image, heap.memory, heap.offset + resource.memoryOffset);
+            } else {
+                result = vkBindBufferMemory(device, resource.buffer, heap.memory, heap.offset + resource.memoryOffset);
+            }
+            assert(result == VK_SUCCESS);
+        } else {
+            if (resource.isImage) {
+                result = deviceObj->memoryAllocator.allocateForImage(resource.image, VK_IMAGE_TILING_OPTIMAL,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ALLOCATION_STRATEGY_FREE_LIST, &resource.allocation);
+            } else {
+                result = deviceObj->memoryAllocator.allocateForBuffer(resource.buffer,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ALLOCATION_STRATEGY_FREE_LIST, &resource.allocation);
+            }
+            assert(result == VK_SUCCESS);
+            stats.allocatedBytes += resource.requirements.size;
+        }
+
+        const VkImageUsageFlags viewUsage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT
+            | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+        if (!resource.isImage || !(resource.imageDesc.usage & viewUsage)) {
+            continue;
+        }
+
+        const RenderImageDesc& desc = resource.imageDesc;
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.pNext = NULL;
+        viewInfo.flags = 0;
+        viewInfo.image = resource.image;
+        viewInfo.viewType = desc.extent.depth > 1 ? VK_IMAGE_VIEW_TYPE_3D
+            : desc.arrayLayers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = desc.format;
+        viewInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+        viewInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+        viewInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+        viewInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+        viewInfo.subresourceRange.aspectMask = desc.aspectMask;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+        result = vkCreateImageView(device, &viewInfo, NULL, &resource.view);
+        assert(result == VK_SUCCESS);
+    }
+}
+
+void RenderGraph::addAliasingBarriers()
+{
+    // The first use of a transient resource waits for the earlier uses of its memory on the same
+    // queue: by the resources it took the memory over from, and in the previous execution by all
+    // that share it. Uses on other queues are covered by the semaphore waits.
+    for (uint32_t r = 0; r < resources.size(); r++) {
+        const Resource& resource = resources[r];
+        if (resource.imported || resource.firstPosition == INVALID_INDEX) {
+            continue;
+        }
+
+        const Pass& pass = passes[resource.firstPass];
+        uint32_t queue = batches[pass.batch].queue;
+        VkPipelineStageFlags srcStages = 0;
+        VkAccessFlags srcAccess = 0;
+        for (uint32_t other = 0; other < resources.size(); other++) {
+            const Resource& otherResource = resources[other];
+            if (other != r) {
+                if (!resource.aliased || !otherResource.aliased || otherResource.imported
+                    || otherResource.firstPosition == INVALID_INDEX) {
+                    continue;
+                }
+                VkDeviceSize end = resource.memoryOffset + resource.requirements.size;
+                VkDeviceSize otherEnd = otherResource.memoryOffset + otherResource.requirements.size;
+                if (resource.memoryOffset >= otherEnd || otherResource.memoryOffset >= end) {
+                    continue;
+                }
+            }
+            if (otherResource.queueStages[queue]) {
+                srcStages |= otherResource.queueStages[queue];
+                srcAccess |= otherResource.writeAccess;
+            }
+        }
+        if (!srcStages) {
+            continue;
+        }
+
+        const Access* access = NULL;
+        for (const auto& passAccess : pass.accesses) {
+            if (passAccess.resource == r) {
+                access = &passAccess;
+            }
+        }
+        assert(access);
+
+        Barrier& barrier = batches[pass.batch].barriers[pass.batchPosition];
+        bool transitioned = false;
+        for (auto& transition : barrier.transitions) {
+            if (transition.resource == r) {
+                transition.srcAccessMask |= srcAccess;
+                transitioned = true;
+            }
+        }
+        if (!transitioned) {
+            barrier.srcAccessMask |= srcAccess;
+            barrier.dstAccessMask |= access->accessMask;
+        }
+        barrier.srcStageMask = (barrier.srcStageMask & ~VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT) | srcStages;
+        barrier.dstStageMask |= access->stageMask;
+    }
+}
+
+void RenderGraph::compile()
+{
+    if (compiled) {
+        return;
+    }
+
+    // The transient resources of the previous compile may be in use.
+    waitIdle();
+    destroyTransientResources();
+
+    stats.passesDeclared = (uint32_t)passes.size();
+    stats.transientBytes = 0;
+    cullPasses();
+    scheduleBatches();
+    createTransientResources();
+    computeBarriers();
+    stats.batches = (uint32_t)batches.size();
+    compiled = true;
+}
+
+void RenderGraph::recordBarrier(VkCommandBuffer cmdBuffer, const Barrier& barrier)
+{
+    if (!barrier.srcStageMask) {
+        return;
+    }
+
+    VkMemoryBarrier memoryBarrier = {};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.pNext = NULL;
+    memoryBarrier.srcAccessMask = barrier.srcAccessMask;
+    memoryBarrier.dstAccessMask = barrier.dstAccessMask;
+    bool memory = barrier.srcAccessMask || barrier.dstAccessMask;
+
+    std::vector<VkImageMemoryBarrier> imageBarriers(barrier.transitions.size());
+    for (size_t i = 0; i < barrier.transitions.size(); i++) {
+        const ImageTransition& transition = barrier.transitions[i];
+        const Resource& resource = resources[transition.resource];
+
+        VkImageMemoryBarrier& imageBarrier = imageBarriers[i];
+        imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarrier.pNext = NULL;
+        imageBarrier.srcAccessMask = transition.srcAccessMask;
+        imageBarrier.dstAccessMask = transition.dstAccessMask;
+        imageBarrier.oldLayout = transition.oldLayout;
+        imageBarrier.newLayout = transition.newLayout;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image = resource.image;
+        imageBarrier.subresourceRange.aspectMask = resource.imageDesc.aspectMask;
+        imageBarrier.subresourceRange.baseMipLevel = 0;
+        imageBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        imageBarrier.subresourceRange.baseArrayLayer = 0;
+        imageBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+    }
+
+    vkCmdPipelineBarrier(cmdBuffer, barrier.srcStageMask, barrier.dstStageMask, 0,
+        memory ? 1 : 0, memory ? &memoryBarrier : NULL, 0, NULL,
+        (uint32_t)imageBarriers.size(), imageBarriers.size() ? imageBarriers.data() : NULL);
+}
+
+void RenderGraph::waitForSlot(FrameCommands& frame)
+{
+    if (!frame.submitted) {
+        return;
+    }
+
+    VkResult result;
+    if (waitSemaphoresFn) {
+        std::vector<VkSemaphore> semaphores;
+        std::vector<uint64_t> values;
+        for (uint32_t i = 0; i < queueCount; i++) {
+            if (frame.signaledValues[i] > 0) {
+                semaphores.push_back(queues[i].timeline);
+                values.push_back(frame.signaledValues[i]);
+            }
+        }
+
+        VkSemaphoreWaitInfoKHR waitInfo = {};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+        waitInfo.pNext = NULL;
+        waitInfo.flags = 0;
+        waitInfo.semaphoreCount = (uint32_t)semaphores.size();
+        waitInfo.pSemaphores = semaphores.data();
+        waitInfo.pValues = values.data();
+        result = waitSemaphoresFn(deviceObj->device, &waitInfo, UINT64_MAX);
+        assert(result == VK_SUCCESS);
+    } else {
+        result = vkWaitForFences(deviceObj->device, 1, &frame.fence, VK_TRUE, UINT64_MAX);
+        assert(result == VK_SUCCESS);
+        result = vkResetFences(deviceObj->device, 1, &frame.fence);
+        assert(result == VK_SUCCESS);
+    }
+    frame.submitted = false;
+}
+
+void RenderGraph::execute(uint32_t frameSlot)
+{
+    compile();
+    if (batches.empty()) {
+        return;
+    }
+
+    FrameCommands& frame = frames[frameSlot];
+    waitForSlot(frame);
+
+    VkDevice device = deviceObj->device;
+    VkResult result;
+    for (uint32_t i = 0; i < queueCount; i++) {
+        result = vkResetCommandPool(device, frame.pools[i], 0);
+        assert(result == VK_SUCCESS);
+
+        std::vector<VkCommandBuffer>& cmdBuffers = frame.cmdBuffers[i];
+        if (cmdBuffers.size() < queues[i].batchCount) {
+            size_t allocated = cmdBuffers.size();
+            cmdBuffers.resize(queues[i].batchCount);
+
+            VkCommandBufferAllocateInfo allocateInfo = {};
+            allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocateInfo.pNext = NULL;
+            allocateInfo.commandPool = frame.pools[i];
+            allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocateInfo.commandBufferCount = (uint32_t)(cmdBuffers.size() - allocated);
+            CommandBufferMgr::allocCommandBuffer(&device, frame.pools[i], &cmdBuffers[allocated], &allocateInfo,
+                deviceObj->debugUtils, "Render graph command buffer");
+        }
+    }
+
+    // Everything is recorded before the first submission.
+    for (const auto& batch : batches) {
+        VkCommandBuffer cmdBuffer = frame.cmdBuffers[batch.queue][batch.ordinal];
+
+        VkCommandBufferBeginInfo cmdBufferBeginInfo = {};
+        cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        cmdBufferBeginInfo.pNext = NULL;
+        cmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        cmdBufferBeginInfo.pInheritanceInfo = NULL;
+        CommandBufferMgr::beginCommandBuffer(cmdBuffer, &cmdBufferBeginInfo);
+
+        for (size_t i = 0; i < batch.passes.size(); i++) {
+            const Pass& pass = passes[batch.passes[i]];
+            recordBarrier(cmdBuffer, batch.barriers[i]);
+            CommandBufferLabel label(deviceObj->debugUtils, cmdBuffer, pass.name.c_str());
+            pass.record(cmdBuffer, *this);
+        }
+        recordBarrier(cmdBuffer, batch.endBarrier);
+
+        CommandBufferMgr::endCommandBuffer(cmdBuffer);
+    }
+
+    // Batch b of a queue signals the value the queue had before this execution plus b + 1. The
+    // first batch of a queue also waits for the previous execution, which used the same transient memory.
+    uint64_t baseValues[RENDER_QUEUE_COUNT];
+    for (uint32_t i = 0; i < queueCount; i++) {
+        baseValues[i] = queues[i].lastSignaled;
+    }
+    for (size_t b = 0; b < batches.size(); b++) {
+        const Batch& batch = batches[b];
+        VkCommandBuffer cmdBuffer = frame.cmdBuffers[batch.queue][batch.ordinal];
+
+        std::vector<VkSemaphore> waitSemaphores;
+        std::vector<uint64_t> waitValues;
+        std::vector<VkPipelineStageFlags> waitStages;
+        for (uint32_t q = 0; q < queueCount && waitSemaphoresFn; q++) {
+            uint64_t value = 0;
+            if (batch.waitBatch[q] != INVALID_INDEX) {
+                value = baseValues[q] + batches[batch.waitBatch[q]].ordinal + 1;
+            } else if (batch.firstOnQueue && q != batch.queue) {
+                value = baseValues[q];
+            }
+            if (value > 0) {
+                waitSemaphores.push_back(queues[q].timeline);
+                waitValues.push_back(value);
+                waitStages.push_back(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+            }
+        }
+        uint64_t signalValue = baseValues[batch.queue] + batch.ordinal + 1;
+
+        VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+        timelineInfo.pNext = NULL;
+        timelineInfo.waitSemaphoreValueCount = (uint32_t)waitValues.size();
+        timelineInfo.pWaitSemaphoreValues = waitValues.size() ? waitValues.data() : NULL;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = waitSemaphoresFn ? &timelineInfo : NULL;
+        submitInfo.waitSemaphoreCount = (uint32_t)waitSemaphores.size();
+        submitInfo.pWaitSemaphores = waitSemaphores.size() ? waitSemaphores.data() : NULL;
+        submitInfo.pWaitDstStageMask = waitStages.size() ? waitStages.data() : NULL;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &cmdBuffer;
+        submitInfo.signalSemaphoreCount = waitSemaphoresFn ? 1 : 0;
+        submitInfo.pSignalSemaphores = waitSemaphoresFn ? &queues[batch.queue].timeline : NULL;
+
+        // Without a timeline there is one queue and one batch, the fence tells when the slot is free.
+        result = vkQueueSubmit(queues[batch.queue].queue, 1, &submitInfo, waitSemaphoresFn ? VK_NULL_HANDLE : frame.fence);
+        assert(result == VK_SUCCESS);
+    }
+
+    for (uint32_t i = 0; i < queueCount; i++) {
+        queues[i].lastSignaled = baseValues[i] + queues[i].batchCount;
+        frame.signaledValues[i] = queues[i].lastSignaled;
+    }
+    frame.submitted = true;
+    stats.executions++;
+}
+
+void RenderGraph::waitIdle()
+{
+    for (auto& frame : frames) {
+        waitForSlot(frame);
+    }
+}
+
+void RenderGraph::destroyTransientResources()
+{
+    VkDevice device = deviceObj->device;
+    for (auto& resource : resources) {
+        if (resource.imported) {
+            continue;
+        }
+        if (resource.view != VK_NULL_HANDLE) {
+            vkDestroyImageView(device, resource.view, NULL);
+            resource.view = VK_NULL_HANDLE;
+        }
+        if (resource.image != VK_NULL_HANDLE) {
+            vkDestroyImage(device, resource.image, NULL);
+            resource.image = VK_NULL_HANDLE;
+        }
+        if (resource.buffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(device, resource.buffer, NULL);
+            resource.buffer = VK_NULL_HANDLE;
+        }
+        if (resource.allocation.memory != VK_NULL_HANDLE) {
+            deviceObj->memoryAllocator.free(resource.allocation);
+            resource.allocation = MemoryAllocation();
+        }
+        resource.aliased = false;
+    }
+    if (heap.memory != VK_NULL_HANDLE) {
+        deviceObj->memoryAllocator.free(heap);
+        heap = MemoryAllocation();
+    }
+}
+
+void RenderGraph::reset()
+{
+    waitIdle();
+    destroyTransientResources();
+    passes.clear();
+    resources.clear();
+    batches.clear();
+    executionOrder.clear();
+    compiled = false;
+}
+
+void RenderGraph::printStats() const
+{
+    std::cout << "Render graph: " << stats.passesDeclared << " passes, " << stats.passesCulled << " culled, "
+              << stats.batches << " submissions, " << stats.pipelineBarriers << " barriers with "
+              << stats.imageBarriers << " layout transitions, " << stats.semaphoreWaits << " semaphore waits, "
+              << stats.transientBytes / 1024 << " KB of transient resources in " << stats.allocatedBytes / 1024
+              << " KB, " << stats.executions << " executions" << std::endl;
+}
@@ -0,0 +1,287 @@
+#include "StagingRing.h"
+#include "VulkanDevice.h"
+#include "CommandBufferManager.h"
+
+StagingRing::StagingRing()
+{
+    deviceObj = NULL;
+    queue = VK_NULL_HANDLE;
+    cmdPool = VK_NULL_HANDLE;
+    ringBuffer = VK_NULL_HANDLE;
+    mappedData = NULL;
+    ringSize = 0;
+    head = tail = flushedHead = 0;
+    queuedBytes = 0;
+    stats = {};
+    hasUploaded = false;
+}
+
+StagingRing::~StagingRing()
+{
+}
+
+void StagingRing::createStagingRing(VulkanDevice* inDeviceObj, VkQueue inQueue, uint32_t queueFamilyIndex, VkDeviceSize inRingSize)
+{
+    VkResult result;
+
+    deviceObj = inDeviceObj;
+    queue = inQueue;
+    ringSize = inRingSize;
+
+    fencePool.createFencePool(deviceObj->device, 4, deviceObj->debugUtils, "Staging fence");
+
+    // Upload command buffers are reused one by one once their submission has finished.
+    VkCommandPoolCreateInfo cmdPoolInfo = {};
+    cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmdPoolInfo.pNext = NULL;
+    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
+
+    result = vkCreateCommandPool(deviceObj->device, &cmdPoolInfo, NULL, &cmdPool);
+    assert(result == VK_SUCCESS);
+    deviceObj->setObjectName(VK_OBJECT_TYPE_COMMAND_POOL, cmdPool, "Staging command pool");
+
+    VkBufferCreateInfo bufInfo = {};
+    bufInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufInfo.pNext = NULL;
+    bufInfo.flags = 0;
+    bufInfo.size = ringSize;
+    bufInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    bufInfo.queueFamilyIndexCount = 0;
+    bufInfo.pQueueFamilyIndices = NULL;
+
+    result = vkCreateBuffer(deviceObj->device, &bufInfo, NULL, &ringBuffer);
+    assert(result == VK_SUCCESS);
+    deviceObj->setObjectName(VK_OBJECT_TYPE_BUFFER, ringBuffer, "Staging ring");
+
+    // Coherent memory, so writes need no explicit flush before the copy reads them.
+    result = deviceObj->memoryAllocator.allocateForBuffer(ringBuffer,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        ALLOCATION_STRATEGY_FREE_LIST, &ringMemory);
+    assert(result == VK_SUCCESS);
+
+    mappedData = (char*)ringMemory.mappedData;
+    assert(mappedData);
+}
+
+void StagingRing::destroyStagingRing()
+{
+    // Waits for the in-flight uploads before anything is released.
+    fencePool.destroyFencePool();
+    pendingRegions.clear();
+
+    vkDestroyCommandPool(deviceObj->device, cmdPool, NULL);
+    uploadCmdBuffers.clear();
+
+    vkDestroyBuffer(deviceObj->device, ringBuffer, NULL);
+    deviceObj->memoryAllocator.free(ringMemory);
+    mappedData = NULL;
+}
+
+void* StagingRing::reserve(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* ringOffset)
+{
+    if (size > ringSize) {
+        return NULL;
+    }
+
+    uint64_t start = placeRequest(size, alignment);
+
+    // Would overwrite data the GPU may still be reading?
+    if (start + size - tail > ringSize) {
+        reclaim();
+        start = placeRequest(size, alignment);
+        if (start + size - tail > ringSize) {
+            return NULL;
+        }
+    }
+
+    if (!hasUploaded) {
+        hasUploaded = true;
+        firstUploadTime = std::chrono::steady_clock::now();
+    }
+
+    head = start + size;
+    *ringOffset = start % ringSize;
+    return mappedData + *ringOffset;
+}
+
+uint64_t StagingRing::placeRequest(VkDeviceSize size, VkDeviceSize alignment)
+{
+    // Nothing queued or in flight: start over at the next ring boundary, where a request of
+    // up to the ring size fits. Otherwise one wrapping around could never fit.
+    uint64_t physical = head % ringSize;
+    if (tail == head && pendingRegions.empty() && physical) {
+        head = tail = flushedHead = head - physical + ringSize;
+        physical = 0;
+    }
+
+    // Align the physical offset, and skip to the start of the ring
+    // if the request does not fit before its end.
+    uint64_t alignedPhysical = alignment > 1 ? (physical + alignment - 1) / alignment * alignment : physical;
+    if (alignedPhysical + size > ringSize) {
+        return head - physical + ringSize;
+    }
+    return head - physical + alignedPhysical;
+}
+
+void StagingRing::enqueueBufferCopy(VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize ringOffset, VkDeviceSize size)
+{
+    std::vector<VkBufferCopy>& regions = bufferCopies[dstBuffer];
+
+    // Merge with the previous region when both source and destination are contiguous.
+    if (!regions.empty()) {
+        VkBufferCopy& last = regions.back();
+        if (last.srcOffset + last.size == ringOffset && last.dstOffset + last.size == dstOffset) {
+            last.size += size;
+            queuedBytes += size;
+            stats.copyCount++;
+            return;
+        }
+    }
+
+    VkBufferCopy region = {};
+    region.srcOffset = ringOffset;
+    region.dstOffset = dstOffset;
+    region.size = size;
+    regions.push_back(region);
+
+    queuedBytes += size;
+    stats.copyCount++;
+}
+
+void StagingRing::enqueueImageCopy(VkImage dstImage, VkImageLayout dstLayout, const VkBufferImageCopy& region, VkDeviceSize size)
+{
+    imageCopies[std::make_pair(dstImage, dstLayout)].push_back(region);
+    queuedBytes += size;
+    stats.copyCount++;
+}
+
+bool StagingRing::uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+    if (size > ringSize) {
+        return false;
+    }
+
+    VkDeviceSize ringOffset;
+    void* dst = reserve(size, 4, &ringOffset);
+    if (!dst) {
+        // The ring is full, push out what is queued and wait for the oldest uploads to retire.
+        flush();
+        while (!dst && !pendingRegions.empty()) {
+            fencePool.wait(pendingRegions.front().token);
+            reclaim();
+            dst = reserve(size, 4, &ringOffset);
+        }
+        if (!dst) {
+            return false;
+        }
+    }
+
+    memcpy(dst, data, (size_t)size);
+    enqueueBufferCopy(dstBuffer, dstOffset, ringOffset, size);
+    return true;
+}
+
+VkCommandBuffer StagingRing::acquireCommandBuffer(UploadCommandBuffer** owner)
+{
+    // Reuse a command buffer whose last submission has finished.
+    for (auto& upload : uploadCmdBuffers) {
+        if (fencePool.isComplete(upload.token)) {
+            VkResult result = vkResetCommandBuffer(upload.cmdBuffer, 0);
+            assert(result == VK_SUCCESS);
+            *owner = &upload;
+            return upload.cmdBuffer;
+        }
+    }
+
+    VkCommandBufferAllocateInfo cmdBufferAllocateInfo = {};
+    cmdBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdBufferAllocateInfo.pNext = NULL;
+    cmdBufferAllocateInfo.commandPool = cmdPool;
+    cmdBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmdBufferAllocateInfo.commandBufferCount = 1;
+
+    UploadCommandBuffer upload;
+    CommandBufferMgr::allocCommandBuffer(&deviceObj->device, cmdPool, &upload.cmdBuffer, &cmdBufferAllocateInfo,
+        deviceObj->debugUtils, "Staging command buffer");
+    uploadCmdBuffers.push_back(upload);
+
+    *owner = &uploadCmdBuffers.back();
+    return upload.cmdBuffer;
+}
+
+SubmitToken StagingRing::flush()
+{
+    if (bufferCopies.empty() && imageCopies.empty()) {
+        return SubmitToken();
+    }
+
+    UploadCommandBuffer* owner;
+    VkCommandBuffer cmdBuffer = acquireCommandBuffer(&owner);
+
+    VkCommandBufferBeginInfo cmdBufferBeginInfo = {};
+    cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmdBufferBeginInfo.pNext = NULL;
+    cmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    cmdBufferBeginInfo.pInheritanceInfo = NULL;
+    CommandBufferMgr::beginCommandBuffer(cmdBuffer, &cmdBufferBeginInfo);
+
+    {
+        CommandBufferLabel cmdLabel(deviceObj->debugUtils, cmdBuffer, "Staging upload");
+
+        // One copy command per destination, carrying all of its regions.
+        for (auto& copy : bufferCopies) {
+            vkCmdCopyBuffer(cmdBuffer, ringBuffer, copy.first, (uint32_t)copy.second.size(), copy.second.data());
+        }
+        for (auto& copy : imageCopies) {
+            vkCmdCopyBufferToImage(cmdBuffer, ringBuffer, copy.first.first, copy.first.second, (uint32_t)copy.second.size(), copy.second.data());
+        }
+
+        // Make the uploaded data visible to everything submitted after this batch.
+        VkMemoryBarrier memoryBarrier = {};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.pNext = NULL;
+        memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+            1, &memoryBarrier, 0, NULL, 0, NULL);
+    }
+
+    CommandBufferMgr::endCommandBuffer(cmdBuffer);
+
+    SubmitToken token = CommandBufferMgr::submitCommandBufferAsync(queue, fencePool, &cmdBuffer, 1);
+    owner->token = token;
+
+    // The ring space up to 'head' is released once this submission has finished.
+    PendingRegion region;
+    region.token = token;
+    region.end = head;
+    pendingRegions.push_back(region);
+    flushedHead = head;
+
+    stats.bytesUploaded += queuedBytes;
+    stats.submitCount++;
+    stats.activeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - firstUploadTime).count();
+
+    bufferCopies.clear();
+    imageCopies.clear();
+    queuedBytes = 0;
+    return token;
+}
+
+void StagingRing::reclaim()
+{
+    while (!pendingRegions.empty() && fencePool.isComplete(pendingRegions.front().token)) {
+        tail = pendingRegions.front().end;
+        pendingRegions.pop_front();
+    }
+}
+
+void StagingRing::printStats() const
+{
+    std::cout << "Staging uploads: " << stats.bytesUploaded << " bytes in "
+              << stats.copyCount << " copies, " << stats.submitCount << " submits" << std::endl;
+    std::cout << "\t" << stats.megabytesPerSecond() << " MB/s, "
+              << stats.submitsPerMegabyte() << " submits per MB" << std::endl;
+}
@@ -0,0 +1,321 @@
+#include "SubAllocator.h"
+
+SubAllocator::SubAllocator(VkDeviceSize inSize, VkDeviceSize bufferImageGranularity)
+{
+    size = inSize;
+    granularity = std::max<VkDeviceSize>(bufferImageGranularity, 1);
+}
+
+/***************LINEAR***************/
+
+LinearSubAllocator::LinearSubAllocator(VkDeviceSize inSize, VkDeviceSize bufferImageGranularity)
+    : SubAllocator(inSize, bufferImageGranularity)
+{
+    reset();
+}
+
+bool LinearSubAllocator::allocate(VkDeviceSize requestSize, VkDeviceSize alignment, bool linearResource, VkDeviceSize* offset)
+{
+    VkDeviceSize start = alignUp(head, alignment);
+
+    // Keep linear and optimal resources off the same granularity page.
+    if (head > 0 && linearResource != lastWasLinear && onSamePage(head, start)) {
+        start = alignUp(start, granularity);
+    }
+
+    if (start + requestSize > size) {
+        return false;
+    }
+
+    *offset = start;
+    head = start + requestSize;
+    lastWasLinear = linearResource;
+    liveCount++;
+    return true;
+}
+
+void LinearSubAllocator::free(VkDeviceSize offset)
+{
+    assert(liveCount > 0);
+
+    // Individual ranges are not reclaimed, the block is rewound once it is empty.
+    if (--liveCount == 0) {
+        reset();
+    }
+}
+
+void LinearSubAllocator::reset()
+{
+    head = 0;
+    lastWasLinear = false;
+    liveCount = 0;
+}
+
+SubAllocatorStats LinearSubAllocator::getStats() const
+{
+    SubAllocatorStats stats = {};
+    stats.size = size;
+    stats.usedBytes = head;
+    stats.largestFreeRange = size - head;
+    stats.allocationCount = liveCount;
+    stats.freeRangeCount = head < size ? 1 : 0;
+    return stats;
+}
+
+/***************BUDDY***************/
+
+BuddySubAllocator::BuddySubAllocator(VkDeviceSize inSize, VkDeviceSize bufferImageGranularity, VkDeviceSize inMinNodeSize)
+    : SubAllocator(inSize, bufferImageGranularity)
+{
+    // Round the smallest node up to a power of two that covers a whole granularity page.
+    minNodeSize = 1;
+    while (minNodeSize < std::max(inMinNodeSize, granularity)) {
+        minNodeSize <<= 1;
+    }
+
+    // Manage the largest power of two that fits into the block.
+    maxOrder = 0;
+    while (nodeSize(maxOrder + 1) <= inSize) {
+        maxOrder++;
+    }
+    assert(nodeSize(maxOrder) <= inSize);
+    size = nodeSize(maxOrder);
+
+    freeNodes.resize(maxOrder + 1);
+    freeNodes[maxOrder].insert(0);
+    usedBytes = 0;
+}
+
+bool BuddySubAllocator::allocate(VkDeviceSize requestSize, VkDeviceSize alignment, bool linearResource, VkDeviceSize* offset)
+{
+    // Nodes are aligned to their own size, so a node at least as large
+    // as the (power of two) alignment is always suitably aligned.
+    VkDeviceSize needed = std::max(requestSize, alignment);
+
+    uint32_t order = 0;
+    while (order <= maxOrder && nodeSize(order) < needed) {
+        order++;
+    }
+    if (order > maxOrder) {
+        return false;
+    }
+
+    // Find the smallest free node that is large enough.
+    uint32_t freeOrder = order;
+    while (freeOrder <= maxOrder && freeNodes[freeOrder].empty()) {
+        freeOrder++;
+    }
+    if (freeOrder > maxOrder) {
+        return false;
+    }
+
+    VkDeviceSize nodeOffset = *freeNodes[freeOrder].begin();
+    freeNodes[freeOrder].erase(freeNodes[freeOrder].begin());
+
+    // Split it down, keeping the lower half and freeing the upper buddies.
+    while (freeOrder > order) {
+        freeOrder--;
+        freeNodes[freeOrder].insert(nodeOffset + nodeSize(freeOrder));
+    }
+
+    allocatedNodes[nodeOffset] = order;
+    usedBytes += nodeSize(order);
+    *offset = nodeOffset;
+    return true;
+}
+
+void BuddySubAllocator::free(VkDeviceSize offset)
+{
+    std::map<VkDeviceSize, uint32_t>::iterator it = allocatedNodes.find(offset);
+    assert(it != allocatedNodes.end());
+
+    uint32_t order = it->second;
+    allocatedNodes.erase(it);
+    usedBytes -= nodeSize(order);
+
+    // Merge with the buddy for as long as it is free as well.
+    while (order < maxOrder) {
+        VkDeviceSize buddy = offset ^ nodeSize(order);
+        std::set<VkDeviceSize>::iterator buddyIt = freeNodes[order].find(buddy);
+        if (buddyIt == freeNodes[order].end()) {
+            break;
+        }
+        freeNodes[order].erase(buddyIt);
+        offset = std::min(offset, buddy);
+        order++;
+    }
+    freeNodes[order].insert(offset);
+}
+
+SubAllocatorStats BuddySubAllocator::getStats() const
+{
+    SubAllocatorStats stats = {};
+    stats.size = size;
+    stats.usedBytes = usedBytes;
+    stats.allocationCount = (uint32_t)allocatedNodes.size();
+    for (uint32_t order = 0; order <= maxOrder; order++) {
+        stats.freeRangeCount += (uint32_t)freeNodes[order].size();
+        if (!freeNodes[order].empty()) {
+            stats.largestFreeRange = nodeSize(order);
+        }
+    }
+    return stats;
+}
+
+/***************FREE-LIST***************/
+
+FreeListSubAllocator::FreeListSubAllocator(VkDeviceSize inSize, VkDeviceSize bufferImageGranularity)
+    : SubAllocator(inSize, bufferImageGranularity)
+{
+    Range range;
+    range.size = inSize;
+    range.isFree = true;
+    range.linearResource = false;
+    ranges[0] = range;
+    insertFree(0, inSize);
+
+    usedBytes = 0;
+    allocationCount = 0;
+}
+
+bool FreeListSubAllocator::fits(RangeMap::iterator it, VkDeviceSize requestSize, VkDeviceSize alignment, bool linearResource, VkDeviceSize* offset)
+{
+    VkDeviceSize rangeStart = it->first;
+    VkDeviceSize rangeEnd = it->first + it->second.size;
+    VkDeviceSize start = alignUp(rangeStart, alignment);
+
+    // Step over the granularity page of a used neighbour of the other resource kind.
+    if (it != ranges.begin()) {
+        RangeMap::iterator prev = it;
+        --prev;
+        if (!prev->second.isFree && prev->second.linearResource != linearResource && onSamePage(rangeStart, start)) {
+            start = alignUp(start, granularity);
+        }
+    }
+
+    VkDeviceSize end = start + requestSize;
+    if (end > rangeEnd) {
+        return false;
+    }
+
+    RangeMap::iterator next = it;
+    ++next;
+    if (next != ranges.end() && !next->second.isFree && next->second.linearResource != linearResource && onSamePage(end, next->first)) {
+        return false;
+    }
+
+    *offset = start;
+    return true;
+}
+
+bool FreeListSubAllocator::allocate(VkDeviceSize requestSize, VkDeviceSize alignment, bool linearResource, VkDeviceSize* offset)
+{
+    // Best fit: try the free ranges from the smallest one that could hold the request upwards.
+    std::multimap<VkDeviceSize, VkDeviceSize>::iterator candidate = freeBySize.lower_bound(requestSize);
+    for (; candidate != freeBySize.end(); ++candidate) {
+        RangeMap::iterator it = ranges.find(candidate->second);
+        assert(it != ranges.end() && it->second.isFree);
+
+        VkDeviceSize start;
+        if (!fits(it, requestSize, alignment, linearResource, &start)) {
+            continue;
+        }
+
+        VkDeviceSize rangeStart = it->first;
+        VkDeviceSize rangeEnd = it->first + it->second.size;
+        eraseFree(rangeStart, it->second.size);
+        ranges.erase(it);
+
+        // Alignment padding in front stays a free range of its own.
+        if (start > rangeStart) {
+            Range padding;
+            padding.size = start - rangeStart;
+            padding.isFree = true;
+            padding.linearResource = false;
+            ranges[rangeStart] = padding;
+            insertFree(rangeStart, padding.size);
+        }
+
+        Range used;
+        used.size = requestSize;
+        used.isFree = false;
+        used.linearResource = linearResource;
+        ranges[start] = used;
+
+        if (start + requestSize < rangeEnd) {
+            Range remainder;
+            remainder.size = rangeEnd - (start + requestSize);
+            remainder.isFree = true;
+            remainder.linearResource = false;
+            ranges[start + requestSize] = remainder;
+            insertFree(start + requestSize, remainder.size);
+        }
+
+        usedBytes += requestSize;
+        allocationCount++;
+        *offset = start;
+        return true;
+    }
+    return false;
+}
+
+void FreeListSubAllocator::free(VkDeviceSize offset)
+{
+    RangeMap::iterator it = ranges.find(offset);
+    assert(it != ranges.end() && !it->second.isFree);
+
+    usedBytes -= it->second.size;
+    allocationCount--;
+    it->second.isFree = true;
+
+    // Merge with the following free range.
+    RangeMap::iterator next = it;
+    ++next;
+    if (next != ranges.end() && next->second.isFree) {
+        eraseFree(next->first, next->second.size);
+        it->second.size += next->second.size;
+        ranges.erase(next);
+    }
+
+    // Merge with the preceding free range.
+    if (it != ranges.begin()) {
+        RangeMap::iterator prev = it;
+        --prev;
+        if (prev->second.isFree) {
+            eraseFree(prev->first, prev->second.size);
+            prev->second.size += it->second.size;
+            ranges.erase(it);
+            it = prev;
+        }
+    }
+
+    insertFree(it->first, it->second.size);
+}
+
+void FreeListSubAllocator::insertFree(VkDeviceSize offset, VkDeviceSize rangeSize)
+{
+    freeBySize.insert(std::make_pair(rangeSize, offset));
+}
+
+void FreeListSubAllocator::eraseFree(VkDeviceSize offset, VkDeviceSize rangeSize)
+{
+    std::pair<std::multimap<VkDeviceSize, VkDeviceSize>::iterator, std::multimap<VkDeviceSize, VkDeviceSize>::iterator> sameSize = freeBySize.equal_range(rangeSize);
+    for (std::multimap<VkDeviceSize, VkDeviceSize>::iterator it = sameSize.first; it != sameSize.second; ++it) {
+        if (it->second == offset) {
+            freeBySize.erase(it);
+            return;
+        }
+    }
+    assert(!"Free range is not registered.");
+}
+
+SubAllocatorStats FreeListSubAllocator::getStats() const
+{
+    SubAllocatorStats stats = {};
+    stats.size = size;
+    stats.usedBytes = usedBytes;
+    stats.allocationCount = allocationCount;
+    stats.freeRangeCount = (uint32_t)freeBySize.size();
+    stats.largestFreeRange = freeBySize.empty() ? 0 : freeBySize.rbegin()->first;
+    return stats;
+}
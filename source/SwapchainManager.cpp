@@ -0,0 +1,351 @@
+#include "SwapchainManager.h"
+#include "VulkanDevice.h"
+#include <cstdio>
+
+SwapchainManager::SwapchainManager()
+{
+    deviceObj = NULL;
+    surface = VK_NULL_HANDLE;
+    policy = PRESENT_POLICY_BALANCED;
+    swapchain = VK_NULL_HANDLE;
+    surfaceFormat.format = VK_FORMAT_UNDEFINED;
+    surfaceFormat.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+    extent.width = 0;
+    extent.height = 0;
+    presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    imageUsage = 0;
+    requestedWidth = 0;
+    requestedHeight = 0;
+    needsRecreate = false;
+    stats = {};
+}
+
+SwapchainManager::~SwapchainManager()
+{
+}
+
+VkPresentModeKHR SwapchainManager::choosePresentMode(const std::vector<VkPresentModeKHR>& available, PresentPolicy policy)
+{
+    // FIFO is the only mode every implementation has to support.
+    static const VkPresentModeKHR lowLatency[] = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_KHR };
+    static const VkPresentModeKHR balanced[] = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR };
+    static const VkPresentModeKHR powerSaving[] = { VK_PRESENT_MODE_FIFO_KHR };
+
+    const VkPresentModeKHR* preferred = balanced;
+    size_t preferredCount = sizeof(balanced) / sizeof(balanced[0]);
+    if (policy == PRESENT_POLICY_LOW_LATENCY) {
+        preferred = lowLatency;
+        preferredCount = sizeof(lowLatency) / sizeof(lowLatency[0]);
+    } else if (policy == PRESENT_POLICY_POWER_SAVING) {
+        preferred = powerSaving;
+        preferredCount = sizeof(powerSaving) / sizeof(powerSaving[0]);
+    }
+
+    for (size_t i = 0; i < preferredCount; i++) {
+        if (std::find(available.begin(), available.end(), preferred[i]) != available.end()) {
+            return preferred[i];
+        }
+    }
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+VkSurfaceFormatKHR SwapchainManager::chooseSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& available)
+{
+    // The 8 bit UNORM formats, like the offscreen images.
+    VkSurfaceFormatKHR preferred = {};
+    preferred.format = VK_FORMAT_B8G8R8A8_UNORM;
+    preferred.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+
+    // A single UNDEFINED entry means the surface takes any format.
+    if (available.empty() || (available.size() == 1 && available[0].format == VK_FORMAT_UNDEFINED)) {
+        return preferred;
+    }
+
+    for (size_t i = 0; i < available.size(); i++) {
+        if ((available[i].format == VK_FORMAT_B8G8R8A8_UNORM || available[i].format == VK_FORMAT_R8G8B8A8_UNORM) &&
+            available[i].colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+            return available[i];
+        }
+    }
+    return available[0];
+}
+
+VkExtent2D SwapchainManager::chooseExtent(const VkSurfaceCapabilitiesKHR& capabilities, uint32_t width, uint32_t height)
+{
+    // The surface size decides, unless the surface lets the swapchain decide.
+    if (capabilities.currentExtent.width != UINT32_MAX) {
+        return capabilities.currentExtent;
+    }
+
+    VkExtent2D chosen;
+    chosen.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, width));
+    chosen.height = std::max(capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.height, height));
+    return chosen;
+}
+
+uint32_t SwapchainManager::chooseImageCount(const VkSurfaceCapabilitiesKHR& capabilities, VkPresentModeKHR presentMode)
+{
+    // One image more than the minimum so that acquire does not wait on the presentation engine,
+    // and mailbox needs one being shown, one queued and one being rendered.
+    uint32_t count = capabilities.minImageCount + 1;
+    if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+        count = std::max(count, 3u);
+    }
+    // A maximum of 0 means no limit.
+    if (capabilities.maxImageCount > 0) {
+        count = std::min(count, capabilities.maxImageCount);
+    }
+    return count;
+}
+
+const char* SwapchainManager::presentModeName(VkPresentModeKHR presentMode)
+{
+    switch (presentMode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR: return "IMMEDIATE";
+    case VK_PRESENT_MODE_MAILBOX_KHR: return "MAILBOX";
+    case VK_PRESENT_MODE_FIFO_KHR: return "FIFO";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+    default: return "UNKNOWN";
+    }
+}
+
+VkResult SwapchainManager::createSwapchain(VulkanDevice* inDeviceObj, VkSurfaceKHR inSurface, uint32_t width, uint32_t height,
+    PresentPolicy inPolicy)
+{
+    deviceObj = inDeviceObj;
+    surface = inSurface;
+    policy = inPolicy;
+
+    // A surface without a size yet is not an error, the swapchain is created at a later acquire.
+    VkResult result = buildSwapchain(width, height);
+    needsRecreate = result != VK_SUCCESS;
+    if (result == VK_SUCCESS) {
+        std::cout << "Swapchain: " << images.size() << " images of " << extent.width << "x" << extent.height
+                  << ", present mode " << presentModeName(presentMode) << std::endl;
+    }
+    return result;
+}
+
+void SwapchainManager::destroySwapchain()
+{
+    destroyImageViews(imageViews);
+    images.clear();
+    if (swapchain != VK_NULL_HANDLE) {
+        vkDestroySwapchainKHR(deviceObj->device, swapchain, NULL);
+        swapchain = VK_NULL_HANDLE;
+    }
+}
+
+VkResult SwapchainManager::recreateSwapchain(uint32_t width, uint32_t height)
+{
+    VkSwapchainKHR oldSwapchain = swapchain;
+    std::vector<VkImageView> oldImageViews = imageViews;
+
+    VkResult result = buildSwapchain(width, height);
+    if (result != VK_SUCCESS) {
+        needsRecreate = true; // Try again at the next acquire.
+        return result;
+    }
+    needsRecreate = false;
+
+    // Frames still in flight may be using the old images, the views go before the swapchain.
+    if (oldSwapchain != VK_NULL_HANDLE) {
+        stats.recreations++;
+        for (size_t i = 0; i < oldImageViews.size(); i++) {
+            deviceObj->deletionQueue.destroyObject(VK_OBJECT_TYPE_IMAGE_VIEW, oldImageViews[i]);
+        }
+        deviceObj->deletionQueue.destroyObject(VK_OBJECT_TYPE_SWAPCHAIN_KHR, oldSwapchain);
+    }
+    return result;
+}
+
+VkResult SwapchainManager::acquireNextImage(VkSemaphore semaphore, uint32_t* imageIndex)
+{
+    VkResult result;
+    if (needsRecreate) {
+        result = recreateSwapchain(requestedWidth, requestedHeight);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+
+    // An OUT_OF_DATE acquire leaves the semaphore untouched, so it can be retried once.
+    for (int attempt = 0; attempt < 2; attempt++) {
+        result = vkAcquireNextImageKHR(deviceObj->device, swapchain, UINT64_MAX, semaphore, VK_NULL_HANDLE, imageIndex);
+        if (result == VK_SUCCESS) {
+            stats.imagesAcquired++;
+            return result;
+        }
+        if (result == VK_SUBOPTIMAL_KHR) {
+            // The image is acquired and the semaphore will be signaled, use it and recreate next time.
+            stats.imagesAcquired++;
+            stats.suboptimal++;
+            needsRecreate = true;
+            return result;
+        }
+        if (result != VK_ERROR_OUT_OF_DATE_KHR) {
+            return result;
+        }
+
+        stats.outOfDate++;
+        result = recreateSwapchain(requestedWidth, requestedHeight);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+    return VK_ERROR_OUT_OF_DATE_KHR;
+}
+
+VkResult SwapchainManager::present(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore)
+{
+    VkPresentInfoKHR presentInfo = {};
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    presentInfo.pNext = NULL;
+    presentInfo.waitSemaphoreCount = waitSemaphore != VK_NULL_HANDLE ? 1 : 0;
+    presentInfo.pWaitSemaphores = waitSemaphore != VK_NULL_HANDLE ? &waitSemaphore : NULL;
+    presentInfo.swapchainCount = 1;
+    presentInfo.pSwapchains = &swapchain;
+    presentInfo.pImageIndices = &imageIndex;
+    presentInfo.pResults = NULL;
+
+    VkResult result = vkQueuePresentKHR(queue, &presentInfo);
+    if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+        stats.imagesPresented++;
+    }
+    if (result == VK_SUBOPTIMAL_KHR) {
+        stats.suboptimal++;
+        needsRecreate = true;
+    } else if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        stats.outOfDate++;
+        needsRecreate = true;
+    }
+    return result;
+}
+
+VkResult SwapchainManager::buildSwapchain(uint32_t width, uint32_t height)
+{
+    VkResult result;
+    VkPhysicalDevice gpu = *deviceObj->gpu;
+
+    requestedWidth = width;
+    requestedHeight = height;
+
+    VkSurfaceCapabilitiesKHR capabilities;
+    result = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(gpu, surface, &capabilities);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    VkExtent2D newExtent = chooseExtent(capabilities, width, height);
+    if (newExtent.width == 0 || newExtent.height == 0) {
+        return VK_NOT_READY;
+    }
+
+    uint32_t count = 0;
+    result = vkGetPhysicalDeviceSurfaceFormatsKHR(gpu, surface, &count, NULL);
+    assert(result == VK_SUCCESS);
+    std::vector<VkSurfaceFormatKHR> formats(count);
+    result = vkGetPhysicalDeviceSurfaceFormatsKHR(gpu, surface, &count, formats.data());
+    assert(result == VK_SUCCESS);
+
+    result = vkGetPhysicalDeviceSurfacePresentModesKHR(gpu, surface, &count, NULL);
+    assert(result == VK_SUCCESS);
+    std::vector<VkPresentModeKHR> presentModes(count);
+    result = vkGetPhysicalDeviceSurfacePresentModesKHR(gpu, surface, &count, presentModes.data());
+    assert(result == VK_SUCCESS);
+
+    surfaceFormat = chooseSurfaceFormat(formats);
+    presentMode = choosePresentMode(presentModes, policy);
+
+    // Transfer destination lets the frames be cleared or copied into without a render pass.
+    imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+        (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+
+    VkCompositeAlphaFlagBitsKHR compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    if (!(capabilities.supportedCompositeAlpha & VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR)) {
+        // Take the lowest supported mode, at least one bit is always set.
+        compositeAlpha = (VkCompositeAlphaFlagBitsKHR)(capabilities.supportedCompositeAlpha & (~capabilities.supportedCompositeAlpha + 1));
+    }
+
+    VkSwapchainCreateInfoKHR swapchainInfo = {};
+    swapchainInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    swapchainInfo.pNext = NULL;
+    swapchainInfo.flags = 0;
+    swapchainInfo.surface = surface;
+    swapchainInfo.minImageCount = chooseImageCount(capabilities, presentMode);
+    swapchainInfo.imageFormat = surfaceFormat.format;
+    swapchainInfo.imageColorSpace = surfaceFormat.colorSpace;
+    swapchainInfo.imageExtent = newExtent;
+    swapchainInfo.imageArrayLayers = 1;
+    swapchainInfo.imageUsage = imageUsage;
+    swapchainInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE; // Rendered and presented on the same queue.
+    swapchainInfo.queueFamilyIndexCount = 0;
+    swapchainInfo.pQueueFamilyIndices = NULL;
+    swapchainInfo.preTransform = (capabilities.supportedTransforms & VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR) ?
+        VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR : capabilities.currentTransform;
+    swapchainInfo.compositeAlpha = compositeAlpha;
+    swapchainInfo.presentMode = presentMode;
+    swapchainInfo.clipped = VK_TRUE;
+    // The old swapchain keeps presenting its queued images, new acquires are from the new one.
+    swapchainInfo.oldSwapchain = swapchain;
+
+    VkSwapchainKHR newSwapchain;
+    result = vkCreateSwapchainKHR(deviceObj->device, &swapchainInfo, NULL, &newSwapchain);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+    swapchain = newSwapchain;
+    extent = newExtent;
+    deviceObj->setObjectName(VK_OBJECT_TYPE_SWAPCHAIN_KHR, swapchain, "Swapchain");
+
+    result = vkGetSwapchainImagesKHR(deviceObj->device, swapchain, &count, NULL);
+    assert(result == VK_SUCCESS);
+    images.resize(count);
+    result = vkGetSwapchainImagesKHR(deviceObj->device, swapchain, &count, images.data());
+    assert(result == VK_SUCCESS);
+
+    // The previous views belong to the retired swapchain now.
+    imageViews.clear();
+    imageViews.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.pNext = NULL;
+        viewInfo.flags = 0;
+        viewInfo.image = images[i];
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = surfaceFormat.format;
+        viewInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+        viewInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+        viewInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+        viewInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        result = vkCreateImageView(deviceObj->device, &viewInfo, NULL, &imageViews[i]);
+        assert(result == VK_SUCCESS);
+
+        char name[64];
+        snprintf(name, sizeof(name), "Swapchain image %u", i);
+        deviceObj->setObjectName(VK_OBJECT_TYPE_IMAGE, images[i], name);
+    }
+    return VK_SUCCESS;
+}
+
+void SwapchainManager::destroyImageViews(std::vector<VkImageView>& views)
+{
+    for (size_t i = 0; i < views.size(); i++) {
+        vkDestroyImageView(deviceObj->device, views[i], NULL);
+    }
+    views.clear();
+}
+
+void SwapchainManager::printStats() const
+{
+    std::cout << "Swapchain: " << stats.imagesAcquired << " images acquired, " << stats.imagesPresented << " presented, "
+              << stats.recreations << " recreations (" << stats.outOfDate << " out of date, "
+              << stats.suboptimal << " suboptimal)" << std::endl;
+}
@@ -0,0 +1,120 @@
+#include "ThreadPool.h"
+#include "CpuProfiler.h"
+#include <cstdio>
+
+ThreadPool::ThreadPool()
+{
+    currentTask = NULL;
+    taskCount = 0;
+    nextTask = 0;
+    remainingTasks = 0;
+    activeWorkers = 0;
+    generation = 0;
+    stopping = false;
+}
+
+ThreadPool::~ThreadPool()
+{
+    destroyThreads();
+}
+
+void ThreadPool::createThreads(uint32_t threadCount)
+{
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    stopping = false;
+    for (uint32_t i = 0; i < threadCount; i++) {
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+    }
+}
+
+void ThreadPool::destroyThreads()
+{
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void ThreadPool::parallelFor(uint32_t inTaskCount, const std::function<void(uint32_t, uint32_t)>& task)
+{
+    if (inTaskCount == 0) {
+        return;
+    }
+
+    // Without workers run everything on the calling thread.
+    if (workers.empty()) {
+        for (uint32_t i = 0; i < inTaskCount; i++) {
+            task(i, 0);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> dispatchLock(dispatchMutex);
+    std::unique_lock<std::mutex> lock(poolMutex);
+
+    currentTask = &task;
+    taskCount = inTaskCount;
+    nextTask = 0;
+    remainingTasks = inTaskCount;
+    generation++;
+    wakeCondition.notify_all();
+
+    // Also wait for the workers to leave the job, so none of them
+    // touches the task counters once the next job is set up.
+    doneCondition.wait(lock, [this]() { return remainingTasks == 0 && activeWorkers == 0; });
+    currentTask = NULL;
+}
+
+void ThreadPool::workerLoop(uint32_t workerIndex)
+{
+    uint64_t seenGeneration = 0;
+
+    char threadName[32];
+    snprintf(threadName, sizeof(threadName), "Worker %u", workerIndex);
+    PROFILE_THREAD_NAME(threadName);
+
+    for (;;) {
+        const std::function<void(uint32_t, uint32_t)>* task;
+        uint32_t count;
+        {
+            std::unique_lock<std::mutex> lock(poolMutex);
+            wakeCondition.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+            if (stopping) {
+                return;
+            }
+            seenGeneration = generation;
+            // The job may already be finished by the other workers.
+            if (remainingTasks == 0) {
+                continue;
+            }
+            task = currentTask;
+            count = taskCount;
+            activeWorkers++;
+        }
+
+        // Tasks are grabbed one by one, which balances uneven task sizes.
+        for (;;) {
+            uint32_t taskIndex = nextTask.fetch_add(1);
+            if (taskIndex >= count) {
+                break;
+            }
+            (*task)(taskIndex, workerIndex);
+            remainingTasks.fetch_sub(1);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(poolMutex);
+            activeWorkers--;
+        }
+        doneCondition.notify_all();
+    }
+}
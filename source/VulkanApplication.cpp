@@ -1,27 +1,41 @@
 #include "VulkanApplication.h"
-
-std::unique_ptr<VulkanApplication> VulkanApplication::instance;
-std::once_flag VulkanApplication::onlyOnce;
-
-extern std::vector<const char*> layerNames;
-extern std::vector<const char*> instanceExtensionNames;
-extern std::vector<const char*> deviceExtensionNames;
+#include "CpuProfiler.h"
+#include "CommandBufferManager.h"
+#include <fstream>
 
 // Application constructor for layer enumeration.
 VulkanApplication::VulkanApplication()
 {
-    // At application start up, enumerate instance layers.
-    instanceObj.layerExtension.getInstanceLayerProperties();
-
     deviceObj = NULL;
     debugFlag = true;
+    currentFrame = NULL;
+    currentImageIndex = 0;
+    currentImageAcquired = false;
+    framesInFlight = FrameScheduler::DEFAULT_FRAMES_IN_FLIGHT;
+    frameLimit = 1000;
+    pipelineCachePath = "pipeline_cache.bin";
+    capabilityCachePath = "capabilities.bin";
+    listCapabilities = false;
+    maxDeviceCount = 1;
+#ifdef WSI_SUPPORTED
+    headless = false;
+#else
+    headless = true; // Built without a window system.
+#endif
+    renderWidth = 1280;
+    renderHeight = 720;
+    surface = VK_NULL_HANDLE;
+    presentPolicy = PRESENT_POLICY_BALANCED;
+    mesh = NULL;
+    cullObjectCount = 0;
 }
 
 VkResult VulkanApplication::createVulkanInstance(std::vector<const char*>& layers,
     std::vector<const char*>& extensions,
-    const char* appName)
+    const char* appName,
+    const std::vector<const char*>& optionalExtensions)
 {
-    return instanceObj.createInstance(layers, extensions, appName);
+    return instanceObj.createInstance(layers, extensions, appName, optionalExtensions);
 }
 
 /*
@@ -38,33 +52,64 @@ VkResult VulkanApplication::createVulkanInstance(std::vector<const char*>& layer
  */
 VkResult VulkanApplication::handShakeWithDevice(VkPhysicalDevice* gpu, std::vector<const char*>& layers, std::vector<const char*>& extensions)
 {
-    deviceObj = new VulkanDevice(gpu);
-    if (!deviceObj) {
+    PROFILE_SCOPE("VulkanApplication::handShakeWithDevice");
+    VulkanDevice* device = new VulkanDevice(gpu);
+    if (!device) {
         return VK_ERROR_OUT_OF_HOST_MEMORY;
     }
+    deviceList.push_back(device);
 
-    // Print the devices available layer and their extension.
-    deviceObj->layerExtension.getDeviceExtensionProperties(gpu);
+    // Get the devices available layer and their extension.
+    device->layerExtension.getDeviceExtensionProperties(gpu, capabilityDB);
+    if (listCapabilities) {
+        device->layerExtension.printLayerProperties("Device extensions", "Device Extension");
+    }
 
     // Get the physical device/GPU properties.
-    vkGetPhysicalDeviceProperties(*gpu, &deviceObj->gpuProps);
+    vkGetPhysicalDeviceProperties(*gpu, &device->gpuProps);
 
     // Get the memory properties from the physical device.GPU.
-    vkGetPhysicalDeviceMemoryProperties(*gpu, &deviceObj->memoryProperties);
+    vkGetPhysicalDeviceMemoryProperties(*gpu, &device->memoryProperties);
 
     // Query the available queues on the physical device and their properties.
-    deviceObj->getPhysicalDeviceQueuesAndProperties();
+    device->getPhysicalDeviceQueuesAndProperties();
 
     // Retrieve the queue which support graphics pipeline.
-    deviceObj->getGraphicsQueueHandle();
+    device->getGraphicsQueueHandle();
+
+    // Object names go through the instance's debug utils entry points.
+    device->debugUtils = &instanceObj.debugUtils;
+    device->instance = instanceObj.instance;
+
+    // Features used where the device has them, createDevice keeps the supported ones.
+    device->requestedFeatures.timelineSemaphore.timelineSemaphore = VK_TRUE; // Render graph queue waits.
+    BindlessTable::requestFeatures(device->requestedFeatures);
+    GpuCuller::requestFeatures(device->requestedFeatures);
+    BarrierBuilder::requestFeatures(device->requestedFeatures);
 
     // Create logical device, ensure that this device is conneced to graphics queue.
-    return deviceObj->createDevice(layers, extensions);
+    VkResult result = device->createDevice(layers, extensions, optionalDeviceExtensionNames, &instanceObj.layerExtension.enabled);
+    if (result != VK_SUCCESS) {
+        deviceList.pop_back();
+        delete device;
+        return result;
+    }
+
+    // Get the handle of the queue the frames are submitted to.
+    device->getDeviceQueue();
+
+    // Set up the device memory sub-allocator, it chooses memory types from 'memoryProperties'.
+    device->memoryAllocator.createAllocator(device);
+
+    // Objects given up while the GPU may still use them wait here, no device wait needed.
+    device->deletionQueue.createDeletionQueue(device);
+    return result;
 }
 
 VkResult VulkanApplication::enumeratePhysicalDevice(
     std::vector<VkPhysicalDevice>& gpuList)
 {
+    PROFILE_SCOPE("VulkanApplication::enumeratePhysicalDevice");
     // Hold the gpu count.
     uint32_t gpuDeviceCount;
 
@@ -72,7 +117,11 @@ VkResult VulkanApplication::enumeratePhysicalDevice(
     VkResult result = vkEnumeratePhysicalDevices(instanceObj.instance, &gpuDeviceCount, NULL);
     assert(result == VK_SUCCESS);
 
-    assert(gpuDeviceCount);
+    if (gpuDeviceCount == 0) {
+        std::cout << "Error: no Vulkan physical device found." << std::endl;
+        gpuList.clear();
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
 
     // Make space for restrieval
     gpuList.resize(gpuDeviceCount);
@@ -84,59 +133,445 @@ VkResult VulkanApplication::enumeratePhysicalDevice(
     return result;
 }
 
-VulkanApplication::~VulkanApplication() { }
-
-VulkanApplication* VulkanApplication::GetInstance()
+/*
+ * Scores every enumerated GPU on its properties, memory heaps, queue families and
+ * whether it supports the required device extensions.
+ */
+std::vector<uint32_t> VulkanApplication::selectPhysicalDevices()
 {
-    std::call_once(onlyOnce, []() { instance.reset(new VulkanApplication()); });
-    return instance.get();
+    PROFILE_SCOPE("VulkanApplication::selectPhysicalDevices");
+    std::vector<DeviceCandidate> candidates(gpuList.size());
+    for (uint32_t i = 0; i < (uint32_t)gpuList.size(); i++) {
+        DeviceSelector::queryCandidate(gpuList[i], i, candidates[i]);
+
+        // Same check createDevice() does, against the enumerated extensions of this GPU.
+        const DeviceCapabilities* capabilities = capabilityDB.findDevice(gpuList[i]);
+        if (capabilities) {
+            CapabilitySet supported;
+            supported.build(CAPABILITY_LEVEL_DEVICE, capabilities->implementation, capabilities->layers);
+
+            std::vector<const char*> enableList;
+            candidates[i].hasRequiredExtensions = supported.resolveExtensions(requiredDeviceExtensions, std::vector<const char*>(),
+                enableList, NULL, &instanceObj.layerExtension.enabled);
+        }
+    }
+
+    DeviceSelector::printRanking(candidates, devicePolicy);
+    return DeviceSelector::rankDevices(candidates, devicePolicy);
 }
 
+VulkanApplication::~VulkanApplication() { }
+
 void VulkanApplication::initialize()
 {
+    PROFILE_SCOPE("VulkanApplication::initialize");
     char title[] = "Hello World!!!";
 
+    // At application start up, enumerate instance layers, or take them from the previous run.
+    capabilityDB.loadDatabase(capabilityCachePath);
+    instanceObj.layerExtension.getInstanceLayerProperties(capabilityDB);
+    if (listCapabilities) {
+        instanceObj.layerExtension.printLayerProperties("Instanced Layers", "Layer Extension");
+    }
+
     // Check if the supplied layer are supported or not such that typos could be detected.
     if (debugFlag) {
         instanceObj.layerExtension.areLayersSupported(layerNames);
     }
 
     // Create the Vulkan instance wit specified layer and extension names.
-    createVulkanInstance(layerNames, instanceExtensionNames, title);
+    // Headless rendering needs no window system integration, so it runs without a display server.
+    requiredInstanceExtensions = headless ? std::vector<const char*>() : instanceExtensionNames;
+    requiredDeviceExtensions = headless ? std::vector<const char*>() : deviceExtensionNames;
+
+    std::vector<const char*> optionalInstanceExtensions = featureInstanceExtensionNames;
+    if (debugFlag) {
+        optionalInstanceExtensions.insert(optionalInstanceExtensions.end(),
+            debugInstanceExtensionNames.begin(), debugInstanceExtensionNames.end());
+    }
+    if (!headless) {
+        optionalInstanceExtensions.insert(optionalInstanceExtensions.end(),
+            presentInstanceExtensionNames.begin(), presentInstanceExtensionNames.end());
+    }
+    createVulkanInstance(layerNames, requiredInstanceExtensions, title, optionalInstanceExtensions);
 
-    // Create the debugging report if debugging is enabled
+    // Create the debug messenger, or the debugging report on older loaders, if debugging is enabled
     if (debugFlag) {
-        instanceObj.layerExtension.createDebugReportCallback();
+        instanceObj.layerExtension.createDebugMessenger(instanceObj.instance, instanceObj.debugUtils);
     }
 
-    // Get the list of physical devices on the system.
-    std::vector<VkPhysicalDevice> gpuList;
+    // There is no window to present to, the surface comes from the headless surface extension.
+    if (!headless && instanceObj.createHeadlessSurface(&surface) != VK_SUCCESS) {
+        std::cout << "No presentation surface available, rendering offscreen." << std::endl;
+        headless = true;
+        requiredDeviceExtensions.clear();
+    }
+
+    // Get the list of physical devices on the system, it is kept for the lifetime of the devices.
     enumeratePhysicalDevice(gpuList);
 
-    // Assuming the system has only one GPU.
-    if (gpuList.size() > 0) {
-        handShakeWithDevice(&gpuList[0], layerNames, deviceExtensionNames);
+    // Device extensions of all GPUs at once, then keep everything for the next start up.
+    capabilityDB.enumerateDevices(gpuList);
+    capabilityDB.saveDatabase();
+    capabilityDB.printSummary();
+
+    // Create the logical devices on the best GPUs, the first one renders.
+    std::vector<uint32_t> ranking = selectPhysicalDevices();
+    if (ranking.empty()) {
+        std::cout << "Error: no physical device is able to run the application." << std::endl;
+        return; // No device, the caller reports the failure.
+    }
+
+    for (size_t i = 0; i < ranking.size() && deviceList.size() < maxDeviceCount; i++) {
+        if (handShakeWithDevice(&gpuList[ranking[i]], layerNames, requiredDeviceExtensions) != VK_SUCCESS) {
+            continue;
+        }
+
+        // Seed the pipeline cache with the compiles of the previous run, one file per device.
+        VulkanDevice* device = deviceList.back();
+        std::string cachePath = pipelineCachePath;
+        if (deviceList.size() > 1 && !cachePath.empty()) {
+            cachePath += "." + std::to_string(deviceList.size() - 1);
+        }
+        device->pipelineManager.createPipelineManager(device, cachePath);
+
+        std::cout << "Logical device " << deviceList.size() - 1 << " created on " << device->gpuProps.deviceName << std::endl;
+    }
+    deviceObj = deviceList.empty() ? NULL : deviceList[0];
+
+    // Frames are presented from the queue they are rendered on.
+    if (deviceObj && surface != VK_NULL_HANDLE) {
+        VkBool32 presentSupported = VK_FALSE;
+        vkGetPhysicalDeviceSurfaceSupportKHR(*deviceObj->gpu, deviceObj->graphicsQueueIndex, surface, &presentSupported);
+        if (presentSupported) {
+            deviceObj->graphicsQueueWithPresentIndex = deviceObj->graphicsQueueIndex;
+        } else {
+            std::cout << "The graphics queue cannot present to the surface, rendering offscreen." << std::endl;
+            instanceObj.destroySurface(surface);
+            surface = VK_NULL_HANDLE;
+            headless = true;
+        }
     }
 }
 
 void VulkanApplication::prepare()
 {
+    PROFILE_SCOPE("VulkanApplication::prepare");
+    // Allocate the per-frame command pools, command buffers and synchronization objects.
+    frameScheduler.createFrameSlots(deviceObj, framesInFlight);
+
+    // Timestamp queries for each frame slot, read back when the slot is reused.
+    gpuProfiler.createProfiler(deviceObj, frameScheduler.getFramesInFlight(), deviceObj->graphicsQueueIndex);
+    frameScheduler.setProfiler(&gpuProfiler);
+
+    // Allocate the worker thread command pools, one set for each frame in flight.
+    commandPoolMgr.createCommandPools(deviceObj, deviceObj->graphicsQueueIndex, framesInFlight);
+
+    // Descriptor pools for each frame slot and recording thread, recycled with the slot.
+    descriptorAllocator.createDescriptorAllocator(deviceObj, frameScheduler.getFramesInFlight(), commandPoolMgr.getWorkerCount());
+
+    // Pipeline barriers of the frame, with synchronization2 where the device has it.
+    barrierBuilder.createBarrierBuilder(deviceObj);
+
+    // Staging memory for uploads, submitted ahead of each frame on the same queue.
+    stagingRing.createStagingRing(deviceObj, deviceObj->queue, deviceObj->graphicsQueueIndex);
+
+    // Compute jobs outside the frame, on the compute queue so they overlap rendering.
+    computeEngine.createComputeEngine(deviceObj, deviceObj->computeQueue, deviceObj->computeQueueIndex);
+
+    // One descriptor set with every texture and buffer, where descriptor indexing is available.
+    if (BindlessTable::isSupported(deviceObj)) {
+        bindlessTable.createBindlessTable(deviceObj);
+    } else {
+        std::cout << "Descriptor indexing not available, draws bind their own descriptor sets." << std::endl;
+    }
+
+    // Mesh LODs go through the staging ring, coarsest first so something can be drawn early.
+    meshStreamer.createMeshStreamer(deviceObj, &stagingRing);
+    if (!meshPath.empty()) {
+        mesh = meshStreamer.openMesh(meshPath);
+        for (uint32_t lod = mesh ? mesh->header->lodCount : 0; lod-- > 0;) {
+            meshStreamer.requestLod(mesh, lod);
+        }
+    }
+
+    // Without a swapchain every frame slot renders into its own image, which is read back.
+    if (headless) {
+        offscreenTarget.createOffscreenTarget(deviceObj, renderWidth, renderHeight, frameScheduler.getFramesInFlight());
+        readbackPool.createReadbackPool(deviceObj, frameScheduler.getFramesInFlight(),
+            (VkDeviceSize)renderWidth * renderHeight * offscreenTarget.getTexelSize());
+    } else {
+        // Images not acquired yet are fine, a surface without size gets its swapchain later.
+        swapchainMgr.createSwapchain(deviceObj, surface, renderWidth, renderHeight, presentPolicy);
+    }
+
+    // A generated scene of objects culled on the GPU every frame, to measure the cost per object.
+    // The offscreen pass draws the bounding boxes of the visible ones.
+    if (cullObjectCount && !GpuCuller::isSupported(deviceObj)) {
+        std::cout << "Indirect draws cannot set firstInstance, GPU culling disabled." << std::endl;
+    } else if (cullObjectCount && gpuCuller.createGpuCuller(deviceObj, &computeEngine, &descriptorAllocator,
+        &stagingRing, frameScheduler.getFramesInFlight())) {
+        if (headless) {
+            gpuCuller.createBoundsPipeline(offscreenTarget.getRenderPass(), renderWidth, renderHeight);
+        }
+        std::vector<CullDraw> draws;
+        std::vector<CullObject> objects;
+        GpuCuller::buildTestScene(cullObjectCount, draws, objects);
+        gpuCuller.setScene(draws, objects);
+    }
 }
 
 void VulkanApplication::update()
 {
+    PROFILE_SCOPE("VulkanApplication::update");
+    // Wait for the oldest frame slot to retire and start recording into it.
+    currentFrame = frameScheduler.beginFrame();
+
+    // The slot has retired, recycle the secondary command buffers recorded for it.
+    commandPoolMgr.resetFramePools(currentFrame->slotIndex);
+    descriptorAllocator.resetFrame(currentFrame->slotIndex);
+    if (gpuCuller.getObjectCount()) {
+        gpuCuller.beginFrame(currentFrame->slotIndex);
+    }
+
+    // Give back the staging space of uploads that have completed.
+    stagingRing.reclaim();
+
+    // Destroy in one go what the frames retired since the last update no longer use.
+    deviceObj->deletionQueue.beginFrame(currentFrame->frameNumber, frameScheduler.getRetiredFrameCount());
+    if (bindlessTable.getLayout() != VK_NULL_HANDLE) {
+        bindlessTable.beginFrame(currentFrame->frameNumber, frameScheduler.getRetiredFrameCount());
+    }
+
+    // Queue the next slices of the requested mesh LODs, flushed with this frame's uploads.
+    meshStreamer.update();
+
+    // The image the slot rendered last time around is in host memory now.
+    if (headless) {
+        readbackPool.acquireData(currentFrame->slotIndex);
+        return;
+    }
+
+    // An out of date swapchain is recreated here, the old one goes to the deletion queue.
+    VkResult result = swapchainMgr.acquireNextImage(currentFrame->imageAcquiredSemaphore, &currentImageIndex);
+    currentImageAcquired = result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR;
 }
 
 bool VulkanApplication::render()
 {
-    return true;
+    PROFILE_SCOPE("VulkanApplication::render");
+    // Submit this frame's uploads as one batch before the frame that consumes them.
+    stagingRing.flush();
+
+    // The draw commands of the frame are culled before its passes.
+    if (gpuCuller.getObjectCount()) {
+        recordCulling(currentFrame);
+    }
+
+    if (headless) {
+        recordOffscreenFrame(currentFrame);
+    } else if (currentImageAcquired) {
+        recordSwapchainFrame(currentFrame);
+    }
+
+    // Submit the recorded frame, the GPU works on it while the next one is recorded. Without an
+    // image, for example while the surface has no size, the frame is submitted but not presented.
+    if (currentImageAcquired) {
+        frameScheduler.endFrame(currentFrame, currentFrame->imageAcquiredSemaphore, VK_PIPELINE_STAGE_TRANSFER_BIT, true);
+        swapchainMgr.present(deviceObj->queue, currentImageIndex, currentFrame->renderCompleteSemaphore);
+        currentImageAcquired = false;
+    } else {
+        frameScheduler.endFrame(currentFrame);
+    }
+    currentFrame = NULL;
+    currentImageIndex = 0;
+    currentImageAcquired = false;
+
+    return frameLimit == 0 || frameScheduler.getFrameNumber() < frameLimit;
+}
+
+// The camera sits in the middle of the scene and turns around once every 600 frames.
+static float cameraYaw(uint64_t frameNumber)
+{
+    return (frameNumber % 600) / 600.0f * 2.0f * 3.14159265f;
+}
+
+void VulkanApplication::recordCulling(FrameSlot* frame)
+{
+    float planes[6][4];
+    GpuCuller::cameraFrustum(cameraYaw(frame->frameNumber), (float)renderWidth / renderHeight,
+        GpuCuller::testSceneExtent(cullObjectCount) * 2.0f, planes);
+
+    GpuProfileScope scope(&gpuProfiler, frame->cmdBuffer, "GPU culling");
+    gpuCuller.recordCulling(frame->cmdBuffer, frame->slotIndex, planes);
+}
+
+void VulkanApplication::recordOffscreenFrame(FrameSlot* frame)
+{
+    VkCommandBuffer cmdBuffer = frame->cmdBuffer;
+
+    // Cycle the clear color so consecutive frames are distinguishable in the readback.
+    float phase = (frame->frameNumber % 120) / 120.0f;
+    float clearColor[4] = { phase, 0.2f, 1.0f - phase, 1.0f };
+
+    {
+        CommandBufferLabel label(deviceObj->debugUtils, cmdBuffer, "Offscreen pass");
+        GpuProfileScope scope(&gpuProfiler, cmdBuffer, "Offscreen pass");
+        offscreenTarget.beginRenderPass(cmdBuffer, frame->slotIndex, clearColor);
+        if (gpuCuller.getObjectCount()) {
+            float viewProjection[4][4];
+            GpuCuller::cameraViewProjection(cameraYaw(frame->frameNumber), (float)renderWidth / renderHeight,
+                GpuCuller::testSceneExtent(cullObjectCount) * 2.0f, viewProjection);
+            gpuCuller.recordBoundsDraws(cmdBuffer, frame->slotIndex, viewProjection);
+        }
+        offscreenTarget.endRenderPass(cmdBuffer);
+    }
+
+    GpuProfileScope scope(&gpuProfiler, cmdBuffer, "Readback copy");
+    readbackPool.recordImageCopy(cmdBuffer, frame->slotIndex, frame->frameNumber,
+        offscreenTarget.getImage(frame->slotIndex), offscreenTarget.getFinalLayout(),
+        offscreenTarget.getWidth(), offscreenTarget.getHeight(), offscreenTarget.getTexelSize());
+}
+
+void VulkanApplication::recordSwapchainFrame(FrameSlot* frame)
+{
+    VkCommandBuffer cmdBuffer = frame->cmdBuffer;
+    VkImage image = swapchainMgr.getImage(currentImageIndex);
+    bool canClear = (swapchainMgr.getImageUsage() & VK_IMAGE_USAGE_TRANSFER_DST_BIT) != 0;
+
+    CommandBufferLabel label(deviceObj->debugUtils, cmdBuffer, "Swapchain pass");
+    GpuProfileScope scope(&gpuProfiler, cmdBuffer, "Swapchain pass");
+
+    VkImageSubresourceRange range;
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    range.baseMipLevel = 0;
+    range.levelCount = 1;
+    range.baseArrayLayer = 0;
+    range.layerCount = 1;
+
+    // The previous contents are not needed. The transfer stage is the one waiting on the
+    // acquire semaphore, so the layout change happens after the image is acquired.
+    barrierBuilder.addImageBarrier(image, range, VK_IMAGE_LAYOUT_UNDEFINED,
+        canClear ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, canClear ? VK_ACCESS_TRANSFER_WRITE_BIT : 0);
+    barrierBuilder.flush(cmdBuffer);
+    if (!canClear) {
+        return;
+    }
+
+    float phase = (frame->frameNumber % 120) / 120.0f;
+    VkClearColorValue clearColor = {};
+    clearColor.float32[0] = phase;
+    clearColor.float32[1] = 0.2f;
+    clearColor.float32[2] = 1.0f - phase;
+    clearColor.float32[3] = 1.0f;
+    vkCmdClearColorImage(cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &range);
+
+    // Presentation needs no access mask, the render complete semaphore makes the writes available.
+    barrierBuilder.addImageBarrier(image, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+    barrierBuilder.flush(cmdBuffer);
+}
+
+// Writes the newest image still held by the readback pool as a binary PPM.
+bool VulkanApplication::writeLastReadback(const std::string& filePath)
+{
+    const void* newestData = NULL;
+    uint64_t newestFrame = 0;
+    for (uint32_t i = 0; i < frameScheduler.getFramesInFlight(); i++) {
+        uint64_t frameNumber;
+        const void* data = readbackPool.acquireData(i, &frameNumber);
+        if (data && (!newestData || frameNumber > newestFrame)) {
+            newestData = data;
+            newestFrame = frameNumber;
+        }
+    }
+    if (!newestData) {
+        return false;
+    }
+
+    std::ofstream file(filePath.c_str(), std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+    file << "P6\n" << renderWidth << " " << renderHeight << "\n255\n";
+
+    // RGBA rows to RGB, a BGRA format would need its channels swapped here.
+    const unsigned char* texels = (const unsigned char*)newestData;
+    std::vector<unsigned char> row(renderWidth * 3);
+    for (uint32_t y = 0; y < renderHeight; y++) {
+        for (uint32_t x = 0; x < renderWidth; x++) {
+            const unsigned char* texel = texels + ((size_t)y * renderWidth + x) * 4;
+            row[x * 3 + 0] = texel[0];
+            row[x * 3 + 1] = texel[1];
+            row[x * 3 + 2] = texel[2];
+        }
+        file.write((const char*)row.data(), row.size());
+    }
+    std::cout << "Frame " << newestFrame << " written to " << filePath << std::endl;
+    return (bool)file;
 }
 
 void VulkanApplication::deInitialize()
 {
-    deviceObj->destroyDevice();
+    PROFILE_SCOPE("VulkanApplication::deInitialize");
+    frameScheduler.destroyFrameSlots();
+    frameScheduler.printStats();
+
+    // Every frame has completed, take the timestamps not read back yet.
+    gpuProfiler.collectAll();
+    gpuProfiler.printStats();
+    if (!gpuTracePath.empty() && !gpuProfiler.writeChromeTrace(gpuTracePath)) {
+        std::cout << "Could not write the GPU trace to " << gpuTracePath << std::endl;
+    }
+    gpuProfiler.destroyProfiler();
+
+    if (headless) {
+        if (!readbackPath.empty() && !writeLastReadback(readbackPath)) {
+            std::cout << "Could not write the last frame to " << readbackPath << std::endl;
+        }
+        readbackPool.printStats();
+        readbackPool.destroyReadbackPool();
+        offscreenTarget.destroyOffscreenTarget();
+    }
+    if (swapchainMgr.getSwapchain() != VK_NULL_HANDLE) {
+        swapchainMgr.printStats();
+    }
+    swapchainMgr.destroySwapchain();
+    descriptorAllocator.printStats();
+    descriptorAllocator.destroyDescriptorAllocator();
+    commandPoolMgr.destroyCommandPools();
+    if (bindlessTable.getLayout() != VK_NULL_HANDLE) {
+        bindlessTable.printStats();
+        bindlessTable.destroyBindlessTable();
+    }
+    if (gpuCuller.getObjectCount()) {
+        gpuCuller.printStats();
+    }
+    gpuCuller.destroyGpuCuller();
+    barrierBuilder.printStats();
+    meshStreamer.printStats();
+    meshStreamer.destroyMeshStreamer();
+    mesh = NULL;
+    stagingRing.printStats();
+    stagingRing.destroyStagingRing();
+    computeEngine.printStats();
+    computeEngine.destroyComputeEngine();
+
+    // Keep this run's compiles for the next start up.
+    for (size_t i = 0; i < deviceList.size(); i++) {
+        deviceList[i]->pipelineManager.saveCache();
+        deviceList[i]->pipelineManager.printStats();
+
+        deviceList[i]->destroyDevice();
+        delete deviceList[i];
+    }
+    deviceList.clear();
+    deviceObj = NULL;
     if (debugFlag) {
-        instanceObj.layerExtension.destroyDebugReportCallback();
+        instanceObj.layerExtension.destroyDebugMessenger(instanceObj.instance, instanceObj.debugUtils);
     }
+    instanceObj.destroySurface(surface);
+    surface = VK_NULL_HANDLE;
     instanceObj.destroyInstance();
 }
\ No newline at end of file
@@ -1,10 +1,67 @@
 #include "VulkanDevice.h"
 #include "VulkanInstance.h"
-#include "VulkanApplication.h"
+#include "CpuProfiler.h"
+#include <cstddef>
+
+DeviceFeatures::DeviceFeatures()
+{
+    // Zeroes the padding too, intersect() combines the structs word by word.
+    memset(this, 0, sizeof(*this));
+    core.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+    timelineSemaphore.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    descriptorIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    synchronization2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+}
+
+VkPhysicalDeviceFeatures2KHR* DeviceFeatures::chain(const VulkanDevice& device)
+{
+    void** next = &core.pNext;
+    if (device.isExtensionEnabled(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+        *next = &timelineSemaphore;
+        next = &timelineSemaphore.pNext;
+    }
+    if (device.isExtensionEnabled(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+        *next = &descriptorIndexing;
+        next = &descriptorIndexing.pNext;
+    }
+    if (device.isExtensionEnabled(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME)) {
+        *next = &synchronization2;
+        next = &synchronization2.pNext;
+    }
+    *next = NULL;
+    return &core;
+}
+
+// ANDs the VkBool32 members of 'features', the ones after 'firstMember', with 'supported'.
+template <typename T>
+static void intersectStruct(T& features, const T& supported, size_t firstMember)
+{
+    VkBool32* enabled = (VkBool32*)((char*)&features + firstMember);
+    const VkBool32* available = (const VkBool32*)((const char*)&supported + firstMember);
+    for (size_t i = 0; i < (sizeof(T) - firstMember) / sizeof(VkBool32); i++) {
+        enabled[i] = enabled[i] && available[i];
+    }
+}
+
+void DeviceFeatures::intersect(const DeviceFeatures& supported)
+{
+    intersectStruct(core, supported.core, offsetof(VkPhysicalDeviceFeatures2KHR, features));
+    intersectStruct(timelineSemaphore, supported.timelineSemaphore, offsetof(VkPhysicalDeviceTimelineSemaphoreFeaturesKHR, timelineSemaphore));
+    intersectStruct(descriptorIndexing, supported.descriptorIndexing,
+        offsetof(VkPhysicalDeviceDescriptorIndexingFeaturesEXT, shaderInputAttachmentArrayDynamicIndexing));
+    intersectStruct(synchronization2, supported.synchronization2, offsetof(VkPhysicalDeviceSynchronization2FeaturesKHR, synchronization2));
+}
 
 VulkanDevice::VulkanDevice(VkPhysicalDevice* physicalDevice)
 {
     gpu = physicalDevice;
+    debugUtils = NULL;
+    instance = VK_NULL_HANDLE;
+
+    // Graphics work is latency critical, uploads and async compute fill the gaps.
+    graphicsQueuePriority = 1.0f;
+    computeQueuePriority = 0.5f;
+    transferQueuePriority = 0.5f;
 }
 
 VulkanDevice::~VulkanDevice()
@@ -13,39 +70,102 @@ VulkanDevice::~VulkanDevice()
 
 // NOTE: This function requires queue object to be in existance before.
 // By VulkanDevice::getGraphicsHanle()
-VkResult VulkanDevice::createDevice(std::vector<const char*>& layers, std::vector<const char*>& extensions)
+VkResult VulkanDevice::createDevice(std::vector<const char*>& layers, std::vector<const char*>& extensions,
+    const std::vector<const char*>& optionalExtensions, const CapabilitySet* enabledInstanceExtensions)
 {
-    layerExtension.appRequestedExtensionNames = layers;
-    layerExtension.appRequestedExtensionNames = extensions;
+    PROFILE_SCOPE("VulkanDevice::createDevice");
+    // Check the extensions before the driver does, and order them after their dependencies.
+    VkResult result = layerExtension.resolveExtensions(CAPABILITY_LEVEL_DEVICE, layers, extensions, optionalExtensions, enabledInstanceExtensions);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+    const std::vector<const char*>& enabledExtensions = layerExtension.appRequestedExtensionNames;
 
-    VkResult result;
-    float queuePriorities[1] = { 0.0 };
-    VkDeviceQueueCreateInfo queueCreateInfo = {};
-    queueCreateInfo.queueFamilyIndex = graphicsQueueIndex;
-    queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    queueCreateInfo.pNext = NULL;
-    queueCreateInfo.queueCount = 1;
-    queueCreateInfo.pQueuePriorities = queuePriorities;
+    // One create info per used family, each listing the priority of every queue it creates.
+    // A queue shared by several kinds of work takes the priority of the first one.
+    std::vector<std::vector<float> > familyPriorities(queueFamilyCount);
+    for (uint32_t i = 0; i < queueFamilyCount; i++) {
+        familyPriorities[i].resize(queueSelection.queueCounts[i], -1.0f);
+    }
+    uint32_t families[3] = { queueSelection.graphicsFamily, queueSelection.computeFamily, queueSelection.transferFamily };
+    uint32_t queues[3] = { queueSelection.graphicsQueue, queueSelection.computeQueue, queueSelection.transferQueue };
+    float priorities[3] = { graphicsQueuePriority, computeQueuePriority, transferQueuePriority };
+    for (uint32_t i = 0; i < 3; i++) {
+        float& priority = familyPriorities[families[i]][queues[i]];
+        if (priority < 0.0f) {
+            priority = priorities[i];
+        }
+    }
+
+    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+    for (uint32_t i = 0; i < queueFamilyCount; i++) {
+        if (familyPriorities[i].empty()) {
+            continue;
+        }
+
+        VkDeviceQueueCreateInfo queueCreateInfo = {};
+        queueCreateInfo.queueFamilyIndex = i;
+        queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueCreateInfo.pNext = NULL;
+        queueCreateInfo.queueCount = (uint32_t)familyPriorities[i].size();
+        queueCreateInfo.pQueuePriorities = familyPriorities[i].data();
+        queueCreateInfos.push_back(queueCreateInfo);
+    }
 
     VkDeviceCreateInfo deviceCreateInfo = {};
     deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     deviceCreateInfo.pNext = NULL;
-    deviceCreateInfo.queueCreateInfoCount = 1;
-    deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
+    deviceCreateInfo.queueCreateInfoCount = (uint32_t)queueCreateInfos.size();
+    deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
     deviceCreateInfo.enabledLayerCount = 0;
     deviceCreateInfo.ppEnabledLayerNames = NULL; // Device layers are deprecated.
-    deviceCreateInfo.enabledExtensionCount = (uint32_t)extensions.size();
-    deviceCreateInfo.ppEnabledExtensionNames = extensions.size() ? extensions.data() : NULL;
+    deviceCreateInfo.enabledExtensionCount = (uint32_t)enabledExtensions.size();
+    deviceCreateInfo.ppEnabledExtensionNames = enabledExtensions.size() ? enabledExtensions.data() : NULL;
     deviceCreateInfo.pEnabledFeatures = NULL;
 
+    // Enable the requested features the device has. With VK_KHR_get_physical_device_properties2
+    // the core and extension features go in one chain, otherwise only the core ones can be enabled.
+    DeviceFeatures supportedFeatures;
+    queryFeatures(enabledInstanceExtensions, supportedFeatures);
+    enabledFeatures = requestedFeatures;
+    enabledFeatures.intersect(supportedFeatures);
+    if (enabledInstanceExtensions && enabledInstanceExtensions->hasExtension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+        deviceCreateInfo.pNext = enabledFeatures.chain(*this);
+    } else {
+        deviceCreateInfo.pEnabledFeatures = &enabledFeatures.core.features;
+    }
+
     result = vkCreateDevice(*gpu, &deviceCreateInfo, NULL, &device);
     assert(result == VK_SUCCESS);
 
     return result;
 }
 
+void VulkanDevice::queryFeatures(const CapabilitySet* enabledInstanceExtensions, DeviceFeatures& supported) const
+{
+    supported = DeviceFeatures();
+
+    PFN_vkGetPhysicalDeviceFeatures2KHR getFeatures2 = NULL;
+    if (enabledInstanceExtensions && enabledInstanceExtensions->hasExtension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+        getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+    }
+
+    if (getFeatures2) {
+        getFeatures2(*gpu, supported.chain(*this));
+        supported.core.pNext = NULL;
+        supported.timelineSemaphore.pNext = NULL;
+        supported.descriptorIndexing.pNext = NULL;
+    } else {
+        vkGetPhysicalDeviceFeatures(*gpu, &supported.core.features);
+    }
+}
+
 void VulkanDevice::destroyDevice()
 {
+    deletionQueue.printStats();
+    deletionQueue.destroyDeletionQueue();
+    pipelineManager.destroyPipelineManager();
+    memoryAllocator.destroyAllocator();
     vkDestroyDevice(device, NULL);
 }
 
@@ -63,32 +183,120 @@ void VulkanDevice::getPhysicalDeviceQueuesAndProperties()
 
 /*
  * This function stores the handle of the graphics queue in `graphicsQueueIndex`, which is used
- * in the creation of the logical device (VkDevice) object.
+ * in the creation of the logical device (VkDevice) object. It also picks the families of the
+ * compute and transfer queues.
  */
 uint32_t VulkanDevice::getGraphicsQueueHandle()
 {
-    bool found = false;
-    // 1. Iterate the number of queues supported by the physical device.
-    for (unsigned int i = 0; i < queueFamilyCount; i++) {
-        // Get the graphics queue type.
-        if (queueFamilyProps[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-            // Get the handle/index ID of the graphics queue family.
-            found = true;
-            graphicsQueueIndex = i;
-            break;
-        }
-    }
+    queueSelection = selectQueueFamilies(queueFamilyProps);
 
     // Assert if there is no queue found.
-    assert(found);
+    assert(queueSelection.found);
+
+    graphicsQueueIndex = queueSelection.graphicsFamily;
+    // Until a surface is queried for presentation support,
+    // present through the graphics queue.
+    graphicsQueueWithPresentIndex = graphicsQueueIndex;
+    computeQueueIndex = queueSelection.computeFamily;
+    transferQueueIndex = queueSelection.transferFamily;
 
     return 0;
 }
 
+// Returns the first family that has all 'required' and none of the 'excluded' flags.
+static uint32_t findQueueFamily(const std::vector<VkQueueFamilyProperties>& families, VkQueueFlags required, VkQueueFlags excluded)
+{
+    for (uint32_t i = 0; i < (uint32_t)families.size(); i++) {
+        if (families[i].queueCount > 0 && (families[i].queueFlags & required) == required && !(families[i].queueFlags & excluded)) {
+            return i;
+        }
+    }
+    return UINT32_MAX;
+}
+
+// Takes the next unused queue of a family, or shares its last queue when all are taken.
+static uint32_t claimQueue(const std::vector<VkQueueFamilyProperties>& families, std::vector<uint32_t>& queueCounts, uint32_t family)
+{
+    if (queueCounts[family] < families[family].queueCount) {
+        return queueCounts[family]++;
+    }
+    return queueCounts[family] - 1;
+}
+
+QueueFamilySelection VulkanDevice::selectQueueFamilies(const std::vector<VkQueueFamilyProperties>& families)
+{
+    QueueFamilySelection selection = {};
+    selection.queueCounts.resize(families.size(), 0);
+
+    // 1. Graphics: the first family with graphics support.
+    selection.graphicsFamily = findQueueFamily(families, VK_QUEUE_GRAPHICS_BIT, 0);
+    if (selection.graphicsFamily == UINT32_MAX) {
+        selection.found = false;
+        return selection;
+    }
+    selection.found = true;
+    selection.graphicsQueue = claimQueue(families, selection.queueCounts, selection.graphicsFamily);
+
+    // 2. Compute: prefer a family without graphics, otherwise a spare queue
+    //    of the graphics family, otherwise share the graphics queue.
+    selection.computeFamily = findQueueFamily(families, VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
+    selection.dedicatedComputeFamily = selection.computeFamily != UINT32_MAX;
+    if (!selection.dedicatedComputeFamily) {
+        selection.computeFamily = (families[selection.graphicsFamily].queueFlags & VK_QUEUE_COMPUTE_BIT)
+            ? selection.graphicsFamily
+            : findQueueFamily(families, VK_QUEUE_COMPUTE_BIT, 0);
+        if (selection.computeFamily == UINT32_MAX) {
+            selection.computeFamily = selection.graphicsFamily; // No compute support at all.
+        }
+    }
+    selection.computeQueue = claimQueue(families, selection.queueCounts, selection.computeFamily);
+
+    // 3. Transfer: prefer a family with neither graphics nor compute (DMA engines),
+    //    otherwise a spare queue of the compute family. Graphics and compute
+    //    queues always support transfers implicitly.
+    selection.transferFamily = findQueueFamily(families, VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+    selection.dedicatedTransferFamily = selection.transferFamily != UINT32_MAX;
+    if (!selection.dedicatedTransferFamily) {
+        selection.transferFamily = selection.computeFamily;
+    }
+    selection.transferQueue = claimQueue(families, selection.queueCounts, selection.transferFamily);
+
+    return selection;
+}
+
 /*
 * High level wrapper function to get the device's associated queue.
 */
 void VulkanDevice::getDeviceQueue()
 {
     vkGetDeviceQueue(device, graphicsQueueWithPresentIndex, 0, &queue);
-}
\ No newline at end of file
+    vkGetDeviceQueue(device, queueSelection.computeFamily, queueSelection.computeQueue, &computeQueue);
+    vkGetDeviceQueue(device, queueSelection.transferFamily, queueSelection.transferQueue, &transferQueue);
+
+    setObjectName(VK_OBJECT_TYPE_DEVICE, device, gpuProps.deviceName);
+    setObjectName(VK_OBJECT_TYPE_QUEUE, queue, "Graphics queue");
+    if (computeQueue != queue) {
+        setObjectName(VK_OBJECT_TYPE_QUEUE, computeQueue, "Compute queue");
+    }
+    if (transferQueue != queue && transferQueue != computeQueue) {
+        setObjectName(VK_OBJECT_TYPE_QUEUE, transferQueue, "Transfer queue");
+    }
+}
+
+bool VulkanDevice::memoryTypeFromProperties(uint32_t typeBits, VkFlags requirementsMask, uint32_t* typeIndex)
+{
+    // Search the memory types to find the first index with those properties.
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if ((typeBits & 1) == 1) {
+            // Type is available, does it match the user properties?
+            if ((memoryProperties.memoryTypes[i].propertyFlags & requirementsMask) == requirementsMask) {
+                *typeIndex = i;
+                return true;
+            }
+        }
+        typeBits >>= 1;
+    }
+
+    // No memory types matched, return failure.
+    return false;
+}
@@ -1,9 +1,17 @@
 #include "VulkanInstance.h"
+#include "CpuProfiler.h"
 
-VkResult VulkanInstance::createInstance(std::vector<const char*>& layers, std::vector<const char*>& extensionNames, char const* const appName)
+VkResult VulkanInstance::createInstance(std::vector<const char*>& layers, std::vector<const char*>& extensionNames, char const* const appName,
+    const std::vector<const char*>& optionalExtensions)
 {
-    layerExtension.appRequestedExtensionNames = extensionNames;
-    layerExtension.appRequestedLayerNames = layers;
+    PROFILE_SCOPE("VulkanInstance::createInstance");
+    // Check the extensions before the loader does, and order them after their dependencies.
+    VkResult result = layerExtension.resolveExtensions(CAPABILITY_LEVEL_INSTANCE, layers, extensionNames, optionalExtensions);
+    assert(result == VK_SUCCESS);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+    const std::vector<const char*>& enabledExtensions = layerExtension.appRequestedExtensionNames;
 
     // Define the Vulkan application structure
     VkApplicationInfo appInfo = {};
@@ -19,8 +27,18 @@ VkResult VulkanInstance::createInstance(std::vector<const char*>& layers, std::v
     // Define the Vulkan instance create info structure
     VkInstanceCreateInfo instCreateInfo = {};
     instCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-    //instCreateInfo.pNext = VK_NULL_HANDLE;
-    instCreateInfo.pNext = &layerExtension.dbgReportCreateInfo; // In order to enable debugging.
+    // Messages of vkCreateInstance/vkDestroyInstance themselves go to the debug sink as well.
+    bool useDebugUtils = layerExtension.enabled.hasExtension(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    bool useDebugReport = layerExtension.enabled.hasExtension(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+    VkDebugUtilsMessengerCreateInfoEXT messengerCreateInfo = DebugUtils::messengerCreateInfo(&layerExtension.debugSink);
+    if (useDebugUtils) {
+        instCreateInfo.pNext = &messengerCreateInfo;
+    } else if (useDebugReport) {
+        layerExtension.fillDebugReportCreateInfo();
+        instCreateInfo.pNext = &layerExtension.dbgReportCreateInfo; // In order to enable debugging.
+    } else {
+        instCreateInfo.pNext = NULL;
+    }
     instCreateInfo.flags = 0;
     instCreateInfo.pApplicationInfo = &appInfo;
 
@@ -29,17 +47,47 @@ VkResult VulkanInstance::createInstance(std::vector<const char*>& layers, std::v
     instCreateInfo.ppEnabledLayerNames = layers.size() ? layers.data() : NULL;
 
     // Specify the list of extensions to be used in the application.
-    instCreateInfo.enabledExtensionCount = (uint32_t)extensionNames.size();
-    instCreateInfo.ppEnabledExtensionNames = extensionNames.size() ? extensionNames.data() : NULL;
+    instCreateInfo.enabledExtensionCount = (uint32_t)enabledExtensions.size();
+    instCreateInfo.ppEnabledExtensionNames = enabledExtensions.size() ? enabledExtensions.data() : NULL;
 
-    VkResult result = vkCreateInstance(&instCreateInfo, NULL, &instance);
+    result = vkCreateInstance(&instCreateInfo, NULL, &instance);
     std::cout << "'vkCreateInstance' return = " << result << std::endl;
     assert(result == VK_SUCCESS);
 
+    if (result == VK_SUCCESS && useDebugUtils) {
+        debugUtils.loadFunctions(instance);
+    }
     return result;
 }
 
 void VulkanInstance::destroyInstance()
 {
     vkDestroyInstance(instance, NULL);
+}
+
+VkResult VulkanInstance::createHeadlessSurface(VkSurfaceKHR* surface)
+{
+    *surface = VK_NULL_HANDLE;
+    if (!layerExtension.enabled.hasExtension(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME)) {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+
+    PFN_vkCreateHeadlessSurfaceEXT createHeadlessSurfaceFn =
+        (PFN_vkCreateHeadlessSurfaceEXT)vkGetInstanceProcAddr(instance, "vkCreateHeadlessSurfaceEXT");
+    if (!createHeadlessSurfaceFn) {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+
+    VkHeadlessSurfaceCreateInfoEXT surfaceInfo = {};
+    surfaceInfo.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+    surfaceInfo.pNext = NULL;
+    surfaceInfo.flags = 0;
+    return createHeadlessSurfaceFn(instance, &surfaceInfo, NULL, surface);
+}
+
+void VulkanInstance::destroySurface(VkSurfaceKHR surface)
+{
+    if (surface != VK_NULL_HANDLE) {
+        vkDestroySurfaceKHR(instance, surface, NULL);
+    }
 }
\ No newline at end of file
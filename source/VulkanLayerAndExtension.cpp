@@ -1,5 +1,7 @@
 #include "VulkanLayerAndExtension.h"
-#include "VulkanApplication.h"
+#include "CapabilityDatabase.h"
+#include "DebugUtils.h"
+#include "CpuProfiler.h"
 
 VulkanLayerAndExtension::VulkanLayerAndExtension()
 {
@@ -17,70 +19,27 @@ VulkanLayerAndExtension::~VulkanLayerAndExtension()
 
 /*
  * This function queries layer properties including extensions for all layers.
- * Resulting layer properties are stored in `layerPropertyList`.
+ * Resulting layer properties are stored in `layerPropertyList`. The enumeration
+ * itself, parallel and cached on disk, is done by the capability database.
  */
-VkResult VulkanLayerAndExtension::getInstanceLayerProperties()
+VkResult VulkanLayerAndExtension::getInstanceLayerProperties(CapabilityDatabase& capabilities)
 {
-    uint32_t instanceLayerCount; // To store number of instance layers.
-    std::vector<VkLayerProperties> layerProperties; // To store layer properties, Initially the size is 0.
-    VkResult result; // Completion codes to check Vulkan API result status. VK_SUCCESS = 0
-
-    // Query all the layers:
-    do {
-        // Get number of instance layer
-        result = vkEnumerateInstanceLayerProperties(
-            &instanceLayerCount,
-            NULL); // All successful completion codes are non-negative values. All runtime error codes are negative values.
-
-        if (result)
-            return result;
-
-        if (instanceLayerCount == 0)
-            return VK_INCOMPLETE; // Return fail.
-
-        layerProperties.resize(instanceLayerCount); // Now allocate memory by the
-                                                    // obtained instanceLayerCount.
-        result = vkEnumerateInstanceLayerProperties(
-            &instanceLayerCount,
-            layerProperties.data()); // Get layer properties for every layer,
-                                     // each entry stores a VkLayerProperties for one layer
-    } while (result == VK_INCOMPLETE); // While the returned vector is too small for the result
-
-    // Query all the extensions for each layer and store it.
-    std::cout << "\nInstanced Layers" << std::endl;
-    std::cout << "===================" << std::endl;
-    for (auto globalLayerProp : layerProperties) {
-        // Print layer names and its description.
-        std::cout << "\n"
-                  << globalLayerProp.description << "\n\t|\n\t---[Layer Name]-->"
-                  << globalLayerProp.layerName << "\n";
-
-        LayerProperties layerProps;
-        layerProps.properties = globalLayerProp;
-
-        // Get instance level extensions for corresponding layer properties
-        // resulting extensions are stored in layerProps.extensions.
-        result = getExtensionProperties(layerProps);
-
-        if (result) {
-            continue; // If not successful but no error, leave this layer for other threads.
-        }
-
-        layerPropertyList.push_back(layerProps);
-
-        // Print extension name for each instance layer.
-        for (auto extension : layerProps.extensions) {
-            std::cout << "\t\t|\n\t\t|---[Layer Extension]--> "
-                      << extension.extensionName << "\n";
-        }
+    PROFILE_SCOPE("VulkanLayerAndExtension::getInstanceLayerProperties");
+    VkResult result = capabilities.enumerateInstance();
+    if (result) {
+        return result;
     }
-    return result;
+
+    layerPropertyList = capabilities.getInstanceLayers();
+    supported.build(CAPABILITY_LEVEL_INSTANCE, capabilities.getInstanceImplementation(), layerPropertyList);
+    return layerPropertyList.empty() ? VK_INCOMPLETE : VK_SUCCESS;
 }
 
 /*
  * This function retrieves extension and its properties at instance and device level.
  * Pass a valid physical device pointer (gpu) to retrieve device level extensions,
- * otherwise use NULL to retrieve instance level extensions.
+ * otherwise use NULL to retrieve instance level extensions. An empty layer name
+ * retrieves the extensions of the implementation rather than of a layer.
  * Resulting extensions are store 'in LayerProperties.extensions'.
  */
 VkResult VulkanLayerAndExtension::getExtensionProperties(LayerProperties& layerProps,
@@ -88,7 +47,8 @@ VkResult VulkanLayerAndExtension::getExtensionProperties(LayerProperties& layerP
 {
     uint32_t extensionCount; // Store number of extensions per layer.
     VkResult result; // Variable to check Vulkan API result status.
-    char* layerName = layerProps.properties.layerName; // Name of the layer.
+    // Name of the layer, NULL queries the extensions of the implementation.
+    const char* layerName = layerProps.properties.layerName[0] ? layerProps.properties.layerName : NULL;
 
     do {
         // Get the total number of extension in this layer
@@ -114,36 +74,39 @@ VkResult VulkanLayerAndExtension::getExtensionProperties(LayerProperties& layerP
     return result;
 }
 
-VkResult VulkanLayerAndExtension::getDeviceExtensionProperties(VkPhysicalDevice* gpu)
+VkResult VulkanLayerAndExtension::getDeviceExtensionProperties(VkPhysicalDevice* gpu, CapabilityDatabase& capabilities)
 {
-    VkResult result;
-
-    // Query all the extensions for each layer and store it.
-    std::cout << "Device extensions" << std::endl;
-    std::cout << "==================" << std::endl;
-    VulkanApplication* appObj = VulkanApplication::GetInstance();
-    std::vector<LayerProperties>* instanceLayerProp = &appObj->GetInstance()->instanceObj.layerExtension.layerPropertyList;
-
-    for (auto globalLayerProp : *instanceLayerProp) {
-        LayerProperties layerProps;
-        layerProps.properties = globalLayerProp.properties;
+    PROFILE_SCOPE("VulkanLayerAndExtension::getDeviceExtensionProperties");
+    // The database has enumerated every device ahead of time, or read them from the file.
+    const DeviceCapabilities* device = capabilities.findDevice(*gpu);
+    if (!device) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
 
-        if (result = getExtensionProperties(layerProps, gpu))
-            continue;
+    layerPropertyList = device->layers;
+    supported.build(CAPABILITY_LEVEL_DEVICE, device->implementation, layerPropertyList);
+    return VK_SUCCESS;
+}
 
+void VulkanLayerAndExtension::printLayerProperties(const char* title, const char* extensionLabel)
+{
+    std::cout << "\n" << title << std::endl;
+    std::cout << "===================" << std::endl;
+    for (auto& layerProps : layerPropertyList) {
+        // Print layer names and its description.
         std::cout << "\n"
-                  << globalLayerProp.properties.description << "\n\t|\n\t|---[Layer Name]--> " << globalLayerProp.properties.layerName << "\n";
-        layerPropertyList.push_back(layerProps);
+                  << layerProps.properties.description << "\n\t|\n\t---[Layer Name]-->"
+                  << layerProps.properties.layerName << "\n";
 
         if (layerProps.extensions.size()) {
-            for (auto extension : layerProps.extensions) {
-                std::cout << "\t\t|\n\t\t|---[Device Extension]--> " << extension.extensionName << "\n";
+            for (auto& extension : layerProps.extensions) {
+                std::cout << "\t\t|\n\t\t|---[" << extensionLabel << "]--> " << extension.extensionName << "\n";
             }
         } else {
-            std::cout << "\t\t|\n\t\t|---[Device Extension]--> No extension found \n";
+            std::cout << "\t\t|\n\t\t|---[" << extensionLabel << "]--> No extension found \n";
         }
     }
-    return result;
+    std::cout << std::flush;
 }
 
 /*
@@ -152,36 +115,44 @@ VkResult VulkanLayerAndExtension::getDeviceExtensionProperties(VkPhysicalDevice*
  */
 VkBool32 VulkanLayerAndExtension::areLayersSupported(std::vector<const char*>& layerNames)
 {
-    uint32_t checkCount = (uint32_t)layerNames.size();
-    uint32_t layerCount = (uint32_t)layerPropertyList.size();
-    std::vector<const char*> unsupportedLayerNames;
-    for (uint32_t i = 0; i < checkCount; i++) {
-        VkBool32 isSupported = 0;
-        for (uint32_t j = 0; j < layerCount; j++) {
-            if (!strcmp(layerNames[i], layerPropertyList[j].properties.layerName)) {
-                isSupported = 1;
-            }
-        }
-
-        if (!isSupported) {
-            std::cout << "No layer support found, remove layer: " << layerNames[i] << std::endl;
-            unsupportedLayerNames.push_back(layerNames[i]);
+    for (auto layerName : layerNames) {
+        if (!supported.hasLayer(layerName)) {
+            std::cout << "No layer support found, remove layer: " << layerName << std::endl;
         } else {
-            std::cout << "Layer supported: " << layerNames[i] << std::endl;
+            std::cout << "Layer supported: " << layerName << std::endl;
         }
     }
 
-    // **************************************************
-    // why not deleting it right after found unsupported?
-    // **************************************************
-    for (auto i : unsupportedLayerNames) {
-        auto it = std::find(layerNames.begin(), layerNames.end(), i);
-        if (it != layerNames.end()) {
-            layerNames.erase(it);
+    // One pass keeping the order, instead of erasing the unsupported names one by one.
+    layerNames = supported.filterLayers(layerNames);
+    return true;
+}
+
+/*
+ * Resolves the extensions to enable against the supported ones, see CapabilitySet::resolveExtensions.
+ * Missing required extensions are reported and make it fail, the result is stored in
+ * 'appRequestedExtensionNames' and the 'enabled' set.
+ */
+VkResult VulkanLayerAndExtension::resolveExtensions(CapabilityLevel level,
+    const std::vector<const char*>& layerNames,
+    const std::vector<const char*>& requiredExtensions,
+    const std::vector<const char*>& optionalExtensions,
+    const CapabilitySet* enabledInstanceExtensions)
+{
+    std::vector<const char*> enableList;
+    std::vector<const char*> missing;
+    if (!supported.resolveExtensions(requiredExtensions, optionalExtensions, enableList, &missing, enabledInstanceExtensions)) {
+        for (auto extensionName : missing) {
+            std::cout << "Error: required " << (level == CAPABILITY_LEVEL_INSTANCE ? "instance" : "device")
+                      << " extension not supported: " << extensionName << std::endl;
         }
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
     }
 
-    return true;
+    appRequestedLayerNames = layerNames;
+    appRequestedExtensionNames = enableList;
+    enabled.buildEnabled(level, layerNames, enableList);
+    return VK_SUCCESS;
 }
 
 /**
@@ -202,6 +173,12 @@ VulkanLayerAndExtension::debugFunction(VkFlags msgFlags,
     uint64_t srcObject, size_t location, int32_t msgCode,
     const char* layerPrefix, const char* msg, void* userData)
 {
+    // Asynchronous path: copy the message and return to the driver right away.
+    if (userData) {
+        ((DebugReportSink*)userData)->push(msgFlags, objType, srcObject, location, msgCode, layerPrefix, msg);
+        return VK_TRUE;
+    }
+
     if (msgFlags & VK_DEBUG_REPORT_ERROR_BIT_EXT) {
         std::cout << "[VK_DEBUG_REPORT] ERROR: [" << layerPrefix << "] Code" << msgCode << ":" << msg << std::endl;
     } else if (msgFlags & VK_DEBUG_REPORT_WARNING_BIT_EXT) {
@@ -220,15 +197,52 @@ VulkanLayerAndExtension::debugFunction(VkFlags msgFlags,
     return VK_TRUE;
 }
 
-VkResult VulkanLayerAndExtension::createDebugReportCallback()
+/*
+ * Define the debug report control structure, provide the reference of 'debugFunction',
+ * this function prints the debug information on the console.
+ */
+void VulkanLayerAndExtension::fillDebugReportCreateInfo()
 {
-    VkResult result;
+    dbgReportCreateInfo.sType = VK_STRUCTURE_TYPE_DEBUG_REPORT_CREATE_INFO_EXT;
+    dbgReportCreateInfo.pfnCallback = debugFunction;
+    dbgReportCreateInfo.pUserData = &debugSink;
+    dbgReportCreateInfo.pNext = NULL;
+    dbgReportCreateInfo.flags = VK_DEBUG_REPORT_WARNING_BIT_EXT | VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT | VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_DEBUG_BIT_EXT;
+}
+
+VkResult VulkanLayerAndExtension::createDebugMessenger(VkInstance instance, DebugUtils& debugUtils)
+{
+    if (debugUtils.isEnabled()) {
+        debugSink.startSink();
+        return debugUtils.createMessenger(instance, &debugSink);
+    }
 
-    VulkanApplication* appObj = VulkanApplication::GetInstance();
-    VkInstance* instance = &appObj->instanceObj.instance;
+    // Older loaders and layers only know the debug report extension.
+    if (enabled.hasExtension(VK_EXT_DEBUG_REPORT_EXTENSION_NAME)) {
+        return createDebugReportCallback(instance);
+    }
+
+    std::cout << "Neither VK_EXT_debug_utils nor VK_EXT_debug_report is available, validation messages are not reported." << std::endl;
+    return VK_ERROR_EXTENSION_NOT_PRESENT;
+}
+
+void VulkanLayerAndExtension::destroyDebugMessenger(VkInstance instance, DebugUtils& debugUtils)
+{
+    if (debugUtils.isEnabled()) {
+        debugUtils.destroyMessenger(instance);
+        debugSink.stopSink();
+        debugSink.printStats();
+    } else if (dbgDestroyDebugReportCallback) {
+        destroyDebugReportCallback(instance);
+    }
+}
+
+VkResult VulkanLayerAndExtension::createDebugReportCallback(VkInstance instance)
+{
+    VkResult result;
 
     // Get vkCreateDebugReportCallbackEXT API dynamically, which is not exposed statically.
-    dbgCreateDebugReportCallback = (PFN_vkCreateDebugReportCallbackEXT)vkGetInstanceProcAddr(*instance, "vkCreateDebugReportCallbackEXT");
+    dbgCreateDebugReportCallback = (PFN_vkCreateDebugReportCallbackEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugReportCallbackEXT");
     if (!dbgCreateDebugReportCallback) {
         std::cout << "Error: `GetInstanceProcAddr()' unable to locate `vkCreateDebugReportCallbackEXT` function." << std::endl;
         return VK_ERROR_INITIALIZATION_FAILED;
@@ -236,33 +250,30 @@ VkResult VulkanLayerAndExtension::createDebugReportCallback()
     std::cout << "`GetInstanceProcAddr()' loaded `dbgCreateDebugReportCallback` function.\n";
 
     // Get vkDestroyDebugReportCallbackEXT API
-    dbgDestroyDebugReportCallback = (PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(*instance, "vkDestroyDebugReportCallbackEXT");
+    dbgDestroyDebugReportCallback = (PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugReportCallbackEXT");
     if (!dbgDestroyDebugReportCallback) {
         std::cout << "Error: `GetInstanceProcAddr()` unable to locate `vkDestroyDebugReportCallbackEXT` function" << std::endl;
     }
     std::cout << "`GetInstanceProcAddr()` loaded `dbgDestroyDebugReportCallback` function\n";
 
-    /*
-     * Define the debug report control structure, provide the reference of 'debugFunction',
-     * this function prints the debug information on the console.
-     */
-    dbgReportCreateInfo.sType = VK_STRUCTURE_TYPE_DEBUG_REPORT_CREATE_INFO_EXT;
-    dbgReportCreateInfo.pfnCallback = debugFunction;
-    dbgReportCreateInfo.pUserData = NULL;
-    dbgReportCreateInfo.pNext = NULL;
-    dbgReportCreateInfo.flags = VK_DEBUG_REPORT_WARNING_BIT_EXT | VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT | VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_DEBUG_BIT_EXT;
+    fillDebugReportCreateInfo();
+
+    // The sink has to drain before the first message arrives.
+    debugSink.startSink();
 
     // Create the debug report callback and store the handle into 'debugReportCallback', then function `debugReportCallback` is reday to use.
-    result = dbgCreateDebugReportCallback(*instance, &dbgReportCreateInfo, NULL, &debugReportCallback);
+    result = dbgCreateDebugReportCallback(instance, &dbgReportCreateInfo, NULL, &debugReportCallback);
     if (result == VK_SUCCESS) {
         std::cout << "Debug report callback object created successfully." << std::endl;
     }
     return result;
 }
 
-void VulkanLayerAndExtension::destroyDebugReportCallback()
+void VulkanLayerAndExtension::destroyDebugReportCallback(VkInstance instance)
 {
-    VulkanApplication* appObj = VulkanApplication::GetInstance();
-    VkInstance& instance = appObj->instanceObj.instance;
     dbgDestroyDebugReportCallback(instance, debugReportCallback, NULL);
+
+    // No more messages can arrive, print what is queued and the counters.
+    debugSink.stopSink();
+    debugSink.printStats();
 }
@@ -3,14 +3,41 @@
 
 #include "Headers.h"
 #include "VulkanApplication.h"
+#include "CpuProfiler.h"
+#include "DeviceBenchmarks.h"
+#include <thread>
+#include <atomic>
 
-std::vector<const char*> instanceExtensionNames = {
+// Window system integration, none of it is requested in headless mode.
+static std::vector<const char*> instanceExtensionNames = {
+#ifdef WSI_SUPPORTED
     VK_KHR_SURFACE_EXTENSION_NAME,
-    VK_KHR_WIN32_SURFACE_EXTENSION_NAME,
+#endif
+#if defined(VK_USE_PLATFORM_WIN32_KHR)
+    VK_KHR_WIN32_SURFACE_EXTENSION_NAME
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+    VK_KHR_XCB_SURFACE_EXTENSION_NAME
+#endif
+};
+
+// Enabled when present and debugging is on. Debug utils is preferred, debug report is the fallback
+// for loaders and layers that predate it.
+static std::vector<const char*> debugInstanceExtensionNames = {
+    VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
     VK_EXT_DEBUG_REPORT_EXTENSION_NAME // This will expoese the vulkan debug APIs to the application
 };
 
-std::vector<const char*> layerNames = {
+// Enabled when present outside headless mode, the swapchain is presented to a surface without window.
+static std::vector<const char*> presentInstanceExtensionNames = {
+    VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME
+};
+
+// Enabled when present, device extensions with features to enable depend on it.
+static std::vector<const char*> featureInstanceExtensionNames = {
+    VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME
+};
+
+static std::vector<const char*> layerNames = {
     // "VK_LAYER_LUNARG_api_dump" // This layer prints API calls, parameters, and values to the identified output stream.
     // If names not correct: "VK_KHR_LUNARG_api_dump", it will report `VK_ERROR_LAYER_NOT_PRESENT`,
     // which fails at `vkCreateInstance()`.
@@ -36,18 +63,202 @@ std::vector<const char*> layerNames = {
                                       */
 };
 
-std::vector<const char*> deviceExtensionNames = {
+static std::vector<const char*> deviceExtensionNames = {
+#ifdef WSI_SUPPORTED
     VK_KHR_SWAPCHAIN_EXTENSION_NAME
+#endif
 };
 
-int main(int argc, char** argv)
+// Enabled where the device supports them, the application falls back to core paths otherwise.
+static std::vector<const char*> optionalDeviceExtensionNames = {
+    VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME, // Writes a descriptor set in one call.
+    VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME, // Render graph submissions across queues.
+    VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME, // Bindless table.
+    VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME, // Draw count of the GPU culling pass.
+    VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME // vkCmdPipelineBarrier2 for the barrier builder.
+};
+
+// Gives a context the layer and extension lists above and applies the command line options to it.
+// With several contexts, each file they write gets the context index appended.
+static void configureContext(VulkanApplication* appObj, uint32_t contextIndex, uint32_t contextCount, int argc, char** argv)
+{
+    appObj->layerNames = layerNames;
+    appObj->instanceExtensionNames = instanceExtensionNames;
+    appObj->debugInstanceExtensionNames = debugInstanceExtensionNames;
+    appObj->presentInstanceExtensionNames = presentInstanceExtensionNames;
+    appObj->featureInstanceExtensionNames = featureInstanceExtensionNames;
+    appObj->deviceExtensionNames = deviceExtensionNames;
+    appObj->optionalDeviceExtensionNames = optionalDeviceExtensionNames;
+
+    // Optional arguments: --frames <count> (0 renders forever), --frames-in-flight <count>,
+    // --pipeline-cache <path>, --capability-cache <path> (empty strings disable the on-disk caches),
+    // --list-capabilities, --gpu <index> (use this GPU if it is usable), --gpu-count <count>
+    // (logical devices on the best ranked GPUs), --gpu-trace <path> (Chrome trace of the GPU scopes),
+    // --headless (render offscreen without a window system), --size <width>x<height> (offscreen
+    // image size, and requested swapchain size), --readback <path> (headless mode writes its last
+    // frame as PPM), --present-policy <low-latency|balanced|power-saving> (swapchain present mode),
+    // --mesh <path> (streams the LODs of a .vkmesh file written by meshConverter), --cull-objects <count>
+    // (scene of that many objects frustum culled on the GPU every frame, needs shaders/cull.comp.spv),
+    // --benchmark <name> (runs a device benchmark instead of the frame loop, see DeviceBenchmarks).
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--frames") && hasValue) {
+            appObj->frameLimit = strtoull(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--frames-in-flight") && hasValue) {
+            appObj->framesInFlight = std::max(1u, (uint32_t)strtoul(argv[++i], NULL, 10));
+        } else if (!strcmp(argv[i], "--pipeline-cache") && hasValue) {
+            appObj->pipelineCachePath = argv[++i];
+        } else if (!strcmp(argv[i], "--capability-cache") && hasValue) {
+            appObj->capabilityCachePath = argv[++i];
+        } else if (!strcmp(argv[i], "--gpu") && hasValue) {
+            appObj->devicePolicy.forcedGpuIndex = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--gpu-count") && hasValue) {
+            appObj->maxDeviceCount = std::max(1u, (uint32_t)strtoul(argv[++i], NULL, 10));
+        } else if (!strcmp(argv[i], "--gpu-trace") && hasValue) {
+            appObj->gpuTracePath = argv[++i];
+        } else if ((!strcmp(argv[i], "--cpu-trace") || !strcmp(argv[i], "--contexts")) && hasValue) {
+            i++; // Process wide, see main().
+        } else if (!strcmp(argv[i], "--headless")) {
+            appObj->headless = true;
+        } else if (!strcmp(argv[i], "--size") && hasValue) {
+            unsigned width, height;
+            if (sscanf(argv[++i], "%ux%u", &width, &height) == 2 && width && height) {
+                appObj->renderWidth = width;
+                appObj->renderHeight = height;
+            }
+        } else if (!strcmp(argv[i], "--readback") && hasValue) {
+            appObj->readbackPath = argv[++i];
+        } else if (!strcmp(argv[i], "--mesh") && hasValue) {
+            appObj->meshPath = argv[++i];
+        } else if (!strcmp(argv[i], "--cull-objects") && hasValue) {
+            appObj->cullObjectCount = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--benchmark") && hasValue) {
+            appObj->benchmarkName = argv[++i];
+        } else if (!strcmp(argv[i], "--present-policy") && hasValue) {
+            const char* policy = argv[++i];
+            if (!strcmp(policy, "low-latency")) {
+                appObj->presentPolicy = PRESENT_POLICY_LOW_LATENCY;
+            } else if (!strcmp(policy, "power-saving")) {
+                appObj->presentPolicy = PRESENT_POLICY_POWER_SAVING;
+            } else {
+                appObj->presentPolicy = PRESENT_POLICY_BALANCED;
+            }
+        } else if (!strcmp(argv[i], "--list-capabilities")) {
+            appObj->listCapabilities = true;
+        }
+    }
+
+    if (contextCount > 1) {
+        std::string suffix = "." + std::to_string(contextIndex);
+        std::string* paths[] = { &appObj->pipelineCachePath, &appObj->capabilityCachePath, &appObj->gpuTracePath, &appObj->readbackPath };
+        for (std::string* path : paths) {
+            if (!path->empty()) {
+                *path += suffix;
+            }
+        }
+    }
+}
+
+// Runs one context from start up to shut down, false when its benchmark failed. In stress mode a
+// failed Vulkan call of the frame loop or a validation error fails it as well.
+static bool runContext(VulkanApplication* appObj, bool stress)
 {
-    VulkanApplication* appObj = VulkanApplication::GetInstance();
     appObj->initialize();
+    if (!appObj->deviceObj) {
+        std::cout << "Error: no logical device could be created." << std::endl;
+        return false;
+    }
     appObj->prepare();
-    appObj->render();
+
+    bool passed = true;
+    if (!appObj->benchmarkName.empty()) {
+        passed = DeviceBenchmarks::run(appObj, appObj->benchmarkName);
+    } else {
+        // Frame loop: update records the next frame while earlier frames are still on the GPU.
+        bool isWindowOpen = true;
+        while (isWindowOpen) {
+            appObj->update();
+            isWindowOpen = appObj->render();
+        }
+    }
+
     appObj->deInitialize();
 
+    // Messages of the whole run are counted, shut down included.
+    if (stress) {
+        const FramePacingStats& frameStats = appObj->frameScheduler.getStats();
+        uint64_t validationErrors = appObj->instanceObj.layerExtension.debugSink.getStats().received[DEBUG_SEVERITY_ERROR];
+        if (frameStats.failedCalls || validationErrors || frameStats.framesCompleted != frameStats.framesSubmitted) {
+            std::cout << "Stress run failed: " << frameStats.failedCalls << " failed Vulkan calls, " << validationErrors
+                      << " validation errors, " << frameStats.framesCompleted << " of " << frameStats.framesSubmitted
+                      << " frames completed" << std::endl;
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+int main(int argc, char** argv)
+{
+    PROFILE_THREAD_NAME("Main thread");
+    std::string cpuTracePath;
+    uint32_t contextCount = 1;
+    bool stress = false;
+
+    // Process wide arguments: --cpu-trace <path> (Chrome trace of the CPU scopes, builds without
+    // NDEBUG only), --contexts <count> (independent contexts, each rendering on its own thread,
+    // to stress the driver with parallel instances), --stress (the contexts render headless with
+    // the Khronos validation layer, the run fails on any failed frame loop call or validation
+    // error). The other arguments apply to every context.
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--cpu-trace") && hasValue) {
+            cpuTracePath = argv[++i];
+        } else if (!strcmp(argv[i], "--contexts") && hasValue) {
+            contextCount = std::max(1u, (uint32_t)strtoul(argv[++i], NULL, 10));
+        } else if (!strcmp(argv[i], "--stress")) {
+            stress = true;
+        }
+    }
+
+    std::vector<std::unique_ptr<VulkanApplication> > contexts;
+    for (uint32_t i = 0; i < contextCount; i++) {
+        contexts.push_back(std::unique_ptr<VulkanApplication>(new VulkanApplication()));
+        configureContext(contexts.back().get(), i, contextCount, argc, argv);
+        if (stress) {
+            contexts.back()->headless = true;
+            contexts.back()->layerNames.push_back("VK_LAYER_KHRONOS_validation"); // Skipped when not installed.
+        }
+    }
+
+    std::atomic<uint32_t> failedCount(0);
+    if (contextCount == 1) {
+        failedCount += runContext(contexts[0].get(), stress) ? 0 : 1;
+    } else {
+        std::vector<std::thread> threads;
+        for (uint32_t i = 0; i < contextCount; i++) {
+            VulkanApplication* appObj = contexts[i].get();
+            threads.push_back(std::thread([appObj, i, stress, &failedCount]() {
+                std::string threadName = "Context " + std::to_string(i);
+                PROFILE_THREAD_NAME(threadName.c_str());
+                failedCount += runContext(appObj, stress) ? 0 : 1;
+            }));
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+    contexts.clear();
+    if (stress) {
+        std::cout << "Stress run: " << contextCount - failedCount << " of " << contextCount << " contexts passed" << std::endl;
+    }
+
+    // All scopes are closed and the worker threads are gone.
+    CpuProfiler::printStats();
+    if (!cpuTracePath.empty() && !CpuProfiler::writeChromeTrace(cpuTracePath)) {
+        std::cout << "Could not write the CPU trace to " << cpuTracePath << std::endl;
+    }
+
     // std::cout << "Hello CMake." << std::endl;
-    // return 0;
+    return failedCount ? 1 : 0;
 }
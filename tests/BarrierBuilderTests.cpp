@@ -0,0 +1,162 @@
+#include "TestFramework.h"
+#include "FakeVulkan.h"
+#include "CommandBufferManager.h"
+#include "VulkanDevice.h"
+
+static VkCommandBuffer beginCommandBuffer(VkCommandPool& cmdPool)
+{
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    vkCreateCommandPool(getFakeDevice(), &poolInfo, NULL, &cmdPool);
+    VkCommandBufferAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocateInfo.commandPool = cmdPool;
+    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocateInfo.commandBufferCount = 1;
+    VkCommandBuffer cmdBuffer;
+    vkAllocateCommandBuffers(getFakeDevice(), &allocateInfo, &cmdBuffer);
+    CommandBufferMgr::beginCommandBuffer(cmdBuffer);
+    return cmdBuffer;
+}
+
+static bool hasRange(const VkImageMemoryBarrier& barrier, uint32_t baseMipLevel, uint32_t levelCount,
+    uint32_t baseArrayLayer, uint32_t layerCount)
+{
+    const VkImageSubresourceRange& range = barrier.subresourceRange;
+    return range.baseMipLevel == baseMipLevel && range.levelCount == levelCount
+        && range.baseArrayLayer == baseArrayLayer && range.layerCount == layerCount;
+}
+
+// A 3 level, 4 layer image written, read twice, then written in part, without synchronization2.
+TEST_CASE(barrierBuilderSkipsAndMergesRanges)
+{
+    VulkanDevice deviceObj(NULL);
+    deviceObj.device = getFakeDevice();
+    VkCommandPool cmdPool;
+    VkCommandBuffer cmdBuffer = beginCommandBuffer(cmdPool);
+    const std::vector<FakePipelineBarrier>& recorded = getFakeCommandBuffer(cmdBuffer)->barriers;
+
+    BarrierBuilder builder;
+    builder.createBarrierBuilder(&deviceObj);
+    CHECK(!builder.usesSynchronization2());
+    VkImage image = makeFakeHandle<VkImage>();
+    builder.trackImage(image, VK_IMAGE_ASPECT_COLOR_BIT, 3, 4, VK_IMAGE_LAYOUT_UNDEFINED);
+
+    // Every subresource has the same transition, the layers merge into one range per level and
+    // the levels into one range.
+    builder.useImage(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    builder.flush(cmdBuffer);
+    CHECK(recorded.size() == 1);
+    if (recorded.size() == 1) {
+        const FakePipelineBarrier& barrier = recorded[0];
+        CHECK(barrier.srcStageMask == VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT && barrier.dstStageMask == VK_PIPELINE_STAGE_TRANSFER_BIT);
+        CHECK(barrier.memoryBarriers.empty() && barrier.bufferBarriers.empty() && barrier.imageBarriers.size() == 1);
+        if (barrier.imageBarriers.size() == 1) {
+            const VkImageMemoryBarrier& imageBarrier = barrier.imageBarriers[0];
+            CHECK(hasRange(imageBarrier, 0, 3, 0, 4));
+            CHECK(imageBarrier.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && imageBarrier.newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+            CHECK(imageBarrier.srcAccessMask == 0 && imageBarrier.dstAccessMask == VK_ACCESS_TRANSFER_WRITE_BIT);
+        }
+    }
+    CHECK(builder.getStats().mergedBarriers == 11);
+
+    // Read in the fragment shader, the second time it already sees the transfer's writes.
+    builder.useImage(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    builder.flush(cmdBuffer);
+    builder.useImage(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    builder.flush(cmdBuffer);
+    CHECK(recorded.size() == 2);
+    if (recorded.size() == 2 && recorded[1].imageBarriers.size() == 1) {
+        const VkImageMemoryBarrier& imageBarrier = recorded[1].imageBarriers[0];
+        CHECK(recorded[1].srcStageMask == VK_PIPELINE_STAGE_TRANSFER_BIT);
+        CHECK(imageBarrier.srcAccessMask == VK_ACCESS_TRANSFER_WRITE_BIT && imageBarrier.dstAccessMask == VK_ACCESS_SHADER_READ_BIT);
+        CHECK(hasRange(imageBarrier, 0, 3, 0, 4));
+    }
+    CHECK(builder.getStats().skippedBarriers == 3);
+
+    // Two layers of the middle level only, the unused layers around them produce nothing.
+    VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 1, 1, 2, 2 };
+    builder.useImage(image, range, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+    builder.flush(cmdBuffer);
+    CHECK(recorded.size() == 3);
+    if (recorded.size() == 3 && recorded[2].imageBarriers.size() == 1) {
+        const VkImageMemoryBarrier& imageBarrier = recorded[2].imageBarriers[0];
+        CHECK(hasRange(imageBarrier, 1, 1, 2, 2));
+        CHECK(imageBarrier.oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && imageBarrier.newLayout == VK_IMAGE_LAYOUT_GENERAL);
+        CHECK(recorded[2].srcStageMask == VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+            && recorded[2].dstStageMask == VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+    CHECK(builder.getLayout(image, 1, 2) == VK_IMAGE_LAYOUT_GENERAL && builder.getLayout(image, 1, 1) == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    const BarrierBuilderStats& stats = builder.getStats();
+    CHECK(stats.flushes == 3 && stats.imageBarriers == 3 && stats.imageUses == 4);
+    vkDestroyCommandPool(getFakeDevice(), cmdPool, NULL);
+}
+
+TEST_CASE(barrierBuilderFoldsStagePairsAndKeepsLastLayout)
+{
+    VulkanDevice deviceObj(NULL);
+    deviceObj.device = getFakeDevice();
+    VkCommandPool cmdPool;
+    VkCommandBuffer cmdBuffer = beginCommandBuffer(cmdPool);
+    const std::vector<FakePipelineBarrier>& recorded = getFakeCommandBuffer(cmdBuffer)->barriers;
+
+    BarrierBuilder builder;
+    builder.createBarrierBuilder(&deviceObj);
+
+    // A buffer barrier within a queue family is a memory barrier, folded with the one of its
+    // stage pair. Only the ownership transfer keeps its buffer.
+    VkBuffer buffer = makeFakeHandle<VkBuffer>();
+    builder.addMemoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    builder.addBufferBarrier(buffer, 0, VK_WHOLE_SIZE, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_UNIFORM_READ_BIT);
+    builder.addBufferBarrier(buffer, 256, 512, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 1);
+    builder.flush(cmdBuffer);
+    CHECK(builder.getStats().mergedBarriers == 1);
+    CHECK(recorded.size() == 1);
+    if (recorded.size() == 1 && recorded[0].memoryBarriers.size() == 1 && recorded[0].bufferBarriers.size() == 1) {
+        const FakePipelineBarrier& barrier = recorded[0];
+        CHECK(barrier.srcStageMask == (VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT));
+        CHECK(barrier.dstStageMask == (VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT));
+        CHECK(barrier.memoryBarriers[0].srcAccessMask == VK_ACCESS_SHADER_WRITE_BIT);
+        CHECK(barrier.memoryBarriers[0].dstAccessMask == (VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT));
+        const VkBufferMemoryBarrier& bufferBarrier = barrier.bufferBarriers[0];
+        CHECK(bufferBarrier.buffer == buffer && bufferBarrier.offset == 256 && bufferBarrier.size == 512);
+        CHECK(bufferBarrier.srcQueueFamilyIndex == 0 && bufferBarrier.dstQueueFamilyIndex == 1);
+    }
+
+    // Three uses in one batch: one transition to the last layout, waiting at every stage and
+    // with every access of the uses, the write of the first one included.
+    VkImage image = makeFakeHandle<VkImage>();
+    builder.trackImage(image, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1, VK_IMAGE_LAYOUT_UNDEFINED);
+    builder.useImage(image, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+    builder.useImage(image, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    builder.useImage(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    builder.flush(cmdBuffer);
+    CHECK(builder.getStats().mergedBarriers == 2);
+    CHECK(builder.getLayout(image) == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    CHECK(recorded.size() == 2);
+    if (recorded.size() == 2 && recorded[1].imageBarriers.size() == 1) {
+        const VkImageMemoryBarrier& imageBarrier = recorded[1].imageBarriers[0];
+        CHECK(imageBarrier.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && imageBarrier.newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        CHECK(imageBarrier.dstAccessMask == (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT));
+        CHECK(recorded[1].dstStageMask == (VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT));
+    }
+
+    // Reading what the batch wrote, in the same layout, is a memory dependency of the same
+    // stage pair as the explicit one.
+    const VkPipelineStageFlags writeStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    builder.addMemoryBarrier(writeStages, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_UNIFORM_READ_BIT);
+    builder.useImage(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    builder.flush(cmdBuffer);
+    CHECK(builder.getStats().mergedBarriers == 3);
+    CHECK(recorded.size() == 3);
+    if (recorded.size() == 3 && recorded[2].memoryBarriers.size() == 1) {
+        CHECK(recorded[2].imageBarriers.empty());
+        CHECK(recorded[2].srcStageMask == writeStages && recorded[2].dstStageMask == VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        CHECK(recorded[2].memoryBarriers[0].dstAccessMask == (VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT));
+    }
+    vkDestroyCommandPool(getFakeDevice(), cmdPool, NULL);
+}
@@ -0,0 +1,135 @@
+#include "TestFramework.h"
+#include "FakeVulkan.h"
+#include "CapabilityDatabase.h"
+
+static const char* DATABASE_PATH = "engineTests_capabilities.bin";
+
+static VkLayerProperties makeLayer(const char* name)
+{
+    VkLayerProperties layer = {};
+    strncpy(layer.layerName, name, VK_MAX_EXTENSION_NAME_SIZE - 1);
+    layer.specVersion = VK_MAKE_VERSION(1, 0, 0);
+    layer.implementationVersion = 1;
+    return layer;
+}
+
+static bool hasExtension(const LayerProperties& layer, const char* name)
+{
+    for (const VkExtensionProperties& extension : layer.extensions) {
+        if (!strcmp(extension.extensionName, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// One run of the application against the fake loader: load, enumerate, save.
+static void runDatabase(CapabilityDatabase& database, const std::vector<VkPhysicalDevice>& gpus)
+{
+    database.loadDatabase(DATABASE_PATH);
+    CHECK(database.enumerateInstance() == VK_SUCCESS);
+    CHECK(database.enumerateDevices(gpus) == VK_SUCCESS);
+    database.saveDatabase();
+}
+
+TEST_CASE(capabilityDatabaseReusesFile)
+{
+    std::remove(DATABASE_PATH);
+    fakeVulkan.instanceLayers.push_back(makeLayer("VK_LAYER_fake_validation"));
+    fakeVulkan.instanceExtensions[""] = makeFakeExtensions({ VK_KHR_SURFACE_EXTENSION_NAME });
+    fakeVulkan.instanceExtensions["VK_LAYER_fake_validation"] = makeFakeExtensions({ VK_EXT_DEBUG_REPORT_EXTENSION_NAME });
+
+    // Two identical GPUs share one entry, enumerated once.
+    std::vector<VkPhysicalDevice> gpus;
+    gpus.push_back(makeFakePhysicalDevice(0x10de, 0x1, 100, { VK_KHR_SWAPCHAIN_EXTENSION_NAME }));
+    gpus.push_back(makeFakePhysicalDevice(0x10de, 0x1, 100, { VK_KHR_SWAPCHAIN_EXTENSION_NAME }));
+    CapabilityDatabase cold;
+    runDatabase(cold, gpus);
+    CHECK(!cold.isInstanceFromCache() && cold.getDevicesFromCache() == 0);
+    CHECK(fakeCallCount("vkEnumerateDeviceExtensionProperties") == 3); // Count and data of the driver, the count of the layer.
+    CHECK(cold.findDevice(gpus[0]) == cold.findDevice(gpus[1]));
+    CHECK(hasExtension(cold.findDevice(gpus[1])->implementation, VK_KHR_SWAPCHAIN_EXTENSION_NAME));
+
+    // The second run only asks the drivers for their instance extensions.
+    uint64_t deviceCalls = fakeCallCount("vkEnumerateDeviceExtensionProperties");
+    uint64_t instanceCalls = fakeCallCount("vkEnumerateInstanceExtensionProperties");
+    CapabilityDatabase warm;
+    runDatabase(warm, gpus);
+    CHECK(warm.isInstanceFromCache() && warm.getDevicesFromCache() == 2);
+    CHECK(fakeCallCount("vkEnumerateDeviceExtensionProperties") == deviceCalls);
+    CHECK(fakeCallCount("vkEnumerateInstanceExtensionProperties") == instanceCalls + 2);
+    CHECK(hasExtension(warm.getInstanceLayers()[0], VK_EXT_DEBUG_REPORT_EXTENSION_NAME));
+
+    // A new driver, same layers: its extensions show up and a third GPU gets its own entry.
+    fakeVulkan.instanceExtensions[""] = makeFakeExtensions({ VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME });
+    gpus.push_back(makeFakePhysicalDevice(0x1002, 0x2, 7, { VK_KHR_MAINTENANCE1_EXTENSION_NAME }));
+    CapabilityDatabase updated;
+    runDatabase(updated, gpus);
+    CHECK(updated.isInstanceFromCache() && updated.getDevicesFromCache() == 2);
+    CHECK(hasExtension(updated.getInstanceImplementation(), VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME));
+    CHECK(hasExtension(updated.findDevice(gpus[2])->implementation, VK_KHR_MAINTENANCE1_EXTENSION_NAME));
+
+    CapabilityDatabase reloaded;
+    runDatabase(reloaded, gpus);
+    CHECK(reloaded.getDevicesFromCache() == 3);
+    CHECK(hasExtension(reloaded.getInstanceImplementation(), VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME));
+    std::remove(DATABASE_PATH);
+}
+
+TEST_CASE(capabilityDatabaseDropsChangedLayers)
+{
+    std::remove(DATABASE_PATH);
+    fakeVulkan.instanceLayers.push_back(makeLayer("VK_LAYER_fake_validation"));
+    std::vector<VkPhysicalDevice> gpus(1, makeFakePhysicalDevice(0x10de, 0x1, 100, { VK_KHR_SWAPCHAIN_EXTENSION_NAME }));
+    CapabilityDatabase first;
+    runDatabase(first, gpus);
+
+    // An updated layer may add extensions to every device, nothing stored is used.
+    fakeVulkan.instanceLayers[0].implementationVersion++;
+    CapabilityDatabase second;
+    runDatabase(second, gpus);
+    CHECK(!second.isInstanceFromCache() && second.getDevicesFromCache() == 0);
+    std::remove(DATABASE_PATH);
+}
+
+// Start up time of the capability queries for 16 layers and 2 GPUs, cold: enumerated on worker
+// threads, then warm: from the file of the cold run. Every extension query naming a layer sleeps
+// 2 ms in the fake loader, as loading the layer library does.
+BENCHMARK_CASE(capabilityStartupTime)
+{
+    const uint32_t layerCount = 16;
+    const uint32_t warmRuns = 10;
+    std::remove(DATABASE_PATH);
+    fakeVulkan.layerQueryMicroseconds = 2000;
+    fakeVulkan.instanceExtensions[""] = makeFakeExtensions({ VK_KHR_SURFACE_EXTENSION_NAME });
+    for (uint32_t i = 0; i < layerCount; i++) {
+        std::string name = "VK_LAYER_fake_" + std::to_string(i);
+        fakeVulkan.instanceLayers.push_back(makeLayer(name.c_str()));
+        fakeVulkan.instanceExtensions[name] = makeFakeExtensions({ VK_EXT_DEBUG_UTILS_EXTENSION_NAME });
+    }
+    std::vector<VkPhysicalDevice> gpus;
+    gpus.push_back(makeFakePhysicalDevice(0x10de, 0x1, 100, { VK_KHR_SWAPCHAIN_EXTENSION_NAME }));
+    gpus.push_back(makeFakePhysicalDevice(0x8086, 0x2, 7, { VK_KHR_SWAPCHAIN_EXTENSION_NAME }));
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    CapabilityDatabase cold;
+    runDatabase(cold, gpus);
+    double coldMs = elapsedMs(start);
+    uint64_t layerQueries = fakeCallCount("vkEnumerateInstanceExtensionProperties") + fakeCallCount("vkEnumerateDeviceExtensionProperties");
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < warmRuns; i++) {
+        CapabilityDatabase warm;
+        runDatabase(warm, gpus);
+        CHECK(warm.isInstanceFromCache() && warm.getDevicesFromCache() == 2);
+    }
+    double warmMs = elapsedMs(start) / warmRuns;
+    std::remove(DATABASE_PATH);
+
+    char detail[96];
+    snprintf(detail, sizeof(detail), "%llu extension queries, %u layers, %u GPUs", (unsigned long long)layerQueries,
+        layerCount, (uint32_t)gpus.size());
+    reportBenchmark("Cold enumeration", coldMs, "ms", detail);
+    snprintf(detail, sizeof(detail), "%.1fx faster than cold", coldMs / warmMs);
+    reportBenchmark("Warm from database", warmMs, "ms", detail);
+}
@@ -0,0 +1,109 @@
+#include "TestFramework.h"
+#include "FakeVulkan.h"
+#include "CapabilitySet.h"
+
+static void buildSet(CapabilitySet& set, CapabilityLevel level, const std::vector<const char*>& extensionNames)
+{
+    LayerProperties implementation = {};
+    implementation.extensions = makeFakeExtensions(extensionNames);
+    set.build(level, implementation, std::vector<LayerProperties>());
+}
+
+// Position of 'name' in 'list', list.size() when it is not there.
+static size_t indexOf(const std::vector<const char*>& list, const char* name)
+{
+    for (size_t i = 0; i < list.size(); i++) {
+        if (!strcmp(list[i], name)) {
+            return i;
+        }
+    }
+    return list.size();
+}
+
+TEST_CASE(capabilitySetEnablesDependenciesFirst)
+{
+    CapabilitySet enabledInstance;
+    enabledInstance.buildEnabled(CAPABILITY_LEVEL_INSTANCE, std::vector<const char*>(), { "VK_KHR_get_physical_device_properties2" });
+    CapabilitySet device;
+    buildSet(device, CAPABILITY_LEVEL_DEVICE, { "VK_KHR_dynamic_rendering", "VK_KHR_depth_stencil_resolve",
+        "VK_KHR_create_renderpass2", "VK_KHR_multiview", "VK_KHR_maintenance2", "VK_KHR_maintenance3", "VK_EXT_descriptor_indexing" });
+
+    // Shared dependencies are enabled once.
+    std::vector<const char*> enableList, missing;
+    CHECK(device.resolveExtensions({ "VK_KHR_dynamic_rendering", "VK_KHR_maintenance3", "VK_EXT_descriptor_indexing" },
+        std::vector<const char*>(), enableList, &missing, &enabledInstance));
+    CHECK(missing.empty());
+    CHECK(enableList.size() == 7);
+    CHECK(indexOf(enableList, "VK_KHR_multiview") < indexOf(enableList, "VK_KHR_create_renderpass2"));
+    CHECK(indexOf(enableList, "VK_KHR_maintenance2") < indexOf(enableList, "VK_KHR_create_renderpass2"));
+    CHECK(indexOf(enableList, "VK_KHR_create_renderpass2") < indexOf(enableList, "VK_KHR_depth_stencil_resolve"));
+    CHECK(indexOf(enableList, "VK_KHR_depth_stencil_resolve") < indexOf(enableList, "VK_KHR_dynamic_rendering"));
+    CHECK(indexOf(enableList, "VK_KHR_maintenance3") < indexOf(enableList, "VK_EXT_descriptor_indexing"));
+
+    CapabilitySet instance;
+    buildSet(instance, CAPABILITY_LEVEL_INSTANCE, { "VK_KHR_xcb_surface", "VK_KHR_surface" });
+    CHECK(instance.resolveExtensions({ "VK_KHR_xcb_surface" }, std::vector<const char*>(), enableList));
+    CHECK(enableList.size() == 2 && !strcmp(enableList[0], "VK_KHR_surface") && !strcmp(enableList[1], "VK_KHR_xcb_surface"));
+}
+
+TEST_CASE(capabilitySetReportsMissingRequired)
+{
+    // VK_KHR_swapchain needs VK_KHR_surface on the instance, VK_KHR_create_renderpass2 needs VK_KHR_maintenance2.
+    CapabilitySet enabledInstance;
+    enabledInstance.buildEnabled(CAPABILITY_LEVEL_INSTANCE, std::vector<const char*>(), { "VK_KHR_get_physical_device_properties2" });
+    CapabilitySet device;
+    buildSet(device, CAPABILITY_LEVEL_DEVICE, { "VK_KHR_swapchain", "VK_KHR_create_renderpass2", "VK_KHR_multiview" });
+
+    std::vector<const char*> enableList, missing;
+    CHECK(!device.resolveExtensions({ "VK_KHR_swapchain", "VK_KHR_create_renderpass2", "VK_KHR_timeline_semaphore" },
+        std::vector<const char*>(), enableList, &missing, &enabledInstance));
+    CHECK(missing.size() == 3);
+    CHECK(indexOf(missing, "VK_KHR_surface") < missing.size());
+    CHECK(indexOf(missing, "VK_KHR_maintenance2") < missing.size());
+    CHECK(indexOf(missing, "VK_KHR_timeline_semaphore") < missing.size());
+    CHECK(indexOf(enableList, "VK_KHR_swapchain") == enableList.size());
+    CHECK(indexOf(enableList, "VK_KHR_create_renderpass2") == enableList.size());
+}
+
+// An optional extension that cannot be enabled takes back the dependencies it enabled, not
+// the ones other extensions enabled before it.
+TEST_CASE(capabilitySetRollsBackOptional)
+{
+    CapabilitySet enabledInstance;
+    enabledInstance.buildEnabled(CAPABILITY_LEVEL_INSTANCE, std::vector<const char*>(), { "VK_KHR_get_physical_device_properties2" });
+    CapabilitySet device;
+    buildSet(device, CAPABILITY_LEVEL_DEVICE, { "VK_KHR_dynamic_rendering", "VK_KHR_depth_stencil_resolve",
+        "VK_KHR_create_renderpass2", "VK_KHR_multiview", "VK_KHR_storage_buffer_storage_class", "VK_KHR_16bit_storage" });
+
+    std::vector<const char*> enableList, missing;
+    CHECK(device.resolveExtensions({ "VK_KHR_storage_buffer_storage_class" },
+        { "VK_KHR_dynamic_rendering", "VK_KHR_16bit_storage", "VK_KHR_multiview" }, enableList, &missing, &enabledInstance));
+    CHECK(missing.empty()); // Only required extensions are reported.
+    CHECK(enableList.size() == 3);
+    CHECK(!strcmp(enableList[0], "VK_KHR_storage_buffer_storage_class"));
+    CHECK(!strcmp(enableList[1], "VK_KHR_16bit_storage"));
+    CHECK(!strcmp(enableList[2], "VK_KHR_multiview")); // Rolled back with dynamic rendering, then enabled on its own.
+    CHECK(indexOf(enableList, "VK_KHR_create_renderpass2") == enableList.size());
+    CHECK(indexOf(enableList, "VK_KHR_depth_stencil_resolve") == enableList.size());
+}
+
+TEST_CASE(capabilitySetPrefersImplementation)
+{
+    LayerProperties implementation = {};
+    implementation.extensions = makeFakeExtensions({ "VK_EXT_debug_utils" });
+    std::vector<LayerProperties> layers(1);
+    layers[0].properties = VkLayerProperties();
+    strcpy(layers[0].properties.layerName, "VK_LAYER_fake_validation");
+    layers[0].extensions = makeFakeExtensions({ "VK_EXT_debug_utils", "VK_EXT_validation_features" });
+
+    CapabilitySet instance;
+    instance.build(CAPABILITY_LEVEL_INSTANCE, implementation, layers);
+    CHECK(instance.getExtensionCount() == 2);
+    CHECK(instance.getProvidingLayer("VK_EXT_debug_utils") == NULL);
+    CHECK(!strcmp(instance.getProvidingLayer("VK_EXT_validation_features"), "VK_LAYER_fake_validation"));
+    CHECK(instance.hasLayer("VK_LAYER_fake_validation") && !instance.hasLayer("VK_LAYER_other"));
+    CHECK(instance.getExtensionSpecVersion("VK_EXT_debug_utils") == 1 && instance.getExtensionSpecVersion("VK_KHR_surface") == 0);
+
+    std::vector<const char*> filtered = instance.filterLayers({ "VK_LAYER_other", "VK_LAYER_fake_validation" });
+    CHECK(filtered.size() == 1 && !strcmp(filtered[0], "VK_LAYER_fake_validation"));
+}
@@ -0,0 +1,133 @@
+#include "TestFramework.h"
+#include "FakeVulkan.h"
+#include "CommandPoolManager.h"
+#include "CommandBufferManager.h"
+#include "VulkanDevice.h"
+
+static void recordDraws(VkCommandBuffer cmdBuffer, uint32_t firstBatch, uint32_t batchCount, uint32_t drawsPerBatch)
+{
+    for (uint32_t batch = firstBatch; batch < firstBatch + batchCount; batch++) {
+        for (uint32_t draw = 0; draw < drawsPerBatch; draw++) {
+            vkCmdDraw(cmdBuffer, 3, 1, batch, draw);
+        }
+    }
+}
+
+// Secondaries of the primary in execution order, with the batches each one recorded.
+static std::vector<FakeCommandBuffer*> executedSecondaries(VkCommandBuffer primary)
+{
+    std::vector<FakeCommandBuffer*> secondaries;
+    for (const FakeCommand& command : getFakeCommandBuffer(primary)->commands) {
+        if (!strcmp(command.name, "vkCmdExecuteCommands")) {
+            secondaries.push_back(getFakeCommandBuffer((VkCommandBuffer)(uintptr_t)command.args[0]));
+        }
+    }
+    return secondaries;
+}
+
+TEST_CASE(recordParallelKeepsBatchOrder)
+{
+    VulkanDevice deviceObj(NULL);
+    deviceObj.device = getFakeDevice();
+
+    CommandPoolManager poolMgr;
+    poolMgr.createCommandPools(&deviceObj, 0, 2, 4);
+    CHECK(poolMgr.getWorkerCount() == 4);
+    CHECK(fakeCallCount("vkCreateCommandPool") == 8);
+
+    VkCommandBuffer primary = poolMgr.acquireCommandBuffer(0, 0, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    CommandBufferMgr::beginCommandBuffer(primary);
+    poolMgr.recordParallel(0, primary, 1000, NULL, [](VkCommandBuffer cmdBuffer, uint32_t firstBatch, uint32_t batchCount) {
+        recordDraws(cmdBuffer, firstBatch, batchCount, 1);
+    });
+    CommandBufferMgr::endCommandBuffer(primary);
+
+    // Every batch recorded once, the secondaries executed in batch order.
+    std::vector<FakeCommandBuffer*> secondaries = executedSecondaries(primary);
+    CHECK(secondaries.size() > 1 && secondaries.size() <= 4 * 4);
+    uint64_t nextBatch = 0;
+    for (FakeCommandBuffer* secondary : secondaries) {
+        CHECK(secondary->level == VK_COMMAND_BUFFER_LEVEL_SECONDARY && !secondary->recording);
+        for (const FakeCommand& command : secondary->commands) {
+            CHECK(command.args[2] == nextBatch);
+            nextBatch++;
+        }
+    }
+    CHECK(nextBatch == 1000);
+
+    poolMgr.destroyCommandPools();
+}
+
+TEST_CASE(resetFramePoolsReusesCommandBuffers)
+{
+    VulkanDevice deviceObj(NULL);
+    deviceObj.device = getFakeDevice();
+
+    CommandPoolManager poolMgr;
+    poolMgr.createCommandPools(&deviceObj, 0, 2, 2);
+
+    std::vector<VkCommandBuffer> first;
+    for (uint32_t i = 0; i < 20; i++) {
+        first.push_back(poolMgr.acquireCommandBuffer(1, 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY));
+    }
+    uint64_t allocations = fakeCallCount("vkAllocateCommandBuffers");
+    CHECK(allocations == 3); // In chunks, not one call per buffer.
+
+    // After the reset the same buffers come back in the same order, nothing is allocated.
+    poolMgr.resetFramePools(1);
+    CHECK(fakeCallCount("vkResetCommandPool") == 2);
+    for (uint32_t i = 0; i < 20; i++) {
+        CHECK(poolMgr.acquireCommandBuffer(1, 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY) == first[i]);
+    }
+    CHECK(fakeCallCount("vkAllocateCommandBuffers") == allocations);
+
+    // The other slot and level have their own buffers.
+    CHECK(poolMgr.acquireCommandBuffer(0, 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY) != first[0]);
+    CHECK(poolMgr.acquireCommandBuffer(1, 1, VK_COMMAND_BUFFER_LEVEL_PRIMARY) != first[0]);
+
+    poolMgr.destroyCommandPools();
+}
+
+// Recording throughput of recordParallel() by worker count, 4096 batches of 64 draws a frame.
+// The fake driver appends every draw to the command buffer's memory, as a driver encodes it.
+BENCHMARK_CASE(recordParallelScaling)
+{
+    const uint32_t batchCount = 4096;
+    const uint32_t drawsPerBatch = 64;
+    const uint32_t frameCount = 20;
+    uint32_t maxWorkers = std::max(1u, std::thread::hardware_concurrency());
+
+    VulkanDevice deviceObj(NULL);
+    deviceObj.device = getFakeDevice();
+
+    double singleThreadRate = 0.0;
+    for (uint32_t workers = 1; workers <= maxWorkers; workers = workers < maxWorkers ? std::min(workers * 2, maxWorkers) : workers + 1) {
+        CommandPoolManager poolMgr;
+        poolMgr.createCommandPools(&deviceObj, 0, 1, workers);
+
+        // The first frame allocates the command buffers and grows their memory.
+        std::chrono::steady_clock::time_point start;
+        for (uint32_t frame = 0; frame <= frameCount; frame++) {
+            if (frame == 1) {
+                start = std::chrono::steady_clock::now();
+            }
+            poolMgr.resetFramePools(0);
+            VkCommandBuffer primary = poolMgr.acquireCommandBuffer(0, 0, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+            CommandBufferMgr::beginCommandBuffer(primary);
+            poolMgr.recordParallel(0, primary, batchCount, NULL, [](VkCommandBuffer cmdBuffer, uint32_t firstBatch, uint32_t count) {
+                recordDraws(cmdBuffer, firstBatch, count, drawsPerBatch);
+            });
+            CommandBufferMgr::endCommandBuffer(primary);
+        }
+        double ms = elapsedMs(start);
+        poolMgr.destroyCommandPools();
+
+        double rate = frameCount * (double)batchCount * drawsPerBatch / (ms / 1000.0);
+        if (workers == 1) {
+            singleThreadRate = rate;
+        }
+        char detail[64];
+        snprintf(detail, sizeof(detail), "%u workers, %.2fx one worker", workers, rate / singleThreadRate);
+        reportBenchmark("Parallel recording", rate / 1e6, "M draws/s", detail);
+    }
+}
@@ -0,0 +1,135 @@
+#include "TestFramework.h"
+#include "FakeVulkan.h"
+#include "DebugUtils.h"
+#include "CommandBufferManager.h"
+#include "DescriptorAllocator.h"
+#include "PipelineManager.h"
+#include "VulkanDevice.h"
+
+static const VkInstance FAKE_INSTANCE = (VkInstance)(uintptr_t)0x3000;
+
+static VkCommandBuffer beginCommandBuffer(VkCommandPool& cmdPool)
+{
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    vkCreateCommandPool(getFakeDevice(), &poolInfo, NULL, &cmdPool);
+    VkDevice device = getFakeDevice();
+    VkCommandBuffer cmdBuffer;
+    CommandBufferMgr::allocCommandBuffer(&device, cmdPool, &cmdBuffer);
+    CommandBufferMgr::beginCommandBuffer(cmdBuffer);
+    return cmdBuffer;
+}
+
+static std::vector<std::string> commandNames(VkCommandBuffer cmdBuffer)
+{
+    std::vector<std::string> names;
+    for (const FakeCommand& command : getFakeCommandBuffer(cmdBuffer)->commands) {
+        names.push_back(command.name);
+    }
+    return names;
+}
+
+TEST_CASE(debugLabelsRecordPairs)
+{
+    fakeVulkan.debugUtils = true;
+    DebugUtils debugUtils;
+    CHECK(debugUtils.loadFunctions(FAKE_INSTANCE));
+    VkCommandPool cmdPool;
+    VkCommandBuffer cmdBuffer = beginCommandBuffer(cmdPool);
+
+    // Nested scopes end in reverse order, around the commands recorded inside them.
+    {
+        CommandBufferLabel outer(&debugUtils, cmdBuffer, "Outer");
+        {
+            CommandBufferLabel inner(&debugUtils, cmdBuffer, "Inner");
+            vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+        }
+    }
+    {
+        QueueLabel queueLabel(&debugUtils, getFakeQueue(), "Submit");
+        CHECK(fakeCallCount("vkQueueBeginDebugUtilsLabelEXT") == 1 && fakeCallCount("vkQueueEndDebugUtilsLabelEXT") == 0);
+    }
+    std::vector<std::string> commands = commandNames(cmdBuffer);
+    CHECK(commands.size() == 5);
+    if (commands.size() == 5) {
+        CHECK(commands[0] == "vkCmdBeginDebugUtilsLabelEXT" && commands[1] == "vkCmdBeginDebugUtilsLabelEXT");
+        CHECK(commands[2] == "vkCmdDraw");
+        CHECK(commands[3] == "vkCmdEndDebugUtilsLabelEXT" && commands[4] == "vkCmdEndDebugUtilsLabelEXT");
+    }
+    CHECK(fakeCallCount("vkQueueEndDebugUtilsLabelEXT") == 1);
+    CHECK(fakeVulkan.labels.size() == 3 && fakeVulkan.labels[0] == "Outer" && fakeVulkan.labels[2] == "Submit");
+
+    // Without debug utils, or with the extension missing, the labels record nothing.
+    DebugUtils disabled;
+    fakeVulkan.debugUtils = false;
+    CHECK(!disabled.loadFunctions(FAKE_INSTANCE));
+    CommandBufferMgr::beginCommandBuffer(cmdBuffer);
+    {
+        CommandBufferLabel noUtils(NULL, cmdBuffer, "None");
+        CommandBufferLabel noExtension(&disabled, cmdBuffer, "None");
+        QueueLabel noQueueUtils(NULL, getFakeQueue(), "None");
+        QueueLabel noQueueExtension(&disabled, getFakeQueue(), "None");
+        vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+    }
+    CHECK(commandNames(cmdBuffer).size() == 1);
+    CHECK(fakeCallCount("vkQueueBeginDebugUtilsLabelEXT") == 1 && fakeVulkan.labels.size() == 3);
+    vkDestroyCommandPool(getFakeDevice(), cmdPool, NULL);
+}
+
+// The wrappers name what they create, so captures and validation messages show more than handles.
+TEST_CASE(wrappersNameCreatedObjects)
+{
+    fakeVulkan.debugUtils = true;
+    DebugUtils debugUtils;
+    CHECK(debugUtils.loadFunctions(FAKE_INSTANCE));
+    VulkanDevice deviceObj(NULL);
+    deviceObj.device = getFakeDevice();
+    deviceObj.gpuProps = VkPhysicalDeviceProperties();
+    deviceObj.debugUtils = &debugUtils;
+
+    FencePool fencePool;
+    fencePool.createFencePool(getFakeDevice(), 0, &debugUtils, "Test fence");
+    CommandBufferMgr::submitCommandBufferAsync(getFakeQueue(), fencePool, NULL, 0);
+    CHECK(getFakeObjectName(fakeVulkan.submittedFences.back()) == "Test fence");
+
+    VkCommandPool cmdPool;
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    vkCreateCommandPool(getFakeDevice(), &poolInfo, NULL, &cmdPool);
+    VkCommandBufferAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocateInfo.commandPool = cmdPool;
+    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocateInfo.commandBufferCount = 2;
+    VkCommandBuffer cmdBuffers[2];
+    CommandBufferMgr::allocCommandBuffer(&deviceObj.device, cmdPool, cmdBuffers, &allocateInfo, &debugUtils, "Test command buffer");
+    CHECK(getFakeObjectName(cmdBuffers[0]) == "Test command buffer" && getFakeObjectName(cmdBuffers[1]) == "Test command buffer");
+
+    PipelineManager pipelineMgr;
+    pipelineMgr.createPipelineManager(&deviceObj, "");
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = makeFakeHandle<VkShaderModule>();
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = makeFakeHandle<VkPipelineLayout>();
+    VkPipeline pipeline;
+    CHECK(pipelineMgr.getComputePipeline(pipelineInfo, &pipeline, "Test kernel") == VK_SUCCESS);
+    CHECK(getFakeObjectName(pipeline) == "Test kernel");
+
+    DescriptorAllocator allocator;
+    allocator.createDescriptorAllocator(&deviceObj, 1);
+    VkDescriptorSetLayout layout = allocator.getLayout(std::vector<VkDescriptorSetLayoutBinding>(), 0, "Test layout");
+    CHECK(getFakeObjectName(layout) == "Test layout");
+
+    // A cached layout keeps the name of its creation.
+    CHECK(allocator.getLayout(std::vector<VkDescriptorSetLayoutBinding>(), 0, "Other layout") == layout);
+    CHECK(getFakeObjectName(layout) == "Test layout");
+
+    allocator.destroyDescriptorAllocator();
+    pipelineMgr.destroyPipelineManager();
+    vkDestroyCommandPool(getFakeDevice(), cmdPool, NULL);
+    completeFakeSubmissions();
+    fencePool.destroyFencePool();
+}
@@ -0,0 +1,82 @@
+#include "TestFramework.h"
+#include "FakeVulkan.h"
+#include "DeletionQueue.h"
+#include "CommandBufferManager.h"
+#include "VulkanDevice.h"
+
+static bool destroyedInOrder(const std::vector<uint64_t>& expected)
+{
+    return fakeVulkan.destroyedObjects == expected;
+}
+
+TEST_CASE(deletionQueueWaitsForFrames)
+{
+    VulkanDevice deviceObj(NULL);
+    deviceObj.device = getFakeDevice();
+    DeletionQueue deletionQueue;
+    deletionQueue.createDeletionQueue(&deviceObj);
+
+    VkSemaphore first = makeFakeHandle<VkSemaphore>();
+    VkSemaphore second = makeFakeHandle<VkSemaphore>();
+    VkImageView third = makeFakeHandle<VkImageView>();
+    deletionQueue.beginFrame(0, 0);
+    deletionQueue.destroyObject(VK_OBJECT_TYPE_SEMAPHORE, first); // Used by frame 0.
+    deletionQueue.destroyObject(VK_OBJECT_TYPE_SEMAPHORE, (VkSemaphore)VK_NULL_HANDLE);
+    deletionQueue.beginFrame(1, 0);
+    deletionQueue.destroyObject(VK_OBJECT_TYPE_SEMAPHORE, second); // Used by frame 1.
+    deletionQueue.destroyObject(VK_OBJECT_TYPE_IMAGE_VIEW, third, DeletionKey::afterFrame(0));
+    CHECK(deletionQueue.getPendingCount() == 3);
+    CHECK(fakeVulkan.destroyedObjects.empty());
+
+    // Frame 0 has completed. The view queued behind frame 1 waits for it: late, never early.
+    deletionQueue.beginFrame(2, 1);
+    CHECK(destroyedInOrder({ (uint64_t)first }));
+    deletionQueue.collect();
+    CHECK(deletionQueue.getPendingCount() == 2);
+
+    deletionQueue.beginFrame(3, 2);
+    CHECK(destroyedInOrder({ (uint64_t)first, (uint64_t)second, (uint64_t)third }));
+    CHECK(deletionQueue.getPendingCount() == 0);
+    CHECK(deletionQueue.getStats().queued == 3 && deletionQueue.getStats().destroyed == 3);
+    CHECK(deletionQueue.getStats().maxPending == 3);
+    deletionQueue.destroyDeletionQueue();
+}
+
+TEST_CASE(deletionQueueWaitsForSerials)
+{
+    VulkanDevice deviceObj(NULL);
+    deviceObj.device = getFakeDevice();
+    DeletionQueue deletionQueue;
+    deletionQueue.createDeletionQueue(&deviceObj);
+    FencePool fencePool;
+    fencePool.createFencePool(getFakeDevice(), 2);
+
+    VkSemaphore frameObject = makeFakeHandle<VkSemaphore>();
+    VkSemaphore firstUpload = makeFakeHandle<VkSemaphore>();
+    VkSemaphore secondUpload = makeFakeHandle<VkSemaphore>();
+    deletionQueue.beginFrame(0, 0);
+    deletionQueue.destroyObject(VK_OBJECT_TYPE_SEMAPHORE, frameObject);
+    SubmitToken first = CommandBufferMgr::submitCommandBufferAsync(getFakeQueue(), fencePool, NULL, 0);
+    SubmitToken second = CommandBufferMgr::submitCommandBufferAsync(getFakeQueue(), fencePool, NULL, 0);
+    deletionQueue.destroyObject(VK_OBJECT_TYPE_SEMAPHORE, firstUpload, DeletionKey::afterSubmit(fencePool, first));
+    deletionQueue.destroyObject(VK_OBJECT_TYPE_SEMAPHORE, secondUpload, DeletionKey::afterSubmit(fencePool, second));
+
+    // Serials complete independently of the frames.
+    deletionQueue.collect();
+    CHECK(fakeVulkan.destroyedObjects.empty());
+    completeFakeSubmissions(1);
+    deletionQueue.collect();
+    CHECK(destroyedInOrder({ (uint64_t)firstUpload }));
+
+    // A frame retiring leaves the second upload waiting.
+    deletionQueue.beginFrame(1, 1);
+    CHECK(destroyedInOrder({ (uint64_t)firstUpload, (uint64_t)frameObject }));
+    CHECK(deletionQueue.getPendingCount() == 1);
+
+    // Whatever is left goes with the queue, the device is idle by then.
+    deletionQueue.destroyDeletionQueue();
+    CHECK(destroyedInOrder({ (uint64_t)firstUpload, (uint64_t)frameObject, (uint64_t)secondUpload }));
+    CHECK(deletionQueue.getPendingCount() == 0);
+    completeFakeSubmissions();
+    fencePool.destroyFencePool();
+}
@@ -0,0 +1,97 @@
+#include "TestFramework.h"
+#include "FakeVulkan.h"
+#include "DescriptorAllocator.h"
+#include "VulkanDevice.h"
+
+static uint32_t poolMaxSets(VkDescriptorSet set)
+{
+    return getFakeDescriptorPool(fakeVulkan.descriptorSetPools[set])->maxSets;
+}
+
+// Allocates sets one by one until one comes from a pool of 'maxSets', returns that set.
+static VkDescriptorSet allocateUntilPoolSize(DescriptorAllocator& allocator, uint32_t frameSlot, VkDescriptorSetLayout layout,
+    uint32_t maxSets)
+{
+    for (uint32_t i = 0; i < 8192; i++) {
+        VkDescriptorSet set = allocator.allocate(frameSlot, layout);
+        if (poolMaxSets(set) == maxSets) {
+            return set;
+        }
+    }
+    return VK_NULL_HANDLE;
+}
+
+TEST_CASE(descriptorAllocatorCachesLayouts)
+{
+    VulkanDevice deviceObj(NULL);
+    deviceObj.device = getFakeDevice();
+
+    DescriptorAllocator allocator;
+    allocator.createDescriptorAllocator(&deviceObj, 1);
+
+    std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+    for (uint32_t i = 0; i < 2; i++) {
+        bindings[i] = {};
+        bindings[i].binding = i;
+        bindings[i].descriptorType = i ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayout layout = allocator.getLayout(bindings);
+
+    // Listed in another order it is the same layout, another stage makes another one.
+    std::swap(bindings[0], bindings[1]);
+    CHECK(allocator.getLayout(bindings) == layout);
+    bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    CHECK(allocator.getLayout(bindings) != layout);
+
+    DescriptorAllocatorStats stats = allocator.getStats();
+    CHECK(stats.layoutsCreated == 2 && stats.layoutCacheHits == 1);
+    CHECK(fakeCallCount("vkCreateDescriptorSetLayout") == 2);
+
+    allocator.destroyDescriptorAllocator();
+    CHECK(fakeCallCount("vkDestroyDescriptorSetLayout") == 2);
+}
+
+TEST_CASE(descriptorAllocatorReusesPoolsOfTheChainSize)
+{
+    const uint32_t initial = DescriptorAllocator::INITIAL_SETS_PER_POOL;
+
+    VulkanDevice deviceObj(NULL);
+    deviceObj.device = getFakeDevice();
+
+    DescriptorAllocator allocator;
+    allocator.createDescriptorAllocator(&deviceObj, 2);
+    VkDescriptorSetLayout layout = allocator.getLayout(std::vector<VkDescriptorSetLayoutBinding>());
+
+    // Slot 0 runs out twice, its chain doubles to a pool of four times the initial size.
+    CHECK(poolMaxSets(allocator.allocate(0, layout)) == initial);
+    CHECK(allocateUntilPoolSize(allocator, 0, layout, initial * 4) != VK_NULL_HANDLE);
+    CHECK(fakeCallCount("vkCreateDescriptorPool") == 3);
+
+    // The reset keeps the largest pool with slot 0 and frees the two exhausted ones.
+    allocator.resetFrame(0);
+    CHECK(fakeCallCount("vkResetDescriptorPool") == 3);
+    CHECK(poolMaxSets(allocator.allocate(0, layout)) == initial * 4);
+
+    // Slot 1 takes the free pools in the order its chain grows, then creates the next size.
+    CHECK(poolMaxSets(allocator.allocate(1, layout)) == initial);
+    CHECK(fakeCallCount("vkCreateDescriptorPool") == 3);
+    CHECK(allocateUntilPoolSize(allocator, 1, layout, initial * 2) != VK_NULL_HANDLE);
+    CHECK(fakeCallCount("vkCreateDescriptorPool") == 3);
+    CHECK(allocateUntilPoolSize(allocator, 1, layout, initial * 4) != VK_NULL_HANDLE);
+    CHECK(fakeCallCount("vkCreateDescriptorPool") == 4);
+
+    // A chain that has grown never takes a free pool smaller than it asks for.
+    allocator.resetFrame(1);
+    VkDescriptorSet sets[256];
+    allocator.allocate(0, layout, 256, sets);
+    CHECK(poolMaxSets(sets[255]) == initial * 4);
+    CHECK(allocateUntilPoolSize(allocator, 0, layout, initial * 8) != VK_NULL_HANDLE);
+    CHECK(fakeCallCount("vkCreateDescriptorPool") == 5);
+
+    DescriptorAllocatorStats stats = allocator.getStats();
+    CHECK(stats.poolsCreated == 5);
+    allocator.destroyDescriptorAllocator();
+    CHECK(fakeCallCount("vkDestroyDescriptorPool") == 5);
+}
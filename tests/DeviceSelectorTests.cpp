@@ -0,0 +1,102 @@
+#include "TestFramework.h"
+#include "DeviceSelector.h"
+
+static const VkDeviceSize MB = 1024 * 1024;
+
+// A device with one device local heap, a graphics family and 'dedicatedFamilies' transfer-only families.
+static DeviceCandidate candidate(uint32_t gpuIndex, VkPhysicalDeviceType deviceType, VkDeviceSize deviceLocalBytes,
+    uint32_t dedicatedFamilies = 0, uint32_t apiVersion = VK_MAKE_VERSION(1, 1, 0))
+{
+    DeviceCandidate device;
+    device.gpuIndex = gpuIndex;
+    device.properties = VkPhysicalDeviceProperties();
+    device.properties.deviceType = deviceType;
+    device.properties.apiVersion = apiVersion;
+    device.properties.vendorID = 0x1000 + gpuIndex;
+    snprintf(device.properties.deviceName, sizeof(device.properties.deviceName), "Fake GPU %u", gpuIndex);
+
+    device.memoryProperties = VkPhysicalDeviceMemoryProperties();
+    device.memoryProperties.memoryHeapCount = 2;
+    device.memoryProperties.memoryHeaps[0].size = 16 * 1024 * MB; // System memory, not counted.
+    device.memoryProperties.memoryHeaps[1].size = deviceLocalBytes;
+    device.memoryProperties.memoryHeaps[1].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+
+    VkQueueFamilyProperties family = {};
+    family.queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+    family.queueCount = 1;
+    device.queueFamilies.push_back(family);
+    family.queueFlags = VK_QUEUE_TRANSFER_BIT;
+    device.queueFamilies.insert(device.queueFamilies.end(), dedicatedFamilies, family);
+
+    device.hasRequiredExtensions = true;
+    return device;
+}
+
+TEST_CASE(rankDevicesOrdersByScore)
+{
+    std::vector<DeviceCandidate> candidates;
+    candidates.push_back(candidate(0, VK_PHYSICAL_DEVICE_TYPE_CPU, 0));
+    candidates.push_back(candidate(1, VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU, 512 * MB));
+    candidates.push_back(candidate(2, VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 4096 * MB));
+    candidates.push_back(candidate(3, VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8192 * MB));
+    candidates.push_back(candidate(4, VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 4096 * MB, 1));
+    candidates.push_back(candidate(5, VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 4096 * MB, 1, VK_MAKE_VERSION(1, 2, 0)));
+    candidates.push_back(candidate(6, VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 4096 * MB, 1, VK_MAKE_VERSION(1, 2, 0)));
+
+    // Type, then device local memory, dedicated families, API version, and the index last.
+    std::vector<uint32_t> ranking = DeviceSelector::rankDevices(candidates, DeviceSelectionPolicy());
+    const uint32_t expected[] = { 3, 5, 6, 4, 2, 1, 0 };
+    CHECK(ranking == std::vector<uint32_t>(expected, expected + 7));
+
+    // The order of the input does not matter.
+    std::reverse(candidates.begin(), candidates.end());
+    CHECK(DeviceSelector::rankDevices(candidates, DeviceSelectionPolicy()) == ranking);
+}
+
+TEST_CASE(rankDevicesAppliesPolicy)
+{
+    std::vector<DeviceCandidate> candidates;
+    candidates.push_back(candidate(0, VK_PHYSICAL_DEVICE_TYPE_CPU, 0));
+    candidates.push_back(candidate(1, VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU, 512 * MB));
+    candidates.push_back(candidate(2, VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 4096 * MB));
+
+    DeviceSelectionPolicy policy;
+    policy.preferredVendorID = candidates[1].properties.vendorID;
+    std::vector<uint32_t> ranking = DeviceSelector::rankDevices(candidates, policy);
+    CHECK(ranking.size() == 3 && ranking[0] == 1 && ranking[1] == 2);
+
+    policy.preferredVendorID = 0;
+    policy.forcedGpuIndex = 0;
+    ranking = DeviceSelector::rankDevices(candidates, policy);
+    CHECK(ranking.size() == 3 && ranking[0] == 0 && ranking[1] == 2 && ranking[2] == 1);
+
+    // A forced device that is not allowed falls back to the ranking.
+    policy.allowCpuDevices = false;
+    ranking = DeviceSelector::rankDevices(candidates, policy);
+    CHECK(ranking.size() == 2 && ranking[0] == 2 && ranking[1] == 1);
+}
+
+TEST_CASE(rankDevicesRejectsUnusable)
+{
+    std::vector<DeviceCandidate> candidates;
+    candidates.push_back(candidate(0, VK_PHYSICAL_DEVICE_TYPE_CPU, 0));
+    candidates.push_back(candidate(1, VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8192 * MB));
+    candidates[1].hasRequiredExtensions = false;
+    candidates.push_back(candidate(2, VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8192 * MB, 1));
+    candidates[2].queueFamilies[0].queueFlags = VK_QUEUE_COMPUTE_BIT; // Compute only.
+    candidates.push_back(candidate(3, VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8192 * MB));
+    candidates[3].queueFamilies[0].queueCount = 0;
+    candidates.push_back(candidate(4, VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU, 512 * MB));
+
+    DeviceSelectionPolicy policy;
+    policy.allowCpuDevices = false;
+    std::vector<uint32_t> ranking = DeviceSelector::rankDevices(candidates, policy);
+    CHECK(ranking.size() == 1 && ranking[0] == 4);
+
+    CHECK(!strcmp(DeviceSelector::getRejectionReason(candidates[0], policy), "CPU devices not allowed"));
+    CHECK(!strcmp(DeviceSelector::getRejectionReason(candidates[1], policy), "missing required extensions"));
+    CHECK(!strcmp(DeviceSelector::getRejectionReason(candidates[2], policy), "no graphics queue"));
+    CHECK(!strcmp(DeviceSelector::getRejectionReason(candidates[3], policy), "no graphics queue"));
+    CHECK(DeviceSelector::getRejectionReason(candidates[4], policy) == NULL);
+    CHECK(DeviceSelector::getRejectionReason(candidates[0], DeviceSelectionPolicy()) == NULL);
+}
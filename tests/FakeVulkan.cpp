@@ -0,0 +1,744 @@
+#include "FakeVulkan.h"
+#include <chrono>
+#include <functional>
+#include <thread>
+
+FakeVulkanState fakeVulkan;
+
+struct FakeCommandPool {
+    std::vector<FakeCommandBuffer*> cmdBuffers;
+};
+
+static std::vector<std::unique_ptr<FakePhysicalDevice> > physicalDevices;
+
+static void countCall(const char* entryPoint)
+{
+    std::lock_guard<std::mutex> lock(fakeVulkan.callMutex);
+    fakeVulkan.calls[entryPoint]++;
+}
+
+static void recordCommand(VkCommandBuffer cmdBuffer, const char* name, uint64_t arg0 = 0, uint64_t arg1 = 0, uint64_t arg2 = 0, uint64_t arg3 = 0)
+{
+    FakeCommandBuffer* fakeCmdBuffer = getFakeCommandBuffer(cmdBuffer);
+    assert(fakeCmdBuffer->recording);
+    FakeCommand command = { name, { arg0, arg1, arg2, arg3 } };
+    fakeCmdBuffer->commands.push_back(command);
+}
+
+void resetFakeVulkan()
+{
+    {
+        std::lock_guard<std::mutex> lock(fakeVulkan.callMutex);
+        fakeVulkan.calls.clear();
+    }
+    fakeVulkan.queueFamilies.clear();
+    fakeVulkan.invalidatedRanges.clear();
+    fakeVulkan.destroyedObjects.clear();
+    fakeVulkan.descriptorSetPools.clear();
+    fakeVulkan.debugUtils = false;
+    fakeVulkan.objectNames.clear();
+    fakeVulkan.labels.clear();
+    fakeVulkan.instanceLayers.clear();
+    fakeVulkan.instanceExtensions.clear();
+    fakeVulkan.layerQueryMicroseconds = 0;
+    physicalDevices.clear();
+    std::lock_guard<std::mutex> lock(fakeVulkan.fenceMutex);
+    fakeVulkan.submittedFences.clear();
+    fakeVulkan.submittedCmdBuffers.clear();
+    fakeVulkan.holdWaiters = false;
+    fakeVulkan.submitResult = VK_SUCCESS;
+}
+
+uint64_t fakeCallCount(const char* entryPoint)
+{
+    std::lock_guard<std::mutex> lock(fakeVulkan.callMutex);
+    std::map<std::string, uint64_t>::const_iterator it = fakeVulkan.calls.find(entryPoint);
+    return it == fakeVulkan.calls.end() ? 0 : it->second;
+}
+
+FakeCommandBuffer* getFakeCommandBuffer(VkCommandBuffer cmdBuffer)
+{
+    return (FakeCommandBuffer*)cmdBuffer;
+}
+
+FakeDescriptorPool* getFakeDescriptorPool(VkDescriptorPool pool)
+{
+    return (FakeDescriptorPool*)(uintptr_t)pool;
+}
+
+static FakeFence* getFakeFence(VkFence fence)
+{
+    return (FakeFence*)(uintptr_t)fence;
+}
+
+void signalFakeFence(VkFence fence)
+{
+    {
+        std::lock_guard<std::mutex> lock(fakeVulkan.fenceMutex);
+        getFakeFence(fence)->signaled = true;
+    }
+    fakeVulkan.fenceSignaled.notify_all();
+}
+
+bool isFakeFenceSignaled(VkFence fence)
+{
+    std::lock_guard<std::mutex> lock(fakeVulkan.fenceMutex);
+    return getFakeFence(fence)->signaled;
+}
+
+void holdFakeWaiters(bool hold)
+{
+    {
+        std::lock_guard<std::mutex> lock(fakeVulkan.fenceMutex);
+        fakeVulkan.holdWaiters = hold;
+    }
+    fakeVulkan.fenceSignaled.notify_all();
+}
+
+void completeFakeSubmissions(size_t count)
+{
+    {
+        std::lock_guard<std::mutex> lock(fakeVulkan.fenceMutex);
+        for (VkFence fence : fakeVulkan.submittedFences) {
+            if (count && !getFakeFence(fence)->signaled) {
+                getFakeFence(fence)->signaled = true;
+                count--;
+            }
+        }
+    }
+    fakeVulkan.fenceSignaled.notify_all();
+}
+
+std::vector<VkExtensionProperties> makeFakeExtensions(const std::vector<const char*>& names)
+{
+    std::vector<VkExtensionProperties> extensions(names.size());
+    for (size_t i = 0; i < names.size(); i++) {
+        memset(&extensions[i], 0, sizeof(VkExtensionProperties));
+        strncpy(extensions[i].extensionName, names[i], VK_MAX_EXTENSION_NAME_SIZE - 1);
+        extensions[i].specVersion = 1;
+    }
+    return extensions;
+}
+
+VkPhysicalDevice makeFakePhysicalDevice(uint32_t vendorID, uint32_t deviceID, uint32_t driverVersion,
+    const std::vector<const char*>& extensionNames)
+{
+    FakePhysicalDevice* gpu = new FakePhysicalDevice();
+    gpu->properties.vendorID = vendorID;
+    gpu->properties.deviceID = deviceID;
+    gpu->properties.driverVersion = driverVersion;
+    gpu->extensions = makeFakeExtensions(extensionNames);
+    physicalDevices.push_back(std::unique_ptr<FakePhysicalDevice>(gpu));
+    return (VkPhysicalDevice)gpu;
+}
+
+FakePhysicalDevice* getFakePhysicalDevice(VkPhysicalDevice gpu)
+{
+    return (FakePhysicalDevice*)gpu;
+}
+
+// The two call enumeration protocol: the count without an array, else up to '*pCount' items.
+template <typename T>
+static VkResult enumerate(const std::vector<T>& items, uint32_t* pCount, T* pItems)
+{
+    if (!pItems) {
+        *pCount = (uint32_t)items.size();
+        return VK_SUCCESS;
+    }
+    VkResult result = *pCount < items.size() ? VK_INCOMPLETE : VK_SUCCESS;
+    *pCount = std::min(*pCount, (uint32_t)items.size());
+    std::copy(items.begin(), items.begin() + *pCount, pItems);
+    return result;
+}
+
+/***************DEBUG UTILS***************/
+static VKAPI_ATTR VkResult VKAPI_CALL fakeCreateDebugUtilsMessenger(VkInstance instance,
+    const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pMessenger)
+{
+    countCall("vkCreateDebugUtilsMessengerEXT");
+    *pMessenger = makeFakeHandle<VkDebugUtilsMessengerEXT>();
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL fakeDestroyDebugUtilsMessenger(VkInstance instance, VkDebugUtilsMessengerEXT messenger,
+    const VkAllocationCallbacks* pAllocator)
+{
+    countCall("vkDestroyDebugUtilsMessengerEXT");
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL fakeSetDebugUtilsObjectName(VkDevice device, const VkDebugUtilsObjectNameInfoEXT* pNameInfo)
+{
+    countCall("vkSetDebugUtilsObjectNameEXT");
+    std::lock_guard<std::mutex> lock(fakeVulkan.callMutex);
+    fakeVulkan.objectNames[pNameInfo->objectHandle] = pNameInfo->pObjectName;
+    return VK_SUCCESS;
+}
+
+static void addFakeLabel(const VkDebugUtilsLabelEXT* pLabelInfo)
+{
+    std::lock_guard<std::mutex> lock(fakeVulkan.callMutex);
+    fakeVulkan.labels.push_back(pLabelInfo->pLabelName);
+}
+
+static VKAPI_ATTR void VKAPI_CALL fakeCmdBeginDebugUtilsLabel(VkCommandBuffer commandBuffer, const VkDebugUtilsLabelEXT* pLabelInfo)
+{
+    recordCommand(commandBuffer, "vkCmdBeginDebugUtilsLabelEXT");
+    addFakeLabel(pLabelInfo);
+}
+
+static VKAPI_ATTR void VKAPI_CALL fakeCmdEndDebugUtilsLabel(VkCommandBuffer commandBuffer)
+{
+    recordCommand(commandBuffer, "vkCmdEndDebugUtilsLabelEXT");
+}
+
+static VKAPI_ATTR void VKAPI_CALL fakeCmdInsertDebugUtilsLabel(VkCommandBuffer commandBuffer, const VkDebugUtilsLabelEXT* pLabelInfo)
+{
+    recordCommand(commandBuffer, "vkCmdInsertDebugUtilsLabelEXT");
+}
+
+static VKAPI_ATTR void VKAPI_CALL fakeQueueBeginDebugUtilsLabel(VkQueue queue, const VkDebugUtilsLabelEXT* pLabelInfo)
+{
+    countCall("vkQueueBeginDebugUtilsLabelEXT");
+    addFakeLabel(pLabelInfo);
+}
+
+static VKAPI_ATTR void VKAPI_CALL fakeQueueEndDebugUtilsLabel(VkQueue queue)
+{
+    countCall("vkQueueEndDebugUtilsLabelEXT");
+}
+
+/***************INSTANCE***************/
+// No vkEnumerateInstanceVersion: a 1.0 loader. The debug utils entry points only when enabled.
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(VkInstance instance, const char* pName)
+{
+    if (!fakeVulkan.debugUtils) {
+        return NULL;
+    }
+    static const struct {
+        const char* name;
+        PFN_vkVoidFunction function;
+    } debugUtilsFunctions[] = {
+        { "vkCreateDebugUtilsMessengerEXT", (PFN_vkVoidFunction)fakeCreateDebugUtilsMessenger },
+        { "vkDestroyDebugUtilsMessengerEXT", (PFN_vkVoidFunction)fakeDestroyDebugUtilsMessenger },
+        { "vkSetDebugUtilsObjectNameEXT", (PFN_vkVoidFunction)fakeSetDebugUtilsObjectName },
+        { "vkCmdBeginDebugUtilsLabelEXT", (PFN_vkVoidFunction)fakeCmdBeginDebugUtilsLabel },
+        { "vkCmdEndDebugUtilsLabelEXT", (PFN_vkVoidFunction)fakeCmdEndDebugUtilsLabel },
+        { "vkCmdInsertDebugUtilsLabelEXT", (PFN_vkVoidFunction)fakeCmdInsertDebugUtilsLabel },
+        { "vkQueueBeginDebugUtilsLabelEXT", (PFN_vkVoidFunction)fakeQueueBeginDebugUtilsLabel },
+        { "vkQueueEndDebugUtilsLabelEXT", (PFN_vkVoidFunction)fakeQueueEndDebugUtilsLabel },
+    };
+    for (const auto& entry : debugUtilsFunctions) {
+        if (!strcmp(pName, entry.name)) {
+            return entry.function;
+        }
+    }
+    return NULL;
+}
+
+static void loadFakeLayer(const char* layerName)
+{
+    if (layerName && fakeVulkan.layerQueryMicroseconds) {
+        std::this_thread::sleep_for(std::chrono::microseconds(fakeVulkan.layerQueryMicroseconds));
+    }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceLayerProperties(uint32_t* pPropertyCount, VkLayerProperties* pProperties)
+{
+    return enumerate(fakeVulkan.instanceLayers, pPropertyCount, pProperties);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceExtensionProperties(const char* pLayerName, uint32_t* pPropertyCount,
+    VkExtensionProperties* pProperties)
+{
+    countCall("vkEnumerateInstanceExtensionProperties");
+    loadFakeLayer(pLayerName);
+    return enumerate(fakeVulkan.instanceExtensions[pLayerName ? pLayerName : ""], pPropertyCount, pProperties);
+}
+
+/***************PHYSICAL DEVICES***************/
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties(VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties* pProperties)
+{
+    *pProperties = getFakePhysicalDevice(physicalDevice)->properties;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceExtensionProperties(VkPhysicalDevice physicalDevice, const char* pLayerName,
+    uint32_t* pPropertyCount, VkExtensionProperties* pProperties)
+{
+    countCall("vkEnumerateDeviceExtensionProperties");
+    loadFakeLayer(pLayerName);
+    static const std::vector<VkExtensionProperties> noExtensions;
+    return enumerate(pLayerName ? noExtensions : getFakePhysicalDevice(physicalDevice)->extensions, pPropertyCount, pProperties);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceQueueFamilyProperties(VkPhysicalDevice physicalDevice, uint32_t* pQueueFamilyPropertyCount,
+    VkQueueFamilyProperties* pQueueFamilyProperties)
+{
+    const std::vector<VkQueueFamilyProperties>& families = fakeVulkan.queueFamilies;
+    if (pQueueFamilyProperties) {
+        *pQueueFamilyPropertyCount = std::min(*pQueueFamilyPropertyCount, (uint32_t)families.size());
+        std::copy(families.begin(), families.begin() + *pQueueFamilyPropertyCount, pQueueFamilyProperties);
+    } else {
+        *pQueueFamilyPropertyCount = (uint32_t)families.size();
+    }
+}
+
+/***************FENCES AND QUEUES***************/
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateFence(VkDevice device, const VkFenceCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkFence* pFence)
+{
+    countCall("vkCreateFence");
+    FakeFence* fence = new FakeFence();
+    fence->signaled = (pCreateInfo->flags & VK_FENCE_CREATE_SIGNALED_BIT) != 0;
+    *pFence = (VkFence)(uintptr_t)fence;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyFence(VkDevice device, VkFence fence, const VkAllocationCallbacks* pAllocator)
+{
+    countCall("vkDestroyFence");
+    {
+        std::lock_guard<std::mutex> lock(fakeVulkan.fenceMutex);
+        std::vector<VkFence>& fences = fakeVulkan.submittedFences;
+        fences.erase(std::remove(fences.begin(), fences.end(), fence), fences.end());
+    }
+    delete getFakeFence(fence);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetFenceStatus(VkDevice device, VkFence fence)
+{
+    countCall("vkGetFenceStatus");
+    return isFakeFenceSignaled(fence) ? VK_SUCCESS : VK_NOT_READY;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetFences(VkDevice device, uint32_t fenceCount, const VkFence* pFences)
+{
+    countCall("vkResetFences");
+    std::lock_guard<std::mutex> lock(fakeVulkan.fenceMutex);
+    for (uint32_t i = 0; i < fenceCount; i++) {
+        getFakeFence(pFences[i])->signaled = false;
+    }
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitForFences(VkDevice device, uint32_t fenceCount, const VkFence* pFences,
+    VkBool32 waitAll, uint64_t timeout)
+{
+    countCall("vkWaitForFences");
+    std::unique_lock<std::mutex> lock(fakeVulkan.fenceMutex);
+    std::function<bool()> done = [&]() {
+        uint32_t signaledCount = 0;
+        for (uint32_t i = 0; i < fenceCount; i++) {
+            signaledCount += getFakeFence(pFences[i])->signaled ? 1 : 0;
+        }
+        return !fakeVulkan.holdWaiters && (waitAll ? signaledCount == fenceCount : signaledCount > 0);
+    };
+    if (timeout == UINT64_MAX) {
+        fakeVulkan.fenceSignaled.wait(lock, done);
+        return VK_SUCCESS;
+    }
+    return fakeVulkan.fenceSignaled.wait_for(lock, std::chrono::nanoseconds(timeout), done) ? VK_SUCCESS : VK_TIMEOUT;
+}
+
+// Timeline semaphores are never waited on for real, the fake queues complete nothing on their own.
+static VKAPI_ATTR VkResult VKAPI_CALL fakeWaitSemaphores(VkDevice device, const VkSemaphoreWaitInfo* pWaitInfo, uint64_t timeout)
+{
+    countCall("vkWaitSemaphoresKHR");
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(VkDevice device, const char* pName)
+{
+    if (!strcmp(pName, "vkWaitSemaphoresKHR")) {
+        return (PFN_vkVoidFunction)fakeWaitSemaphores;
+    }
+    return NULL;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSemaphore(VkDevice device, const VkSemaphoreCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkSemaphore* pSemaphore)
+{
+    countCall("vkCreateSemaphore");
+    *pSemaphore = makeFakeHandle<VkSemaphore>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySemaphore(VkDevice device, VkSemaphore semaphore, const VkAllocationCallbacks* pAllocator)
+{
+    countCall("vkDestroySemaphore");
+    fakeVulkan.destroyedObjects.push_back((uint64_t)semaphore);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence)
+{
+    countCall("vkQueueSubmit");
+    std::lock_guard<std::mutex> lock(fakeVulkan.fenceMutex);
+    if (fakeVulkan.submitResult != VK_SUCCESS) {
+        return fakeVulkan.submitResult;
+    }
+    for (uint32_t i = 0; i < submitCount; i++) {
+        fakeVulkan.submittedCmdBuffers.insert(fakeVulkan.submittedCmdBuffers.end(),
+            pSubmits[i].pCommandBuffers, pSubmits[i].pCommandBuffers + pSubmits[i].commandBufferCount);
+    }
+    if (fence != VK_NULL_HANDLE) {
+        // A recycled fence stands for its latest submission only.
+        std::vector<VkFence>& fences = fakeVulkan.submittedFences;
+        fences.erase(std::remove(fences.begin(), fences.end(), fence), fences.end());
+        fences.push_back(fence);
+    }
+    return VK_SUCCESS;
+}
+
+/***************MEMORY AND BUFFERS***************/
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(VkDevice device, const VkMemoryAllocateInfo* pAllocateInfo,
+    const VkAllocationCallbacks* pAllocator, VkDeviceMemory* pMemory)
+{
+    countCall("vkAllocateMemory");
+    FakeMemory* memory = new FakeMemory();
+    memory->size = pAllocateInfo->allocationSize;
+    *pMemory = (VkDeviceMemory)(uintptr_t)memory;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks* pAllocator)
+{
+    countCall("vkFreeMemory");
+    delete (FakeMemory*)(uintptr_t)memory;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size,
+    VkMemoryMapFlags flags, void** ppData)
+{
+    countCall("vkMapMemory");
+    FakeMemory* fakeMemory = (FakeMemory*)(uintptr_t)memory;
+    fakeMemory->data.resize((size_t)fakeMemory->size);
+    *ppData = fakeMemory->data.data() + offset;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUnmapMemory(VkDevice device, VkDeviceMemory memory)
+{
+    countCall("vkUnmapMemory");
+}
+
+// Buffers need 256 byte alignment and may use any memory type.
+VKAPI_ATTR VkResult VKAPI_CALL vkInvalidateMappedMemoryRanges(VkDevice device, uint32_t memoryRangeCount,
+    const VkMappedMemoryRange* pMemoryRanges)
+{
+    countCall("vkInvalidateMappedMemoryRanges");
+    fakeVulkan.invalidatedRanges.insert(fakeVulkan.invalidatedRanges.end(), pMemoryRanges, pMemoryRanges + memoryRangeCount);
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyImageView(VkDevice device, VkImageView imageView, const VkAllocationCallbacks* pAllocator)
+{
+    countCall("vkDestroyImageView");
+    fakeVulkan.destroyedObjects.push_back((uint64_t)imageView);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateBuffer(VkDevice device, const VkBufferCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkBuffer* pBuffer)
+{
+    countCall("vkCreateBuffer");
+    *pBuffer = (VkBuffer)(uintptr_t)new VkDeviceSize(pCreateInfo->size);
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyBuffer(VkDevice device, VkBuffer buffer, const VkAllocationCallbacks* pAllocator)
+{
+    countCall("vkDestroyBuffer");
+    delete (VkDeviceSize*)(uintptr_t)buffer;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements(VkDevice device, VkBuffer buffer, VkMemoryRequirements* pMemoryRequirements)
+{
+    pMemoryRequirements->size = *(VkDeviceSize*)(uintptr_t)buffer;
+    pMemoryRequirements->alignment = 256;
+    pMemoryRequirements->memoryTypeBits = ~0u;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice device, VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize memoryOffset)
+{
+    countCall("vkBindBufferMemory");
+    return VK_SUCCESS;
+}
+
+/***************DESCRIPTORS***************/
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorSetLayout(VkDevice device, const VkDescriptorSetLayoutCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkDescriptorSetLayout* pSetLayout)
+{
+    countCall("vkCreateDescriptorSetLayout");
+    *pSetLayout = makeFakeHandle<VkDescriptorSetLayout>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorSetLayout(VkDevice device, VkDescriptorSetLayout descriptorSetLayout,
+    const VkAllocationCallbacks* pAllocator)
+{
+    countCall("vkDestroyDescriptorSetLayout");
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorPool(VkDevice device, const VkDescriptorPoolCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkDescriptorPool* pDescriptorPool)
+{
+    countCall("vkCreateDescriptorPool");
+    FakeDescriptorPool* pool = new FakeDescriptorPool();
+    pool->maxSets = pCreateInfo->maxSets;
+    pool->allocatedSets = 0;
+    *pDescriptorPool = (VkDescriptorPool)(uintptr_t)pool;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorPool(VkDevice device, VkDescriptorPool descriptorPool, const VkAllocationCallbacks* pAllocator)
+{
+    countCall("vkDestroyDescriptorPool");
+    delete getFakeDescriptorPool(descriptorPool);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetDescriptorPool(VkDevice device, VkDescriptorPool descriptorPool, VkDescriptorPoolResetFlags flags)
+{
+    countCall("vkResetDescriptorPool");
+    getFakeDescriptorPool(descriptorPool)->allocatedSets = 0;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateDescriptorSets(VkDevice device, const VkDescriptorSetAllocateInfo* pAllocateInfo,
+    VkDescriptorSet* pDescriptorSets)
+{
+    countCall("vkAllocateDescriptorSets");
+    FakeDescriptorPool* pool = getFakeDescriptorPool(pAllocateInfo->descriptorPool);
+    if (pool->allocatedSets + pAllocateInfo->descriptorSetCount > pool->maxSets) {
+        return VK_ERROR_OUT_OF_POOL_MEMORY;
+    }
+    pool->allocatedSets += pAllocateInfo->descriptorSetCount;
+    for (uint32_t i = 0; i < pAllocateInfo->descriptorSetCount; i++) {
+        pDescriptorSets[i] = makeFakeHandle<VkDescriptorSet>();
+        fakeVulkan.descriptorSetPools[pDescriptorSets[i]] = pAllocateInfo->descriptorPool;
+    }
+    return VK_SUCCESS;
+}
+
+/***************QUERIES***************/
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateQueryPool(VkDevice device, const VkQueryPoolCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkQueryPool* pQueryPool)
+{
+    countCall("vkCreateQueryPool");
+    *pQueryPool = makeFakeHandle<VkQueryPool>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyQueryPool(VkDevice device, VkQueryPool queryPool, const VkAllocationCallbacks* pAllocator)
+{
+    countCall("vkDestroyQueryPool");
+}
+
+// Timestamps one microsecond (1000 ticks) apart, in query order.
+VKAPI_ATTR VkResult VKAPI_CALL vkGetQueryPoolResults(VkDevice device, VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount,
+    size_t dataSize, void* pData, VkDeviceSize stride, VkQueryResultFlags flags)
+{
+    countCall("vkGetQueryPoolResults");
+    assert(flags & VK_QUERY_RESULT_64_BIT);
+    for (uint32_t i = 0; i < queryCount; i++) {
+        *(uint64_t*)((char*)pData + i * stride) = (firstQuery + i) * 1000ull;
+    }
+    return VK_SUCCESS;
+}
+
+/***************PIPELINES***************/
+// The cache data is a version one header for a device with vendor 0x1234, device 0x5678 and a
+// zero UUID, followed by one byte per pipeline compiled through the cache.
+VKAPI_ATTR VkResult VKAPI_CALL vkCreatePipelineCache(VkDevice device, const VkPipelineCacheCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkPipelineCache* pPipelineCache)
+{
+    countCall("vkCreatePipelineCache");
+    std::vector<uint8_t>* cacheData = new std::vector<uint8_t>(16 + VK_UUID_SIZE, 0);
+    const uint32_t header[4] = { 16 + VK_UUID_SIZE, VK_PIPELINE_CACHE_HEADER_VERSION_ONE, 0x1234, 0x5678 };
+    memcpy(cacheData->data(), header, sizeof(header));
+    if (pCreateInfo->initialDataSize > cacheData->size()) {
+        const uint8_t* initialData = (const uint8_t*)pCreateInfo->pInitialData;
+        cacheData->insert(cacheData->end(), initialData + cacheData->size(), initialData + pCreateInfo->initialDataSize);
+    }
+    *pPipelineCache = (VkPipelineCache)(uintptr_t)cacheData;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipelineCache(VkDevice device, VkPipelineCache pipelineCache, const VkAllocationCallbacks* pAllocator)
+{
+    countCall("vkDestroyPipelineCache");
+    delete (std::vector<uint8_t>*)(uintptr_t)pipelineCache;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPipelineCacheData(VkDevice device, VkPipelineCache pipelineCache, size_t* pDataSize, void* pData)
+{
+    const std::vector<uint8_t>& cacheData = *(std::vector<uint8_t>*)(uintptr_t)pipelineCache;
+    if (pData) {
+        *pDataSize = std::min(*pDataSize, cacheData.size());
+        memcpy(pData, cacheData.data(), *pDataSize);
+    } else {
+        *pDataSize = cacheData.size();
+    }
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateGraphicsPipelines(VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount,
+    const VkGraphicsPipelineCreateInfo* pCreateInfos, const VkAllocationCallbacks* pAllocator, VkPipeline* pPipelines)
+{
+    countCall("vkCreateGraphicsPipelines");
+    for (uint32_t i = 0; i < createInfoCount; i++) {
+        pPipelines[i] = makeFakeHandle<VkPipeline>();
+        ((std::vector<uint8_t>*)(uintptr_t)pipelineCache)->push_back(1);
+    }
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateComputePipelines(VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount,
+    const VkComputePipelineCreateInfo* pCreateInfos, const VkAllocationCallbacks* pAllocator, VkPipeline* pPipelines)
+{
+    countCall("vkCreateComputePipelines");
+    for (uint32_t i = 0; i < createInfoCount; i++) {
+        pPipelines[i] = makeFakeHandle<VkPipeline>();
+        ((std::vector<uint8_t>*)(uintptr_t)pipelineCache)->push_back(1);
+    }
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipeline(VkDevice device, VkPipeline pipeline, const VkAllocationCallbacks* pAllocator)
+{
+    countCall("vkDestroyPipeline");
+}
+
+/***************COMMAND POOLS AND BUFFERS***************/
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateCommandPool(VkDevice device, const VkCommandPoolCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkCommandPool* pCommandPool)
+{
+    countCall("vkCreateCommandPool");
+    *pCommandPool = (VkCommandPool)(uintptr_t)new FakeCommandPool();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyCommandPool(VkDevice device, VkCommandPool commandPool, const VkAllocationCallbacks* pAllocator)
+{
+    countCall("vkDestroyCommandPool");
+    FakeCommandPool* pool = (FakeCommandPool*)(uintptr_t)commandPool;
+    if (!pool) {
+        return;
+    }
+    for (FakeCommandBuffer* cmdBuffer : pool->cmdBuffers) {
+        delete cmdBuffer;
+    }
+    delete pool;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandPool(VkDevice device, VkCommandPool commandPool, VkCommandPoolResetFlags flags)
+{
+    countCall("vkResetCommandPool");
+    FakeCommandPool* pool = (FakeCommandPool*)(uintptr_t)commandPool;
+    for (FakeCommandBuffer* cmdBuffer : pool->cmdBuffers) {
+        cmdBuffer->recording = false;
+        cmdBuffer->commands.clear();
+        cmdBuffer->barriers.clear();
+    }
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(VkDevice device, const VkCommandBufferAllocateInfo* pAllocateInfo,
+    VkCommandBuffer* pCommandBuffers)
+{
+    countCall("vkAllocateCommandBuffers");
+    FakeCommandPool* pool = (FakeCommandPool*)(uintptr_t)pAllocateInfo->commandPool;
+    for (uint32_t i = 0; i < pAllocateInfo->commandBufferCount; i++) {
+        FakeCommandBuffer* cmdBuffer = new FakeCommandBuffer();
+        cmdBuffer->cmdPool = pAllocateInfo->commandPool;
+        cmdBuffer->level = pAllocateInfo->level;
+        cmdBuffer->recording = false;
+        pool->cmdBuffers.push_back(cmdBuffer);
+        pCommandBuffers[i] = (VkCommandBuffer)cmdBuffer;
+    }
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandBuffer(VkCommandBuffer commandBuffer, VkCommandBufferResetFlags flags)
+{
+    FakeCommandBuffer* cmdBuffer = getFakeCommandBuffer(commandBuffer);
+    cmdBuffer->recording = false;
+    cmdBuffer->commands.clear();
+    cmdBuffer->barriers.clear();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBeginCommandBuffer(VkCommandBuffer commandBuffer, const VkCommandBufferBeginInfo* pBeginInfo)
+{
+    FakeCommandBuffer* cmdBuffer = getFakeCommandBuffer(commandBuffer);
+    cmdBuffer->recording = true;
+    cmdBuffer->commands.clear();
+    cmdBuffer->barriers.clear();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEndCommandBuffer(VkCommandBuffer commandBuffer)
+{
+    FakeCommandBuffer* cmdBuffer = getFakeCommandBuffer(commandBuffer);
+    assert(cmdBuffer->recording);
+    cmdBuffer->recording = false;
+    return VK_SUCCESS;
+}
+
+/***************COMMANDS***************/
+VKAPI_ATTR void VKAPI_CALL vkCmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount,
+    uint32_t firstVertex, uint32_t firstInstance)
+{
+    recordCommand(commandBuffer, "vkCmdDraw", vertexCount, instanceCount, firstVertex, firstInstance);
+}
+
+// One command per region: source offset, destination offset and size.
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer,
+    uint32_t regionCount, const VkBufferCopy* pRegions)
+{
+    for (uint32_t i = 0; i < regionCount; i++) {
+        recordCommand(commandBuffer, "vkCmdCopyBuffer", (uint64_t)(uintptr_t)dstBuffer, pRegions[i].srcOffset, pRegions[i].dstOffset, pRegions[i].size);
+    }
+}
+
+// One command per region: image, buffer, buffer offset.
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyImageToBuffer(VkCommandBuffer commandBuffer, VkImage srcImage, VkImageLayout srcImageLayout,
+    VkBuffer dstBuffer, uint32_t regionCount, const VkBufferImageCopy* pRegions)
+{
+    for (uint32_t i = 0; i < regionCount; i++) {
+        recordCommand(commandBuffer, "vkCmdCopyImageToBuffer", (uint64_t)srcImage, (uint64_t)dstBuffer, pRegions[i].bufferOffset);
+    }
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask,
+    VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlags, uint32_t memoryBarrierCount,
+    const VkMemoryBarrier* pMemoryBarriers, uint32_t bufferMemoryBarrierCount, const VkBufferMemoryBarrier* pBufferMemoryBarriers,
+    uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier* pImageMemoryBarriers)
+{
+    recordCommand(commandBuffer, "vkCmdPipelineBarrier", srcStageMask, dstStageMask, memoryBarrierCount,
+        bufferMemoryBarrierCount + imageMemoryBarrierCount);
+
+    FakePipelineBarrier barrier;
+    barrier.srcStageMask = srcStageMask;
+    barrier.dstStageMask = dstStageMask;
+    barrier.memoryBarriers.assign(pMemoryBarriers, pMemoryBarriers + memoryBarrierCount);
+    barrier.bufferBarriers.assign(pBufferMemoryBarriers, pBufferMemoryBarriers + bufferMemoryBarrierCount);
+    barrier.imageBarriers.assign(pImageMemoryBarriers, pImageMemoryBarriers + imageMemoryBarrierCount);
+    getFakeCommandBuffer(commandBuffer)->barriers.push_back(barrier);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdResetQueryPool(VkCommandBuffer commandBuffer, VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount)
+{
+    recordCommand(commandBuffer, "vkCmdResetQueryPool", (uint64_t)queryPool, firstQuery, queryCount);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdWriteTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits pipelineStage,
+    VkQueryPool queryPool, uint32_t query)
+{
+    recordCommand(commandBuffer, "vkCmdWriteTimestamp", pipelineStage, (uint64_t)queryPool, query);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdExecuteCommands(VkCommandBuffer commandBuffer, uint32_t commandBufferCount,
+    const VkCommandBuffer* pCommandBuffers)
+{
+    for (uint32_t i = 0; i < commandBufferCount; i++) {
+        recordCommand(commandBuffer, "vkCmdExecuteCommands", (uint64_t)(uintptr_t)pCommandBuffers[i]);
+    }
+}
@@ -0,0 +1,134 @@
+// In-process stand-in for the Vulkan entry points the tested classes call. FakeVulkan.cpp defines
+// them in engineTests itself, which the linker prefers over the loader, so the tests run without
+// an ICD. Entry points not defined there go to the loader and must not be reached by a test.
+//
+// Handles are unique counters, or pointers to the fake objects below where the tests look
+// inside. Commands are recorded into the command buffer as FakeCommand entries.
+
+#pragma once
+
+#include "Headers.h"
+#include <map>
+#include <string>
+#include <atomic>
+#include <condition_variable>
+
+struct FakeCommand {
+    const char* name; // Entry point that recorded it, e.g. "vkCmdDraw".
+    uint64_t args[4];
+};
+
+// Contents of a vkCmdPipelineBarrier command.
+struct FakePipelineBarrier {
+    VkPipelineStageFlags srcStageMask;
+    VkPipelineStageFlags dstStageMask;
+    std::vector<VkMemoryBarrier> memoryBarriers;
+    std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+};
+
+struct FakeCommandBuffer {
+    VkCommandPool cmdPool;
+    VkCommandBufferLevel level;
+    bool recording;
+    std::vector<FakeCommand> commands; // Since the last begin or reset.
+    std::vector<FakePipelineBarrier> barriers; // Same, in the order of their vkCmdPipelineBarrier commands.
+};
+
+// The fake GPU never finishes anything on its own, a test signals the fences it wants completed.
+struct FakeFence {
+    bool signaled;
+};
+
+// Host memory behind the fake device memory, allocated on first map.
+struct FakeMemory {
+    VkDeviceSize size;
+    std::vector<char> data;
+};
+
+// Physical device handles of makeFakePhysicalDevice() point to these.
+struct FakePhysicalDevice {
+    VkPhysicalDeviceProperties properties;
+    std::vector<VkExtensionProperties> extensions; // Of the driver, layers have none.
+};
+
+// vkAllocateDescriptorSets fails with VK_ERROR_OUT_OF_POOL_MEMORY past 'maxSets'.
+struct FakeDescriptorPool {
+    uint32_t maxSets;
+    uint32_t allocatedSets; // Since creation or the last reset.
+};
+
+struct FakeVulkanState {
+    std::atomic<uint64_t> nextHandle;
+    std::mutex callMutex;
+    std::map<std::string, uint64_t> calls; // Entry points other than vkCmd*, by name.
+
+    std::vector<VkQueueFamilyProperties> queueFamilies; // Of every physical device.
+    std::vector<VkLayerProperties> instanceLayers;
+    std::map<std::string, std::vector<VkExtensionProperties> > instanceExtensions; // By layer, "" for the implementation.
+    uint32_t layerQueryMicroseconds; // Slept by extension queries naming a layer, as loading its library takes.
+
+    std::mutex fenceMutex;
+    std::condition_variable fenceSignaled;
+    std::vector<VkFence> submittedFences; // Passed to vkQueueSubmit and not destroyed, in submission order.
+    std::vector<VkCommandBuffer> submittedCmdBuffers; // Same, for the command buffers.
+    bool holdWaiters; // vkWaitForFences does not return while set, even with its fences signaled.
+    VkResult submitResult; // Returned by vkQueueSubmit, which submits nothing unless it is VK_SUCCESS.
+
+    std::vector<VkMappedMemoryRange> invalidatedRanges; // Passed to vkInvalidateMappedMemoryRanges, in call order.
+    std::vector<uint64_t> destroyedObjects; // Semaphores and image views, in destruction order.
+    std::map<VkDescriptorSet, VkDescriptorPool> descriptorSetPools; // Pool each set was allocated from.
+
+    bool debugUtils; // vkGetInstanceProcAddr returns the VK_EXT_debug_utils entry points.
+    std::map<uint64_t, std::string> objectNames; // Set with vkSetDebugUtilsObjectNameEXT, by handle.
+    std::vector<std::string> labels; // Begun on command buffers and queues, in call order.
+};
+
+extern FakeVulkanState fakeVulkan;
+
+// Called before every test and benchmark.
+void resetFakeVulkan();
+
+// Number of calls to 'entryPoint' since the last reset.
+uint64_t fakeCallCount(const char* entryPoint);
+
+FakeCommandBuffer* getFakeCommandBuffer(VkCommandBuffer cmdBuffer);
+FakeDescriptorPool* getFakeDescriptorPool(VkDescriptorPool pool);
+
+// Name given to 'handle' with vkSetDebugUtilsObjectNameEXT, empty if none.
+template <typename T>
+std::string getFakeObjectName(T handle)
+{
+    std::lock_guard<std::mutex> lock(fakeVulkan.callMutex);
+    std::map<uint64_t, std::string>::const_iterator it = fakeVulkan.objectNames.find((uint64_t)(uintptr_t)handle);
+    return it == fakeVulkan.objectNames.end() ? std::string() : it->second;
+}
+
+// Completes the fake GPU work behind 'fence', waking vkWaitForFences callers.
+void signalFakeFence(VkFence fence);
+bool isFakeFenceSignaled(VkFence fence);
+
+// Keeps vkWaitForFences callers blocked until released, to look at the state they wait in.
+void holdFakeWaiters(bool hold);
+
+// Signals the fences of the oldest 'count' submissions not signaled yet, all of them by default.
+void completeFakeSubmissions(size_t count = SIZE_MAX);
+
+// Instance or device extension list with spec version 1.
+std::vector<VkExtensionProperties> makeFakeExtensions(const std::vector<const char*>& names);
+
+// Owned by the fake state until the next reset.
+VkPhysicalDevice makeFakePhysicalDevice(uint32_t vendorID, uint32_t deviceID, uint32_t driverVersion,
+    const std::vector<const char*>& extensionNames);
+FakePhysicalDevice* getFakePhysicalDevice(VkPhysicalDevice gpu);
+
+// A non-dispatchable handle nothing else has.
+template <typename T>
+T makeFakeHandle()
+{
+    return (T)(uintptr_t)++fakeVulkan.nextHandle;
+}
+
+// Dummy dispatchable handles for the objects a test never looks into.
+inline VkDevice getFakeDevice() { return (VkDevice)(uintptr_t)0x1000; }
+inline VkQueue getFakeQueue(uint32_t index = 0) { return (VkQueue)(uintptr_t)(0x2000 + index * 8); }
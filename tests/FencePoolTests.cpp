@@ -0,0 +1,156 @@
+#include "TestFramework.h"
+#include "FakeVulkan.h"
+#include "FencePool.h"
+#include "CommandBufferManager.h"
+#include <thread>
+
+static SubmitToken submitEmpty(FencePool& fencePool)
+{
+    return CommandBufferMgr::submitCommandBufferAsync(getFakeQueue(), fencePool, NULL, 0);
+}
+
+// Polls until another thread has entered vkWaitForFences 'count' times in total.
+static bool waitForWaiters(uint64_t count)
+{
+    for (uint32_t i = 0; i < 2000 && fakeCallCount("vkWaitForFences") < count; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return fakeCallCount("vkWaitForFences") >= count;
+}
+
+TEST_CASE(fencesRetireInSubmissionOrder)
+{
+    FencePool fencePool;
+    fencePool.createFencePool(getFakeDevice(), 2);
+
+    SubmitToken tokens[3];
+    for (uint32_t i = 0; i < 3; i++) {
+        tokens[i] = submitEmpty(fencePool);
+        CHECK(tokens[i].serial == i + 1);
+    }
+    CHECK(fakeCallCount("vkQueueSubmit") == 3);
+    CHECK(!fencePool.isComplete(tokens[0]));
+    CHECK(fencePool.isComplete(SubmitToken()));
+
+    // The second one finishing first is seen, but it does not retire before the first.
+    signalFakeFence(fakeVulkan.submittedFences[1]);
+    CHECK(fencePool.isComplete(tokens[1]));
+    CHECK(!fencePool.isComplete(tokens[0]));
+    CHECK(fencePool.retireCompleted() == 0);
+
+    completeFakeSubmissions(1);
+    CHECK(fencePool.retireCompleted() == 2);
+    CHECK(!fencePool.isComplete(tokens[2]));
+    completeFakeSubmissions();
+    CHECK(fencePool.wait(tokens[2]) == VK_SUCCESS);
+    CHECK(fencePool.lastCompletedSerial() == 3);
+
+    // Retired fences are reset and reused, the pool does not grow.
+    uint64_t created = fakeCallCount("vkCreateFence");
+    CHECK(created == 3);
+    for (uint32_t i = 0; i < 3; i++) {
+        submitEmpty(fencePool);
+    }
+    CHECK(fakeCallCount("vkCreateFence") == created);
+    CHECK(fencePool.lastSubmittedSerial() == 6);
+
+    completeFakeSubmissions();
+    fencePool.destroyFencePool();
+    CHECK(fakeCallCount("vkDestroyFence") == created);
+}
+
+TEST_CASE(waitTimesOut)
+{
+    FencePool fencePool;
+    fencePool.createFencePool(getFakeDevice());
+
+    SubmitToken token = submitEmpty(fencePool);
+    CHECK(fencePool.wait(token, 1000) == VK_TIMEOUT);
+    CHECK(!fencePool.isComplete(token));
+
+    completeFakeSubmissions();
+    CHECK(fencePool.wait(token, 1000) == VK_SUCCESS);
+    fencePool.destroyFencePool();
+}
+
+// A thread blocked in wait() must not keep the others from submitting or polling.
+TEST_CASE(waitDoesNotBlockOtherThreads)
+{
+    FencePool fencePool;
+    fencePool.createFencePool(getFakeDevice());
+
+    SubmitToken token = submitEmpty(fencePool);
+    VkFence waitedFence = fakeVulkan.submittedFences[0];
+    VkResult waitResult = VK_NOT_READY;
+    std::thread waiter([&]() { waitResult = fencePool.wait(token); });
+    CHECK(waitForWaiters(1));
+
+    // These return while the fence is still unsignaled.
+    SubmitToken other = submitEmpty(fencePool);
+    CHECK(!fencePool.isComplete(token));
+    CHECK(!fencePool.isComplete(other));
+    CHECK(fencePool.lastSubmittedSerial() == 2);
+    CHECK(!isFakeFenceSignaled(waitedFence));
+
+    completeFakeSubmissions();
+    waiter.join();
+    CHECK(waitResult == VK_SUCCESS);
+    CHECK(fencePool.retireCompleted() == 2);
+    fencePool.destroyFencePool();
+}
+
+// A fence that signaled while a thread still waits on it stays in flight until that thread is back.
+TEST_CASE(waitedFenceIsNotRecycled)
+{
+    FencePool fencePool;
+    fencePool.createFencePool(getFakeDevice(), 1);
+
+    SubmitToken token = submitEmpty(fencePool);
+    VkFence waitedFence = fakeVulkan.submittedFences[0];
+    holdFakeWaiters(true);
+    std::thread waiter([&]() { fencePool.wait(token); });
+    CHECK(waitForWaiters(1));
+
+    signalFakeFence(waitedFence);
+    CHECK(fencePool.isComplete(token));
+    CHECK(fencePool.retireCompleted() == 0);
+    submitEmpty(fencePool);
+    CHECK(fakeVulkan.submittedFences.back() != waitedFence);
+
+    holdFakeWaiters(false);
+    waiter.join();
+    CHECK(fencePool.lastCompletedSerial() == 1);
+
+    completeFakeSubmissions();
+    fencePool.destroyFencePool();
+}
+
+// A failed submit hands its fence back unsignaled, nothing waits on it or behind it.
+TEST_CASE(failedSubmitReleasesItsFence)
+{
+    FencePool fencePool;
+    fencePool.createFencePool(getFakeDevice(), 1);
+
+    SubmitToken first = submitEmpty(fencePool);
+    fakeVulkan.submitResult = VK_ERROR_DEVICE_LOST;
+    SubmitToken failed = submitEmpty(fencePool);
+    CHECK(failed.serial == 0);
+    CHECK(fencePool.wait(failed) == VK_SUCCESS);
+
+    fakeVulkan.submitResult = VK_SUCCESS;
+    SubmitToken last = submitEmpty(fencePool);
+    CHECK(last.serial == 3);
+    completeFakeSubmissions();
+    CHECK(fencePool.wait(last) == VK_SUCCESS);
+    CHECK(fencePool.isComplete(first));
+    CHECK(fencePool.retireCompleted() == 3);
+
+    // The released fence was not reset, it goes back to the pool as it is.
+    CHECK(fakeCallCount("vkResetFences") == 2);
+    submitEmpty(fencePool);
+    CHECK(fakeCallCount("vkCreateFence") == 3);
+
+    completeFakeSubmissions();
+    fencePool.destroyFencePool();
+    CHECK(fakeCallCount("vkDestroyFence") == 3);
+}
@@ -0,0 +1,37 @@
+#include "TestFramework.h"
+#include "FakeVulkan.h"
+#include "FrameScheduler.h"
+#include "VulkanDevice.h"
+
+TEST_CASE(failedFrameSubmitIsNotWaitedOn)
+{
+    VulkanDevice deviceObj(NULL);
+    deviceObj.device = getFakeDevice();
+    deviceObj.queue = getFakeQueue(0);
+
+    // One slot, so the next beginFrame() comes straight back to the failed frame's slot.
+    FrameScheduler scheduler;
+    scheduler.createFrameSlots(&deviceObj, 1);
+
+    FrameSlot* slot = scheduler.beginFrame();
+    fakeVulkan.submitResult = VK_ERROR_DEVICE_LOST;
+    scheduler.endFrame(slot);
+    fakeVulkan.submitResult = VK_SUCCESS;
+    CHECK(!slot->submitted);
+    CHECK(scheduler.getStats().failedCalls == 1);
+    CHECK(scheduler.getStats().lastFailure == VK_ERROR_DEVICE_LOST);
+    CHECK(scheduler.getStats().framesSubmitted == 0);
+    CHECK(scheduler.getRetiredFrameCount() == 1);
+
+    // Its fence was reset and never signaled, waiting on it would block forever.
+    uint64_t waits = fakeCallCount("vkWaitForFences");
+    slot = scheduler.beginFrame();
+    CHECK(fakeCallCount("vkWaitForFences") == waits);
+    scheduler.endFrame(slot);
+    CHECK(slot->submitted);
+    CHECK(scheduler.getStats().framesSubmitted == 1);
+
+    completeFakeSubmissions();
+    scheduler.destroyFrameSlots();
+    CHECK(scheduler.getStats().framesCompleted == 1);
+}
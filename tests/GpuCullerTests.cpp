@@ -0,0 +1,85 @@
+#include "TestFramework.h"
+#include "GpuCuller.h"
+#include <cmath>
+
+static void project(const float rows[4][4], const float point[3], float clip[4])
+{
+    for (uint32_t i = 0; i < 4; i++) {
+        clip[i] = rows[i][0] * point[0] + rows[i][1] * point[1] + rows[i][2] * point[2] + rows[i][3];
+    }
+}
+
+static CullObject makeObject(float x, float y, float z, float radius, uint32_t drawIndex)
+{
+    CullObject object = {};
+    object.center[0] = x;
+    object.center[1] = y;
+    object.center[2] = z;
+    object.radius = radius;
+    object.drawIndex = drawIndex;
+    return object;
+}
+
+// The CPU culling agrees with the camera's projection: what it keeps lands on screen.
+TEST_CASE(gpuCullerCullsOnCpuAgainstTheFrustum)
+{
+    const float farDistance = 100.0f;
+    float planes[6][4];
+    float rows[4][4];
+    GpuCuller::cameraFrustum(0.0f, 2.0f, farDistance, planes);
+    GpuCuller::cameraViewProjection(0.0f, 2.0f, farDistance, rows);
+
+    std::vector<CullDraw> draws(2);
+    draws[0] = { 36, 0, 0, 0 };
+    draws[1] = { 72, 36, 0, 0 };
+
+    // The camera looks along +Z, the field of view is 60 degrees high and 2 times as wide.
+    std::vector<CullObject> objects;
+    objects.push_back(makeObject(0.0f, 0.0f, 10.0f, 1.0f, 1)); // In front.
+    objects.push_back(makeObject(0.0f, 0.0f, -10.0f, 1.0f, 0)); // Behind.
+    objects.push_back(makeObject(0.0f, 10.0f, 10.0f, 1.0f, 0)); // Above.
+    objects.push_back(makeObject(10.0f, 0.0f, 10.0f, 1.0f, 0)); // Inside the wide side.
+    objects.push_back(makeObject(0.0f, 0.0f, farDistance + 0.5f, 1.0f, 1)); // Past the far plane, touching it.
+    objects.push_back(makeObject(0.0f, 0.0f, farDistance + 2.0f, 1.0f, 0)); // Past the far plane.
+
+    std::vector<VkDrawIndexedIndirectCommand> commands;
+    CHECK(GpuCuller::cullOnCpu(draws, objects, planes, commands) == 3);
+    CHECK(commands.size() == 3);
+    CHECK(commands[0].firstInstance == 0 && commands[1].firstInstance == 3 && commands[2].firstInstance == 4);
+    CHECK(commands[0].indexCount == 72 && commands[0].firstIndex == 36 && commands[0].instanceCount == 1);
+
+    for (const VkDrawIndexedIndirectCommand& command : commands) {
+        float clip[4];
+        project(rows, objects[command.firstInstance].center, clip);
+        bool onScreen = clip[3] > 0.0f && std::fabs(clip[0]) <= clip[3] && std::fabs(clip[1]) <= clip[3];
+        CHECK(onScreen || command.firstInstance == 4);
+    }
+
+    // Clip space Y points down, depth runs from 0 at the near plane to 1 at the far one.
+    float above[3] = { 0.0f, 1.0f, 10.0f };
+    float clip[4];
+    project(rows, above, clip);
+    CHECK(clip[1] < 0.0f);
+    float onFarPlane[3] = { 0.0f, 0.0f, farDistance };
+    project(rows, onFarPlane, clip);
+    CHECK(std::fabs(clip[2] / clip[3] - 1.0f) < 1e-4f);
+}
+
+TEST_CASE(gpuCullerBuildsTheTestScene)
+{
+    std::vector<CullDraw> draws;
+    std::vector<CullObject> objects;
+    GpuCuller::buildTestScene(1000, draws, objects);
+    CHECK(draws.size() == 8 && objects.size() == 1000);
+    CHECK(draws[7].firstIndex == 36 * 127 && draws[7].indexCount == 36 << 7);
+
+    float extent = GpuCuller::testSceneExtent(1000);
+    bool inside = true;
+    for (const CullObject& object : objects) {
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            inside = inside && std::fabs(object.center[axis]) <= extent;
+        }
+        inside = inside && object.radius >= 0.25f && object.drawIndex < 8;
+    }
+    CHECK(inside);
+}
@@ -0,0 +1,219 @@
+#include "TestFramework.h"
+#include "FakeVulkan.h"
+#include "MemoryAllocator.h"
+#include "VulkanDevice.h"
+
+static const VkDeviceSize MB = 1024 * 1024;
+
+// A device with one device local memory type on a heap of 'heapSize'.
+static void setUpDevice(VulkanDevice& deviceObj, VkDeviceSize heapSize)
+{
+    deviceObj.device = getFakeDevice();
+    deviceObj.gpuProps = VkPhysicalDeviceProperties();
+    deviceObj.gpuProps.limits.bufferImageGranularity = 1024;
+    deviceObj.memoryProperties = VkPhysicalDeviceMemoryProperties();
+    deviceObj.memoryProperties.memoryTypeCount = 1;
+    deviceObj.memoryProperties.memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    deviceObj.memoryProperties.memoryTypes[0].heapIndex = 0;
+    deviceObj.memoryProperties.memoryHeapCount = 1;
+    deviceObj.memoryProperties.memoryHeaps[0].size = heapSize;
+}
+
+static VkMemoryRequirements requirements(VkDeviceSize size, VkDeviceSize alignment)
+{
+    VkMemoryRequirements memRqrmnt = {};
+    memRqrmnt.size = size;
+    memRqrmnt.alignment = alignment;
+    memRqrmnt.memoryTypeBits = 1;
+    return memRqrmnt;
+}
+
+TEST_CASE(linearSubAllocatorRewindsWhenEmpty)
+{
+    LinearSubAllocator linear(4096, 1024);
+    VkDeviceSize offsets[3];
+    CHECK(linear.allocate(100, 1, true, &offsets[0]) && offsets[0] == 0);
+    CHECK(linear.allocate(100, 256, true, &offsets[1]) && offsets[1] == 256);
+
+    // An optimal resource after a linear one starts on the next granularity page.
+    CHECK(linear.allocate(100, 1, false, &offsets[2]) && offsets[2] == 1024);
+    VkDeviceSize offset;
+    CHECK(!linear.allocate(4096, 1, false, &offset));
+
+    // Freed ranges come back only once the block is empty.
+    linear.free(offsets[1]);
+    CHECK(linear.getStats().usedBytes == 1124);
+    linear.free(offsets[0]);
+    linear.free(offsets[2]);
+    CHECK(linear.isEmpty() && linear.getStats().usedBytes == 0);
+    CHECK(linear.allocate(4096, 1, false, &offset) && offset == 0);
+}
+
+TEST_CASE(buddySubAllocatorSplitsAndMerges)
+{
+    // The block is cut down to a power of two, nodes are at least a granularity page.
+    BuddySubAllocator buddy(5000, 1024);
+    CHECK(buddy.getSize() == 4096);
+
+    VkDeviceSize a, b, c, offset;
+    CHECK(buddy.allocate(1000, 1, true, &a) && a == 0);
+    CHECK(buddy.allocate(1500, 1, false, &b) && b == 2048);
+    CHECK(buddy.allocate(10, 1, true, &c) && c == 1024);
+    CHECK(buddy.getStats().usedBytes == 4096);
+    CHECK(!buddy.allocate(1, 1, true, &offset));
+
+    // Alignment above the request size picks a larger node.
+    buddy.free(b);
+    CHECK(!buddy.allocate(10, 4096, true, &offset));
+    buddy.free(a);
+    buddy.free(c);
+    CHECK(buddy.getStats().freeRangeCount == 1 && buddy.getStats().largestFreeRange == 4096);
+    CHECK(buddy.allocate(10, 4096, true, &offset) && offset == 0);
+}
+
+TEST_CASE(freeListSubAllocatorBestFitAndCoalescing)
+{
+    FreeListSubAllocator freeList(8192, 1);
+    const VkDeviceSize sizes[5] = { 1000, 500, 1000, 3000, 500 };
+    VkDeviceSize offsets[5];
+    VkDeviceSize expected = 0;
+    for (uint32_t i = 0; i < 5; i++) {
+        CHECK(freeList.allocate(sizes[i], 1, true, &offsets[i]) && offsets[i] == expected);
+        expected += sizes[i];
+    }
+
+    // Best fit: the 500 byte hole is used before the 3000 byte one and the tail.
+    freeList.free(offsets[1]);
+    freeList.free(offsets[3]);
+    CHECK(freeList.getStats().freeRangeCount == 3);
+    VkDeviceSize offset;
+    CHECK(freeList.allocate(400, 1, true, &offset) && offset == offsets[1]);
+    freeList.free(offset);
+
+    // Neighbouring free ranges merge back into one.
+    freeList.free(offsets[0]);
+    freeList.free(offsets[2]);
+    freeList.free(offsets[4]);
+    SubAllocatorStats stats = freeList.getStats();
+    CHECK(stats.freeRangeCount == 1 && stats.largestFreeRange == 8192 && stats.fragmentation() == 0.0);
+}
+
+TEST_CASE(freeListSubAllocatorKeepsGranularity)
+{
+    FreeListSubAllocator freeList(8192, 1024);
+    VkDeviceSize linearOffset, optimalOffset, offset;
+    CHECK(freeList.allocate(100, 1, true, &linearOffset) && linearOffset == 0);
+    CHECK(freeList.allocate(100, 1, false, &optimalOffset) && optimalOffset == 1024);
+    CHECK(freeList.allocate(100, 1, false, &offset) && offset == 1124);
+}
+
+TEST_CASE(memoryAllocatorBlockSizeIsPowerOfTwo)
+{
+    VulkanDevice deviceObj(NULL);
+    setUpDevice(deviceObj, 384 * MB);
+
+    // An eighth of the heap is 48 MB, blocks are 32 MB.
+    MemoryAllocator allocator;
+    allocator.createAllocator(&deviceObj);
+    MemoryAllocation allocation;
+    CHECK(allocator.allocate(requirements(MB, 256), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, ALLOCATION_STRATEGY_BUDDY, &allocation) == VK_SUCCESS);
+    MemoryAllocatorStats stats = allocator.getStats();
+    CHECK(stats.blockCount == 1 && stats.reservedBytes == 32 * MB);
+
+    // Above half a block it gets a block of its own.
+    MemoryAllocation large;
+    CHECK(allocator.allocate(requirements(20 * MB, 256), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, ALLOCATION_STRATEGY_BUDDY, &large) == VK_SUCCESS);
+    CHECK(large.block->dedicated && large.memory != allocation.memory);
+
+    allocator.free(large);
+    allocator.free(allocation);
+    allocator.destroyAllocator();
+    CHECK(fakeCallCount("vkAllocateMemory") == fakeCallCount("vkFreeMemory"));
+}
+
+TEST_CASE(memoryAllocatorReleasesBlockItCannotUse)
+{
+    VulkanDevice deviceObj(NULL);
+    setUpDevice(deviceObj, 1024 * MB);
+
+    MemoryAllocator allocator;
+    allocator.createAllocator(&deviceObj);
+    MemoryAllocation allocation;
+    CHECK(allocator.allocate(requirements(MB, 128 * MB), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true,
+        ALLOCATION_STRATEGY_BUDDY, &allocation) == VK_ERROR_OUT_OF_DEVICE_MEMORY);
+    CHECK(allocator.getStats().blockCount == 0);
+    CHECK(fakeCallCount("vkAllocateMemory") == 1 && fakeCallCount("vkFreeMemory") == 1);
+    CHECK(allocation.block == NULL);
+    allocator.destroyAllocator();
+}
+
+TEST_CASE(memoryAllocatorKeepsOneSpareBlock)
+{
+    VulkanDevice deviceObj(NULL);
+    setUpDevice(deviceObj, 1024 * MB);
+
+    MemoryAllocator allocator;
+    allocator.createAllocator(&deviceObj, 4 * MB);
+    std::vector<MemoryAllocation> allocations(6);
+    for (MemoryAllocation& allocation : allocations) {
+        CHECK(allocator.allocate(requirements(MB + 1, 256), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true,
+            ALLOCATION_STRATEGY_FREE_LIST, &allocation) == VK_SUCCESS);
+    }
+    CHECK(allocator.getStats().blockCount == 2);
+
+    // Empty blocks are released but one, allocating again does not call vkAllocateMemory.
+    for (MemoryAllocation& allocation : allocations) {
+        allocator.free(allocation);
+    }
+    CHECK(allocator.getStats().blockCount == 1);
+    CHECK(allocator.allocate(requirements(MB, 256), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true,
+        ALLOCATION_STRATEGY_FREE_LIST, &allocations[0]) == VK_SUCCESS);
+    CHECK(fakeCallCount("vkAllocateMemory") == 2);
+    allocator.free(allocations[0]);
+    allocator.destroyAllocator();
+}
+
+// Allocations and frees per second of each strategy, on a mix of 256 B to 64 KB requests with
+// a quarter of them live at a time. vkAllocateMemory is faked, only the block bookkeeping counts.
+BENCHMARK_CASE(memoryAllocatorThroughput)
+{
+    const uint32_t operationCount = 1000000;
+    const uint32_t liveCount = 4096;
+    const char* strategyNames[ALLOCATION_STRATEGY_COUNT] = { "free list", "buddy", "linear" };
+
+    VulkanDevice deviceObj(NULL);
+    setUpDevice(deviceObj, 4096 * MB);
+
+    for (uint32_t strategy = 0; strategy < ALLOCATION_STRATEGY_COUNT; strategy++) {
+        MemoryAllocator allocator;
+        allocator.createAllocator(&deviceObj);
+        std::vector<MemoryAllocation> allocations(liveCount);
+        uint32_t seed = 12345;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < operationCount; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            MemoryAllocation& allocation = allocations[(seed >> 8) % liveCount];
+            if (allocation.block) {
+                allocator.free(allocation);
+            } else {
+                VkDeviceSize size = (VkDeviceSize)256 << ((seed >> 4) % 9);
+                VkResult result = allocator.allocate(requirements(size, 256), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true,
+                    (AllocationStrategy)strategy, &allocation);
+                CHECK(result == VK_SUCCESS);
+            }
+        }
+        double ms = elapsedMs(start);
+        MemoryAllocatorStats stats = allocator.getStats();
+
+        for (MemoryAllocation& allocation : allocations) {
+            allocator.free(allocation);
+        }
+        allocator.destroyAllocator();
+
+        char detail[96];
+        snprintf(detail, sizeof(detail), "%u blocks, %.0f%% utilization, %.2f fragmentation", stats.blockCount,
+            stats.utilization * 100.0, stats.fragmentation);
+        reportBenchmark(strategyNames[strategy], operationCount / (ms / 1000.0) / 1e6, "M operations/s", detail);
+    }
+}
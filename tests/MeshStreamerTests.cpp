@@ -0,0 +1,173 @@
+#include "TestFramework.h"
+#include "FakeVulkan.h"
+#include "MeshStreamer.h"
+#include <fstream>
+
+static const char* MESH_PATH = "engineTests_mesh.vkmesh";
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Writes a mesh file of 'lodCount' LODs, each with a quarter of the vertices of the previous one
+// and two triangles per vertex, as a grid has. Returns the file size.
+static uint64_t writeMeshFile(const char* path, uint32_t vertexCount, uint32_t lodCount)
+{
+    MeshFileHeader header = {};
+    header.magic = MESH_FILE_MAGIC;
+    header.version = MESH_FILE_VERSION;
+    header.vertexStride = sizeof(MeshVertex);
+    header.lodCount = lodCount;
+    for (uint32_t k = 0; k < 3; k++) {
+        header.positionScale[k] = 1.0f;
+    }
+
+    uint64_t offset = alignUp(sizeof(MeshFileHeader), MESH_LOD_ALIGNMENT);
+    for (uint32_t i = 0; i < lodCount; i++) {
+        MeshLod& lod = header.lods[i];
+        lod.vertexCount = std::max(vertexCount >> (2 * i), 3u);
+        lod.indexCount = lod.vertexCount * 6;
+        lod.meshletCount = (lod.indexCount / 3 + MESH_MAX_MESHLET_TRIANGLES - 1) / MESH_MAX_MESHLET_TRIANGLES;
+        lod.indexSize = lod.vertexCount > 0xffff ? 4 : 2;
+        lod.indexOffset = alignUp(lod.vertexCount * sizeof(MeshVertex), MESH_SECTION_ALIGNMENT);
+        lod.meshletOffset = alignUp(lod.indexOffset + (uint64_t)lod.indexCount * lod.indexSize, MESH_SECTION_ALIGNMENT);
+        lod.blockOffset = offset;
+        lod.blockSize = lod.meshletOffset + lod.meshletCount * sizeof(MeshMeshlet);
+        offset = alignUp(offset + lod.blockSize, MESH_LOD_ALIGNMENT);
+    }
+    header.fileSize = header.lods[lodCount - 1].blockOffset + header.lods[lodCount - 1].blockSize;
+
+    std::vector<uint8_t> data((size_t)header.fileSize, 0);
+    memcpy(data.data(), &header, sizeof(header));
+    for (uint32_t i = 0; i < lodCount; i++) {
+        const MeshLod& lod = header.lods[i];
+        uint8_t* block = &data[(size_t)lod.blockOffset];
+        for (uint32_t v = 0; v < lod.vertexCount; v++) {
+            MeshVertex* vertex = (MeshVertex*)block + v;
+            vertex->position[0] = (int16_t)(v & 0x7fff);
+            vertex->normal[2] = 127;
+        }
+        for (uint32_t index = 0; index < lod.indexCount; index++) {
+            uint32_t value = (index / 3 + index % 3) % lod.vertexCount;
+            if (lod.indexSize == 4) {
+                ((uint32_t*)(block + lod.indexOffset))[index] = value;
+            } else {
+                ((uint16_t*)(block + lod.indexOffset))[index] = (uint16_t)value;
+            }
+        }
+        for (uint32_t m = 0; m < lod.meshletCount; m++) {
+            MeshMeshlet* meshlet = (MeshMeshlet*)(block + lod.meshletOffset) + m;
+            meshlet->firstIndex = m * MESH_MAX_MESHLET_TRIANGLES * 3;
+            meshlet->indexCount = std::min(MESH_MAX_MESHLET_TRIANGLES * 3, lod.indexCount - meshlet->firstIndex);
+            meshlet->radius = 1.0f;
+        }
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write((const char*)data.data(), data.size());
+    return header.fileSize;
+}
+
+TEST_CASE(meshStreamerValidatesFiles)
+{
+    MeshStreamer streamer;
+    uint64_t fileSize = writeMeshFile(MESH_PATH, 10000, 3);
+
+    StreamedMesh* mesh = streamer.openMesh(MESH_PATH);
+    CHECK(mesh != NULL);
+    if (mesh) {
+        CHECK(mesh->fileSize == fileSize && mesh->header->lodCount == 3);
+        CHECK(mesh->header->lods[0].indexSize == 2 && mesh->header->lods[2].vertexCount == 10000 / 16);
+        CHECK(streamer.getResidentLod(mesh, 0) == MeshStreamer::INVALID_LOD);
+        streamer.closeMesh(mesh);
+    }
+    CHECK(streamer.getStats().meshesOpened == 1 && streamer.getStats().bytesMapped == fileSize);
+
+    // Cut inside the last LOD block, the header no longer matches the file.
+    {
+        std::vector<char> data((size_t)fileSize);
+        std::ifstream(MESH_PATH, std::ios::binary).read(data.data(), data.size());
+        std::ofstream(MESH_PATH, std::ios::binary | std::ios::trunc).write(data.data(), data.size() - 1);
+    }
+    CHECK(streamer.openMesh(MESH_PATH) == NULL);
+    CHECK(streamer.openMesh("engineTests_missing.vkmesh") == NULL);
+    CHECK(streamer.getStats().meshesOpened == 1);
+
+    streamer.destroyMeshStreamer();
+    std::remove(MESH_PATH);
+}
+
+// Time from file to staging memory of every LOD, for a 1M vertex mesh of 4 LODs. Mapped: the
+// streamer maps the file and the blocks are copied from the pages as they are stored. Parsed:
+// the file is read into memory, decoded into vertex, 32-bit index and meshlet arrays, then
+// those are copied. The destination stands in for the staging ring.
+BENCHMARK_CASE(meshLoadTime)
+{
+    const uint32_t loadCount = 10;
+    uint64_t fileSize = writeMeshFile(MESH_PATH, 1 << 20, 4);
+    std::vector<uint8_t> staging((size_t)fileSize * 2); // Parsed indices are widened to 32 bits.
+
+    MeshStreamer streamer;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < loadCount; i++) {
+        StreamedMesh* mesh = streamer.openMesh(MESH_PATH);
+        size_t stagingOffset = 0;
+        for (uint32_t lod = 0; lod < mesh->header->lodCount; lod++) {
+            const MeshLod& fileLod = mesh->header->lods[lod];
+            memcpy(&staging[stagingOffset], mesh->fileData + fileLod.blockOffset, (size_t)fileLod.blockSize);
+            stagingOffset += (size_t)fileLod.blockSize;
+        }
+        streamer.closeMesh(mesh);
+    }
+    double mappedMs = elapsedMs(start) / loadCount;
+    streamer.destroyMeshStreamer();
+
+    uint64_t checksum = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < loadCount; i++) {
+        std::ifstream file(MESH_PATH, std::ios::binary | std::ios::ate);
+        std::vector<char> fileData((size_t)file.tellg());
+        file.seekg(0);
+        file.read(fileData.data(), fileData.size());
+
+        MeshFileHeader header;
+        memcpy(&header, fileData.data(), sizeof(header));
+        size_t stagingOffset = 0;
+        for (uint32_t lod = 0; lod < header.lodCount; lod++) {
+            const MeshLod& fileLod = header.lods[lod];
+            const char* block = &fileData[(size_t)fileLod.blockOffset];
+
+            std::vector<MeshVertex> vertices(fileLod.vertexCount);
+            for (uint32_t v = 0; v < fileLod.vertexCount; v++) {
+                memcpy(&vertices[v], block + v * sizeof(MeshVertex), sizeof(MeshVertex));
+            }
+            std::vector<uint32_t> indices(fileLod.indexCount);
+            for (uint32_t index = 0; index < fileLod.indexCount; index++) {
+                const char* source = block + fileLod.indexOffset + index * fileLod.indexSize;
+                indices[index] = fileLod.indexSize == 4 ? *(const uint32_t*)source : *(const uint16_t*)source;
+            }
+            std::vector<MeshMeshlet> meshlets(fileLod.meshletCount);
+            for (uint32_t m = 0; m < fileLod.meshletCount; m++) {
+                memcpy(&meshlets[m], block + fileLod.meshletOffset + m * sizeof(MeshMeshlet), sizeof(MeshMeshlet));
+            }
+
+            memcpy(&staging[stagingOffset], vertices.data(), vertices.size() * sizeof(MeshVertex));
+            stagingOffset += vertices.size() * sizeof(MeshVertex);
+            memcpy(&staging[stagingOffset], indices.data(), indices.size() * sizeof(uint32_t));
+            stagingOffset += indices.size() * sizeof(uint32_t);
+            memcpy(&staging[stagingOffset], meshlets.data(), meshlets.size() * sizeof(MeshMeshlet));
+            stagingOffset += meshlets.size() * sizeof(MeshMeshlet);
+            checksum += indices.back();
+        }
+    }
+    double parsedMs = elapsedMs(start) / loadCount;
+    std::remove(MESH_PATH);
+
+    char detail[96];
+    snprintf(detail, sizeof(detail), "%.1f MB file, %.2f GB/s", fileSize / (1024.0 * 1024.0),
+        fileSize / (1024.0 * 1024.0 * 1024.0) / (mappedMs / 1000.0));
+    reportBenchmark("Mapped load", mappedMs, "ms", detail);
+    snprintf(detail, sizeof(detail), "%.2fx mapped, checksum %llu", parsedMs / mappedMs, (unsigned long long)checksum);
+    reportBenchmark("Parsed load", parsedMs, "ms", detail);
+}
@@ -0,0 +1,136 @@
+#include "TestFramework.h"
+#include "FakeVulkan.h"
+#include "PipelineManager.h"
+#include "VulkanDevice.h"
+#include <fstream>
+
+static const char* CACHE_PATH = "engineTests_pipeline_cache.bin";
+
+// The device the fake pipeline cache data is written for.
+static void setUpDevice(VulkanDevice& deviceObj)
+{
+    deviceObj.device = getFakeDevice();
+    deviceObj.gpuProps = VkPhysicalDeviceProperties();
+    deviceObj.gpuProps.vendorID = 0x1234;
+    deviceObj.gpuProps.deviceID = 0x5678;
+}
+
+struct ComputeState {
+    VkSpecializationMapEntry entry;
+    uint32_t value;
+    VkSpecializationInfo specialization;
+    VkComputePipelineCreateInfo info;
+
+    ComputeState(VkShaderModule module, VkPipelineLayout layout, uint32_t inValue)
+    {
+        entry.constantID = 0;
+        entry.offset = 0;
+        entry.size = sizeof(uint32_t);
+        value = inValue;
+        specialization.mapEntryCount = 1;
+        specialization.pMapEntries = &entry;
+        specialization.dataSize = sizeof(value);
+        specialization.pData = &value;
+
+        info = VkComputePipelineCreateInfo();
+        info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        info.stage.module = module;
+        info.stage.pName = "main";
+        info.stage.pSpecializationInfo = &specialization;
+        info.layout = layout;
+        info.basePipelineIndex = -1;
+    }
+};
+
+TEST_CASE(pipelineManagerReusesEqualState)
+{
+    VulkanDevice deviceObj(NULL);
+    setUpDevice(deviceObj);
+    PipelineManager pipelineMgr;
+    pipelineMgr.createPipelineManager(&deviceObj, "");
+
+    VkShaderModule module = makeFakeHandle<VkShaderModule>();
+    VkPipelineLayout layout = makeFakeHandle<VkPipelineLayout>();
+    VkPipeline first, second, other;
+    ComputeState state(module, layout, 64);
+    CHECK(pipelineMgr.getComputePipeline(state.info, &first) == VK_SUCCESS);
+
+    // Equal state at other addresses is found, other constants are not.
+    ComputeState sameState(module, layout, 64);
+    CHECK(pipelineMgr.getComputePipeline(sameState.info, &second) == VK_SUCCESS && second == first);
+    ComputeState otherState(module, layout, 128);
+    CHECK(pipelineMgr.getComputePipeline(otherState.info, &other) == VK_SUCCESS && other != first);
+
+    PipelineCacheStats stats = pipelineMgr.getStats();
+    CHECK(stats.hits == 1 && stats.misses == 2);
+    CHECK(fakeCallCount("vkCreateComputePipelines") == 2);
+
+    pipelineMgr.destroyPipelineManager();
+    CHECK(fakeCallCount("vkDestroyPipeline") == 2);
+}
+
+// Once the module is destroyed its handle may come back, the pipelines compiled from it must not.
+TEST_CASE(pipelineManagerEvictsDestroyedObjects)
+{
+    VulkanDevice deviceObj(NULL);
+    setUpDevice(deviceObj);
+    PipelineManager pipelineMgr;
+    pipelineMgr.createPipelineManager(&deviceObj, "");
+
+    VkShaderModule module = makeFakeHandle<VkShaderModule>();
+    VkPipelineLayout layout = makeFakeHandle<VkPipelineLayout>();
+    VkPipeline first, second, other;
+    ComputeState state(module, layout, 64);
+    CHECK(pipelineMgr.getComputePipeline(state.info, &first) == VK_SUCCESS);
+    ComputeState otherLayoutState(module, makeFakeHandle<VkPipelineLayout>(), 64);
+    CHECK(pipelineMgr.getComputePipeline(otherLayoutState.info, &other) == VK_SUCCESS);
+
+    pipelineMgr.evictObject(layout);
+    CHECK(pipelineMgr.getStats().evicted == 1);
+    CHECK(pipelineMgr.getComputePipeline(state.info, &second) == VK_SUCCESS && second != first);
+    CHECK(pipelineMgr.getComputePipeline(otherLayoutState.info, &second) == VK_SUCCESS && second == other);
+
+    pipelineMgr.evictObject(module);
+    CHECK(pipelineMgr.getStats().evicted == 3);
+    CHECK(fakeCallCount("vkDestroyPipeline") == 0); // Evicted pipelines may still be in use.
+
+    pipelineMgr.destroyPipelineManager();
+    CHECK(fakeCallCount("vkDestroyPipeline") == 3);
+}
+
+TEST_CASE(pipelineManagerWarmStart)
+{
+    std::remove(CACHE_PATH);
+    VulkanDevice deviceObj(NULL);
+    setUpDevice(deviceObj);
+
+    PipelineManager coldMgr;
+    coldMgr.createPipelineManager(&deviceObj, CACHE_PATH);
+    CHECK(coldMgr.getStats().loadedBytes == 0);
+    VkPipeline pipeline;
+    ComputeState state(makeFakeHandle<VkShaderModule>(), makeFakeHandle<VkPipelineLayout>(), 64);
+    coldMgr.getComputePipeline(state.info, &pipeline);
+    CHECK(coldMgr.saveCache());
+    CHECK(coldMgr.getStats().savedBytes == 16 + VK_UUID_SIZE + 1);
+
+    // Saving again replaces the file, nothing is left behind.
+    coldMgr.getComputePipeline(ComputeState(state.info.stage.module, state.info.layout, 32).info, &pipeline);
+    CHECK(coldMgr.saveCache());
+    coldMgr.destroyPipelineManager();
+    CHECK(!std::ifstream((std::string(CACHE_PATH) + ".tmp").c_str()));
+
+    PipelineManager warmMgr;
+    warmMgr.createPipelineManager(&deviceObj, CACHE_PATH);
+    CHECK(warmMgr.getStats().loadedBytes == 16 + VK_UUID_SIZE + 2);
+    warmMgr.destroyPipelineManager();
+
+    // Written by another device: ignored.
+    deviceObj.gpuProps.deviceID = 0x9999;
+    PipelineManager otherMgr;
+    otherMgr.createPipelineManager(&deviceObj, CACHE_PATH);
+    CHECK(otherMgr.getStats().loadedBytes == 0);
+    otherMgr.destroyPipelineManager();
+    std::remove(CACHE_PATH);
+}
@@ -0,0 +1,128 @@
+#include "TestFramework.h"
+#include "FakeVulkan.h"
+#include "CpuProfiler.h"
+#include "GpuProfiler.h"
+#include "CommandBufferManager.h"
+#include "VulkanDevice.h"
+#include <thread>
+
+static void setUpDevice(VulkanDevice& deviceObj)
+{
+    deviceObj.device = getFakeDevice();
+    deviceObj.gpuProps = VkPhysicalDeviceProperties();
+    deviceObj.gpuProps.limits.timestampPeriod = 1.0f;
+    VkQueueFamilyProperties family = {};
+    family.queueFlags = VK_QUEUE_GRAPHICS_BIT;
+    family.queueCount = 1;
+    family.timestampValidBits = 64;
+    deviceObj.queueFamilyProps.push_back(family);
+}
+
+static VkCommandBuffer createCommandBuffer(VkCommandPool& cmdPool)
+{
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    vkCreateCommandPool(getFakeDevice(), &poolInfo, NULL, &cmdPool);
+    VkCommandBufferAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocateInfo.commandPool = cmdPool;
+    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocateInfo.commandBufferCount = 1;
+    VkCommandBuffer cmdBuffer;
+    vkAllocateCommandBuffers(getFakeDevice(), &allocateInfo, &cmdBuffer);
+    return cmdBuffer;
+}
+
+TEST_CASE(gpuProfilerCollectsScopes)
+{
+    VulkanDevice deviceObj(NULL);
+    setUpDevice(deviceObj);
+    VkCommandPool cmdPool;
+    VkCommandBuffer cmdBuffer = createCommandBuffer(cmdPool);
+
+    GpuProfiler profiler;
+    profiler.createProfiler(&deviceObj, 2, 0, 4);
+    CHECK(profiler.isEnabled() && fakeCallCount("vkCreateQueryPool") == 2);
+
+    // The fake timestamps are 1 us apart, every scope takes 1 us. The fifth scope is out of queries.
+    for (uint32_t frame = 0; frame < 3; frame++) {
+        CommandBufferMgr::beginCommandBuffer(cmdBuffer);
+        profiler.beginFrame(frame % 2, cmdBuffer);
+        uint32_t outer = profiler.beginScope(cmdBuffer, "Frame");
+        for (uint32_t i = 0; i < 4; i++) {
+            profiler.endScope(cmdBuffer, profiler.beginScope(cmdBuffer, "Pass"));
+        }
+        profiler.endScope(cmdBuffer, outer);
+        CommandBufferMgr::endCommandBuffer(cmdBuffer);
+        CHECK(outer == 0);
+    }
+    profiler.collectAll();
+
+    std::vector<GpuScopeStats> stats = profiler.getStats();
+    CHECK(stats.size() == 2);
+    for (const GpuScopeStats& scope : stats) {
+        CHECK(scope.count == (scope.name == "Frame" ? 3u : 9u));
+        CHECK(scope.minMs == 0.001 && scope.maxMs == 0.001);
+    }
+    profiler.destroyProfiler();
+    vkDestroyCommandPool(getFakeDevice(), cmdPool, NULL);
+}
+
+// Cost of a PROFILE_SCOPE against the same loop without it, and of a GPU scope, which records
+// two timestamps and reads them back a frame later. The GPU numbers include the fake driver
+// appending the commands, they are an upper bound of the profiler's own work.
+BENCHMARK_CASE(profilerOverhead)
+{
+    const uint32_t scopeCount = 200000; // Fits the chunks of one thread, none dropped.
+    volatile uint32_t sink = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < scopeCount; i++) {
+        sink = sink + i;
+    }
+    double baselineMs = elapsedMs(start);
+
+#if ENABLE_CPU_PROFILING
+    // A fresh thread, so its buffer starts empty.
+    double cpuMs = 0.0;
+    std::thread recorder([&]() {
+        std::chrono::steady_clock::time_point threadStart = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < scopeCount; i++) {
+            PROFILE_SCOPE("profilerOverhead");
+            sink = sink + i;
+        }
+        cpuMs = elapsedMs(threadStart);
+    });
+    recorder.join();
+    reportBenchmark("CPU scope", (cpuMs - baselineMs) * 1e6 / scopeCount, "ns", "PROFILE_SCOPE, enter and leave");
+#else
+    reportBenchmark("CPU scope", 0.0, "ns", "ENABLE_CPU_PROFILING is 0, the scopes compile to nothing");
+#endif
+
+    const uint32_t frameCount = 1000;
+    const uint32_t scopesPerFrame = GpuProfiler::DEFAULT_MAX_SCOPES;
+    VulkanDevice deviceObj(NULL);
+    setUpDevice(deviceObj);
+    VkCommandPool cmdPool;
+    VkCommandBuffer cmdBuffer = createCommandBuffer(cmdPool);
+    GpuProfiler profiler;
+    profiler.createProfiler(&deviceObj, 2, 0);
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frameCount; frame++) {
+        CommandBufferMgr::beginCommandBuffer(cmdBuffer);
+        profiler.beginFrame(frame % 2, cmdBuffer);
+        for (uint32_t i = 0; i < scopesPerFrame; i++) {
+            profiler.endScope(cmdBuffer, profiler.beginScope(cmdBuffer, (i & 1) ? "Odd pass" : "Even pass"));
+        }
+        CommandBufferMgr::endCommandBuffer(cmdBuffer);
+    }
+    profiler.collectAll();
+    double gpuMs = elapsedMs(start);
+    profiler.destroyProfiler();
+    vkDestroyCommandPool(getFakeDevice(), cmdPool, NULL);
+
+    char detail[96];
+    snprintf(detail, sizeof(detail), "begin, end and read back, %u scopes a frame", scopesPerFrame);
+    reportBenchmark("GPU scope", gpuMs * 1e6 / ((double)frameCount * scopesPerFrame), "ns", detail);
+}
@@ -0,0 +1,94 @@
+#include "TestFramework.h"
+#include "FakeVulkan.h"
+#include "VulkanDevice.h"
+
+static VkQueueFamilyProperties queueFamily(VkQueueFlags flags, uint32_t queueCount)
+{
+    VkQueueFamilyProperties family = {};
+    family.queueFlags = flags;
+    family.queueCount = queueCount;
+    return family;
+}
+
+static const VkQueueFlags ALL_QUEUE_FLAGS = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+
+// A discrete GPU: a general family, an async compute family and a DMA family.
+TEST_CASE(queueFamiliesPreferDedicatedFamilies)
+{
+    std::vector<VkQueueFamilyProperties> families;
+    families.push_back(queueFamily(ALL_QUEUE_FLAGS, 16));
+    families.push_back(queueFamily(VK_QUEUE_TRANSFER_BIT, 2));
+    families.push_back(queueFamily(VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT, 8));
+
+    QueueFamilySelection selection = VulkanDevice::selectQueueFamilies(families);
+    CHECK(selection.found);
+    CHECK(selection.graphicsFamily == 0 && selection.graphicsQueue == 0);
+    CHECK(selection.computeFamily == 2 && selection.computeQueue == 0 && selection.dedicatedComputeFamily);
+    CHECK(selection.transferFamily == 1 && selection.transferQueue == 0 && selection.dedicatedTransferFamily);
+    CHECK(selection.queueCounts == std::vector<uint32_t>({ 1, 1, 1 }));
+}
+
+// One family with several queues: compute and transfer take its spare queues.
+TEST_CASE(queueFamiliesUseSpareQueues)
+{
+    std::vector<VkQueueFamilyProperties> families(1, queueFamily(ALL_QUEUE_FLAGS, 4));
+
+    QueueFamilySelection selection = VulkanDevice::selectQueueFamilies(families);
+    CHECK(selection.found);
+    CHECK(selection.graphicsFamily == 0 && selection.computeFamily == 0 && selection.transferFamily == 0);
+    CHECK(selection.graphicsQueue == 0 && selection.computeQueue == 1 && selection.transferQueue == 2);
+    CHECK(!selection.dedicatedComputeFamily && !selection.dedicatedTransferFamily);
+    CHECK(selection.queueCounts == std::vector<uint32_t>(1, 3));
+}
+
+// One family with a single queue, as on software rasterizers: everything shares it.
+TEST_CASE(queueFamiliesShareSingleQueue)
+{
+    std::vector<VkQueueFamilyProperties> families(1, queueFamily(ALL_QUEUE_FLAGS, 1));
+
+    QueueFamilySelection selection = VulkanDevice::selectQueueFamilies(families);
+    CHECK(selection.found);
+    CHECK(selection.graphicsQueue == 0 && selection.computeQueue == 0 && selection.transferQueue == 0);
+    CHECK(selection.queueCounts == std::vector<uint32_t>(1, 1));
+}
+
+// The graphics family has no compute: compute goes to another family that has it, even with
+// graphics, and transfers follow compute. Families without queues are skipped.
+TEST_CASE(queueFamiliesFallBackToGeneralFamilies)
+{
+    std::vector<VkQueueFamilyProperties> families;
+    families.push_back(queueFamily(VK_QUEUE_COMPUTE_BIT, 0));
+    families.push_back(queueFamily(VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_TRANSFER_BIT, 1));
+    families.push_back(queueFamily(VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT, 2));
+
+    QueueFamilySelection selection = VulkanDevice::selectQueueFamilies(families);
+    CHECK(selection.found);
+    CHECK(selection.graphicsFamily == 1 && selection.graphicsQueue == 0);
+    CHECK(selection.computeFamily == 2 && selection.computeQueue == 0 && !selection.dedicatedComputeFamily);
+    CHECK(selection.transferFamily == 2 && selection.transferQueue == 1 && !selection.dedicatedTransferFamily);
+    CHECK(selection.queueCounts == std::vector<uint32_t>({ 0, 1, 2 }));
+}
+
+TEST_CASE(queueFamiliesNeedGraphics)
+{
+    std::vector<VkQueueFamilyProperties> families;
+    families.push_back(queueFamily(VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT, 4));
+    CHECK(!VulkanDevice::selectQueueFamilies(families).found);
+    CHECK(!VulkanDevice::selectQueueFamilies(std::vector<VkQueueFamilyProperties>()).found);
+}
+
+// The same through the device, with the table coming from the driver.
+TEST_CASE(queueFamiliesFromPhysicalDevice)
+{
+    fakeVulkan.queueFamilies.push_back(queueFamily(VK_QUEUE_TRANSFER_BIT, 1));
+    fakeVulkan.queueFamilies.push_back(queueFamily(ALL_QUEUE_FLAGS, 2));
+
+    VkPhysicalDevice gpu = (VkPhysicalDevice)(uintptr_t)0x3000;
+    VulkanDevice deviceObj(&gpu);
+    deviceObj.getPhysicalDeviceQueuesAndProperties();
+    CHECK(deviceObj.queueFamilyCount == 2);
+    deviceObj.getGraphicsQueueHandle();
+    CHECK(deviceObj.graphicsQueueIndex == 1 && deviceObj.graphicsQueueWithPresentIndex == 1);
+    CHECK(deviceObj.computeQueueIndex == 1 && deviceObj.queueSelection.computeQueue == 1);
+    CHECK(deviceObj.transferQueueIndex == 0 && deviceObj.queueSelection.dedicatedTransferFamily);
+}
@@ -0,0 +1,80 @@
+#include "TestFramework.h"
+#include "FakeVulkan.h"
+#include "ReadbackPool.h"
+#include "CommandBufferManager.h"
+#include "VulkanDevice.h"
+
+static const VkDeviceSize ATOM_SIZE = 1024;
+
+// A device with one host visible, cached and not coherent memory type, in blocks of 16 KB.
+static void setUpDevice(VulkanDevice& deviceObj)
+{
+    deviceObj.device = getFakeDevice();
+    deviceObj.gpuProps = VkPhysicalDeviceProperties();
+    deviceObj.gpuProps.limits.bufferImageGranularity = 1;
+    deviceObj.gpuProps.limits.nonCoherentAtomSize = ATOM_SIZE;
+    deviceObj.memoryProperties = VkPhysicalDeviceMemoryProperties();
+    deviceObj.memoryProperties.memoryTypeCount = 1;
+    deviceObj.memoryProperties.memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    deviceObj.memoryProperties.memoryHeapCount = 1;
+    deviceObj.memoryProperties.memoryHeaps[0].size = 64 * 1024 * 1024;
+    deviceObj.memoryAllocator.createAllocator(&deviceObj, 16 * 1024);
+}
+
+// Each read invalidates the atoms of its own copy, nothing of the other slots or allocations.
+TEST_CASE(readbackPoolInvalidatesCopiedRange)
+{
+    VulkanDevice deviceObj(NULL);
+    setUpDevice(deviceObj);
+
+    // Takes the first 256 bytes of the block, the pool does not start on an atom.
+    VkBufferCreateInfo bufInfo = {};
+    bufInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufInfo.size = 256;
+    VkBuffer spacer;
+    vkCreateBuffer(deviceObj.device, &bufInfo, NULL, &spacer);
+    MemoryAllocation spacerMemory;
+    CHECK(deviceObj.memoryAllocator.allocateForBuffer(spacer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+        ALLOCATION_STRATEGY_FREE_LIST, &spacerMemory) == VK_SUCCESS);
+
+    ReadbackPool readbackPool;
+    readbackPool.createReadbackPool(&deviceObj, 3, 1000);
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    VkCommandPool cmdPool;
+    vkCreateCommandPool(deviceObj.device, &poolInfo, NULL, &cmdPool);
+    VkCommandBufferAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocateInfo.commandPool = cmdPool;
+    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocateInfo.commandBufferCount = 1;
+    VkCommandBuffer cmdBuffer;
+    vkAllocateCommandBuffers(deviceObj.device, &allocateInfo, &cmdBuffer);
+
+    // Slots are 1 KB at 256, 1280 and 2304 in the block.
+    VkImage image = makeFakeHandle<VkImage>();
+    CommandBufferMgr::beginCommandBuffer(cmdBuffer);
+    readbackPool.recordImageCopy(cmdBuffer, 1, 7, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 10, 10, 4);
+    readbackPool.recordImageCopy(cmdBuffer, 2, 7, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 16, 16, 4);
+    CommandBufferMgr::endCommandBuffer(cmdBuffer);
+    CHECK(getFakeCommandBuffer(cmdBuffer)->commands[0].args[2] == 1024);
+
+    uint64_t frameNumber = 0;
+    VkDeviceSize size = 0;
+    CHECK(readbackPool.acquireData(0) == NULL);
+    CHECK(readbackPool.acquireData(1, &frameNumber, &size) != NULL && frameNumber == 7 && size == 400);
+    CHECK(fakeVulkan.invalidatedRanges.size() == 1);
+    CHECK(fakeVulkan.invalidatedRanges[0].offset == 1024 && fakeVulkan.invalidatedRanges[0].size == 1024);
+
+    CHECK(readbackPool.acquireData(2, NULL, &size) != NULL && size == 1024);
+    CHECK(fakeVulkan.invalidatedRanges.size() == 2);
+    CHECK(fakeVulkan.invalidatedRanges[1].offset == 2048 && fakeVulkan.invalidatedRanges[1].size == 2048);
+    CHECK(readbackPool.acquireData(2) == NULL); // Read once per copy.
+
+    vkDestroyCommandPool(deviceObj.device, cmdPool, NULL);
+    readbackPool.destroyReadbackPool();
+    deviceObj.memoryAllocator.free(spacerMemory);
+    vkDestroyBuffer(deviceObj.device, spacer, NULL);
+    deviceObj.memoryAllocator.destroyAllocator();
+}
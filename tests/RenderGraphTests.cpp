@@ -0,0 +1,144 @@
+#include "TestFramework.h"
+#include "FakeVulkan.h"
+#include "RenderGraph.h"
+#include "VulkanDevice.h"
+
+static uint32_t countCommands(VkCommandBuffer cmdBuffer, const char* name)
+{
+    uint32_t count = 0;
+    for (const FakeCommand& command : getFakeCommandBuffer(cmdBuffer)->commands) {
+        count += strcmp(command.name, name) ? 0 : 1;
+    }
+    return count;
+}
+
+static RenderGraph::RecordFunction recordDraw(std::vector<std::string>* recorded, const char* name)
+{
+    return [recorded, name](VkCommandBuffer cmdBuffer, const RenderGraph& graph) {
+        recorded->push_back(name);
+        vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+    };
+}
+
+// Draw into an imported image and copy it into a readback buffer, all on the graphics queue.
+TEST_CASE(renderGraphMergesBarriersOnOneQueue)
+{
+    VulkanDevice deviceObj(NULL);
+    deviceObj.device = getFakeDevice();
+    deviceObj.queue = getFakeQueue(0);
+
+    RenderGraph graph;
+    graph.createRenderGraph(&deviceObj, 2);
+    CHECK(!graph.hasTimelineSemaphores());
+
+    std::vector<std::string> recorded;
+    uint32_t color = graph.importImage("Color", makeFakeHandle<VkImage>(), VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    uint32_t readback = graph.importBuffer("Readback", makeFakeHandle<VkBuffer>());
+    RenderBufferDesc scratchDesc = { 1024, 0 };
+    uint32_t scratch = graph.createBuffer("Scratch", scratchDesc);
+
+    uint32_t draw = graph.addPass("Draw", RENDER_QUEUE_GRAPHICS, recordDraw(&recorded, "Draw"));
+    graph.writeImage(draw, color, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+    // Nobody reads the scratch buffer, the pass is culled and the buffer never created.
+    uint32_t unused = graph.addPass("Unused", RENDER_QUEUE_GRAPHICS, recordDraw(&recorded, "Unused"));
+    graph.writeBuffer(unused, scratch, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+    uint32_t copy = graph.addPass("Copy", RENDER_QUEUE_GRAPHICS, recordDraw(&recorded, "Copy"));
+    graph.readImage(copy, color, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    graph.writeBuffer(copy, readback, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+    graph.compile();
+    const RenderGraphStats& stats = graph.getStats();
+    CHECK(stats.passesDeclared == 3 && stats.passesCulled == 1);
+    CHECK(stats.batches == 1);
+    CHECK(fakeCallCount("vkCreateBuffer") == 0);
+
+    // One barrier before each pass, the copy's transition and buffer hazard merged into one,
+    // and one handing the image back in its final layout.
+    CHECK(stats.pipelineBarriers == 3);
+    CHECK(stats.imageBarriers == 3);
+    CHECK(stats.semaphoreWaits == 0);
+
+    graph.execute(0);
+    CHECK(fakeCallCount("vkQueueSubmit") == 1);
+    CHECK(recorded.size() == 2 && recorded[0] == "Draw" && recorded[1] == "Copy");
+    VkCommandBuffer cmdBuffer = fakeVulkan.submittedCmdBuffers.back();
+    CHECK(countCommands(cmdBuffer, "vkCmdPipelineBarrier") == 3);
+
+    // The other slot records again without waiting, the first one waits for its fence.
+    graph.execute(1);
+    completeFakeSubmissions();
+    graph.execute(0);
+    CHECK(fakeCallCount("vkQueueSubmit") == 3);
+    CHECK(graph.getStats().executions == 3);
+
+    completeFakeSubmissions();
+    graph.destroyRenderGraph();
+}
+
+// Upload on the transfer queue, cull on the compute queue and draw on the graphics queue, each
+// consuming the previous one's output.
+TEST_CASE(renderGraphWaitsAcrossQueues)
+{
+    VulkanDevice deviceObj(NULL);
+    deviceObj.device = getFakeDevice();
+    deviceObj.queue = getFakeQueue(0);
+    deviceObj.computeQueue = getFakeQueue(1);
+    deviceObj.transferQueue = getFakeQueue(2);
+    deviceObj.graphicsQueueIndex = 0;
+    deviceObj.computeQueueIndex = 1;
+    deviceObj.transferQueueIndex = 2;
+    deviceObj.enabledFeatures.timelineSemaphore.timelineSemaphore = VK_TRUE;
+
+    RenderGraph graph;
+    graph.createRenderGraph(&deviceObj, 2);
+    CHECK(graph.hasTimelineSemaphores());
+    CHECK(fakeCallCount("vkCreateSemaphore") == 3);
+
+    std::vector<std::string> recorded;
+    uint32_t objects = graph.importBuffer("Objects", makeFakeHandle<VkBuffer>());
+    uint32_t visible = graph.importBuffer("Visible", makeFakeHandle<VkBuffer>());
+    uint32_t color = graph.importImage("Color", makeFakeHandle<VkImage>(), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+
+    uint32_t upload = graph.addPass("Upload", RENDER_QUEUE_TRANSFER, recordDraw(&recorded, "Upload"));
+    graph.writeBuffer(upload, objects, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+    uint32_t cull = graph.addPass("Cull", RENDER_QUEUE_COMPUTE, recordDraw(&recorded, "Cull"));
+    graph.readBuffer(cull, objects, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    graph.writeBuffer(cull, visible, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+    uint32_t draw = graph.addPass("Draw", RENDER_QUEUE_GRAPHICS, recordDraw(&recorded, "Draw"));
+    graph.readBuffer(draw, visible, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    graph.writeImage(draw, color, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+    graph.compile();
+    const RenderGraphStats& stats = graph.getStats();
+    CHECK(stats.passesCulled == 0);
+    CHECK(stats.batches == 3);
+
+    // Each pass waits for its input on a semaphore, the barriers only cover the imported
+    // resources touched first in the execution.
+    CHECK(stats.semaphoreWaits == 2);
+    CHECK(stats.pipelineBarriers == 3);
+    CHECK(stats.imageBarriers == 1);
+
+    graph.execute(0);
+    CHECK(fakeCallCount("vkQueueSubmit") == 3);
+    CHECK(recorded.size() == 3 && recorded[0] == "Upload" && recorded[1] == "Cull" && recorded[2] == "Draw");
+    CHECK(fakeVulkan.submittedCmdBuffers.size() == 3);
+    for (VkCommandBuffer cmdBuffer : fakeVulkan.submittedCmdBuffers) {
+        CHECK(countCommands(cmdBuffer, "vkCmdPipelineBarrier") == 1);
+    }
+
+    // Reusing the slot waits on the timelines instead of a fence.
+    graph.execute(1);
+    graph.execute(0);
+    CHECK(fakeCallCount("vkWaitSemaphoresKHR") == 1);
+
+    graph.destroyRenderGraph();
+    CHECK(fakeCallCount("vkDestroySemaphore") == 3);
+}
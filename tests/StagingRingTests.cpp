@@ -0,0 +1,159 @@
+#include "TestFramework.h"
+#include "FakeVulkan.h"
+#include "StagingRing.h"
+#include "VulkanDevice.h"
+
+// A device with one host visible, coherent memory type.
+static void setUpDevice(VulkanDevice& deviceObj)
+{
+    deviceObj.device = getFakeDevice();
+    deviceObj.gpuProps = VkPhysicalDeviceProperties();
+    deviceObj.gpuProps.limits.bufferImageGranularity = 1;
+    deviceObj.memoryProperties = VkPhysicalDeviceMemoryProperties();
+    deviceObj.memoryProperties.memoryTypeCount = 1;
+    deviceObj.memoryProperties.memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    deviceObj.memoryProperties.memoryHeapCount = 1;
+    deviceObj.memoryProperties.memoryHeaps[0].size = 64 * 1024 * 1024;
+    deviceObj.memoryAllocator.createAllocator(&deviceObj, 1024 * 1024);
+}
+
+// Copy regions recorded into the command buffer of the latest submission.
+static std::vector<FakeCommand> lastSubmittedCopies()
+{
+    std::vector<FakeCommand> copies;
+    for (const FakeCommand& command : getFakeCommandBuffer(fakeVulkan.submittedCmdBuffers.back())->commands) {
+        if (!strcmp(command.name, "vkCmdCopyBuffer")) {
+            copies.push_back(command);
+        }
+    }
+    return copies;
+}
+
+TEST_CASE(stagingRingMergesContiguousCopies)
+{
+    VulkanDevice deviceObj(NULL);
+    setUpDevice(deviceObj);
+    StagingRing stagingRing;
+    stagingRing.createStagingRing(&deviceObj, getFakeQueue(), 0, 1024);
+
+    VkBuffer dstBuffer = makeFakeHandle<VkBuffer>();
+    char data[300];
+    memset(data, 7, sizeof(data));
+    CHECK(stagingRing.uploadBuffer(dstBuffer, 0, data, 100));
+    CHECK(stagingRing.uploadBuffer(dstBuffer, 100, data, 100));
+    CHECK(stagingRing.uploadBuffer(dstBuffer, 500, data, 300));
+    CHECK(stagingRing.flush().serial == 1);
+
+    std::vector<FakeCommand> copies = lastSubmittedCopies();
+    CHECK(copies.size() == 2);
+    CHECK(copies[0].args[1] == 0 && copies[0].args[2] == 0 && copies[0].args[3] == 200);
+    CHECK(copies[1].args[1] == 200 && copies[1].args[2] == 500 && copies[1].args[3] == 300);
+    CHECK(stagingRing.getStats().bytesUploaded == 500 && stagingRing.getStats().copyCount == 3);
+
+    completeFakeSubmissions();
+    stagingRing.destroyStagingRing();
+    deviceObj.memoryAllocator.destroyAllocator();
+}
+
+TEST_CASE(stagingRingKeepsInFlightData)
+{
+    VulkanDevice deviceObj(NULL);
+    setUpDevice(deviceObj);
+    StagingRing stagingRing;
+    stagingRing.createStagingRing(&deviceObj, getFakeQueue(), 0, 1024);
+
+    VkDeviceSize firstOffset, offset;
+    CHECK(stagingRing.reserve(600, 4, &firstOffset) != NULL && firstOffset == 0);
+    stagingRing.enqueueBufferCopy(makeFakeHandle<VkBuffer>(), 0, firstOffset, 600);
+    stagingRing.flush();
+
+    // The GPU still reads the first 600 bytes.
+    CHECK(stagingRing.reserve(600, 4, &offset) == NULL);
+    CHECK(stagingRing.reserve(400, 4, &offset) != NULL && offset == 600);
+    CHECK(stagingRing.reserve(100, 4, &offset) == NULL);
+
+    completeFakeSubmissions();
+    CHECK(stagingRing.reserve(500, 4, &offset) != NULL && offset == 0);
+
+    stagingRing.destroyStagingRing();
+    deviceObj.memoryAllocator.destroyAllocator();
+}
+
+// A request wrapping around the end of an empty ring fits, whatever the position of the last one.
+TEST_CASE(stagingRingRewindsWhenEmpty)
+{
+    VulkanDevice deviceObj(NULL);
+    setUpDevice(deviceObj);
+    StagingRing stagingRing;
+    stagingRing.createStagingRing(&deviceObj, getFakeQueue(), 0, 1024);
+
+    VkBuffer dstBuffer = makeFakeHandle<VkBuffer>();
+    std::vector<char> data(1024, 1);
+    CHECK(stagingRing.uploadBuffer(dstBuffer, 0, data.data(), 600));
+    stagingRing.flush();
+    completeFakeSubmissions();
+    stagingRing.reclaim();
+
+    CHECK(stagingRing.uploadBuffer(dstBuffer, 600, data.data(), 700));
+    stagingRing.flush();
+    std::vector<FakeCommand> copies = lastSubmittedCopies();
+    CHECK(copies.size() == 1 && copies[0].args[1] == 0 && copies[0].args[3] == 700);
+
+    // Same with the whole ring, once the upload above has retired.
+    completeFakeSubmissions();
+    CHECK(stagingRing.uploadBuffer(dstBuffer, 0, data.data(), 1024));
+    CHECK(!stagingRing.uploadBuffer(dstBuffer, 0, data.data(), 1025));
+    stagingRing.flush();
+
+    completeFakeSubmissions();
+    stagingRing.destroyStagingRing();
+    deviceObj.memoryAllocator.destroyAllocator();
+}
+
+// Upload rate and submit count of 256 MB through the default 32 MB ring, in 256 KB uploads. Per
+// frame: the uploads of a 4 MB frame share one flush. Per upload: each one is flushed on its own.
+// The fake GPU finishes the previous frame's copies at the start of the next, the rate is that of
+// the CPU side: the copy into the ring, the command recording and the submits.
+BENCHMARK_CASE(stagingUploadThroughput)
+{
+    const VkDeviceSize totalSize = 256 * 1024 * 1024;
+    const VkDeviceSize uploadSize = 256 * 1024;
+    const uint32_t uploadsPerFrame = 16;
+    const uint32_t bufferCount = 16;
+    std::vector<char> data((size_t)uploadSize, 3);
+
+    for (uint32_t flushEachUpload = 0; flushEachUpload < 2; flushEachUpload++) {
+        VulkanDevice deviceObj(NULL);
+        setUpDevice(deviceObj);
+        StagingRing stagingRing;
+        stagingRing.createStagingRing(&deviceObj, getFakeQueue(), 0);
+        std::vector<VkBuffer> dstBuffers(bufferCount);
+        for (VkBuffer& dstBuffer : dstBuffers) {
+            dstBuffer = makeFakeHandle<VkBuffer>();
+        }
+
+        uint32_t uploadCount = (uint32_t)(totalSize / uploadSize);
+        for (uint32_t i = 0; i < uploadCount; i++) {
+            if (i % uploadsPerFrame == 0) {
+                completeFakeSubmissions();
+                stagingRing.reclaim();
+            }
+            VkDeviceSize dstOffset = (i / bufferCount) * uploadSize;
+            CHECK(stagingRing.uploadBuffer(dstBuffers[i % bufferCount], dstOffset, data.data(), uploadSize));
+            if (flushEachUpload || i % uploadsPerFrame == uploadsPerFrame - 1) {
+                stagingRing.flush();
+            }
+        }
+        StagingStats stats = stagingRing.getStats();
+        CHECK(stats.bytesUploaded == totalSize);
+
+        completeFakeSubmissions();
+        stagingRing.destroyStagingRing();
+        deviceObj.memoryAllocator.destroyAllocator();
+
+        char detail[96];
+        snprintf(detail, sizeof(detail), "%.2f submits per MB, %llu submits", stats.submitsPerMegabyte(),
+            (unsigned long long)stats.submitCount);
+        reportBenchmark(flushEachUpload ? "Flush per upload" : "Flush per frame", stats.megabytesPerSecond(), "MB/s", detail);
+    }
+}
@@ -0,0 +1,89 @@
+#include "TestFramework.h"
+#include "SwapchainManager.h"
+
+static VkSurfaceCapabilitiesKHR makeCapabilities(uint32_t minImageCount, uint32_t maxImageCount)
+{
+    VkSurfaceCapabilitiesKHR capabilities = {};
+    capabilities.minImageCount = minImageCount;
+    capabilities.maxImageCount = maxImageCount;
+    capabilities.currentExtent.width = 800;
+    capabilities.currentExtent.height = 600;
+    capabilities.minImageExtent.width = 1;
+    capabilities.minImageExtent.height = 1;
+    capabilities.maxImageExtent.width = 4096;
+    capabilities.maxImageExtent.height = 4096;
+    return capabilities;
+}
+
+static VkSurfaceFormatKHR makeFormat(VkFormat format, VkColorSpaceKHR colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
+{
+    VkSurfaceFormatKHR surfaceFormat = { format, colorSpace };
+    return surfaceFormat;
+}
+
+TEST_CASE(swapchainPresentModeFollowsPolicy)
+{
+    std::vector<VkPresentModeKHR> all = { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR };
+    std::vector<VkPresentModeKHR> noMailbox = { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+    std::vector<VkPresentModeKHR> fifoOnly = { VK_PRESENT_MODE_FIFO_KHR };
+
+    CHECK(SwapchainManager::choosePresentMode(all, PRESENT_POLICY_LOW_LATENCY) == VK_PRESENT_MODE_MAILBOX_KHR);
+    CHECK(SwapchainManager::choosePresentMode(noMailbox, PRESENT_POLICY_LOW_LATENCY) == VK_PRESENT_MODE_IMMEDIATE_KHR);
+    CHECK(SwapchainManager::choosePresentMode(fifoOnly, PRESENT_POLICY_LOW_LATENCY) == VK_PRESENT_MODE_FIFO_KHR);
+
+    // Balanced never tears, IMMEDIATE is not taken even when it is the only other mode.
+    CHECK(SwapchainManager::choosePresentMode(all, PRESENT_POLICY_BALANCED) == VK_PRESENT_MODE_MAILBOX_KHR);
+    CHECK(SwapchainManager::choosePresentMode(noMailbox, PRESENT_POLICY_BALANCED) == VK_PRESENT_MODE_FIFO_KHR);
+
+    CHECK(SwapchainManager::choosePresentMode(all, PRESENT_POLICY_POWER_SAVING) == VK_PRESENT_MODE_FIFO_KHR);
+
+    // FIFO is always supported, even if the query left it out.
+    CHECK(SwapchainManager::choosePresentMode(std::vector<VkPresentModeKHR>(), PRESENT_POLICY_LOW_LATENCY) == VK_PRESENT_MODE_FIFO_KHR);
+}
+
+TEST_CASE(swapchainSurfaceFormatPrefersUnorm)
+{
+    // A single UNDEFINED entry lets the swapchain pick, it takes B8G8R8A8_UNORM.
+    VkSurfaceFormatKHR chosen = SwapchainManager::chooseSurfaceFormat(std::vector<VkSurfaceFormatKHR>(1, makeFormat(VK_FORMAT_UNDEFINED)));
+    CHECK(chosen.format == VK_FORMAT_B8G8R8A8_UNORM && chosen.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR);
+
+    std::vector<VkSurfaceFormatKHR> available = { makeFormat(VK_FORMAT_A2B10G10R10_UNORM_PACK32),
+        makeFormat(VK_FORMAT_R8G8B8A8_UNORM, VK_COLOR_SPACE_EXTENDED_SRGB_LINEAR_EXT), makeFormat(VK_FORMAT_R8G8B8A8_UNORM) };
+    chosen = SwapchainManager::chooseSurfaceFormat(available);
+    CHECK(chosen.format == VK_FORMAT_R8G8B8A8_UNORM && chosen.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR);
+
+    // Without an 8 bit UNORM format the first one is taken.
+    available.pop_back();
+    CHECK(SwapchainManager::chooseSurfaceFormat(available).format == VK_FORMAT_A2B10G10R10_UNORM_PACK32);
+}
+
+TEST_CASE(swapchainExtentIsClamped)
+{
+    VkSurfaceCapabilitiesKHR capabilities = makeCapabilities(2, 8);
+    VkExtent2D extent = SwapchainManager::chooseExtent(capabilities, 1920, 1080);
+    CHECK(extent.width == 800 && extent.height == 600);
+
+    // A current extent of UINT32_MAX lets the swapchain decide, within the surface limits.
+    capabilities.currentExtent.width = UINT32_MAX;
+    capabilities.currentExtent.height = UINT32_MAX;
+    capabilities.minImageExtent.width = 64;
+    capabilities.maxImageExtent.height = 1024;
+    extent = SwapchainManager::chooseExtent(capabilities, 32, 2048);
+    CHECK(extent.width == 64 && extent.height == 1024);
+    extent = SwapchainManager::chooseExtent(capabilities, 1280, 720);
+    CHECK(extent.width == 1280 && extent.height == 720);
+}
+
+TEST_CASE(swapchainImageCountFitsPresentMode)
+{
+    // One more than the minimum, at least three for MAILBOX.
+    CHECK(SwapchainManager::chooseImageCount(makeCapabilities(2, 8), VK_PRESENT_MODE_FIFO_KHR) == 3);
+    CHECK(SwapchainManager::chooseImageCount(makeCapabilities(1, 8), VK_PRESENT_MODE_FIFO_KHR) == 2);
+    CHECK(SwapchainManager::chooseImageCount(makeCapabilities(1, 8), VK_PRESENT_MODE_MAILBOX_KHR) == 3);
+    CHECK(SwapchainManager::chooseImageCount(makeCapabilities(3, 8), VK_PRESENT_MODE_MAILBOX_KHR) == 4);
+
+    // A maximum of 0 is no limit, any other maximum caps the count.
+    CHECK(SwapchainManager::chooseImageCount(makeCapabilities(4, 0), VK_PRESENT_MODE_FIFO_KHR) == 5);
+    CHECK(SwapchainManager::chooseImageCount(makeCapabilities(1, 2), VK_PRESENT_MODE_MAILBOX_KHR) == 2);
+    CHECK(SwapchainManager::chooseImageCount(makeCapabilities(2, 2), VK_PRESENT_MODE_FIFO_KHR) == 2);
+}
@@ -0,0 +1,58 @@
+// Test and benchmark registry of engineTests. A test is a function registered with TEST_CASE, it
+// fails when one of its CHECKs does. Benchmarks are registered with BENCHMARK_CASE and only run
+// with --bench, they print their numbers with reportBenchmark().
+
+#pragma once
+
+#include "Headers.h"
+#include <chrono>
+#include <string>
+
+typedef void (*TestFunction)();
+
+struct TestCase {
+    const char* name;
+    TestFunction function;
+    bool benchmark;
+};
+
+class TestRegistry {
+public:
+    static std::vector<TestCase>& getCases();
+
+    // Counts a failure of the running test unless 'passed'.
+    static bool check(bool passed, const char* expression, const char* file, int line);
+    static uint32_t getFailureCount() { return failureCount; }
+
+private:
+    static uint32_t failureCount;
+};
+
+struct TestRegistration {
+    TestRegistration(const char* name, TestFunction function, bool benchmark)
+    {
+        TestCase testCase = { name, function, benchmark };
+        TestRegistry::getCases().push_back(testCase);
+    }
+};
+
+#define TEST_CASE(name) \
+    static void name(); \
+    static TestRegistration name##Registration(#name, name, false); \
+    static void name()
+
+#define BENCHMARK_CASE(name) \
+    static void name(); \
+    static TestRegistration name##Registration(#name, name, true); \
+    static void name()
+
+#define CHECK(expression) TestRegistry::check((expression) ? true : false, #expression, __FILE__, __LINE__)
+
+// Prints one result line, "<benchmark>: <value> <unit> (<detail>)".
+void reportBenchmark(const char* benchmark, double value, const char* unit, const std::string& detail = std::string());
+
+// Milliseconds since 'start'.
+inline double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,64 @@
+// engineTests [--bench] [name filter]: runs the unit tests, or the benchmarks with --bench, whose
+// name contains the filter. The exit code is the number of failed checks.
+
+#include "TestFramework.h"
+#include "FakeVulkan.h"
+
+uint32_t TestRegistry::failureCount = 0;
+
+std::vector<TestCase>& TestRegistry::getCases()
+{
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+bool TestRegistry::check(bool passed, const char* expression, const char* file, int line)
+{
+    if (!passed) {
+        failureCount++;
+        std::cout << "\t" << file << ":" << line << ": CHECK(" << expression << ") failed" << std::endl;
+    }
+    return passed;
+}
+
+void reportBenchmark(const char* benchmark, double value, const char* unit, const std::string& detail)
+{
+    std::cout << "\t" << benchmark << ": " << value << " " << unit;
+    if (!detail.empty()) {
+        std::cout << " (" << detail << ")";
+    }
+    std::cout << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    bool benchmarks = false;
+    const char* filter = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--bench")) {
+            benchmarks = true;
+        } else {
+            filter = argv[i];
+        }
+    }
+
+    uint32_t runCount = 0;
+    uint32_t failedCount = 0;
+    for (const TestCase& testCase : TestRegistry::getCases()) {
+        if (testCase.benchmark != benchmarks || (filter && !strstr(testCase.name, filter))) {
+            continue;
+        }
+
+        std::cout << testCase.name << std::endl;
+        uint32_t failuresBefore = TestRegistry::getFailureCount();
+        resetFakeVulkan();
+        testCase.function();
+        runCount++;
+        if (TestRegistry::getFailureCount() != failuresBefore) {
+            failedCount++;
+        }
+    }
+
+    std::cout << runCount << (benchmarks ? " benchmarks" : " tests") << " run, " << failedCount << " failed" << std::endl;
+    return (int)std::min(TestRegistry::getFailureCount(), 255u);
+}
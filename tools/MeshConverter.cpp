@@ -0,0 +1,503 @@
+// Offline converter from Wavefront OBJ to the streamed mesh format of MeshFormat.h.
+// It welds the OBJ corners into unique vertices, builds coarser LODs by vertex clustering,
+// splits every LOD into meshlets and orders the indices and vertices meshlet by meshlet,
+// quantizes the vertex attributes and writes each LOD as one page aligned block.
+//
+// Usage: meshConverter <input.obj> <output.vkmesh>
+
+#include "MeshFormat.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+struct SourceVertex {
+    float position[3];
+    float normal[3];
+    float uv[2];
+};
+
+struct SourceMesh {
+    std::vector<SourceVertex> vertices;
+    std::vector<uint32_t> indices; // Triangle list.
+    float error; // Deviation from the original mesh.
+};
+
+struct ConvertedLod {
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<MeshMeshlet> meshlets;
+    float error;
+};
+
+// OBJ indices are 1 based, negative ones count back from the latest element.
+static int resolveObjIndex(const std::string& token, size_t count)
+{
+    if (token.empty()) {
+        return -1;
+    }
+    int index = atoi(token.c_str());
+    if (index < 0) {
+        index += (int)count;
+    } else {
+        index -= 1;
+    }
+    return index >= 0 && index < (int)count ? index : -1;
+}
+
+static bool loadObj(const char* path, SourceMesh& mesh)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cout << "Cannot open " << path << std::endl;
+        return false;
+    }
+
+    std::vector<float> positions, normals, uvs;
+    std::map<std::vector<int>, uint32_t> corners; // position/uv/normal indices to vertex.
+    bool hasNormals = true;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        std::string keyword;
+        stream >> keyword;
+        if (keyword == "v") {
+            float x = 0, y = 0, z = 0;
+            stream >> x >> y >> z;
+            positions.push_back(x);
+            positions.push_back(y);
+            positions.push_back(z);
+        } else if (keyword == "vn") {
+            float x = 0, y = 0, z = 0;
+            stream >> x >> y >> z;
+            normals.push_back(x);
+            normals.push_back(y);
+            normals.push_back(z);
+        } else if (keyword == "vt") {
+            float u = 0, v = 0;
+            stream >> u >> v;
+            uvs.push_back(u);
+            uvs.push_back(1.0f - v); // OBJ has v going up.
+        } else if (keyword == "f") {
+            std::vector<uint32_t> polygon;
+            std::string corner;
+            while (stream >> corner) {
+                std::vector<int> key(3, -1);
+                size_t start = 0;
+                for (uint32_t part = 0; part < 3 && start <= corner.size(); part++) {
+                    size_t end = corner.find('/', start);
+                    std::string token = corner.substr(start, end == std::string::npos ? std::string::npos : end - start);
+                    size_t count = part == 0 ? positions.size() / 3 : (part == 1 ? uvs.size() / 2 : normals.size() / 3);
+                    key[part] = resolveObjIndex(token, count);
+                    if (end == std::string::npos) {
+                        break;
+                    }
+                    start = end + 1;
+                }
+                if (key[0] < 0) {
+                    std::cout << "Invalid face corner '" << corner << "' in " << path << std::endl;
+                    return false;
+                }
+                hasNormals = hasNormals && key[2] >= 0;
+
+                auto found = corners.find(key);
+                if (found == corners.end()) {
+                    SourceVertex vertex = {};
+                    memcpy(vertex.position, &positions[key[0] * 3], sizeof(vertex.position));
+                    if (key[1] >= 0) {
+                        memcpy(vertex.uv, &uvs[key[1] * 2], sizeof(vertex.uv));
+                    }
+                    if (key[2] >= 0) {
+                        memcpy(vertex.normal, &normals[key[2] * 3], sizeof(vertex.normal));
+                    }
+                    found = corners.insert(std::make_pair(key, (uint32_t)mesh.vertices.size())).first;
+                    mesh.vertices.push_back(vertex);
+                }
+                polygon.push_back(found->second);
+            }
+
+            // Fan triangulation, OBJ polygons are convex.
+            for (size_t i = 2; i < polygon.size(); i++) {
+                mesh.indices.push_back(polygon[0]);
+                mesh.indices.push_back(polygon[i - 1]);
+                mesh.indices.push_back(polygon[i]);
+            }
+        }
+    }
+
+    if (mesh.indices.empty()) {
+        std::cout << path << " has no faces" << std::endl;
+        return false;
+    }
+
+    // Area weighted face normals where the file has none.
+    if (!hasNormals) {
+        for (auto& vertex : mesh.vertices) {
+            vertex.normal[0] = vertex.normal[1] = vertex.normal[2] = 0.0f;
+        }
+        for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+            const float* a = mesh.vertices[mesh.indices[i]].position;
+            const float* b = mesh.vertices[mesh.indices[i + 1]].position;
+            const float* c = mesh.vertices[mesh.indices[i + 2]].position;
+            float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            for (uint32_t k = 0; k < 3; k++) {
+                float* normal = mesh.vertices[mesh.indices[i + k]].normal;
+                normal[0] += n[0];
+                normal[1] += n[1];
+                normal[2] += n[2];
+            }
+        }
+    }
+    for (auto& vertex : mesh.vertices) {
+        float length = sqrtf(vertex.normal[0] * vertex.normal[0] + vertex.normal[1] * vertex.normal[1] + vertex.normal[2] * vertex.normal[2]);
+        for (uint32_t k = 0; k < 3; k++) {
+            vertex.normal[k] = length > 0.0f ? vertex.normal[k] / length : (k == 2 ? 1.0f : 0.0f);
+        }
+    }
+
+    mesh.error = 0.0f;
+    return true;
+}
+
+static float distance(const float* a, const float* b)
+{
+    float d[3] = { a[0] - b[0], a[1] - b[1], a[2] - b[2] };
+    return sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+}
+
+// Merges the vertices of 'source' that fall into the same cell of a grid of cubic cells from
+// 'boundsMin', 'resolution' cells along the largest extent of the bounds. Cubes keep the error
+// the same in every direction, a flat mesh is not clustered finer across its thin side. Each
+// cell keeps the vertex nearest its mean, so attributes stay consistent, and the triangles
+// that collapse are dropped.
+static SourceMesh clusterVertices(const SourceMesh& source, uint32_t resolution, const float boundsMin[3], float maxExtent)
+{
+    float cellsPerUnit = maxExtent > 0.0f ? resolution / maxExtent : 0.0f;
+    std::map<uint64_t, std::vector<uint32_t> > cells;
+    std::vector<uint64_t> cellOfVertex(source.vertices.size());
+    for (uint32_t i = 0; i < (uint32_t)source.vertices.size(); i++) {
+        uint64_t cell = 0;
+        for (uint32_t k = 0; k < 3; k++) {
+            float t = (source.vertices[i].position[k] - boundsMin[k]) * cellsPerUnit;
+            uint64_t coordinate = (uint64_t)std::min((float)(resolution - 1), std::max(0.0f, t));
+            cell = cell * resolution + coordinate;
+        }
+        cellOfVertex[i] = cell;
+        cells[cell].push_back(i);
+    }
+
+    SourceMesh result;
+    result.error = source.error;
+    std::vector<uint32_t> remap(source.vertices.size());
+    for (auto& cell : cells) {
+        float mean[3] = { 0.0f, 0.0f, 0.0f };
+        for (uint32_t vertex : cell.second) {
+            for (uint32_t k = 0; k < 3; k++) {
+                mean[k] += source.vertices[vertex].position[k] / cell.second.size();
+            }
+        }
+
+        uint32_t representative = cell.second[0];
+        for (uint32_t vertex : cell.second) {
+            if (distance(source.vertices[vertex].position, mean) < distance(source.vertices[representative].position, mean)) {
+                representative = vertex;
+            }
+        }
+
+        uint32_t newIndex = (uint32_t)result.vertices.size();
+        result.vertices.push_back(source.vertices[representative]);
+        for (uint32_t vertex : cell.second) {
+            remap[vertex] = newIndex;
+            result.error = std::max(result.error, source.error
+                + distance(source.vertices[vertex].position, source.vertices[representative].position));
+        }
+    }
+
+    std::set<std::vector<uint32_t> > triangles; // Sorted corners, to drop duplicates.
+    for (size_t i = 0; i < source.indices.size(); i += 3) {
+        uint32_t a = remap[source.indices[i]], b = remap[source.indices[i + 1]], c = remap[source.indices[i + 2]];
+        if (a == b || b == c || a == c) {
+            continue;
+        }
+        std::vector<uint32_t> key = { a, b, c };
+        std::sort(key.begin(), key.end());
+        if (triangles.insert(key).second) {
+            result.indices.push_back(a);
+            result.indices.push_back(b);
+            result.indices.push_back(c);
+        }
+    }
+    return result;
+}
+
+// Splits the triangles into meshlets of at most MESH_MAX_MESHLET_VERTICES vertices and
+// MESH_MAX_MESHLET_TRIANGLES triangles. A meshlet grows by the neighbouring triangle that
+// adds the fewest new vertices. The indices come back in meshlet order.
+static void buildMeshlets(SourceMesh& mesh, std::vector<MeshMeshlet>& meshlets)
+{
+    uint32_t triangleCount = (uint32_t)mesh.indices.size() / 3;
+    std::vector<std::vector<uint32_t> > trianglesOfVertex(mesh.vertices.size());
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        for (uint32_t k = 0; k < 3; k++) {
+            trianglesOfVertex[mesh.indices[t * 3 + k]].push_back(t);
+        }
+    }
+
+    std::vector<bool> used(triangleCount, false);
+    std::vector<uint32_t> ordered;
+    ordered.reserve(mesh.indices.size());
+    uint32_t nextSeed = 0;
+    while (true) {
+        while (nextSeed < triangleCount && used[nextSeed]) {
+            nextSeed++;
+        }
+        if (nextSeed == triangleCount) {
+            break;
+        }
+
+        MeshMeshlet meshlet = {};
+        meshlet.firstIndex = (uint32_t)ordered.size();
+        std::vector<uint32_t> meshletVertices;
+        uint32_t triangle = nextSeed;
+        while (triangle != UINT32_MAX) {
+            used[triangle] = true;
+            for (uint32_t k = 0; k < 3; k++) {
+                uint32_t vertex = mesh.indices[triangle * 3 + k];
+                ordered.push_back(vertex);
+                if (std::find(meshletVertices.begin(), meshletVertices.end(), vertex) == meshletVertices.end()) {
+                    meshletVertices.push_back(vertex);
+                }
+            }
+            meshlet.indexCount += 3;
+            if (meshlet.indexCount / 3 == MESH_MAX_MESHLET_TRIANGLES) {
+                break;
+            }
+
+            // The unused neighbour adding the fewest vertices that still fits.
+            triangle = UINT32_MAX;
+            uint32_t fewestNew = 3;
+            for (uint32_t vertex : meshletVertices) {
+                for (uint32_t candidate : trianglesOfVertex[vertex]) {
+                    if (used[candidate]) {
+                        continue;
+                    }
+                    uint32_t newVertices = 0;
+                    for (uint32_t k = 0; k < 3; k++) {
+                        uint32_t corner = mesh.indices[candidate * 3 + k];
+                        newVertices += std::find(meshletVertices.begin(), meshletVertices.end(), corner) == meshletVertices.end();
+                    }
+                    if (newVertices < fewestNew && meshletVertices.size() + newVertices <= MESH_MAX_MESHLET_VERTICES) {
+                        fewestNew = newVertices;
+                        triangle = candidate;
+                    }
+                }
+            }
+        }
+
+        // Bounding sphere around the box of the meshlet's vertices.
+        float boxMin[3] = { INFINITY, INFINITY, INFINITY }, boxMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+        for (uint32_t vertex : meshletVertices) {
+            for (uint32_t k = 0; k < 3; k++) {
+                boxMin[k] = std::min(boxMin[k], mesh.vertices[vertex].position[k]);
+                boxMax[k] = std::max(boxMax[k], mesh.vertices[vertex].position[k]);
+            }
+        }
+        for (uint32_t k = 0; k < 3; k++) {
+            meshlet.center[k] = (boxMin[k] + boxMax[k]) * 0.5f;
+        }
+        for (uint32_t vertex : meshletVertices) {
+            meshlet.radius = std::max(meshlet.radius, distance(meshlet.center, mesh.vertices[vertex].position));
+        }
+        meshlets.push_back(meshlet);
+    }
+    mesh.indices.swap(ordered);
+
+    // Vertices in order of first use, so each meshlet reads a compact range.
+    std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+    std::vector<SourceVertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (auto& index : mesh.indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = (uint32_t)vertices.size();
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(vertices);
+}
+
+static uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if (exponent <= 0) {
+        return (uint16_t)sign; // Too small, flushed to zero.
+    }
+    if (exponent >= 31) {
+        return (uint16_t)(sign | 0x7C00); // Too large, infinity.
+    }
+    return (uint16_t)(sign | (exponent << 10) | ((mantissa + 0x1000) >> 13));
+}
+
+static int16_t toSnorm16(float value)
+{
+    return (int16_t)lroundf(std::max(-1.0f, std::min(1.0f, value)) * 32767.0f);
+}
+
+static int8_t toSnorm8(float value)
+{
+    return (int8_t)lroundf(std::max(-1.0f, std::min(1.0f, value)) * 127.0f);
+}
+
+static ConvertedLod quantizeLod(const SourceMesh& mesh, const std::vector<MeshMeshlet>& meshlets,
+    const float positionScale[3], const float positionOffset[3])
+{
+    ConvertedLod lod;
+    lod.indices = mesh.indices;
+    lod.meshlets = meshlets;
+    lod.error = mesh.error;
+    lod.vertices.resize(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        const SourceVertex& source = mesh.vertices[i];
+        MeshVertex& vertex = lod.vertices[i];
+        for (uint32_t k = 0; k < 3; k++) {
+            vertex.position[k] = toSnorm16((source.position[k] - positionOffset[k]) / positionScale[k]);
+            vertex.normal[k] = toSnorm8(source.normal[k]);
+        }
+        vertex.position[3] = 0;
+        vertex.normal[3] = 0;
+        vertex.uv[0] = floatToHalf(source.uv[0]);
+        vertex.uv[1] = floatToHalf(source.uv[1]);
+    }
+    return lod;
+}
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static bool writeMeshFile(const char* path, const std::vector<ConvertedLod>& lods,
+    const float positionScale[3], const float positionOffset[3])
+{
+    MeshFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = MESH_FILE_MAGIC;
+    header.version = MESH_FILE_VERSION;
+    header.vertexStride = sizeof(MeshVertex);
+    header.lodCount = (uint32_t)lods.size();
+    memcpy(header.positionScale, positionScale, sizeof(header.positionScale));
+    memcpy(header.positionOffset, positionOffset, sizeof(header.positionOffset));
+
+    // Lay out the blocks: vertices, indices, meshlets.
+    uint64_t offset = alignUp(sizeof(MeshFileHeader), MESH_LOD_ALIGNMENT);
+    for (uint32_t i = 0; i < header.lodCount; i++) {
+        MeshLod& lod = header.lods[i];
+        lod.blockOffset = offset;
+        lod.vertexCount = (uint32_t)lods[i].vertices.size();
+        lod.indexCount = (uint32_t)lods[i].indices.size();
+        lod.meshletCount = (uint32_t)lods[i].meshlets.size();
+        lod.indexSize = lod.vertexCount <= 65536 ? 2 : 4;
+        lod.error = lods[i].error;
+        lod.indexOffset = alignUp((uint64_t)lod.vertexCount * sizeof(MeshVertex), MESH_SECTION_ALIGNMENT);
+        lod.meshletOffset = alignUp(lod.indexOffset + (uint64_t)lod.indexCount * lod.indexSize, MESH_SECTION_ALIGNMENT);
+        lod.blockSize = lod.meshletOffset + (uint64_t)lod.meshletCount * sizeof(MeshMeshlet);
+        offset = alignUp(lod.blockOffset + lod.blockSize, MESH_LOD_ALIGNMENT);
+    }
+    header.fileSize = header.lods[header.lodCount - 1].blockOffset + header.lods[header.lodCount - 1].blockSize;
+
+    std::vector<char> data((size_t)header.fileSize, 0);
+    memcpy(data.data(), &header, sizeof(header));
+    for (uint32_t i = 0; i < header.lodCount; i++) {
+        const MeshLod& lod = header.lods[i];
+        char* block = &data[(size_t)lod.blockOffset];
+        memcpy(block, lods[i].vertices.data(), lods[i].vertices.size() * sizeof(MeshVertex));
+        for (uint32_t k = 0; k < lod.indexCount; k++) {
+            if (lod.indexSize == 2) {
+                uint16_t index = (uint16_t)lods[i].indices[k];
+                memcpy(block + lod.indexOffset + k * 2, &index, 2);
+            } else {
+                memcpy(block + lod.indexOffset + k * 4, &lods[i].indices[k], 4);
+            }
+        }
+        memcpy(block + lod.meshletOffset, lods[i].meshlets.data(), lods[i].meshlets.size() * sizeof(MeshMeshlet));
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open() || !file.write(data.data(), data.size())) {
+        std::cout << "Cannot write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 3) {
+        std::cout << "Usage: meshConverter <input.obj> <output.vkmesh>" << std::endl;
+        return 1;
+    }
+
+    SourceMesh mesh;
+    if (!loadObj(argv[1], mesh)) {
+        return 1;
+    }
+
+    float boundsMin[3] = { INFINITY, INFINITY, INFINITY }, boundsMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+    for (auto& vertex : mesh.vertices) {
+        for (uint32_t k = 0; k < 3; k++) {
+            boundsMin[k] = std::min(boundsMin[k], vertex.position[k]);
+            boundsMax[k] = std::max(boundsMax[k], vertex.position[k]);
+        }
+    }
+    float boundsSize[3], positionScale[3], positionOffset[3];
+    float maxExtent = 0.0f;
+    for (uint32_t k = 0; k < 3; k++) {
+        boundsSize[k] = boundsMax[k] - boundsMin[k];
+        positionOffset[k] = (boundsMin[k] + boundsMax[k]) * 0.5f;
+        positionScale[k] = std::max(boundsSize[k] * 0.5f, 1e-6f);
+        maxExtent = std::max(maxExtent, boundsSize[k]);
+    }
+
+    // LOD 0 is the input, each further LOD clusters on a grid half as fine. Grids that do not
+    // remove enough triangles are skipped.
+    std::vector<ConvertedLod> lods;
+    SourceMesh current = mesh;
+    for (uint32_t resolution = 256; lods.size() < MESH_MAX_LODS; resolution /= 2) {
+        SourceMesh lodMesh = current;
+        std::vector<MeshMeshlet> meshlets;
+        buildMeshlets(lodMesh, meshlets);
+        lods.push_back(quantizeLod(lodMesh, meshlets, positionScale, positionOffset));
+
+        SourceMesh coarser;
+        do {
+            coarser = clusterVertices(current, resolution, boundsMin, maxExtent);
+        } while (coarser.indices.size() > current.indices.size() * 3 / 4 && (resolution /= 2) >= 2);
+        if (resolution < 2 || coarser.indices.size() < 3 * 16) {
+            break;
+        }
+        current = coarser;
+    }
+
+    if (!writeMeshFile(argv[2], lods, positionScale, positionOffset)) {
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < (uint32_t)lods.size(); i++) {
+        std::cout << "LOD " << i << ": " << lods[i].vertices.size() << " vertices, " << lods[i].indices.size() / 3
+                  << " triangles, " << lods[i].meshlets.size() << " meshlets, error " << lods[i].error << std::endl;
+    }
+    return 0;
+}